@@ -30,6 +30,41 @@
 
 SpiCache *spi_global_cache = NULL;
 
+/*
+ * Number of removed objects that are remembered so that Cache.GetItemsPaged
+ * can report them to clients asking for the changes since a generation.
+ */
+#define SPI_CACHE_MAX_TOMBSTONES 4096
+
+/*
+ * Longest time spent walking the tree in one main loop iteration, so that
+ * registering a large application does not stall it.
+ */
+#define SPI_CACHE_SLICE_USEC 2000
+
+/*
+ * Most children of one object queued at a time, so that an object with a
+ * huge number of children does not overrun the slice.
+ */
+#define SPI_CACHE_MAX_CHILDREN_PER_STEP 256
+
+typedef struct _SpiCacheItem SpiCacheItem;
+struct _SpiCacheItem
+{
+  GObject *object;
+  guint generation;
+  SpiCacheRecord *record;
+  /* Changes when the object gains or loses children */
+  guint children_serial;
+};
+
+typedef struct _SpiCacheTombstone SpiCacheTombstone;
+struct _SpiCacheTombstone
+{
+  gchar *path;
+  guint generation;
+};
+
 static gboolean
 child_added_listener (GSignalInvocationHint *signal_hint,
                       guint n_param_values,
@@ -50,6 +85,12 @@ add_object (SpiCache *cache, GObject *gobj);
 static void
 add_subtree (SpiCache *cache, AtkObject *accessible);
 
+static void
+queue_pending (SpiCache *cache, AtkObject *accessible, SpiCachePriority priority);
+
+static gboolean
+add_pending_slice (SpiCache *cache);
+
 static gboolean
 add_pending_items (gpointer data);
 
@@ -64,12 +105,25 @@ enum
 {
   OBJECT_ADDED,
   OBJECT_REMOVED,
+  POPULATION_PROGRESS,
   LAST_SIGNAL
 };
 static guint cache_signals[LAST_SIGNAL] = { 0 };
 
 /*---------------------------------------------------------------------------*/
 
+static void
+item_free (gpointer data)
+{
+  SpiCacheItem *item = data;
+
+  if (item->record)
+    spi_cache_record_free (item->record);
+  g_free (item);
+}
+
+/*---------------------------------------------------------------------------*/
+
 G_DEFINE_TYPE (SpiCache, spi_cache, G_TYPE_OBJECT)
 
 static void
@@ -104,13 +158,45 @@ spi_cache_class_init (SpiCacheClass *klass)
                     G_TYPE_NONE,
                     1,
                     G_TYPE_OBJECT);
+
+  /*
+   * Emitted after each slice of the initial population of the cache, with
+   * the number of objects cached so far and the number still waiting.  The
+   * last emission has no objects waiting.
+   */
+  cache_signals[POPULATION_PROGRESS] =
+      g_signal_new ("population-progress",
+                    SPI_CACHE_TYPE,
+                    G_SIGNAL_ACTION,
+                    0,
+                    NULL,
+                    NULL,
+                    NULL,
+                    G_TYPE_NONE,
+                    2,
+                    G_TYPE_UINT,
+                    G_TYPE_UINT);
 }
 
 static void
 spi_cache_init (SpiCache *cache)
 {
+  gint i;
+
   cache->objects = g_hash_table_new (g_direct_hash, g_direct_equal);
-  cache->add_traversal = g_queue_new ();
+  cache->items = g_sequence_new (item_free);
+  cache->removed = g_queue_new ();
+  cache->generation = 0;
+  cache->removed_floor = 0;
+  cache->children_serial = 0;
+  for (i = 0; i < SPI_CACHE_N_PRIORITIES; i++)
+    cache->add_traversal[i] = g_queue_new ();
+  cache->populating = TRUE;
+  /* Opt into registering added subtrees lazily, see spi_cache_expand() */
+  cache->lazy_children = (g_strcmp0 (g_getenv ("ATSPI_LAZY_CHILDREN"), "1") == 0);
+  cache->unexpanded = g_hash_table_new (g_direct_hash, g_direct_equal);
+  cache->n_never_expanded = 0;
+  cache->child_walks = g_hash_table_new (g_direct_hash, g_direct_equal);
 
 #ifdef SPI_ATK_DEBUG
   if (g_thread_supported ())
@@ -123,7 +209,12 @@ spi_cache_init (SpiCache *cache)
                     "object-deregistered",
                     (GCallback) remove_object, cache);
 
-  add_subtree (cache, spi_global_app_data->root);
+  /*
+   * The first slice is left to the main loop too, so that the cache
+   * adaptor is listening for population-progress by the time it runs.
+   */
+  queue_pending (cache, g_object_ref (spi_global_app_data->root),
+                 SPI_CACHE_PRIORITY_VISIBLE);
 
   cache->child_added_listener = atk_add_global_event_listener (child_added_listener,
                                                                "Gtk:AtkObject:children-changed");
@@ -133,15 +224,30 @@ spi_cache_init (SpiCache *cache)
                     (GCallback) toplevel_added_listener, NULL);
 }
 
+static void
+tombstone_free (gpointer data)
+{
+  SpiCacheTombstone *tombstone = data;
+
+  g_free (tombstone->path);
+  g_free (tombstone);
+}
+
 static void
 spi_cache_finalize (GObject *object)
 {
   SpiCache *cache = SPI_CACHE (object);
-
-  while (!g_queue_is_empty (cache->add_traversal))
-    g_object_unref (G_OBJECT (g_queue_pop_head (cache->add_traversal)));
-  g_queue_free (cache->add_traversal);
+  gint i;
+
+  if (cache->add_pending_idle)
+    g_source_remove (cache->add_pending_idle);
+  for (i = 0; i < SPI_CACHE_N_PRIORITIES; i++)
+    g_queue_free_full (cache->add_traversal[i], g_object_unref);
+  g_hash_table_unref (cache->unexpanded);
+  g_hash_table_unref (cache->child_walks);
   g_hash_table_unref (cache->objects);
+  g_sequence_free (cache->items);
+  g_queue_free_full (cache->removed, tombstone_free);
 
   g_signal_handlers_disconnect_by_func (spi_global_register,
                                         (GCallback) remove_object, cache);
@@ -156,12 +262,45 @@ spi_cache_finalize (GObject *object)
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Remembers the path of a removed object, so that clients asking for the
+ * changes since an earlier generation can be told about the removal.
+ */
+static void
+add_tombstone (SpiCache *cache, GObject *gobj)
+{
+  SpiCacheTombstone *tombstone;
+
+  tombstone = g_new (SpiCacheTombstone, 1);
+  tombstone->path = spi_register_object_to_path (spi_global_register, gobj);
+  tombstone->generation = ++cache->generation;
+  g_queue_push_tail (cache->removed, tombstone);
+
+  if (g_queue_get_length (cache->removed) > SPI_CACHE_MAX_TOMBSTONES)
+    {
+      tombstone = g_queue_pop_head (cache->removed);
+      cache->removed_floor = tombstone->generation;
+      tombstone_free (tombstone);
+    }
+}
+
+static void
+forget_unexpanded (SpiCache *cache, GObject *gobj)
+{
+  if (g_hash_table_remove (cache->unexpanded, gobj))
+    cache->n_never_expanded++;
+}
+
 static void
 remove_object (GObject *source, GObject *gobj, gpointer data)
 {
   SpiCache *cache = SPI_CACHE (data);
+  GSequenceIter *seq_iter;
+
+  forget_unexpanded (cache, gobj);
 
-  if (spi_cache_in (cache, gobj))
+  if (g_hash_table_lookup_extended (cache->objects, gobj, NULL,
+                                    (gpointer *) &seq_iter))
     {
 #ifdef SPI_ATK_DEBUG
       g_debug ("CACHE REM - %s - %d - %s\n", atk_object_get_name (ATK_OBJECT (gobj)),
@@ -169,20 +308,46 @@ remove_object (GObject *source, GObject *gobj, gpointer data)
                spi_register_object_to_path (spi_global_register, gobj));
 #endif
       g_signal_emit (cache, cache_signals[OBJECT_REMOVED], 0, gobj);
+      add_tombstone (cache, gobj);
+      g_sequence_remove (seq_iter);
       g_hash_table_remove (cache->objects, gobj);
     }
-  else if (g_queue_remove (cache->add_traversal, gobj))
+  else
     {
-      g_object_unref (gobj);
+      gint i;
+
+      for (i = 0; i < SPI_CACHE_N_PRIORITIES; i++)
+        if (g_queue_remove (cache->add_traversal[i], gobj))
+          {
+            g_object_unref (gobj);
+            break;
+          }
     }
 }
 
 static void
 add_object (SpiCache *cache, GObject *gobj)
 {
+  SpiCacheItem *item;
+  GSequenceIter *seq_iter;
+
   g_return_if_fail (G_IS_OBJECT (gobj));
 
-  g_hash_table_insert (cache->objects, gobj, NULL);
+  /*
+   * An object that is added again is moved to the end of the sequence,
+   * since clients will see it as changed in the new generation.
+   */
+  if (g_hash_table_lookup_extended (cache->objects, gobj, NULL,
+                                    (gpointer *) &seq_iter))
+    g_sequence_remove (seq_iter);
+
+  item = g_new (SpiCacheItem, 1);
+  item->object = gobj;
+  item->generation = ++cache->generation;
+  item->record = NULL;
+  item->children_serial = ++cache->children_serial;
+  g_hash_table_insert (cache->objects, gobj,
+                       g_sequence_append (cache->items, item));
 
 #ifdef SPI_ATK_DEBUG
   g_debug ("CACHE ADD - %s - %d - %s\n", atk_object_get_name (ATK_OBJECT (gobj)),
@@ -223,16 +388,23 @@ recursion_check_unset ()
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Queues the children of @accessible, at most SPI_CACHE_MAX_CHILDREN_PER_STEP
+ * of them.  If some are left, @accessible is queued again after them, and
+ * queues the next ones when it is reached.
+ */
 static void
-append_children (AtkObject *accessible, GQueue *traversal)
+append_children (SpiCache *cache, AtkObject *accessible, GQueue *traversal)
 {
   AtkObject *current;
-  guint i;
+  gpointer next;
+  gint start = 0, end, i;
   gint count = atk_object_get_n_accessible_children (accessible);
 
-  if (count < 0)
-    count = 0;
-  for (i = 0; i < count; i++)
+  if (g_hash_table_lookup_extended (cache->child_walks, accessible, NULL, &next))
+    start = GPOINTER_TO_INT (next);
+  end = MIN (count, start + SPI_CACHE_MAX_CHILDREN_PER_STEP);
+  for (i = start; i < end; i++)
     {
       current = atk_object_ref_accessible_child (accessible, i);
       if (current)
@@ -240,6 +412,43 @@ append_children (AtkObject *accessible, GQueue *traversal)
           g_queue_push_tail (traversal, current);
         }
     }
+
+  if (end < count)
+    {
+      g_hash_table_insert (cache->child_walks, accessible, GINT_TO_POINTER (end));
+      g_queue_push_tail (traversal, g_object_ref (accessible));
+    }
+  else
+    g_hash_table_remove (cache->child_walks, accessible);
+}
+
+/*
+ * The children of an object are walked with the priority of the object,
+ * raised for an active or focused window and lowered for anything that is
+ * not showing.  The application itself is never showing, so its windows
+ * are decided by their own states.
+ */
+static SpiCachePriority
+child_priority (AtkObject *accessible,
+                AtkStateSet *set,
+                SpiCachePriority priority)
+{
+  if (atk_state_set_contains_state (set, ATK_STATE_ACTIVE) ||
+      atk_state_set_contains_state (set, ATK_STATE_FOCUSED))
+    return SPI_CACHE_PRIORITY_FOCUSED;
+  if (accessible != spi_global_app_data->root &&
+      !atk_state_set_contains_state (set, ATK_STATE_SHOWING))
+    return SPI_CACHE_PRIORITY_HIDDEN;
+  return priority;
+}
+
+static void
+queue_pending (SpiCache *cache, AtkObject *accessible, SpiCachePriority priority)
+{
+  g_queue_push_tail (cache->add_traversal[priority], accessible);
+
+  if (cache->add_pending_idle == 0)
+    cache->add_pending_idle = spi_idle_add (add_pending_items, cache);
 }
 
 /*
@@ -250,6 +459,9 @@ append_children (AtkObject *accessible, GQueue *traversal)
  * registered. A node is considered a leaf
  * if it has the state "manages-descendants"
  * or if it has already been registered.
+ *
+ * Only the first slice of the traversal is done right away; the rest is
+ * left to the main loop.
  */
 static void
 add_subtree (SpiCache *cache, AtkObject *accessible)
@@ -257,25 +469,52 @@ add_subtree (SpiCache *cache, AtkObject *accessible)
   g_return_if_fail (ATK_IS_OBJECT (accessible));
 
   g_object_ref (accessible);
-  g_queue_push_tail (cache->add_traversal, accessible);
-  add_pending_items (cache);
+  g_queue_push_tail (cache->add_traversal[SPI_CACHE_PRIORITY_VISIBLE], accessible);
+  if (add_pending_slice (cache) && cache->add_pending_idle == 0)
+    cache->add_pending_idle = spi_idle_add (add_pending_items, cache);
 }
 
+/*
+ * Walks the pending objects, most urgent first, for at most
+ * SPI_CACHE_SLICE_USEC, and adds the ones walked to the cache.
+ *
+ * Returns: whether some objects are still pending.
+ */
 static gboolean
-add_pending_items (gpointer data)
+add_pending_slice (SpiCache *cache)
 {
-  SpiCache *cache = SPI_CACHE (data);
   AtkObject *current;
   GQueue *to_add;
+  gint64 deadline;
+  guint n_pending;
+  gint priority = 0;
 
   to_add = g_queue_new ();
+  deadline = g_get_monotonic_time () + SPI_CACHE_SLICE_USEC;
 
-  while (!g_queue_is_empty (cache->add_traversal))
+  while (priority < SPI_CACHE_N_PRIORITIES)
     {
       AtkStateSet *set;
 
+      if (g_queue_is_empty (cache->add_traversal[priority]))
+        {
+          priority++;
+          continue;
+        }
+
       /* cache->add_traversal holds a ref to current */
-      current = g_queue_pop_head (cache->add_traversal);
+      current = g_queue_pop_head (cache->add_traversal[priority]);
+
+      /* Queued again for the rest of its children, see append_children() */
+      if (g_hash_table_contains (cache->child_walks, current))
+        {
+          append_children (cache, current, cache->add_traversal[priority]);
+          g_object_unref (current);
+          if (g_get_monotonic_time () >= deadline)
+            break;
+          continue;
+        }
+
       set = atk_object_ref_state_set (current);
 
       if (set && !atk_state_set_contains_state (set, ATK_STATE_TRANSIENT))
@@ -283,20 +522,30 @@ add_pending_items (gpointer data)
           /* transfer the ref into to_add */
           g_queue_push_tail (to_add, current);
           if (!spi_cache_in (cache, G_OBJECT (current)) &&
+              !g_hash_table_contains (cache->unexpanded, current) &&
               !atk_state_set_contains_state (set, ATK_STATE_MANAGES_DESCENDANTS) &&
               !atk_state_set_contains_state (set, ATK_STATE_DEFUNCT))
             {
-              append_children (current, cache->add_traversal);
+              SpiCachePriority next = child_priority (current, set, priority);
+
+              append_children (cache, current, cache->add_traversal[next]);
+              /* The children of a focused window may outrank the queue */
+              if (next < priority)
+                priority = next;
             }
         }
       else
         {
           /* drop the ref for the removed object */
+          forget_unexpanded (cache, G_OBJECT (current));
           g_object_unref (current);
         }
 
       if (set)
         g_object_unref (set);
+
+      if (g_get_monotonic_time () >= deadline)
+        break;
     }
 
   while (!g_queue_is_empty (to_add))
@@ -304,14 +553,34 @@ add_pending_items (gpointer data)
       current = g_queue_pop_head (to_add);
 
       /* Make sure object is registerd so we are notified if it goes away */
-      g_free (spi_register_object_to_path (spi_global_register,
-                                           G_OBJECT (current)));
+      spi_register_object_to_static_path (spi_global_register,
+                                          G_OBJECT (current));
 
       add_object (cache, G_OBJECT (current));
       g_object_unref (G_OBJECT (current));
     }
 
   g_queue_free (to_add);
+
+  n_pending = spi_cache_get_n_pending (cache);
+  if (cache->populating)
+    {
+      cache->populating = (n_pending > 0);
+      g_signal_emit (cache, cache_signals[POPULATION_PROGRESS], 0,
+                     g_hash_table_size (cache->objects), n_pending);
+    }
+
+  return (n_pending > 0);
+}
+
+static gboolean
+add_pending_items (gpointer data)
+{
+  SpiCache *cache = SPI_CACHE (data);
+
+  if (add_pending_slice (cache))
+    return TRUE;
+
   cache->add_pending_idle = 0;
   return FALSE;
 }
@@ -360,10 +629,9 @@ child_added_listener (GSignalInvocationHint *signal_hint,
             }
 
           g_object_ref (child);
-          g_queue_push_tail (cache->add_traversal, child);
-
-          if (cache->add_pending_idle == 0)
-            cache->add_pending_idle = spi_idle_add (add_pending_items, cache);
+          if (cache->lazy_children)
+            g_hash_table_add (cache->unexpanded, child);
+          queue_pending (cache, child, SPI_CACHE_PRIORITY_VISIBLE);
         }
 #ifdef SPI_ATK_DEBUG
       recursion_check_unset ();
@@ -403,10 +671,8 @@ toplevel_added_listener (AtkObject *accessible,
       else
         g_object_ref (child);
 
-      g_queue_push_tail (cache->add_traversal, child);
-
-      if (cache->add_pending_idle == 0)
-        cache->add_pending_idle = spi_idle_add (add_pending_items, cache);
+      if (child)
+        queue_pending (cache, child, SPI_CACHE_PRIORITY_VISIBLE);
 #ifdef SPI_ATK_DEBUG
       recursion_check_unset ();
 #endif
@@ -438,6 +704,366 @@ spi_cache_in (SpiCache *cache, GObject *object)
     return FALSE;
 }
 
+/*
+ * In lazy mode, a child added to a cached object is cached without walking
+ * its own children.  Such an object is expanded the first time a client
+ * asks for its children: all of them are cached before returning, again
+ * one level deep.
+ */
+void
+spi_cache_expand (SpiCache *cache, GObject *object)
+{
+  AtkObject *accessible;
+  AtkObject *child;
+  AtkStateSet *set;
+  gint count, i;
+
+  /* A pending object gets its children walked when it is reached */
+  if (!spi_cache_in (cache, object) ||
+      !g_hash_table_remove (cache->unexpanded, object))
+    return;
+
+  accessible = ATK_OBJECT (object);
+  count = atk_object_get_n_accessible_children (accessible);
+  for (i = 0; i < count; i++)
+    {
+      child = atk_object_ref_accessible_child (accessible, i);
+      if (!child)
+        continue;
+
+      set = atk_object_ref_state_set (child);
+      if (set && !atk_state_set_contains_state (set, ATK_STATE_TRANSIENT) &&
+          !spi_cache_in (cache, G_OBJECT (child)))
+        {
+          g_hash_table_add (cache->unexpanded, child);
+          spi_register_object_to_static_path (spi_global_register,
+                                              G_OBJECT (child));
+          add_object (cache, G_OBJECT (child));
+        }
+
+      if (set)
+        g_object_unref (set);
+      g_object_unref (child);
+    }
+}
+
+/*
+ * Walks the whole subtree of every unexpanded object, for clients that
+ * want every object of the application.  With @wait, the walk is finished
+ * before returning instead of being left to the main loop.
+ */
+void
+spi_cache_expand_all (SpiCache *cache, gboolean wait)
+{
+  GHashTable *unexpanded;
+  GHashTableIter iter;
+  gpointer object;
+
+  if (!cache)
+    return;
+
+  /* Querying the toolkit may add more unexpanded objects */
+  unexpanded = cache->unexpanded;
+  cache->unexpanded = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  g_hash_table_iter_init (&iter, unexpanded);
+  while (g_hash_table_iter_next (&iter, &object, NULL))
+    {
+      if (spi_cache_in (cache, object))
+        append_children (cache, ATK_OBJECT (object),
+                         cache->add_traversal[SPI_CACHE_PRIORITY_VISIBLE]);
+    }
+  g_hash_table_unref (unexpanded);
+
+  if (wait)
+    while (add_pending_slice (cache))
+      ;
+  else if (spi_cache_get_n_pending (cache) > 0 && cache->add_pending_idle == 0)
+    cache->add_pending_idle = spi_idle_add (add_pending_items, cache);
+}
+
+/*
+ * Reports how many objects are waiting to be expanded, and how many went
+ * away without ever being expanded.
+ */
+void
+spi_cache_get_lazy_counters (SpiCache *cache,
+                             guint *n_unexpanded,
+                             guint *n_never_expanded)
+{
+  if (n_unexpanded)
+    *n_unexpanded = g_hash_table_size (cache->unexpanded);
+  if (n_never_expanded)
+    *n_never_expanded = cache->n_never_expanded;
+}
+
+/*
+ * Returns the number of objects that were found but are not walked yet.  An
+ * object whose children are only partly queued counts once more.
+ */
+guint
+spi_cache_get_n_pending (SpiCache *cache)
+{
+  guint n_pending = 0;
+  gint i;
+
+  for (i = 0; i < SPI_CACHE_N_PRIORITIES; i++)
+    n_pending += g_queue_get_length (cache->add_traversal[i]);
+  return n_pending;
+}
+
+guint
+spi_cache_get_generation (SpiCache *cache)
+{
+  return cache->generation;
+}
+
+/*
+ * Orders cache items by generation.  An item without an object is a search
+ * key, and sorts after any real item of the same generation so that
+ * g_sequence_search() finds the first item added after that generation.
+ */
+static gint
+compare_item_generation (gconstpointer a, gconstpointer b, gpointer data)
+{
+  const SpiCacheItem *item_a = a;
+  const SpiCacheItem *item_b = b;
+
+  if (item_a->generation != item_b->generation)
+    return (item_a->generation < item_b->generation ? -1 : 1);
+  if (!item_a->object)
+    return 1;
+  if (!item_b->object)
+    return -1;
+  return 0;
+}
+
+/*
+ * Returns a new reference to up to @max_items cached objects that were
+ * added after @generation, oldest first.  A @max_items of 0 means no limit.
+ *
+ * @next_generation is set to the generation that should be passed to get
+ * the following page, and @complete to whether there are no more objects
+ * after this page, in which case @next_generation is the current generation
+ * of the cache.
+ *
+ * The objects are referenced so that the caller may query them even if this
+ * removes them from the cache.
+ */
+GPtrArray *
+spi_cache_ref_items_since (SpiCache *cache,
+                           guint generation,
+                           guint max_items,
+                           guint *next_generation,
+                           gboolean *complete)
+{
+  GPtrArray *objects;
+  GSequenceIter *seq_iter;
+  SpiCacheItem key = { NULL, generation, NULL };
+  guint last = generation;
+
+  objects = g_ptr_array_new_with_free_func (g_object_unref);
+
+  seq_iter = g_sequence_search (cache->items, &key,
+                                compare_item_generation, NULL);
+  while (!g_sequence_iter_is_end (seq_iter) &&
+         (max_items == 0 || objects->len < max_items))
+    {
+      SpiCacheItem *item = g_sequence_get (seq_iter);
+
+      g_ptr_array_add (objects, g_object_ref (item->object));
+      last = item->generation;
+      seq_iter = g_sequence_iter_next (seq_iter);
+    }
+
+  *complete = g_sequence_iter_is_end (seq_iter);
+  *next_generation = (*complete ? cache->generation : last);
+  return objects;
+}
+
+/*
+ * Returns: whether every object removed from the cache after @generation is
+ * still remembered.
+ */
+gboolean
+spi_cache_remembers_removals_since (SpiCache *cache, guint generation)
+{
+  return (generation >= cache->removed_floor);
+}
+
+/*
+ * Calls @func with the D-Bus path of every object that was removed from the
+ * cache after @generation.
+ *
+ * Returns: FALSE, without calling @func, if some of those removals have
+ * already been forgotten, in which case the caller cannot compute an
+ * accurate delta.
+ */
+gboolean
+spi_cache_foreach_removed_since (SpiCache *cache,
+                                 guint generation,
+                                 GFunc func,
+                                 gpointer data)
+{
+  GList *l;
+
+  if (generation < cache->removed_floor)
+    return FALSE;
+
+  for (l = cache->removed->tail; l; l = l->prev)
+    {
+      SpiCacheTombstone *tombstone = l->data;
+
+      if (tombstone->generation <= generation)
+        break;
+    }
+
+  for (l = (l ? l->next : cache->removed->head); l; l = l->next)
+    {
+      SpiCacheTombstone *tombstone = l->data;
+
+      if (tombstone->path)
+        func (tombstone->path, data);
+    }
+
+  return TRUE;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static SpiCacheItem *
+lookup_item (SpiCache *cache, GObject *object)
+{
+  GSequenceIter *seq_iter;
+
+  if (!cache)
+    return NULL;
+
+  seq_iter = g_hash_table_lookup (cache->objects, object);
+  return (seq_iter ? g_sequence_get (seq_iter) : NULL);
+}
+
+/*
+ * Takes the record kept for @object by spi_cache_store_record(), if any, and
+ * sets @generation to the one the object is in, or 0 if it is not cached.
+ *
+ * The record is taken out of the cache while the caller uses it, since
+ * querying the toolkit may cause the object to signal a change and have its
+ * record dropped.
+ */
+SpiCacheRecord *
+spi_cache_steal_record (SpiCache *cache, GObject *object, guint *generation)
+{
+  SpiCacheItem *item = lookup_item (cache, object);
+  SpiCacheRecord *record;
+
+  if (!item)
+    {
+      *generation = 0;
+      return NULL;
+    }
+
+  *generation = item->generation;
+  record = item->record;
+  item->record = NULL;
+  return record;
+}
+
+/*
+ * Keeps @record for @object until the object changes.  The cache takes
+ * ownership of @record, which is freed right away if @object is no longer
+ * cached, or has changed since @generation was returned by
+ * spi_cache_steal_record().
+ */
+void
+spi_cache_store_record (SpiCache *cache,
+                        GObject *object,
+                        SpiCacheRecord *record,
+                        guint generation)
+{
+  SpiCacheItem *item = lookup_item (cache, object);
+
+  if (!item || item->generation != generation)
+    {
+      spi_cache_record_free (record);
+      return;
+    }
+
+  if (item->record)
+    spi_cache_record_free (item->record);
+  item->record = record;
+}
+
+void
+spi_cache_record_free (SpiCacheRecord *record)
+{
+  g_free (record->name);
+  g_free (record->description);
+  g_free (record->interfaces);
+  g_free (record);
+}
+
+/*
+ * Drops the record of a cached object that has signalled a change, and
+ * moves the object to a new generation so that clients asking for the
+ * changes since an earlier generation are sent its new data.
+ */
+void
+spi_cache_invalidate (SpiCache *cache, GObject *object)
+{
+  GSequenceIter *seq_iter;
+  SpiCacheItem *item;
+
+  if (!cache)
+    return;
+
+  seq_iter = g_hash_table_lookup (cache->objects, object);
+  if (!seq_iter)
+    return;
+
+  item = g_sequence_get (seq_iter);
+  if (item->record)
+    {
+      spi_cache_record_free (item->record);
+      item->record = NULL;
+    }
+
+  item->generation = ++cache->generation;
+  g_sequence_move (seq_iter, g_sequence_get_end_iter (cache->items));
+}
+
+/*
+ * Called when @object gains or loses children.  Besides the child count of
+ * @object, this may shift the index in parent of any of its children, whose
+ * records see it through spi_cache_get_children_serial().
+ */
+void
+spi_cache_invalidate_children (SpiCache *cache, GObject *object)
+{
+  SpiCacheItem *item;
+
+  if (!cache)
+    return;
+
+  item = lookup_item (cache, object);
+  if (item)
+    item->children_serial = ++cache->children_serial;
+  spi_cache_invalidate (cache, object);
+}
+
+/*
+ * Returns a number that changes whenever @object gains or loses children,
+ * or 0 if @object is not cached.  The index in parent of a child of @object
+ * is still valid as long as this does not change.
+ */
+guint
+spi_cache_get_children_serial (SpiCache *cache, GObject *object)
+{
+  SpiCacheItem *item = (object ? lookup_item (cache, object) : NULL);
+
+  return (item ? item->children_serial : 0);
+}
+
 #ifdef SPI_ATK_DEBUG
 void
 spi_cache_print_info (GObject *obj)
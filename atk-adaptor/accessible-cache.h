@@ -28,6 +28,7 @@
 
 typedef struct _SpiCache SpiCache;
 typedef struct _SpiCacheClass SpiCacheClass;
+typedef struct _SpiCacheRecord SpiCacheRecord;
 
 G_BEGIN_DECLS
 
@@ -37,13 +38,47 @@ G_BEGIN_DECLS
 #define SPI_IS_CACHE(o) (G_TYPE_CHECK__INSTANCE_TYPE ((o), SPI_CACHE_TYPE))
 #define SPI_IS_CACHE_CLASS(k) (G_TYPE_CHECK_CLASS_TYPE ((k), SPI_CACHE_TYPE))
 
+/*
+ * Objects waiting to be added to the cache are walked in order of priority:
+ * first the contents of active or focused windows, then the rest of what is
+ * showing, and last whatever is hidden.
+ */
+typedef enum
+{
+  SPI_CACHE_PRIORITY_FOCUSED,
+  SPI_CACHE_PRIORITY_VISIBLE,
+  SPI_CACHE_PRIORITY_HIDDEN,
+  SPI_CACHE_N_PRIORITIES
+} SpiCachePriority;
+
 struct _SpiCache
 {
   GObject parent;
 
+  /* Maps each cached GObject to its GSequenceIter in 'items' */
   GHashTable *objects;
-  GQueue *add_traversal;
+  /* SpiCacheItems, ordered by the generation in which they were added */
+  GSequence *items;
+  /* SpiCacheTombstones for recently removed objects, oldest first */
+  GQueue *removed;
+  guint generation;
+  guint removed_floor;
+  /* Source of the children serials of cached objects */
+  guint children_serial;
+  /* Referenced objects waiting to be added, one queue per SpiCachePriority */
+  GQueue *add_traversal[SPI_CACHE_N_PRIORITIES];
   gint add_pending_idle;
+  /* Whether the initial population of the cache is still running */
+  gboolean populating;
+  /* Whether children added later are registered one level deep only */
+  gboolean lazy_children;
+  /* Objects whose children have not been walked yet, in lazy mode */
+  GHashTable *unexpanded;
+  /* Unexpanded objects that went away before any client looked into them */
+  guint n_never_expanded;
+  /* Objects whose children are being queued a few at a time, mapped to
+   * the index of the next child to queue */
+  GHashTable *child_walks;
 
   guint child_added_listener;
 };
@@ -53,6 +88,30 @@ struct _SpiCacheClass
   GObjectClass parent_class;
 };
 
+/*
+ * The toolkit data marshalled for an object by the Cache interface.  It is
+ * kept with the cached object until the object signals a change, so that
+ * repeated GetItems calls do not query the toolkit again.
+ *
+ * The index in parent is only valid while children_serial matches the
+ * children serial of the parent, since the parent gaining or losing
+ * children may shift it.  The child count goes with the rest of the record.
+ */
+struct _SpiCacheRecord
+{
+  gchar *name;
+  gchar *description;
+  const gchar **interfaces; /* static strings */
+  guint n_interfaces;
+  guint32 role;
+  guint32 states[2];
+  gboolean wants_index;
+  gboolean wants_children;
+  gint32 index;
+  gint32 child_count;
+  guint children_serial;
+};
+
 GType spi_cache_get_type (void);
 
 extern SpiCache *spi_global_cache;
@@ -63,5 +122,59 @@ spi_cache_foreach (SpiCache *cache, GHFunc func, gpointer data);
 gboolean
 spi_cache_in (SpiCache *cache, GObject *object);
 
+guint
+spi_cache_get_n_pending (SpiCache *cache);
+
+void
+spi_cache_expand (SpiCache *cache, GObject *object);
+
+void
+spi_cache_expand_all (SpiCache *cache, gboolean wait);
+
+void
+spi_cache_get_lazy_counters (SpiCache *cache,
+                             guint *n_unexpanded,
+                             guint *n_never_expanded);
+
+guint
+spi_cache_get_generation (SpiCache *cache);
+
+GPtrArray *
+spi_cache_ref_items_since (SpiCache *cache,
+                           guint generation,
+                           guint max_items,
+                           guint *next_generation,
+                           gboolean *complete);
+
+gboolean
+spi_cache_remembers_removals_since (SpiCache *cache, guint generation);
+
+gboolean
+spi_cache_foreach_removed_since (SpiCache *cache,
+                                 guint generation,
+                                 GFunc func,
+                                 gpointer data);
+
+SpiCacheRecord *
+spi_cache_steal_record (SpiCache *cache, GObject *object, guint *generation);
+
+void
+spi_cache_store_record (SpiCache *cache,
+                        GObject *object,
+                        SpiCacheRecord *record,
+                        guint generation);
+
+void
+spi_cache_record_free (SpiCacheRecord *record);
+
+void
+spi_cache_invalidate (SpiCache *cache, GObject *object);
+
+void
+spi_cache_invalidate_children (SpiCache *cache, GObject *object);
+
+guint
+spi_cache_get_children_serial (SpiCache *cache, GObject *object);
+
 G_END_DECLS
 #endif /* ACCESSIBLE_CACHE_H */
@@ -35,11 +35,32 @@
 
 SpiLeasing *spi_global_leasing;
 
-typedef struct _ExpiryElement
+/*
+  The lease time is expected to be in seconds, the rounding is going to be to
+  intervals of 1 second.
+
+  The lease time is going to be rounded up, as the lease time should be
+  considered a MINIMUM that the object will be leased for.
+*/
+#define LEASE_TIME_S 15
+#define EXPIRY_TIME_S (LEASE_TIME_S + 1)
+
+/*
+  Leases are kept in a timing wheel with a bucket for each second of expiry
+  time, so that all the leases ending in the same second are released
+  together.  As leases never end more than EXPIRY_TIME_S in the future, the
+  wheel only needs one more bucket than that.  A shorter lease_time_s only
+  uses fewer of the buckets.
+*/
+#define WHEEL_SIZE (EXPIRY_TIME_S + 1)
+
+typedef struct _SpiLease
 {
-  gint64 expiry_s;
   GObject *object;
-} ExpiryElement;
+  gint64 expiry_s;
+  /* Link in the wheel bucket for expiry_s */
+  GList link;
+} SpiLease;
 
 static void spi_leasing_dispose (GObject *object);
 
@@ -65,8 +86,12 @@ spi_leasing_class_init (SpiLeasingClass *klass)
 static void
 spi_leasing_init (SpiLeasing *leasing)
 {
-  leasing->expiry_queue = g_queue_new ();
+  leasing->leases = g_hash_table_new (g_direct_hash, g_direct_equal);
+  leasing->wheel = g_new0 (GQueue, WHEEL_SIZE);
   leasing->expiry_func_id = 0;
+  leasing->lease_time_s = LEASE_TIME_S;
+  leasing->n_leases = 0;
+  leasing->peak_leases = 0;
 }
 
 static void
@@ -76,20 +101,40 @@ spi_leasing_finalize (GObject *object)
 
   if (leasing->expiry_func_id)
     g_source_remove (leasing->expiry_func_id);
-  g_queue_free (leasing->expiry_queue);
+  g_hash_table_unref (leasing->leases);
+  g_free (leasing->wheel);
   G_OBJECT_CLASS (spi_leasing_parent_class)->finalize (object);
 }
 
+/*
+  Removes the lease from the wheel and the lease table, and returns
+  the leased object, whose reference is passed to the caller.
+*/
+static GObject *
+end_lease (SpiLeasing *leasing, SpiLease *lease)
+{
+  GObject *object = lease->object;
+
+  g_queue_unlink (&leasing->wheel[lease->expiry_s % WHEEL_SIZE], &lease->link);
+  g_hash_table_remove (leasing->leases, object);
+  g_slice_free (SpiLease, lease);
+  leasing->n_leases--;
+
+  return object;
+}
+
 static void
 spi_leasing_dispose (GObject *object)
 {
   SpiLeasing *leasing = SPI_LEASING (object);
+  guint i;
 
-  ExpiryElement *head;
-  while ((head = g_queue_pop_head (leasing->expiry_queue)))
+  for (i = 0; i < WHEEL_SIZE; i++)
     {
-      g_object_unref (head->object);
-      g_slice_free (ExpiryElement, head);
+      GList *head;
+
+      while ((head = g_queue_peek_head_link (&leasing->wheel[i])))
+        g_object_unref (end_lease (leasing, head->data));
     }
   G_OBJECT_CLASS (spi_leasing_parent_class)->dispose (object);
 }
@@ -100,29 +145,34 @@ spi_leasing_dispose (GObject *object)
   End the lease on all objects whose expiry time has passed.
 
   Check when the next event is and set the next expiry func.
+
+  Within a bucket leases are ordered by expiry time.  A bucket normally only
+  holds leases ending in the same second, but may also hold leases ending one
+  turn of the wheel later if this function ran late.
 */
 static gboolean
 expiry_func (gpointer data)
 {
   SpiLeasing *leasing = SPI_LEASING (data);
 
-  ExpiryElement *head, *current;
+  GList *head;
   gint64 secs = g_get_monotonic_time () / 1000000;
+  guint i;
 
-  head = g_queue_peek_head (leasing->expiry_queue);
-  while (head != NULL && head->expiry_s <= secs)
+  for (i = 0; i < WHEEL_SIZE; i++)
     {
-      current = g_queue_pop_head (leasing->expiry_queue);
+      while ((head = g_queue_peek_head_link (&leasing->wheel[i])) &&
+             ((SpiLease *) head->data)->expiry_s <= secs)
+        {
+          GObject *object = end_lease (leasing, head->data);
 
 #ifdef SPI_ATK_DEBUG
-      g_debug ("REVOKE - ");
-      spi_cache_print_info (current->object);
+          g_debug ("REVOKE - ");
+          spi_cache_print_info (object);
 #endif
 
-      g_object_unref (current->object);
-      g_slice_free (ExpiryElement, current);
-
-      head = g_queue_peek_head (leasing->expiry_queue);
+          g_object_unref (object);
+        }
     }
 
   leasing->expiry_func_id = 0;
@@ -135,11 +185,10 @@ expiry_func (gpointer data)
 
 /*
   Checks if an expiry timeout is already scheduled, if so returns.
-  This is becasue events will always be added to the end of the queue.
-  Events are always later in time to previoulsy added events.
+  Leases are only ever extended, so a scheduled timeout is never late.
 
-  Otherwise calculate the next wake time using the top of the queue
-  and add the next expiry function.
+  Otherwise calculate the next wake time using the earliest lease on the
+  wheel and add the next expiry function.
 
   This function is called when a lease is added or at the end of the
   expiry function to add the next expiry timeout.
@@ -147,65 +196,88 @@ expiry_func (gpointer data)
 static void
 add_expiry_timeout (SpiLeasing *leasing)
 {
-  ExpiryElement *elem;
   gint64 secs = g_get_monotonic_time () / 1000000;
-  guint next_expiry;
+  gint64 next_expiry_s = G_MAXINT64;
+  guint i;
 
-  if (leasing->expiry_func_id != 0)
+  if (leasing->expiry_func_id != 0 || leasing->n_leases == 0)
     return;
 
-  elem = (ExpiryElement *) g_queue_peek_head (leasing->expiry_queue);
-  if (elem == NULL)
-    return;
+  for (i = 0; i < WHEEL_SIZE; i++)
+    {
+      SpiLease *lease = g_queue_peek_head (&leasing->wheel[i]);
+
+      if (lease && lease->expiry_s < next_expiry_s)
+        next_expiry_s = lease->expiry_s;
+    }
 
-  next_expiry = elem->expiry_s - secs;
-  leasing->expiry_func_id = spi_timeout_add_seconds (next_expiry,
+  leasing->expiry_func_id = spi_timeout_add_seconds (MAX (next_expiry_s - secs, 0),
                                                      expiry_func, leasing);
 }
 
 /*---------------------------------------------------------------------------*/
 
-/*
-  The lease time is expected to be in seconds, the rounding is going to be to
-  intervals of 1 second.
-
-  The lease time is going to be rounded up, as the lease time should be
-  considered a MINIMUM that the object will be leased for.
-*/
-#define LEASE_TIME_S 15
-#define EXPIRY_TIME_S (LEASE_TIME_S + 1)
-
 GObject *
 spi_leasing_take (SpiLeasing *leasing, GObject *object)
 {
   /*
      Get the current time.
      Quantize the time.
-     Add the release event to the queue.
+     Add the object to the wheel, or move its existing lease.
      Check the next expiry.
    */
 
   gint64 secs = g_get_monotonic_time () / 1000000;
-  guint expiry_s;
+  gint64 expiry_s;
+
+  SpiLease *lease;
 
-  ExpiryElement *elem;
+  expiry_s = secs + MIN (leasing->lease_time_s, LEASE_TIME_S) + 1;
 
-  expiry_s = secs + EXPIRY_TIME_S;
+  lease = g_hash_table_lookup (leasing->leases, object);
+  if (lease)
+    {
+      if (lease->expiry_s == expiry_s)
+        return object;
 
-  elem = g_slice_new (ExpiryElement);
-  elem->expiry_s = expiry_s;
-  elem->object = g_object_ref (object);
+      g_queue_unlink (&leasing->wheel[lease->expiry_s % WHEEL_SIZE], &lease->link);
+    }
+  else
+    {
+      lease = g_slice_new0 (SpiLease);
+      lease->object = g_object_ref (object);
+      lease->link.data = lease;
+      g_hash_table_insert (leasing->leases, object, lease);
+
+      leasing->n_leases++;
+      if (leasing->n_leases > leasing->peak_leases)
+        leasing->peak_leases = leasing->n_leases;
+    }
 
-  g_queue_push_tail (leasing->expiry_queue, elem);
+  lease->expiry_s = expiry_s;
+  g_queue_push_tail_link (&leasing->wheel[expiry_s % WHEEL_SIZE], &lease->link);
 
   add_expiry_timeout (leasing);
 
 #ifdef SPI_ATK_DEBUG
-  g_debug ("LEASE - ");
+  g_debug ("LEASE - %u leased, peak %u", leasing->n_leases, leasing->peak_leases);
   spi_cache_print_info (object);
 #endif
 
   return object;
 }
 
+/*
+  Gets the number of objects currently leased, and the highest number of
+  objects leased at once since the bridge started.
+*/
+void
+spi_leasing_get_counters (SpiLeasing *leasing, guint *n_leases, guint *peak_leases)
+{
+  if (n_leases)
+    *n_leases = leasing->n_leases;
+  if (peak_leases)
+    *peak_leases = leasing->peak_leases;
+}
+
 /*END------------------------------------------------------------------------*/
@@ -42,8 +42,17 @@ struct _SpiLeasing
 {
   GObject parent;
 
-  GQueue *expiry_queue;
+  /* Maps each leased GObject to its SpiLease */
+  GHashTable *leases;
+  /* Timing wheel of SpiLeases, one bucket per second of expiry time */
+  GQueue *wheel;
   guint expiry_func_id;
+  /* Seconds that a lease lasts at least; tests lower it */
+  guint lease_time_s;
+
+  /* Debug counters */
+  guint n_leases;
+  guint peak_leases;
 };
 
 struct _SpiLeasingClass
@@ -57,5 +66,7 @@ extern SpiLeasing *spi_global_leasing;
 
 GObject *spi_leasing_take (SpiLeasing *leasing, GObject *object);
 
+void spi_leasing_get_counters (SpiLeasing *leasing, guint *n_leases, guint *peak_leases);
+
 G_END_DECLS
 #endif /* ACCESSIBLE_LEASING_H */
@@ -35,15 +35,20 @@
  *
  * To access an AtkObject remotely we need to provide a D-Bus object
  * path for it. The D-Bus object paths used have a standard prefix
- * (SPI_ATK_OBJECT_PATH_PREFIX). Appended to this prefix is a string
- * representation of an integer reference. So to access an AtkObject
- * remotely we keep a Hashtable that maps the given reference to
- * the AtkObject pointer. An object in this hash table is said to be 'registered'.
+ * (SPI_ATK_OBJECT_PATH_PREFIX). Appended to this prefix is the index of
+ * a slot in a table of registered objects, followed by the number of times
+ * the slot has been reused when that is not zero, as in ".../accessible/12"
+ * or ".../accessible/12_3".  The generation keeps a path that a client still
+ * holds for a destroyed object from resolving to a newer object in the same
+ * slot.  An object in the slot table is said to be 'registered'.
  *
  * The architecture of AT-SPI dbus is such that AtkObjects are not
  * remotely reference counted. This means that we need to keep track of
  * object destruction. When an object is destroyed it must be 'deregistered'
- * To do this lookup we keep a dbus-id attribute on each AtkObject.
+ * To do this lookup the register maps each object to its slot index in a
+ * table of its own, rather than in qdata: looking up qdata walks a list
+ * kept on the object that other code also stores data in, and setting it
+ * takes the global qdata lock.
  *
  */
 
@@ -51,9 +56,21 @@
 #define SPI_ATK_OBJECT_PATH_PREFIX "/org/a11y/atspi/accessible/"
 #define SPI_ATK_OBJECT_PATH_ROOT "root"
 
-#define SPI_ATK_OBJECT_REFERENCE_TEMPLATE SPI_ATK_OBJECT_PATH_PREFIX "%d"
+/* Terminates the free slot list */
+#define SPI_REGISTER_NO_SLOT 0
 
-#define SPI_DBUS_ID "spi-dbus-id"
+typedef struct _SpiRegisterSlot SpiRegisterSlot;
+struct _SpiRegisterSlot
+{
+  /* The registered object, or NULL if the slot is free */
+  GObject *object;
+  /* D-Bus path of the object */
+  gchar *path;
+  /* Number of times the slot has been reused */
+  guint32 generation;
+  /* Next free slot, while this one is free */
+  guint32 next_free;
+};
 
 SpiRegister *spi_global_register = NULL;
 
@@ -113,8 +130,14 @@ spi_register_class_init (SpiRegisterClass *klass)
 static void
 spi_register_init (SpiRegister *reg)
 {
-  reg->ref2ptr = g_hash_table_new (g_direct_hash, g_direct_equal);
-  reg->reference_counter = 0;
+  SpiRegisterSlot unused = { NULL, NULL, 0, SPI_REGISTER_NO_SLOT };
+
+  reg->slots = g_array_new (FALSE, FALSE, sizeof (SpiRegisterSlot));
+  /* Slot 0 is never used, so that a reference of 0 means 'not registered' */
+  g_array_append_val (reg->slots, unused);
+  reg->refs = g_hash_table_new (g_direct_hash, g_direct_equal);
+  reg->free_slot = SPI_REGISTER_NO_SLOT;
+  reg->n_registered = 0;
 }
 
 static void
@@ -125,19 +148,22 @@ deregister_object (gpointer data, GObject *gobj)
   spi_register_deregister_object (reg, gobj, FALSE);
 }
 
-static void
-spi_register_remove_weak_ref (gpointer key, gpointer val, gpointer reg)
-{
-  g_object_weak_unref (val, deregister_object, reg);
-}
-
 static void
 spi_register_finalize (GObject *object)
 {
   SpiRegister *reg = SPI_REGISTER (object);
+  guint i;
 
-  g_hash_table_foreach (reg->ref2ptr, spi_register_remove_weak_ref, reg);
-  g_hash_table_unref (reg->ref2ptr);
+  for (i = 1; i < reg->slots->len; i++)
+    {
+      SpiRegisterSlot *slot = &g_array_index (reg->slots, SpiRegisterSlot, i);
+
+      if (slot->object)
+        g_object_weak_unref (slot->object, deregister_object, reg);
+      g_free (slot->path);
+    }
+  g_array_free (reg->slots, TRUE);
+  g_hash_table_destroy (reg->refs);
 
   G_OBJECT_CLASS (spi_register_parent_class)->finalize (object);
 }
@@ -147,19 +173,49 @@ spi_register_finalize (GObject *object)
 /*
  * Each AtkObject must be asssigned a D-Bus path (Reference)
  *
- * This function provides an integer reference for a new
- * AtkObject.
- *
- * TODO: Make this reference a little more unique, this is shoddy.
+ * This function provides a free slot for a new AtkObject, reusing
+ * the slots of deregistered objects before growing the table.
  */
 static guint
 assign_reference (SpiRegister *reg)
 {
-  reg->reference_counter++;
-  /* Reference of 0 not allowed as used as direct key in hash table */
-  if (reg->reference_counter == 0)
-    reg->reference_counter++;
-  return reg->reference_counter;
+  SpiRegisterSlot *slot;
+  guint ref;
+
+  if (reg->free_slot != SPI_REGISTER_NO_SLOT)
+    {
+      ref = reg->free_slot;
+      slot = &g_array_index (reg->slots, SpiRegisterSlot, ref);
+      reg->free_slot = slot->next_free;
+    }
+  else
+    {
+      SpiRegisterSlot unused = { NULL, NULL, 0, SPI_REGISTER_NO_SLOT };
+
+      ref = reg->slots->len;
+      g_array_append_val (reg->slots, unused);
+      slot = &g_array_index (reg->slots, SpiRegisterSlot, ref);
+    }
+
+  if (slot->generation)
+    slot->path = g_strdup_printf (SPI_ATK_OBJECT_PATH_PREFIX "%u_%u",
+                                  ref, slot->generation);
+  else
+    slot->path = g_strdup_printf (SPI_ATK_OBJECT_PATH_PREFIX "%u", ref);
+
+  return ref;
+}
+
+static void
+release_reference (SpiRegister *reg, guint ref)
+{
+  SpiRegisterSlot *slot = &g_array_index (reg->slots, SpiRegisterSlot, ref);
+
+  slot->object = NULL;
+  g_clear_pointer (&slot->path, g_free);
+  slot->generation++;
+  slot->next_free = reg->free_slot;
+  reg->free_slot = ref;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -168,18 +224,45 @@ assign_reference (SpiRegister *reg)
  * Returns the reference of the object, or 0 if it is not registered.
  */
 static guint
-object_to_ref (GObject *gobj)
+object_to_ref (SpiRegister *reg, GObject *gobj)
 {
-  return GPOINTER_TO_INT (g_object_get_data (gobj, SPI_DBUS_ID));
+  return GPOINTER_TO_UINT (g_hash_table_lookup (reg->refs, gobj));
 }
 
 /*
- * Converts the Accessible object reference to its D-Bus object path
+ * Parses the part of a D-Bus path that follows the prefix into a slot
+ * reference, checking the generation of the slot.
+ *
+ * Returns 0 if the path does not name a registered object.
  */
-static gchar *
-ref_to_path (guint ref)
+static guint
+path_to_ref (SpiRegister *reg, const char *path)
 {
-  return g_strdup_printf (SPI_ATK_OBJECT_REFERENCE_TEMPLATE, ref);
+  SpiRegisterSlot *slot;
+  guint64 ref = 0, generation = 0;
+
+  if (!g_ascii_isdigit (*path))
+    return 0;
+  for (; g_ascii_isdigit (*path) && ref <= G_MAXUINT32; path++)
+    ref = ref * 10 + (*path - '0');
+
+  if (*path == '_')
+    {
+      path++;
+      if (!g_ascii_isdigit (*path))
+        return 0;
+      for (; g_ascii_isdigit (*path) && generation <= G_MAXUINT32; path++)
+        generation = generation * 10 + (*path - '0');
+    }
+
+  if (*path != '\0' || ref == 0 || ref >= reg->slots->len)
+    return 0;
+
+  slot = &g_array_index (reg->slots, SpiRegisterSlot, ref);
+  if (!slot->object || slot->generation != generation)
+    return 0;
+
+  return ref;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -195,7 +278,7 @@ spi_register_deregister_object (SpiRegister *reg, GObject *gobj, gboolean unref)
 {
   guint ref;
 
-  ref = object_to_ref (gobj);
+  ref = object_to_ref (reg, gobj);
   if (ref != 0)
     {
       g_signal_emit (reg,
@@ -204,7 +287,9 @@ spi_register_deregister_object (SpiRegister *reg, GObject *gobj, gboolean unref)
                      gobj);
       if (unref)
         g_object_weak_unref (gobj, deregister_object, reg);
-      g_hash_table_remove (reg->ref2ptr, GINT_TO_POINTER (ref));
+      g_hash_table_remove (reg->refs, gobj);
+      release_reference (reg, ref);
+      reg->n_registered--;
 
 #ifdef SPI_ATK_DEBUG
       g_debug ("DEREG  - %d", ref);
@@ -220,9 +305,10 @@ register_object (SpiRegister *reg, GObject *gobj)
 
   ref = assign_reference (reg);
 
-  g_hash_table_insert (reg->ref2ptr, GINT_TO_POINTER (ref), gobj);
-  g_object_set_data (G_OBJECT (gobj), SPI_DBUS_ID, GINT_TO_POINTER (ref));
-  g_object_weak_ref (G_OBJECT (gobj), deregister_object, reg);
+  g_array_index (reg->slots, SpiRegisterSlot, ref).object = gobj;
+  reg->n_registered++;
+  g_hash_table_insert (reg->refs, gobj, GUINT_TO_POINTER (ref));
+  g_object_weak_ref (gobj, deregister_object, reg);
 
 #ifdef SPI_ATK_DEBUG
   g_debug ("REG  - %d", ref);
@@ -241,8 +327,7 @@ register_object (SpiRegister *reg, GObject *gobj)
 GObject *
 spi_register_path_to_object (SpiRegister *reg, const char *path)
 {
-  guint index;
-  void *data;
+  guint ref;
 
   g_return_val_if_fail (path, NULL);
 
@@ -255,10 +340,9 @@ spi_register_path_to_object (SpiRegister *reg, const char *path)
   if (!g_strcmp0 (SPI_ATK_OBJECT_PATH_ROOT, path))
     return G_OBJECT (spi_global_app_data->root);
 
-  index = atoi (path);
-  data = g_hash_table_lookup (reg->ref2ptr, GINT_TO_POINTER (index));
-  if (data)
-    return G_OBJECT (data);
+  ref = path_to_ref (reg, path);
+  if (ref)
+    return g_array_index (reg->slots, SpiRegisterSlot, ref).object;
   else
     return NULL;
 }
@@ -270,13 +354,16 @@ spi_global_register_path_to_object (const char *path)
 }
 
 /*
- * Used to lookup a D-Bus path from the GObject.
+ * Used to lookup a D-Bus path from the GObject, without copying it.
  *
  * If the objects is not already registered,
  * this function will register it.
+ *
+ * The path belongs to the register, and stays valid until the object
+ * is deregistered.
  */
-gchar *
-spi_register_object_to_path (SpiRegister *reg, GObject *gobj)
+const gchar *
+spi_register_object_to_static_path (SpiRegister *reg, GObject *gobj)
 {
   guint ref;
 
@@ -285,25 +372,37 @@ spi_register_object_to_path (SpiRegister *reg, GObject *gobj)
 
   /* Map the root object to the root path. */
   if ((void *) gobj == (void *) spi_global_app_data->root)
-    return g_strdup (spi_register_root_path);
+    return spi_register_root_path;
 
-  ref = object_to_ref (gobj);
+  ref = object_to_ref (reg, gobj);
   if (!ref)
     {
       register_object (reg, gobj);
-      ref = object_to_ref (gobj);
+      ref = object_to_ref (reg, gobj);
     }
 
   if (!ref)
     return NULL;
   else
-    return ref_to_path (ref);
+    return g_array_index (reg->slots, SpiRegisterSlot, ref).path;
+}
+
+/*
+ * Used to lookup a D-Bus path from the GObject.
+ *
+ * If the objects is not already registered,
+ * this function will register it.
+ */
+gchar *
+spi_register_object_to_path (SpiRegister *reg, GObject *gobj)
+{
+  return g_strdup (spi_register_object_to_static_path (reg, gobj));
 }
 
 guint
 spi_register_object_to_ref (GObject *gobj)
 {
-  return object_to_ref (gobj);
+  return object_to_ref (spi_global_register, gobj);
 }
 
 /*
@@ -42,8 +42,13 @@ struct _SpiRegister
 {
   GObject parent;
 
-  GHashTable *ref2ptr;
-  guint reference_counter;
+  /* Registered objects, indexed by the reference in their D-Bus path */
+  GArray *slots;
+  /* Maps each registered object to its reference */
+  GHashTable *refs;
+  /* Head of the list of free slots, or 0 */
+  guint free_slot;
+  guint n_registered;
 };
 
 struct _SpiRegisterClass
@@ -66,6 +71,9 @@ spi_global_register_path_to_object (const char *path);
 gchar *
 spi_register_object_to_path (SpiRegister *reg, GObject *gobj);
 
+const gchar *
+spi_register_object_to_static_path (SpiRegister *reg, GObject *gobj);
+
 guint
 spi_register_object_to_ref (GObject *gobj);
 
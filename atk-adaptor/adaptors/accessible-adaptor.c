@@ -26,6 +26,7 @@
 #include <atk/atk.h>
 #include <droute/droute.h>
 
+#include "accessible-cache.h"
 #include "accessible-stateset.h"
 #include "atspi/atspi.h"
 #include "introspection.h"
@@ -182,6 +183,7 @@ impl_GetChildAtIndex (DBusConnection *bus,
         }
       g_free (child_name);
     }
+  spi_cache_expand (spi_global_cache, G_OBJECT (object));
   child = atk_object_ref_accessible_child (object, i);
   reply = spi_object_return_reference (message, child);
   if (child)
@@ -214,6 +216,8 @@ impl_GetChildren (DBusConnection *bus,
       return reply;
     }
 
+  spi_cache_expand (spi_global_cache, G_OBJECT (object));
+
   reply = dbus_message_new_method_return (message);
   if (!reply)
     goto oom;
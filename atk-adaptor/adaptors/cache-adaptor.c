@@ -29,8 +29,10 @@
 #include <droute/droute.h>
 
 #include "accessible-cache.h"
+#include "accessible-register.h"
 #include "accessible-stateset.h"
 #include "bridge.h"
+#include "event.h"
 #include "introspection.h"
 #include "object.h"
 #include "spi-dbus.h"
@@ -58,6 +60,18 @@
                                             DBUS_TYPE_UINT32_AS_STRING \
                                  ")"
 
+/*
+ * Upper bound on the number of items returned by one GetItemsPaged call, so
+ * that a large application does not block its main loop for too long.
+ */
+#define SPI_CACHE_MAX_PAGE_SIZE 1000
+
+/* Maximum number of objects carried by one AddAccessibles or RemoveAccessibles signal */
+#define SPI_CACHE_MAX_SIGNAL_BATCH 1000
+
+/* Shortest interval between two PopulationProgress signals, but the last */
+#define SPI_CACHE_PROGRESS_INTERVAL_USEC (100 * 1000)
+
 /*---------------------------------------------------------------------------*/
 
 static const char *
@@ -103,38 +117,93 @@ should_cache_children (AtkObject *obj, AtkStateSet *set)
 }
 
 /*
- * Marshals the given AtkObject into the provided D-Bus iterator.
- *
- * The object is marshalled including all its client side cache data.
- * The format of the structure is (o(so)iiassusau).
+ * Queries the toolkit for the cache data of @obj, except for the index in
+ * parent and child count, which are filled in by update_record_children().
  */
-static void
-append_cache_item (AtkObject *obj, gpointer data)
+static SpiCacheRecord *
+new_cache_record (AtkObject *obj)
 {
-  DBusMessageIter iter_struct, iter_sub_array;
-  dbus_uint32_t states[2];
-  dbus_int32_t count, index;
+  SpiCacheRecord *record;
   AtkStateSet *set;
-  DBusMessageIter *iter_array = (DBusMessageIter *) data;
-  const char *name, *desc;
-  dbus_uint32_t role;
+  const char *str;
+
+  record = g_new0 (SpiCacheRecord, 1);
 
   set = atk_object_ref_state_set (obj);
-  AtkObject *application, *parent;
+  record->wants_index = should_call_index_in_parent (obj, set);
+  record->wants_children = should_cache_children (obj, set);
+  spi_atk_state_set_to_dbus_array (set, record->states);
+  g_object_unref (set);
 
-  dbus_message_iter_open_container (iter_array, DBUS_TYPE_STRUCT, NULL,
-                                    &iter_struct);
+  record->role = spi_accessible_role_from_atk_role (atk_object_get_role (obj));
 
-  /* Marshal object path */
-  spi_object_append_reference (&iter_struct, obj);
+  str = atk_object_get_name (obj);
+  record->name = g_strdup (str ? str : "");
+  str = atk_object_get_description (obj);
+  record->description = g_strdup (str ? str : "");
 
-  role = spi_accessible_role_from_atk_role (atk_object_get_role (obj));
+  record->interfaces = g_new (const gchar *, SPI_OBJECT_MAX_INTERFACES);
+  record->n_interfaces = spi_object_get_interfaces (obj, record->interfaces,
+                                                    SPI_OBJECT_MAX_INTERFACES);
+  return record;
+}
 
-  /* Marshal application */
-  application = spi_global_app_data->root;
-  spi_object_append_reference (&iter_struct, application);
+static guint
+get_parent_children_serial (AtkObject *obj)
+{
+  return spi_cache_get_children_serial (spi_global_cache,
+                                        G_OBJECT (atk_object_get_parent (obj)));
+}
+
+static void
+update_record_children (AtkObject *obj, SpiCacheRecord *record)
+{
+  /* Read first, since the toolkit may add children while being queried */
+  record->children_serial = get_parent_children_serial (obj);
+
+  record->index = (record->wants_index
+                       ? atk_object_get_index_in_parent (obj)
+                       : -1);
+  record->child_count = (record->wants_children
+                             ? atk_object_get_n_accessible_children (obj)
+                             : -1);
+}
+
+/*
+ * Takes the record of @obj out of the cache, building it or refreshing its
+ * children data as needed.  It must be given back with
+ * spi_cache_store_record().
+ */
+static SpiCacheRecord *
+steal_fresh_record (AtkObject *obj, guint *generation)
+{
+  SpiCacheRecord *record;
+
+  record = spi_cache_steal_record (spi_global_cache, G_OBJECT (obj),
+                                   generation);
+  if (!record)
+    {
+      record = new_cache_record (obj);
+      update_record_children (obj, record);
+    }
+  else
+    {
+      /* Without a cached parent, nothing tells when the index changes */
+      guint serial = get_parent_children_serial (obj);
+      if (serial == 0 || serial != record->children_serial)
+        update_record_children (obj, record);
+    }
+
+  return record;
+}
+
+static void
+append_parent_reference (DBusMessageIter *iter_struct,
+                         AtkObject *obj,
+                         SpiCacheRecord *record)
+{
+  AtkObject *parent;
 
-  /* Marshal parent */
   parent = atk_object_get_parent (obj);
   if (parent == NULL)
     {
@@ -152,151 +221,411 @@ append_cache_item (AtkObject *obj, gpointer data)
                 {
                   DBusMessageIter iter_parent;
                   *(path_parent++) = '\0';
-                  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL,
+                  dbus_message_iter_open_container (iter_struct, DBUS_TYPE_STRUCT, NULL,
                                                     &iter_parent);
                   dbus_message_iter_append_basic (&iter_parent, DBUS_TYPE_STRING, &bus_parent);
                   dbus_message_iter_append_basic (&iter_parent, DBUS_TYPE_OBJECT_PATH, &path_parent);
-                  dbus_message_iter_close_container (&iter_struct, &iter_parent);
+                  dbus_message_iter_close_container (iter_struct, &iter_parent);
                 }
               else
                 {
-                  spi_object_append_null_reference (&iter_struct);
+                  spi_object_append_null_reference (iter_struct);
                 }
             }
           else
             {
-              spi_object_append_null_reference (&iter_struct);
+              spi_object_append_null_reference (iter_struct);
             }
         }
-      else if (role != ATSPI_ROLE_APPLICATION)
-        spi_object_append_null_reference (&iter_struct);
+      else if (record->role != ATSPI_ROLE_APPLICATION)
+        spi_object_append_null_reference (iter_struct);
       else
-        spi_object_append_desktop_reference (&iter_struct);
+        spi_object_append_desktop_reference (iter_struct);
     }
   else
     {
-      spi_object_append_reference (&iter_struct, parent);
+      spi_object_append_reference (iter_struct, parent);
     }
+}
+
+static dbus_int32_t
+get_child_count (AtkObject *obj, SpiCacheRecord *record)
+{
+  if (ATK_IS_SOCKET (obj) && atk_socket_is_occupied (ATK_SOCKET (obj)))
+    return 1;
+  return record->child_count;
+}
+
+/*
+ * Marshals the given AtkObject into the provided D-Bus iterator.
+ *
+ * The object is marshalled including all its client side cache data.
+ * The format of the structure is (o(so)iiassusau).
+ *
+ * Apart from the parent, which is looked up every time so that it is
+ * registered and leased as needed, the data comes from the record kept in
+ * the cache for the object, which is only rebuilt after the object signals
+ * a change.
+ */
+static void
+append_cache_item (AtkObject *obj, gpointer data)
+{
+  DBusMessageIter iter_struct, iter_sub_array;
+  dbus_int32_t count;
+  DBusMessageIter *iter_array = (DBusMessageIter *) data;
+  SpiCacheRecord *record;
+  guint generation;
+  guint i;
+  AtkObject *application;
+
+  record = steal_fresh_record (obj, &generation);
+
+  dbus_message_iter_open_container (iter_array, DBUS_TYPE_STRUCT, NULL,
+                                    &iter_struct);
+
+  /* Marshal object path */
+  spi_object_append_reference (&iter_struct, obj);
+
+  /* Marshal application */
+  application = spi_global_app_data->root;
+  spi_object_append_reference (&iter_struct, application);
+
+  /* Marshal parent */
+  append_parent_reference (&iter_struct, obj, record);
 
   /* Marshal index in parent */
-  index = (should_call_index_in_parent (obj, set)
-               ? atk_object_get_index_in_parent (obj)
-               : -1);
-  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &index);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &record->index);
 
   /* marshal child count */
-  count = (should_cache_children (obj, set)
-               ? atk_object_get_n_accessible_children (obj)
-               : -1);
-
-  if (ATK_IS_SOCKET (obj) && atk_socket_is_occupied (ATK_SOCKET (obj)))
-    count = 1;
+  count = get_child_count (obj, record);
   dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &count);
 
   /* Marshal interfaces */
   dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "s",
                                     &iter_sub_array);
-  spi_object_append_interfaces (&iter_sub_array, obj);
+  for (i = 0; i < record->n_interfaces; i++)
+    dbus_message_iter_append_basic (&iter_sub_array, DBUS_TYPE_STRING,
+                                    &record->interfaces[i]);
   dbus_message_iter_close_container (&iter_struct, &iter_sub_array);
 
   /* Marshal name */
-  name = atk_object_get_name (obj);
-  if (!name)
-    name = "";
-  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &record->name);
 
   /* Marshal role */
-  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_UINT32, &role);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_UINT32, &record->role);
 
   /* Marshal description */
-  desc = atk_object_get_description (obj);
-  if (!desc)
-    desc = "";
-  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &desc);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING,
+                                  &record->description);
 
   /* Marshal state set */
-  spi_atk_state_set_to_dbus_array (set, states);
   dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "u",
                                     &iter_sub_array);
-  for (count = 0; count < 2; count++)
+  for (i = 0; i < 2; i++)
     {
       dbus_message_iter_append_basic (&iter_sub_array, DBUS_TYPE_UINT32,
-                                      &states[count]);
+                                      &record->states[i]);
     }
   dbus_message_iter_close_container (&iter_struct, &iter_sub_array);
 
   dbus_message_iter_close_container (iter_array, &iter_struct);
-  g_object_unref (set);
+
+  spi_cache_store_record (spi_global_cache, G_OBJECT (obj), record, generation);
 }
 
 /*---------------------------------------------------------------------------*/
 
 static void
-ref_accessible_hf (gpointer key, gpointer obj_data, gpointer data)
+append_cache_items (DBusMessageIter *iter_array, GPtrArray *objects)
 {
-  g_object_ref (key);
-}
+  guint i;
 
-/* For use as a GHFunc */
-static void
-append_accessible_hf (gpointer key, gpointer obj_data, gpointer data)
-{
-  /* Make sure it isn't a hyperlink */
-  if (ATK_IS_OBJECT (key))
-    append_cache_item (ATK_OBJECT (key), data);
+  for (i = 0; i < objects->len; i++)
+    {
+      GObject *obj = g_ptr_array_index (objects, i);
+
+      /* Make sure it isn't a hyperlink */
+      if (ATK_IS_OBJECT (obj))
+        append_cache_item (ATK_OBJECT (obj), iter_array);
+    }
 }
 
 static void
-add_to_list_hf (gpointer key, gpointer obj_data, gpointer data)
+append_removed_reference (gpointer path, gpointer data)
 {
-  GSList **listptr = data;
-  *listptr = g_slist_prepend (*listptr, key);
+  DBusMessageIter *iter_array = data;
+  DBusMessageIter iter_struct;
+  const char *name = dbus_bus_get_unique_name (spi_global_app_data->bus);
+
+  dbus_message_iter_open_container (iter_array, DBUS_TYPE_STRUCT, NULL,
+                                    &iter_struct);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &path);
+  dbus_message_iter_close_container (iter_array, &iter_struct);
 }
 
 /*---------------------------------------------------------------------------*/
 
+/*
+ * Cache additions and removals are not signalled one object at a time.
+ * They are collected here and sent once per main loop iteration as
+ * AddAccessibles and RemoveAccessibles signals, so that a subtree
+ * appearing at once wakes up the assistive technologies once.  Older
+ * clients, which do not call GetItemsPaged, get one signal per object.
+ */
+
+/* Objects waiting to be signalled as added, referenced, in order */
+static GPtrArray *pending_adds = NULL;
+/* The objects of pending_adds, mapped to whether they are still in the
+ * cache */
+static GHashTable *pending_add_set = NULL;
+/* D-Bus paths of the objects waiting to be signalled as removed */
+static GPtrArray *pending_removes = NULL;
+static guint pending_flush_idle = 0;
+
+/* When the last PopulationProgress was sent */
+static gint64 last_progress_time = 0;
+/* Clients that called GetItemsPaged during the initial population, mapped
+ * to the generation that they reached */
+static GHashTable *population_clients = NULL;
+
 static void
-emit_cache_remove (SpiCache *cache, GObject *obj)
+emit_cache_signal (const char *member, const char *signature,
+                   GPtrArray *items, guint start, guint end,
+                   void (*append_func) (gpointer item, gpointer data))
 {
   DBusMessage *message;
+  DBusMessageIter iter, iter_array;
+  guint i;
+
+  if (!(message = dbus_message_new_signal (SPI_CACHE_OBJECT_PATH,
+                                           ATSPI_DBUS_INTERFACE_CACHE,
+                                           member)))
+    return;
+
+  dbus_message_iter_init_append (message, &iter);
+  if (signature)
+    dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, signature,
+                                      &iter_array);
+  for (i = start; i < end; i++)
+    append_func (g_ptr_array_index (items, i), signature ? &iter_array : &iter);
+  if (signature)
+    dbus_message_iter_close_container (&iter, &iter_array);
+
+  dbus_connection_send (spi_global_app_data->bus, message, NULL);
+  dbus_message_unref (message);
+}
+
+/*
+ * Sends @items in batches of at most SPI_CACHE_MAX_SIGNAL_BATCH objects.
+ * A lone object, or any object while some client has not opted into the
+ * batched signals with GetItemsPaged, is sent with the older single-object
+ * signal, which every client understands.
+ */
+static void
+emit_cache_signals (const char *single_member, const char *batch_member,
+                    const char *signature, GPtrArray *items,
+                    void (*append_func) (gpointer item, gpointer data))
+{
+  guint start;
 
-  if ((message = dbus_message_new_signal (SPI_CACHE_OBJECT_PATH,
-                                          ATSPI_DBUS_INTERFACE_CACHE,
-                                          "RemoveAccessible")))
+  if (items->len == 1 || !spi_atk_clients_take_batches ())
     {
-      DBusMessageIter iter;
+      for (start = 0; start < items->len; start++)
+        emit_cache_signal (single_member, NULL, items, start, start + 1,
+                           append_func);
+      return;
+    }
 
-      dbus_message_iter_init_append (message, &iter);
+  for (start = 0; start < items->len; start += SPI_CACHE_MAX_SIGNAL_BATCH)
+    emit_cache_signal (batch_member, signature, items, start,
+                       MIN (start + SPI_CACHE_MAX_SIGNAL_BATCH, items->len),
+                       append_func);
+}
 
-      spi_object_append_reference (&iter, ATK_OBJECT (obj));
+static void
+append_added_item (gpointer item, gpointer data)
+{
+  append_cache_item (ATK_OBJECT (item), data);
+}
 
-      dbus_connection_send (spi_global_app_data->bus, message, NULL);
+static gboolean
+flush_pending_signals (gpointer data)
+{
+  GPtrArray *adds, *removes;
+  GHashTable *add_set;
+  guint i;
+
+  pending_flush_idle = 0;
+
+  /*
+   * Marshalling an item calls into the toolkit, which may add or remove
+   * more objects; those are queued for the next flush.
+   */
+  adds = pending_adds;
+  add_set = pending_add_set;
+  removes = pending_removes;
+  pending_adds = NULL;
+  pending_add_set = NULL;
+  pending_removes = NULL;
+
+  if (removes)
+    {
+      if (removes->len > 0 && spi_global_app_data && spi_global_app_data->bus)
+        emit_cache_signals ("RemoveAccessible", "RemoveAccessibles",
+                            SPI_OBJECT_REFERENCE_SIGNATURE, removes,
+                            append_removed_reference);
+      g_ptr_array_unref (removes);
+    }
+
+  if (adds)
+    {
+      /* Leave out the objects that were removed while pending */
+      for (i = adds->len; i > 0; i--)
+        {
+          gpointer obj = g_ptr_array_index (adds, i - 1);
 
-      dbus_message_unref (message);
+          if (!g_hash_table_lookup (add_set, obj) || !ATK_IS_OBJECT (obj))
+            g_ptr_array_remove_index (adds, i - 1);
+        }
+      if (adds->len > 0 && spi_global_app_data && spi_global_app_data->bus)
+        emit_cache_signals ("AddAccessible", "AddAccessibles",
+                            SPI_CACHE_ITEM_SIGNATURE, adds,
+                            append_added_item);
+      g_ptr_array_unref (adds);
+      g_hash_table_unref (add_set);
     }
+
+  return FALSE;
+}
+
+static void
+schedule_flush (void)
+{
+  if (pending_flush_idle == 0)
+    pending_flush_idle = spi_idle_add (flush_pending_signals, NULL);
+}
+
+static void
+emit_cache_remove (SpiCache *cache, GObject *obj)
+{
+  gchar *path;
+
+  if (pending_add_set && g_hash_table_contains (pending_add_set, obj))
+    g_hash_table_replace (pending_add_set, obj, GINT_TO_POINTER (FALSE));
+
+  path = spi_register_object_to_path (spi_global_register, obj);
+  if (!path)
+    return;
+
+  if (!pending_removes)
+    pending_removes = g_ptr_array_new_with_free_func (g_free);
+  g_ptr_array_add (pending_removes, path);
+  schedule_flush ();
 }
 
 static void
 emit_cache_add (SpiCache *cache, GObject *obj)
 {
-  AtkObject *accessible = ATK_OBJECT (obj);
-  DBusMessage *message;
+  /* The initial population is announced with PopulationProgress instead,
+   * and clients fetch it with GetItems or GetItemsPaged */
+  if (cache->populating)
+    return;
 
-  if ((message = dbus_message_new_signal (SPI_CACHE_OBJECT_PATH,
-                                          ATSPI_DBUS_INTERFACE_CACHE,
-                                          "AddAccessible")))
+  if (!pending_adds)
     {
-      DBusMessageIter iter;
+      pending_adds = g_ptr_array_new_with_free_func (g_object_unref);
+      pending_add_set = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+
+  /* An object removed and added again while pending is already queued */
+  if (g_hash_table_contains (pending_add_set, obj))
+    {
+      g_hash_table_replace (pending_add_set, obj, GINT_TO_POINTER (TRUE));
+      return;
+    }
 
-      dbus_message_iter_init_append (message, &iter);
-      g_object_ref (accessible);
-      append_cache_item (accessible, &iter);
-      g_object_unref (accessible);
+  g_hash_table_insert (pending_add_set, obj, GINT_TO_POINTER (TRUE));
+  g_ptr_array_add (pending_adds, g_object_ref (obj));
+  schedule_flush ();
+}
+
+/*
+ * Objects cached during the initial population are not signalled.  Once it
+ * is over, the clients that fetched some items meanwhile are sent the ones
+ * cached after the earliest generation that they reached.
+ */
+static void
+signal_population_remainder (SpiCache *cache)
+{
+  GHashTableIter iter;
+  GPtrArray *objects;
+  gpointer value;
+  guint generation = G_MAXUINT;
+  guint next_generation;
+  gboolean complete;
+  guint i;
+
+  if (!population_clients)
+    return;
+
+  g_hash_table_iter_init (&iter, population_clients);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    generation = MIN (generation, GPOINTER_TO_UINT (value));
+  g_clear_pointer (&population_clients, g_hash_table_unref);
+
+  objects = spi_cache_ref_items_since (cache, generation, 0,
+                                       &next_generation, &complete);
+  for (i = 0; i < objects->len; i++)
+    emit_cache_add (cache, g_ptr_array_index (objects, i));
+  g_ptr_array_unref (objects);
+}
 
-      dbus_connection_send (spi_global_app_data->bus, message, NULL);
+static void
+emit_population_progress (SpiCache *cache, guint n_cached, guint n_pending)
+{
+  DBusMessage *message;
+  dbus_uint32_t d_n_cached = n_cached;
+  dbus_uint32_t d_n_pending = n_pending;
+  gint64 now = g_get_monotonic_time ();
+
+  if (n_pending == 0)
+    signal_population_remainder (cache);
+
+  if (!spi_global_app_data || !spi_global_app_data->bus)
+    return;
+
+  /* Clients refetch on each signal, so a burst of slices is signalled once */
+  if (n_pending > 0 && now - last_progress_time < SPI_CACHE_PROGRESS_INTERVAL_USEC)
+    return;
+  last_progress_time = now;
+
+  if (!(message = dbus_message_new_signal (SPI_CACHE_OBJECT_PATH,
+                                           ATSPI_DBUS_INTERFACE_CACHE,
+                                           "PopulationProgress")))
+    return;
+
+  dbus_message_append_args (message,
+                            DBUS_TYPE_UINT32, &d_n_cached,
+                            DBUS_TYPE_UINT32, &d_n_pending,
+                            DBUS_TYPE_INVALID);
+  dbus_connection_send (spi_global_app_data->bus, message, NULL);
+  dbus_message_unref (message);
+}
 
-      dbus_message_unref (message);
+static void
+discard_pending_signals (gpointer data, GObject *where_the_cache_was)
+{
+  if (pending_flush_idle)
+    {
+      g_source_remove (pending_flush_idle);
+      pending_flush_idle = 0;
     }
+  g_clear_pointer (&pending_adds, g_ptr_array_unref);
+  g_clear_pointer (&pending_add_set, g_hash_table_unref);
+  g_clear_pointer (&pending_removes, g_ptr_array_unref);
+  g_clear_pointer (&population_clients, g_hash_table_unref);
+  last_progress_time = 0;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -314,21 +643,306 @@ impl_GetItems (DBusConnection *bus, DBusMessage *message, void *user_data)
 {
   DBusMessage *reply;
   DBusMessageIter iter, iter_array;
-  GSList *pending_unrefs = NULL;
+  GPtrArray *objects;
+  guint next_generation;
+  gboolean complete;
 
   if (bus == spi_global_app_data->bus)
     spi_atk_add_client (dbus_message_get_sender (message));
 
+  /* The client wants every object, including unexpanded subtrees */
+  spi_cache_expand_all (spi_global_cache, TRUE);
+
   reply = dbus_message_new_method_return (message);
 
+  objects = spi_cache_ref_items_since (spi_global_cache, 0, 0,
+                                       &next_generation, &complete);
+  dbus_message_iter_init_append (reply, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY,
+                                    SPI_CACHE_ITEM_SIGNATURE, &iter_array);
+  append_cache_items (&iter_array, objects);
+  dbus_message_iter_close_container (&iter, &iter_array);
+  g_ptr_array_unref (objects);
+  return reply;
+}
+
+/*---------------------------------------------------------------------------*/
+
+static DBusMessage *
+impl_GetItemsPaged (DBusConnection *bus, DBusMessage *message, void *user_data)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_array;
+  dbus_uint32_t generation, max_items;
+  dbus_uint32_t d_next_generation;
+  dbus_bool_t d_complete, d_reset = FALSE;
+  GPtrArray *objects;
+  guint next_generation;
+  gboolean complete;
+
+  if (!dbus_message_get_args (message, NULL,
+                              DBUS_TYPE_UINT32, &generation,
+                              DBUS_TYPE_UINT32, &max_items,
+                              DBUS_TYPE_INVALID))
+    {
+      return droute_invalid_arguments_error (message);
+    }
+
+  /* Callers of GetItemsPaged also understand the batched signals */
+  if (bus == spi_global_app_data->bus)
+    spi_atk_add_batch_client (dbus_message_get_sender (message));
+
+  if (max_items == 0 || max_items > SPI_CACHE_MAX_PAGE_SIZE)
+    max_items = SPI_CACHE_MAX_PAGE_SIZE;
+
+  /*
+   * Unlike GetItems, this does not expand the subtrees left unexpanded in
+   * lazy mode: clients get the objects cached so far, and the deeper ones
+   * show up in later generations once some client asks for their parents'
+   * children.
+   */
+
+  reply = dbus_message_new_method_return (message);
   dbus_message_iter_init_append (reply, &iter);
+
+  /*
+   * Removals are marshalled first so that the client drops stale objects
+   * before it processes the items.  A client starting from scratch has
+   * nothing to drop.  If some removals were already forgotten, the client
+   * is told to drop everything it has, and gets every item again, starting
+   * from generation 0.
+   */
+  if (generation > 0 &&
+      !spi_cache_remembers_removals_since (spi_global_cache, generation))
+    {
+      generation = 0;
+      d_reset = TRUE;
+    }
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_BOOLEAN, &d_reset);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY,
+                                    SPI_OBJECT_REFERENCE_SIGNATURE, &iter_array);
+  if (generation > 0)
+    spi_cache_foreach_removed_since (spi_global_cache, generation,
+                                     append_removed_reference, &iter_array);
+  dbus_message_iter_close_container (&iter, &iter_array);
+
+  objects = spi_cache_ref_items_since (spi_global_cache, generation, max_items,
+                                       &next_generation, &complete);
+  d_next_generation = next_generation;
+  d_complete = complete;
+
+  /* Objects cached after this page during the initial population are
+   * signalled when it is over, see signal_population_remainder() */
+  if (spi_global_cache->populating && bus == spi_global_app_data->bus)
+    {
+      if (!population_clients)
+        population_clients = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                    g_free, NULL);
+      g_hash_table_replace (population_clients,
+                            g_strdup (dbus_message_get_sender (message)),
+                            GUINT_TO_POINTER (next_generation));
+    }
+
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_UINT32, &d_next_generation);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_BOOLEAN, &d_complete);
   dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY,
                                     SPI_CACHE_ITEM_SIGNATURE, &iter_array);
-  spi_cache_foreach (spi_global_cache, ref_accessible_hf, NULL);
-  spi_cache_foreach (spi_global_cache, append_accessible_hf, &iter_array);
-  spi_cache_foreach (spi_global_cache, add_to_list_hf, &pending_unrefs);
-  g_slist_free_full (pending_unrefs, g_object_unref);
+  append_cache_items (&iter_array, objects);
   dbus_message_iter_close_container (&iter, &iter_array);
+  g_ptr_array_unref (objects);
+  return reply;
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The properties that GetProperties can return.  Most of them come from the
+ * record kept in the cache, like the items of GetItems.
+ */
+typedef struct _CacheProperty
+{
+  const char *name;
+  const char *signature;
+  void (*append) (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record);
+} CacheProperty;
+
+static void
+append_name (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &record->name);
+}
+
+static void
+append_description (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &record->description);
+}
+
+static void
+append_role (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  dbus_message_iter_append_basic (iter, DBUS_TYPE_UINT32, &record->role);
+}
+
+static void
+append_state (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  DBusMessageIter iter_array;
+  guint i;
+
+  dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY, "u", &iter_array);
+  for (i = 0; i < 2; i++)
+    dbus_message_iter_append_basic (&iter_array, DBUS_TYPE_UINT32,
+                                    &record->states[i]);
+  dbus_message_iter_close_container (iter, &iter_array);
+}
+
+static void
+append_interfaces (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  DBusMessageIter iter_array;
+  guint i;
+
+  dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY, "s", &iter_array);
+  for (i = 0; i < record->n_interfaces; i++)
+    dbus_message_iter_append_basic (&iter_array, DBUS_TYPE_STRING,
+                                    &record->interfaces[i]);
+  dbus_message_iter_close_container (iter, &iter_array);
+}
+
+static void
+append_attributes (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  AtkAttributeSet *attributes = atk_object_get_attributes (obj);
+
+  spi_object_append_attribute_set (iter, attributes);
+  atk_attribute_set_free (attributes);
+}
+
+static void
+append_index_in_parent (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  dbus_message_iter_append_basic (iter, DBUS_TYPE_INT32, &record->index);
+}
+
+static void
+append_child_count (DBusMessageIter *iter, AtkObject *obj, SpiCacheRecord *record)
+{
+  dbus_int32_t count = get_child_count (obj, record);
+
+  dbus_message_iter_append_basic (iter, DBUS_TYPE_INT32, &count);
+}
+
+static const CacheProperty cache_properties[] = {
+  { "Name", "s", append_name },
+  { "Description", "s", append_description },
+  { "Role", "u", append_role },
+  { "State", "au", append_state },
+  { "Interfaces", "as", append_interfaces },
+  { "Attributes", "a{ss}", append_attributes },
+  { "Parent", SPI_OBJECT_REFERENCE_SIGNATURE, append_parent_reference },
+  { "IndexInParent", "i", append_index_in_parent },
+  { "ChildCount", "i", append_child_count },
+};
+
+static void
+append_object_properties (DBusMessageIter *iter_array,
+                          AtkObject *obj,
+                          GPtrArray *properties)
+{
+  DBusMessageIter iter_dict, iter_entry, iter_variant;
+  SpiCacheRecord *record = NULL;
+  guint generation = 0;
+  guint i;
+
+  dbus_message_iter_open_container (iter_array, DBUS_TYPE_ARRAY, "{sv}",
+                                    &iter_dict);
+  if (obj)
+    record = steal_fresh_record (obj, &generation);
+  for (i = 0; record && i < properties->len; i++)
+    {
+      const CacheProperty *property = g_ptr_array_index (properties, i);
+
+      dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY, NULL,
+                                        &iter_entry);
+      dbus_message_iter_append_basic (&iter_entry, DBUS_TYPE_STRING,
+                                      &property->name);
+      dbus_message_iter_open_container (&iter_entry, DBUS_TYPE_VARIANT,
+                                        property->signature, &iter_variant);
+      property->append (&iter_variant, obj, record);
+      dbus_message_iter_close_container (&iter_entry, &iter_variant);
+      dbus_message_iter_close_container (&iter_dict, &iter_entry);
+    }
+  if (record)
+    spi_cache_store_record (spi_global_cache, G_OBJECT (obj), record, generation);
+  dbus_message_iter_close_container (iter_array, &iter_dict);
+}
+
+static DBusMessage *
+impl_GetProperties (DBusConnection *bus, DBusMessage *message, void *user_data)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_paths, iter_names, iter_array;
+  GPtrArray *properties;
+  gint n_paths = 0;
+
+  if (strcmp (dbus_message_get_signature (message), "aoas") != 0)
+    return droute_invalid_arguments_error (message);
+
+  dbus_message_iter_init (message, &iter);
+  dbus_message_iter_recurse (&iter, &iter_paths);
+  while (dbus_message_iter_get_arg_type (&iter_paths) == DBUS_TYPE_OBJECT_PATH)
+    {
+      n_paths++;
+      dbus_message_iter_next (&iter_paths);
+    }
+  if (n_paths > SPI_CACHE_MAX_PAGE_SIZE)
+    return dbus_message_new_error_printf (message, DBUS_ERROR_LIMITS_EXCEEDED,
+                                          "GetProperties takes at most %d objects",
+                                          SPI_CACHE_MAX_PAGE_SIZE);
+
+  if (bus == spi_global_app_data->bus)
+    spi_atk_add_client (dbus_message_get_sender (message));
+
+  /* Names that are not known are left out of the reply */
+  properties = g_ptr_array_new ();
+  dbus_message_iter_recurse (&iter, &iter_paths);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_recurse (&iter, &iter_names);
+  while (dbus_message_iter_get_arg_type (&iter_names) == DBUS_TYPE_STRING)
+    {
+      const char *name;
+      guint i;
+
+      dbus_message_iter_get_basic (&iter_names, &name);
+      for (i = 0; i < G_N_ELEMENTS (cache_properties); i++)
+        if (!strcmp (name, cache_properties[i].name))
+          {
+            g_ptr_array_add (properties, (gpointer) &cache_properties[i]);
+            break;
+          }
+      dbus_message_iter_next (&iter_names);
+    }
+
+  reply = dbus_message_new_method_return (message);
+  dbus_message_iter_init_append (reply, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "a{sv}",
+                                    &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_paths) == DBUS_TYPE_OBJECT_PATH)
+    {
+      const char *path;
+      GObject *obj;
+
+      dbus_message_iter_get_basic (&iter_paths, &path);
+      obj = spi_register_path_to_object (spi_global_register, path);
+      append_object_properties (&iter_array,
+                                (obj && ATK_IS_OBJECT (obj)) ? ATK_OBJECT (obj) : NULL,
+                                properties);
+      dbus_message_iter_next (&iter_paths);
+    }
+  dbus_message_iter_close_container (&iter, &iter_array);
+
+  g_ptr_array_free (properties, TRUE);
   return reply;
 }
 
@@ -337,6 +951,8 @@ impl_GetItems (DBusConnection *bus, DBusMessage *message, void *user_data)
 static DRouteMethod methods[] = {
   { impl_GetRoot, "GetRoot" },
   { impl_GetItems, "GetItems" },
+  { impl_GetItemsPaged, "GetItemsPaged" },
+  { impl_GetProperties, "GetProperties" },
   { NULL, NULL }
 };
 
@@ -350,6 +966,11 @@ spi_initialize_cache (DRoutePath *path)
 
   g_signal_connect (spi_global_cache, "object-removed",
                     (GCallback) emit_cache_remove, NULL);
+
+  g_signal_connect (spi_global_cache, "population-progress",
+                    (GCallback) emit_population_progress, NULL);
+
+  g_object_weak_ref (G_OBJECT (spi_global_cache), discard_pending_signals, NULL);
 };
 
 /*END------------------------------------------------------------------------*/
@@ -30,7 +30,6 @@
 #include <droute/droute.h>
 
 #include "accessible-stateset.h"
-#include "bitarray.h"
 #include "spi-dbus.h"
 
 #include "accessible-register.h"
@@ -39,231 +38,165 @@
 
 #define MAX_CHILDREN 65536
 
+/* ATK roles, as bits of a match rule's role bitmap */
+#define ROLE_WORDS ((ATK_ROLE_LAST_DEFINED + 31) / 32)
+
+typedef struct _MatchInterface MatchInterface;
+struct _MatchInterface
+{
+  GType type;    /* G_TYPE_INVALID if the name never matches */
+  gchar *action; /* for an Action, the name of an action it must have */
+};
+
+/* A match rule compiled into masks that each candidate is tested against
+ * with one state set fetch and bitwise operations.
+ */
 typedef struct _MatchRulePrivate MatchRulePrivate;
 struct _MatchRulePrivate
 {
-  gint *states;
+  guint64 states;          /* ATK states, as a bit mask */
+  gboolean unmapped_state; /* a requested state has no ATK equivalent */
   AtspiCollectionMatchType statematchtype;
   AtkAttributeSet *attributes;
   AtspiCollectionMatchType attributematchtype;
-  gint *roles;
+  guint32 roles[ROLE_WORDS]; /* ATK roles matching the requested roles */
+  gboolean extended_role;    /* roles beyond the known ATK roles match */
+  gint n_roles;              /* number of AT-SPI roles requested */
   AtspiCollectionMatchType rolematchtype;
-  gchar **ifaces;
+  MatchInterface *ifaces;
+  gint n_ifaces;
   AtspiCollectionMatchType interfacematchtype;
   gboolean invert;
 };
 
-static gboolean
-child_interface_p (AtkObject *child, gchar *repo_id)
+static const struct
 {
-  if (!strncasecmp (repo_id, "action", 6))
-    {
-      AtkAction *iface;
-      gint i, count;
-      char *p;
-      char name[64];
-      if (!ATK_IS_ACTION (child))
-        return FALSE;
-      iface = ATK_ACTION (child);
-      count = atk_action_get_n_actions (iface);
-      if (count <= 0)
-        return FALSE;
-      if (repo_id[6] == '\0')
-        return TRUE;
-      p = strchr (repo_id, '(');
-      if (!p)
-        return FALSE;
-      strncpy (name, p + 1, sizeof (name));
-      name[sizeof (name) - 1] = '\0';
-      p = strchr (name, ')');
-      if (p)
-        *p = '\0';
-      for (i = 0; i < count; i++)
-        {
-          const char *action = atk_action_get_name (iface, i);
-          if (!strcasecmp (name, action))
-            return TRUE;
-        }
-      return FALSE;
-    }
-  if (!strcasecmp (repo_id, "component"))
-    return ATK_IS_COMPONENT (child);
-  if (!strcasecmp (repo_id, "editabletext"))
-    return ATK_IS_EDITABLE_TEXT (child);
-  if (!strcasecmp (repo_id, "text"))
-    return ATK_IS_TEXT (child);
-  if (!strcasecmp (repo_id, "hypertext"))
-    return ATK_IS_HYPERTEXT (child);
-  if (!strcasecmp (repo_id, "image"))
-    return ATK_IS_IMAGE (child);
-  if (!strcasecmp (repo_id, "selection"))
-    return ATK_IS_SELECTION (child);
-  if (!strcasecmp (repo_id, "table"))
-    return ATK_IS_TABLE (child);
-  if (!strcasecmp (repo_id, "value"))
-    return ATK_IS_VALUE (child);
-  if (!strcasecmp (repo_id, "streamablecontent"))
-    return ATK_IS_STREAMABLE_CONTENT (child);
-  if (!strcasecmp (repo_id, "document"))
-    return ATK_IS_DOCUMENT (child);
-  return FALSE;
-}
-
-#define child_collection_p(ch) (TRUE)
+  const char *name;
+  GType (*get_type) (void);
+} interface_types[] = {
+  { "component", atk_component_get_type },
+  { "editabletext", atk_editable_text_get_type },
+  { "text", atk_text_get_type },
+  { "hypertext", atk_hypertext_get_type },
+  { "image", atk_image_get_type },
+  { "selection", atk_selection_get_type },
+  { "table", atk_table_get_type },
+  { "value", atk_value_get_type },
+  { "streamablecontent", atk_streamable_content_get_type },
+  { "document", atk_document_get_type },
+};
 
-static gboolean
-match_states_all_p (AtkObject *child, gint *set)
+static void
+compile_interface (MatchInterface *iface, const char *repo_id)
 {
-  AtkStateSet *chs;
   gint i;
-  gboolean ret = TRUE;
-
-  if (set == NULL || set[0] == BITARRAY_SEQ_TERM)
-    return TRUE;
 
-  chs = atk_object_ref_state_set (child);
+  iface->type = G_TYPE_INVALID;
+  iface->action = NULL;
 
-  // TODO: use atk-state_set_contains_states; would be more efficient
-  for (i = 0; set[i] != BITARRAY_SEQ_TERM; i++)
+  if (!strncasecmp (repo_id, "action", 6))
     {
-      if (!atk_state_set_contains_state (chs, set[i]))
+      const char *p;
+
+      if (repo_id[6] == '\0')
         {
-          ret = FALSE;
-          break;
+          iface->type = ATK_TYPE_ACTION;
+          return;
         }
+      p = strchr (repo_id, '(');
+      if (!p)
+        return;
+      iface->type = ATK_TYPE_ACTION;
+      iface->action = g_strndup (p + 1, strcspn (p + 1, ")"));
+      return;
     }
 
-  g_object_unref (chs);
-  return ret;
+  for (i = 0; i < G_N_ELEMENTS (interface_types); i++)
+    if (!strcasecmp (repo_id, interface_types[i].name))
+      {
+        iface->type = interface_types[i].get_type ();
+        return;
+      }
 }
 
 static gboolean
-match_states_any_p (AtkObject *child, gint *set)
+child_interface_p (AtkObject *child, const MatchInterface *iface)
 {
-  AtkStateSet *chs;
-  gint i;
-  gboolean ret = FALSE;
+  AtkAction *action;
+  gint i, count;
 
-  if (set == NULL || set[0] == BITARRAY_SEQ_TERM)
+  if (iface->type == G_TYPE_INVALID ||
+      !G_TYPE_CHECK_INSTANCE_TYPE (child, iface->type))
+    return FALSE;
+  if (iface->type != ATK_TYPE_ACTION)
     return TRUE;
 
-  chs = atk_object_ref_state_set (child);
-
-  for (i = 0; set[i] != BITARRAY_SEQ_TERM; i++)
+  action = ATK_ACTION (child);
+  count = atk_action_get_n_actions (action);
+  if (count <= 0)
+    return FALSE;
+  if (!iface->action)
+    return TRUE;
+  for (i = 0; i < count; i++)
     {
-      if (atk_state_set_contains_state (chs, set[i]))
-        {
-          ret = TRUE;
-          break;
-        }
+      const char *name = atk_action_get_name (action, i);
+      if (name && !strcasecmp (iface->action, name))
+        return TRUE;
     }
-
-  g_object_unref (chs);
-  return ret;
+  return FALSE;
 }
 
-static gboolean
-match_states_none_p (AtkObject *child, gint *set)
+#define child_collection_p(ch) (TRUE)
+
+/* Returns those of the @wanted states that @child is in */
+static guint64
+child_states (AtkObject *child, guint64 wanted)
 {
-  AtkStateSet *chs;
+  AtkStateSet *set;
+  guint64 states = 0;
   gint i;
-  gboolean ret = TRUE;
 
-  if (set == NULL || set[0] == BITARRAY_SEQ_TERM)
-    return TRUE;
-
-  chs = atk_object_ref_state_set (child);
-
-  for (i = 0; set[i] != BITARRAY_SEQ_TERM; i++)
-    {
-      if (atk_state_set_contains_state (chs, set[i]))
-        {
-          ret = FALSE;
-          break;
-        }
-    }
-
-  g_object_unref (chs);
-  return ret;
+  set = atk_object_ref_state_set (child);
+  if (!set)
+    return 0;
+  for (i = 0; wanted; i++, wanted >>= 1)
+    if ((wanted & 1) && atk_state_set_contains_state (set, i))
+      states |= G_GUINT64_CONSTANT (1) << i;
+  g_object_unref (set);
+  return states;
 }
 
-// TODO: need to convert at-spi roles/states to atk roles/states */
 static gboolean
 match_states_lookup (AtkObject *child, MatchRulePrivate *mrp)
 {
   switch (mrp->statematchtype)
     {
     case ATSPI_Collection_MATCH_ALL:
-      if (match_states_all_p (child, mrp->states))
-        return TRUE;
-      break;
+      if (mrp->unmapped_state)
+        return FALSE;
+      return !mrp->states || child_states (child, mrp->states) == mrp->states;
 
     case ATSPI_Collection_MATCH_ANY:
-      if (match_states_any_p (child, mrp->states))
-        return TRUE;
-      break;
+      if (!mrp->states)
+        return !mrp->unmapped_state;
+      return child_states (child, mrp->states) != 0;
 
     case ATSPI_Collection_MATCH_NONE:
-      if (match_states_none_p (child, mrp->states))
-        return TRUE;
-      break;
+      return !mrp->states || child_states (child, mrp->states) == 0;
 
     default:
-      break;
+      return FALSE;
     }
-
-  return FALSE;
-}
-
-// TODO: Map at-spi -> atk roles at mrp creation instead of doing this;
-// would be more efficient
-#define spi_get_role(obj) spi_accessible_role_from_atk_role (atk_object_get_role (obj))
-
-static gboolean
-match_roles_all_p (AtkObject *child, gint *roles)
-{
-  if (roles == NULL || roles[0] == BITARRAY_SEQ_TERM)
-    return TRUE;
-  else if (roles[1] != BITARRAY_SEQ_TERM)
-    return FALSE;
-
-  return (spi_get_role (child) == roles[0]);
 }
 
 static gboolean
-match_roles_any_p (AtkObject *child, gint *roles)
+child_role_p (AtkObject *child, MatchRulePrivate *mrp)
 {
-  AtspiRole role;
-  int i;
-
-  if (roles == NULL || roles[0] == BITARRAY_SEQ_TERM)
-    return TRUE;
+  AtkRole role = atk_object_get_role (child);
 
-  role = spi_accessible_role_from_atk_role (atk_object_get_role (child));
-
-  for (i = 0; roles[i] != BITARRAY_SEQ_TERM; i++)
-    if (role == roles[i])
-      return TRUE;
-
-  return FALSE;
-}
-
-static gboolean
-match_roles_none_p (AtkObject *child, gint *roles)
-{
-  AtspiRole role;
-  int i;
-
-  if (roles == NULL || roles[0] == BITARRAY_SEQ_TERM)
-    return TRUE;
-
-  role = spi_get_role (child);
-
-  for (i = 0; roles[i] != BITARRAY_SEQ_TERM; i++)
-    if (role == roles[i])
-      return FALSE;
-
-  return TRUE;
+  if (role >= 0 && role < ATK_ROLE_LAST_DEFINED)
+    return (mrp->roles[role >> 5] & (1u << (role & 31))) != 0;
+  return mrp->extended_role;
 }
 
 static gboolean
@@ -272,96 +205,50 @@ match_roles_lookup (AtkObject *child, MatchRulePrivate *mrp)
   switch (mrp->rolematchtype)
     {
     case ATSPI_Collection_MATCH_ALL:
-      if (match_roles_all_p (child, mrp->roles))
-        return TRUE;
-      break;
+      /* An object only has one role */
+      if (mrp->n_roles > 1)
+        return FALSE;
+      return mrp->n_roles == 0 || child_role_p (child, mrp);
 
     case ATSPI_Collection_MATCH_ANY:
-      if (match_roles_any_p (child, mrp->roles))
-        return TRUE;
-      break;
+      return mrp->n_roles == 0 || child_role_p (child, mrp);
 
     case ATSPI_Collection_MATCH_NONE:
-      if (match_roles_none_p (child, mrp->roles))
-        return TRUE;
-      break;
+      return mrp->n_roles == 0 || !child_role_p (child, mrp);
 
     default:
-      break;
+      return FALSE;
     }
-  return FALSE;
-}
-
-static gboolean
-match_interfaces_all_p (AtkObject *obj, gchar **ifaces)
-{
-  gint i;
-
-  if (ifaces == NULL)
-    return TRUE;
-
-  for (i = 0; ifaces[i]; i++)
-    if (!child_interface_p (obj, ifaces[i]))
-      {
-        return FALSE;
-      }
-  return TRUE;
 }
 
 static gboolean
-match_interfaces_any_p (AtkObject *obj, gchar **ifaces)
-{
-  gint i;
-
-  if (ifaces == NULL)
-    return TRUE;
-
-  for (i = 0; ifaces[i]; i++)
-    if (child_interface_p (obj, ifaces[i]))
-      {
-        return TRUE;
-      }
-  return FALSE;
-}
-
-static gboolean
-match_interfaces_none_p (AtkObject *obj, gchar **ifaces)
+match_interfaces_lookup (AtkObject *child, MatchRulePrivate *mrp)
 {
   gint i;
 
-  for (i = 0; ifaces[i]; i++)
-    if (child_interface_p (obj, ifaces[i]))
-      return FALSE;
-
-  return TRUE;
-}
-
-static gboolean
-match_interfaces_lookup (AtkObject *child, MatchRulePrivate *mrp)
-{
   switch (mrp->interfacematchtype)
     {
-
     case ATSPI_Collection_MATCH_ALL:
-      if (match_interfaces_all_p (child, mrp->ifaces))
-        return TRUE;
-      break;
+      for (i = 0; i < mrp->n_ifaces; i++)
+        if (!child_interface_p (child, &mrp->ifaces[i]))
+          return FALSE;
+      return TRUE;
 
     case ATSPI_Collection_MATCH_ANY:
-      if (match_interfaces_any_p (child, mrp->ifaces))
-        return TRUE;
-      break;
+      for (i = 0; i < mrp->n_ifaces; i++)
+        if (child_interface_p (child, &mrp->ifaces[i]))
+          return TRUE;
+      return FALSE;
 
     case ATSPI_Collection_MATCH_NONE:
-      if (match_interfaces_none_p (child, mrp->ifaces))
-        return TRUE;
-      break;
+      for (i = 0; i < mrp->n_ifaces; i++)
+        if (child_interface_p (child, &mrp->ifaces[i]))
+          return FALSE;
+      return TRUE;
 
     default:
-      break;
+      return FALSE;
     }
-
-  return FALSE;
 }
 
 #define split_attributes(attributes) (g_strsplit (attributes, ";", 0))
@@ -499,6 +386,18 @@ match_attributes_lookup (AtkObject *child, MatchRulePrivate *mrp)
   return FALSE;
 }
 
+/* Tests the cheapest criteria first, so that most candidates are
+ * rejected without a state set or attribute fetch.
+ */
+static gboolean
+match_rule_p (AtkObject *child, MatchRulePrivate *mrp)
+{
+  return match_roles_lookup (child, mrp) &&
+         match_interfaces_lookup (child, mrp) &&
+         match_states_lookup (child, mrp) &&
+         match_attributes_lookup (child, mrp);
+}
+
 static gboolean
 traverse_p (AtkObject *child, const gboolean traverse)
 {
@@ -508,8 +407,55 @@ traverse_p (AtkObject *child, const gboolean traverse)
     return !child_collection_p (child);
 }
 
-static int
-sort_order_canonical (MatchRulePrivate *mrp, GList *ls, gint kount, gint max, AtkObject *obj, glong index, gboolean flag, AtkObject *pobj, gboolean recurse, gboolean traverse)
+/* The matches of a query, marshalled into the reply as they are found;
+ * every walk visits objects in the order their matches are returned.
+ */
+typedef struct _MatchResults MatchResults;
+struct _MatchResults
+{
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_array;
+  AtkObject *last; /* the latest match, kept alive by its reference */
+  gint count;
+};
+
+static void
+results_begin (MatchResults *results, DBusMessage *message)
+{
+  results->reply = dbus_message_new_method_return (message);
+  results->last = NULL;
+  results->count = 0;
+  if (!results->reply)
+    return;
+  dbus_message_iter_init_append (results->reply, &results->iter);
+  dbus_message_iter_open_container (&results->iter, DBUS_TYPE_ARRAY, "(so)",
+                                    &results->iter_array);
+}
+
+static void
+results_add (MatchResults *results, AtkObject *obj)
+{
+  if (results->reply)
+    spi_object_append_reference (&results->iter_array, obj);
+  results->last = obj;
+  results->count++;
+}
+
+/* Closes the array of matches; further values can then be appended to
+ * results->iter before the reply is returned.
+ */
+static void
+results_end (MatchResults *results)
+{
+  if (results->reply)
+    dbus_message_iter_close_container (&results->iter, &results->iter_array);
+}
+
+#define results_full(results, max) ((max) > 0 && (results)->count >= (max))
+
+/* Returns TRUE if pobj was reached, which ends the whole walk */
+static gboolean
+sort_order_canonical (MatchRulePrivate *mrp, MatchResults *results, gint max, AtkObject *obj, glong index, gboolean flag, AtkObject *pobj, gboolean recurse, gboolean traverse)
 {
   gint i = index;
   glong acount = atk_object_get_n_accessible_children (obj);
@@ -517,7 +463,7 @@ sort_order_canonical (MatchRulePrivate *mrp, GList *ls, gint kount, gint max, At
 
   if (acount > MAX_CHILDREN)
     acount = MAX_CHILDREN;
-  for (; i < acount && (max == 0 || kount < max); i++)
+  for (; i < acount && !results_full (results, max); i++)
     {
       AtkObject *child = atk_object_ref_accessible_child (obj, i);
 
@@ -527,134 +473,371 @@ sort_order_canonical (MatchRulePrivate *mrp, GList *ls, gint kount, gint max, At
       if (prev && child == pobj)
         {
           g_object_unref (child);
-          return kount;
+          return TRUE;
         }
 
-      if (flag && match_interfaces_lookup (child, mrp) && match_states_lookup (child, mrp) && match_roles_lookup (child, mrp) && match_attributes_lookup (child, mrp))
-        {
-
-          ls = g_list_append (ls, child);
-          kount++;
-        }
+      if (flag && match_rule_p (child, mrp))
+        results_add (results, child);
 
       if (!flag)
         flag = TRUE;
 
-      if (recurse && traverse_p (child, traverse))
-        kount = sort_order_canonical (mrp, ls, kount,
-                                      max, child, 0, TRUE,
-                                      pobj, recurse, traverse);
+      if (recurse && traverse_p (child, traverse) &&
+          sort_order_canonical (mrp, results, max, child, 0, TRUE,
+                                pobj, recurse, traverse))
+        {
+          g_object_unref (child);
+          return TRUE;
+        }
       g_object_unref (child);
     }
-  return kount;
+  return FALSE;
 }
 
-static int
-sort_order_rev_canonical (MatchRulePrivate *mrp, GList *ls, gint kount, gint max, AtkObject *obj, gboolean flag, AtkObject *pobj)
+/* Visits the children of obj from the last one down to index, each after
+ * its own descendants, so that the walk can stop at the max'th match from
+ * the end.
+ */
+static void
+sort_order_rev_subtree (MatchRulePrivate *mrp, MatchResults *results, gint max, AtkObject *obj, glong index, gboolean flag, gboolean recurse, gboolean traverse)
 {
-  AtkObject *nextobj;
-  AtkObject *parent;
-  glong indexinparent;
+  glong i = atk_object_get_n_accessible_children (obj);
 
-  /* This breaks us out of the recursion. */
-  if (!obj || obj == pobj)
+  if (i > MAX_CHILDREN)
+    i = MAX_CHILDREN;
+  if (index < 0)
+    index = 0;
+  while (--i >= index && !results_full (results, max))
     {
-      return kount;
+      AtkObject *child = atk_object_ref_accessible_child (obj, i);
+
+      if (!child)
+        continue;
+
+      if (recurse && traverse_p (child, traverse))
+        sort_order_rev_subtree (mrp, results, max, child, 0, TRUE,
+                                recurse, traverse);
+
+      if ((flag || i != index) && !results_full (results, max) &&
+          match_rule_p (child, mrp))
+        results_add (results, child);
+      g_object_unref (child);
     }
+}
+
+/* Walks backwards from obj, through the last descendants of its previous
+ * siblings and then its parent, until pobj is reached.
+ */
+static void
+sort_order_rev_canonical (MatchRulePrivate *mrp, MatchResults *results, gint max, AtkObject *obj, gboolean flag, AtkObject *pobj, gboolean traverse)
+{
+  if (obj)
+    g_object_ref (obj);
 
-  /* Add to the list if it matches */
-  if (flag && match_interfaces_lookup (obj, mrp) && match_states_lookup (obj, mrp) && match_roles_lookup (obj, mrp) && match_attributes_lookup (obj, mrp) && (max == 0 || kount < max))
+  while (obj && obj != pobj && !results_full (results, max))
     {
-      ls = g_list_append (ls, obj);
-      kount++;
+      AtkObject *parent = atk_object_get_parent (obj);
+      glong indexinparent = atk_object_get_index_in_parent (obj);
+      AtkObject *nextobj;
+
+      if (flag && match_rule_p (obj, mrp))
+        results_add (results, obj);
+      flag = TRUE;
+
+      if (parent && indexinparent > 0)
+        {
+          nextobj = atk_object_ref_accessible_child (parent, indexinparent - 1);
+
+          /* Now, drill down the right side to the last descendant */
+          while (nextobj && traverse_p (nextobj, traverse))
+            {
+              AtkObject *follow;
+              gint count = atk_object_get_n_accessible_children (nextobj);
+
+              if (count <= 0)
+                break;
+              if (count > MAX_CHILDREN)
+                count = MAX_CHILDREN;
+              follow = atk_object_ref_accessible_child (nextobj, count - 1);
+              if (!follow)
+                break;
+              g_object_unref (nextobj);
+              nextobj = follow;
+            }
+        }
+      else
+        {
+          /* no more siblings so next node must be the parent */
+          nextobj = (parent ? g_object_ref (parent) : NULL);
+        }
+
+      g_object_unref (obj);
+      obj = nextobj;
     }
 
-  /* Get the current nodes index in it's parent and the parent object. */
-  indexinparent = atk_object_get_index_in_parent (obj);
-  parent = atk_object_get_parent (obj);
+  if (obj)
+    g_object_unref (obj);
+}
 
-  if (indexinparent > 0 && (max == 0 || kount < max))
+typedef struct _FlowChild FlowChild;
+struct _FlowChild
+{
+  AtkObject *child;
+  gint x, y;
+  glong index;
+};
+
+static gint
+flow_child_compare (gconstpointer a, gconstpointer b)
+{
+  const FlowChild *fa = a;
+  const FlowChild *fb = b;
+
+  if (fa->y != fb->y)
+    return (fa->y < fb->y ? -1 : 1);
+  if (fa->x != fb->x)
+    return (fa->x < fb->x ? -1 : 1);
+  return (fa->index < fb->index ? -1 : fa->index > fb->index);
+}
+
+/* Returns references to the children of obj sorted top to bottom, then
+ * left to right.  A child without extents keeps its place after the
+ * sibling that precedes it.
+ */
+static GArray *
+ref_children_in_flow_order (AtkObject *obj)
+{
+  glong n = atk_object_get_n_accessible_children (obj);
+  GArray *children;
+  gint x = G_MININT, y = G_MININT;
+  glong i;
+
+  if (n > MAX_CHILDREN)
+    n = MAX_CHILDREN;
+  children = g_array_sized_new (FALSE, FALSE, sizeof (FlowChild), MAX (n, 0));
+  for (i = 0; i < n; i++)
     {
-      /* there are still some siblings to visit so get the previous sibling
-         and get it's last descendant.
-         First, get the previous sibling */
-      nextobj = atk_object_ref_accessible_child (parent, indexinparent - 1);
+      FlowChild fc;
 
-      /* Now, drill down the right side to the last descendant */
-      while (nextobj && atk_object_get_n_accessible_children (nextobj) > 0)
+      fc.child = atk_object_ref_accessible_child (obj, i);
+      if (!fc.child)
+        continue;
+      if (ATK_IS_COMPONENT (fc.child))
         {
-          AtkObject *follow;
-          gint count = atk_object_get_n_accessible_children (nextobj);
-          if (count > MAX_CHILDREN)
-            count = MAX_CHILDREN;
-
-          follow = atk_object_ref_accessible_child (nextobj, count - 1);
-          g_object_unref (nextobj);
-          nextobj = follow;
+          gint cx = -1, cy = -1, width = -1, height = -1;
+
+          atk_component_get_extents (ATK_COMPONENT (fc.child), &cx, &cy,
+                                     &width, &height, ATK_XY_WINDOW);
+          if (width > 0 && height > 0)
+            {
+              x = cx;
+              y = cy;
+            }
         }
-      /* recurse with the last descendant */
-      kount = sort_order_rev_canonical (mrp, ls, kount, max,
-                                        nextobj, TRUE, pobj);
-      if (nextobj)
-        g_object_unref (nextobj);
+      fc.x = x;
+      fc.y = y;
+      fc.index = i;
+      g_array_append_val (children, fc);
+    }
+  g_array_sort (children, flow_child_compare);
+  return children;
+}
+
+static gboolean
+child_focusable_p (AtkObject *child)
+{
+  AtkStateSet *set = atk_object_ref_state_set (child);
+  gboolean ret;
+
+  if (!set)
+    return FALSE;
+  ret = atk_state_set_contains_state (set, ATK_STATE_FOCUSABLE);
+  g_object_unref (set);
+  return ret;
+}
+
+/* A walk in flow or tab order.  Matching begins after start and the walk
+ * ends at stop, either of which may be NULL.
+ */
+typedef struct _FlowWalk FlowWalk;
+struct _FlowWalk
+{
+  MatchRulePrivate *mrp;
+  MatchResults *results;
+  gint max;
+  AtkObject *start;
+  AtkObject *stop;
+  gboolean started;
+  gboolean reverse;
+  gboolean tab;
+  gboolean traverse;
+};
+
+/* Returns FALSE once the walk is over */
+static gboolean
+flow_walk_visit (FlowWalk *walk, AtkObject *child)
+{
+  if (child == walk->stop)
+    return FALSE;
+  if (child == walk->start)
+    walk->started = TRUE;
+  else if (walk->started && match_rule_p (child, walk->mrp) &&
+           (!walk->tab || child_focusable_p (child)))
+    results_add (walk->results, child);
+  return !results_full (walk->results, walk->max);
+}
+
+static gboolean
+sort_order_flow (FlowWalk *walk, AtkObject *obj)
+{
+  GArray *children = ref_children_in_flow_order (obj);
+  gboolean more = TRUE;
+  guint i;
+
+  for (i = 0; i < children->len && more; i++)
+    {
+      guint n = (walk->reverse ? children->len - 1 - i : i);
+      AtkObject *child = g_array_index (children, FlowChild, n).child;
+
+      if (!walk->reverse)
+        more = flow_walk_visit (walk, child);
+      if (more && traverse_p (child, walk->traverse))
+        more = sort_order_flow (walk, child);
+      if (more && walk->reverse)
+        more = flow_walk_visit (walk, child);
     }
-  else if (max == 0 || kount < max)
+
+  for (i = 0; i < children->len; i++)
+    g_object_unref (g_array_index (children, FlowChild, i).child);
+  g_array_free (children, TRUE);
+  return more;
+}
+
+static gboolean
+sort_order_reverse_p (AtspiCollectionSortOrder sortby)
+{
+  return (sortby == ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL ||
+          sortby == ATSPI_Collection_SORT_ORDER_REVERSE_FLOW ||
+          sortby == ATSPI_Collection_SORT_ORDER_REVERSE_TAB);
+}
+
+/* The sort order that visits the same objects the other way round */
+static AtspiCollectionSortOrder
+sort_order_opposite (AtspiCollectionSortOrder sortby)
+{
+  switch (sortby)
     {
-      /* no more siblings so next node must be the parent */
-      kount = sort_order_rev_canonical (mrp, ls, kount, max,
-                                        parent, TRUE, pobj);
+    case ATSPI_Collection_SORT_ORDER_CANONICAL:
+      return ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL;
+    case ATSPI_Collection_SORT_ORDER_FLOW:
+      return ATSPI_Collection_SORT_ORDER_REVERSE_FLOW;
+    case ATSPI_Collection_SORT_ORDER_TAB:
+      return ATSPI_Collection_SORT_ORDER_REVERSE_TAB;
+    case ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL:
+      return ATSPI_Collection_SORT_ORDER_CANONICAL;
+    case ATSPI_Collection_SORT_ORDER_REVERSE_FLOW:
+      return ATSPI_Collection_SORT_ORDER_FLOW;
+    case ATSPI_Collection_SORT_ORDER_REVERSE_TAB:
+      return ATSPI_Collection_SORT_ORDER_TAB;
+    default:
+      return sortby;
     }
-  return kount;
 }
 
-static int
-query_exec (MatchRulePrivate *mrp, AtspiCollectionSortOrder sortby, GList *ls, gint kount, gint max, AtkObject *obj, glong index, gboolean flag, AtkObject *pobj, gboolean recurse, gboolean traverse)
+/* Finds the matches among the descendants of obj, starting at its child
+ * at index (whose own match is skipped unless flag is set) and ending
+ * before pobj, in the given order.
+ */
+static void
+query_exec (MatchRulePrivate *mrp, AtspiCollectionSortOrder sortby, MatchResults *results, gint max, AtkObject *obj, glong index, gboolean flag, AtkObject *pobj, gboolean recurse, gboolean traverse)
 {
   switch (sortby)
     {
     case ATSPI_Collection_SORT_ORDER_CANONICAL:
-      kount = sort_order_canonical (mrp, ls, 0, max, obj, index, flag,
-                                    pobj, recurse, traverse);
+      sort_order_canonical (mrp, results, max, obj, index, flag,
+                            pobj, recurse, traverse);
       break;
     case ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL:
-      kount = sort_order_canonical (mrp, ls, 0, max, obj, index, flag,
-                                    pobj, recurse, traverse);
+      if (pobj)
+        sort_order_rev_canonical (mrp, results, max, pobj, FALSE, obj,
+                                  traverse);
+      else
+        sort_order_rev_subtree (mrp, results, max, obj, index, flag,
+                                recurse, traverse);
+      break;
+    case ATSPI_Collection_SORT_ORDER_FLOW:
+    case ATSPI_Collection_SORT_ORDER_TAB:
+    case ATSPI_Collection_SORT_ORDER_REVERSE_FLOW:
+    case ATSPI_Collection_SORT_ORDER_REVERSE_TAB:
+      {
+        FlowWalk walk;
+        AtkObject *first = NULL;
+
+        if (!flag)
+          first = atk_object_ref_accessible_child (obj, index);
+
+        walk.mrp = mrp;
+        walk.results = results;
+        walk.max = max;
+        walk.reverse = sort_order_reverse_p (sortby);
+        walk.tab = (sortby == ATSPI_Collection_SORT_ORDER_TAB ||
+                    sortby == ATSPI_Collection_SORT_ORDER_REVERSE_TAB);
+        walk.traverse = traverse;
+        /* Going backwards, pobj is where matching begins */
+        walk.start = (walk.reverse ? pobj : first);
+        walk.stop = (walk.reverse ? first : pobj);
+        walk.started = (walk.start == NULL);
+        sort_order_flow (&walk, obj);
+        if (first)
+          g_object_unref (first);
+      }
       break;
     default:
-      kount = 0;
       g_warning ("Sort method not implemented yet");
       break;
     }
+}
+
+static void
+compile_states (dbus_uint32_t *array, int array_count, MatchRulePrivate *mrp)
+{
+  int i;
+
+  mrp->states = 0;
+  mrp->unmapped_state = FALSE;
+  for (i = 0; i < array_count * 32; i++)
+    {
+      AtkStateType state;
 
-  return kount;
+      if (!(array[i >> 5] & (1u << (i & 31))))
+        continue;
+      state = spi_atk_state_from_spi_state (i);
+      if (state == ATK_STATE_INVALID || state >= 64)
+        mrp->unmapped_state = TRUE;
+      else
+        mrp->states |= G_GUINT64_CONSTANT (1) << state;
+    }
 }
 
-static gboolean
-bitarray_to_seq (dbus_uint32_t *array, int array_count, int **ret)
+static void
+compile_roles (dbus_uint32_t *array, int array_count, MatchRulePrivate *mrp)
 {
-  int out_size = 4;
-  int out_count = 0;
-  int i, j;
-  int *out = (int *) g_malloc (out_size * sizeof (int));
+  int i;
 
-  for (i = 0; i < array_count; i++)
+  memset (mrp->roles, 0, sizeof (mrp->roles));
+  mrp->n_roles = 0;
+  for (i = 0; i < array_count * 32; i++)
+    if (array[i >> 5] & (1u << (i & 31)))
+      mrp->n_roles++;
+
+  for (i = 0; i < ATK_ROLE_LAST_DEFINED; i++)
     {
-      for (j = 0; j < 32; j++)
-        {
-          if (array[i] & (1 << j))
-            {
-              if (out_count == out_size - 2)
-                {
-                  out_size <<= 1;
-                  out = (int *) g_realloc (out, out_size * sizeof (int));
-                }
-              out[out_count++] = i * 32 + j;
-            }
-        }
+      AtspiRole role = spi_accessible_role_from_atk_role (i);
+      if (role < array_count * 32 && (array[role >> 5] & (1u << (role & 31))))
+        mrp->roles[i >> 5] |= 1u << (i & 31);
     }
-  out[out_count] = BITARRAY_SEQ_TERM;
-  *ret = out;
-  return TRUE;
+  mrp->extended_role = (ATSPI_ROLE_EXTENDED < array_count * 32 &&
+                        (array[ATSPI_ROLE_EXTENDED >> 5] & (1u << (ATSPI_ROLE_EXTENDED & 31))));
 }
 
 static dbus_bool_t
@@ -672,11 +855,7 @@ read_mr (DBusMessageIter *iter, MatchRulePrivate *mrp)
   /* states */
   dbus_message_iter_recurse (&iter_struct, &iter_array);
   dbus_message_iter_get_fixed_array (&iter_array, &array, &array_count);
-  bitarray_to_seq (array, array_count, &mrp->states);
-  for (i = 0; mrp->states[i] != BITARRAY_SEQ_TERM; i++)
-    {
-      mrp->states[i] = spi_atk_state_from_spi_state (mrp->states[i]);
-    }
+  compile_states (array, array_count, mrp);
   dbus_message_iter_next (&iter_struct);
   dbus_message_iter_get_basic (&iter_struct, &matchType);
   dbus_message_iter_next (&iter_struct);
@@ -732,7 +911,7 @@ read_mr (DBusMessageIter *iter, MatchRulePrivate *mrp)
   /* Get roles and role match */
   dbus_message_iter_recurse (&iter_struct, &iter_array);
   dbus_message_iter_get_fixed_array (&iter_array, &array, &array_count);
-  bitarray_to_seq (array, array_count, &mrp->roles);
+  compile_roles (array, array_count, mrp);
   dbus_message_iter_next (&iter_struct);
   dbus_message_iter_get_basic (&iter_struct, &matchType);
   mrp->rolematchtype = matchType;
@@ -741,16 +920,17 @@ read_mr (DBusMessageIter *iter, MatchRulePrivate *mrp)
 
   /* Get interfaces and interface match */
   dbus_message_iter_recurse (&iter_struct, &iter_array);
-  mrp->ifaces = g_new0 (gchar *, 16);
+  mrp->ifaces = g_new0 (MatchInterface, 16);
   i = 0;
-  while (i < 15 && dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+  while (i < 16 && dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
     {
       char *iface;
       dbus_message_iter_get_basic (&iter_array, &iface);
-      mrp->ifaces[i] = g_strdup (iface);
+      compile_interface (&mrp->ifaces[i], iface);
       i++;
       dbus_message_iter_next (&iter_array);
     }
+  mrp->n_ifaces = i;
   dbus_message_iter_next (&iter_struct);
   dbus_message_iter_get_basic (&iter_struct, &matchType);
   mrp->interfacematchtype = matchType;
@@ -762,40 +942,15 @@ read_mr (DBusMessageIter *iter, MatchRulePrivate *mrp)
   return TRUE;
 }
 
-static DBusMessage *
-return_and_free_list (DBusMessage *message, GList *ls)
-{
-  DBusMessage *reply;
-  DBusMessageIter iter, iter_array;
-  GList *item;
-
-  reply = dbus_message_new_method_return (message);
-  if (!reply)
-    return NULL;
-  dbus_message_iter_init_append (reply, &iter);
-  if (!dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "(so)", &iter_array))
-    goto oom;
-  for (item = ls; item; item = g_list_next (item))
-    {
-      spi_object_append_reference (&iter_array, ATK_OBJECT (item->data));
-    }
-  if (!dbus_message_iter_close_container (&iter, &iter_array))
-    goto oom;
-  g_list_free (ls);
-  return reply;
-oom:
-  // TODO: Handle out of memory
-  g_list_free (ls);
-  return reply;
-}
-
 static void
 free_mrp_data (MatchRulePrivate *mrp)
 {
-  g_free (mrp->states);
+  gint i;
+
   atk_attribute_set_free (mrp->attributes);
-  g_free (mrp->roles);
-  g_strfreev (mrp->ifaces);
+  for (i = 0; i < mrp->n_ifaces; i++)
+    g_free (mrp->ifaces[i].action);
+  g_free (mrp->ifaces);
 }
 
 static DBusMessage *
@@ -807,55 +962,81 @@ GetMatchesFrom (DBusMessage *message,
                 dbus_int32_t count,
                 const dbus_bool_t traverse)
 {
-  GList *ls = NULL;
+  MatchResults results;
   AtkObject *parent;
   glong index = atk_object_get_index_in_parent (current_object);
 
-  ls = g_list_append (ls, current_object);
+  results_begin (&results, message);
 
   if (!isrestrict)
     {
       parent = atk_object_get_parent (current_object);
-      query_exec (mrp, sortby, ls, 0, count, parent, index,
+      query_exec (mrp, sortby, &results, count, parent, index,
                   FALSE, NULL, TRUE, traverse);
     }
   else
-    query_exec (mrp, sortby, ls, 0, count,
+    query_exec (mrp, sortby, &results, count,
                 current_object, 0, FALSE, NULL, TRUE, traverse);
 
-  ls = g_list_remove (ls, ls->data);
-
-  if (sortby == ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL)
-    ls = g_list_reverse (ls);
-
+  results_end (&results);
   free_mrp_data (mrp);
-  return return_and_free_list (message, ls);
+  return results.reply;
 }
 
 /*
   inorder traversal from a given object in the hierarchy
 */
 
-static int
-inorder (AtkObject *collection, MatchRulePrivate *mrp, GList *ls, gint kount, gint max, AtkObject *obj, gboolean flag, AtkObject *pobj, dbus_bool_t traverse)
+static void
+inorder (AtkObject *collection, MatchRulePrivate *mrp, MatchResults *results, gint max, AtkObject *obj, dbus_bool_t traverse, gboolean reverse)
 {
-  int i = 0;
+  AtkObject *current = obj;
+  GPtrArray *ancestors;
+  gint i;
 
-  /* First, look through the children recursively. */
-  kount = sort_order_canonical (mrp, ls, kount, max, obj, 0, TRUE,
-                                NULL, TRUE, TRUE);
+  if (!reverse)
+    {
+      /* First, look through the children recursively. */
+      if (traverse_p (obj, traverse))
+        sort_order_canonical (mrp, results, max, obj, 0, TRUE,
+                              NULL, TRUE, traverse);
+
+      /* Next, we look through the right subtree */
+      while (!results_full (results, max) && obj && obj != collection)
+        {
+          AtkObject *parent = atk_object_get_parent (obj);
+          if (!parent)
+            break;
+          i = atk_object_get_index_in_parent (obj);
+          sort_order_canonical (mrp, results, max, parent,
+                                i + 1, TRUE, NULL, TRUE, traverse);
+          obj = parent;
+        }
+      return;
+    }
 
-  /* Next, we look through the right subtree */
-  while ((max == 0 || kount < max) && obj && obj != collection)
+  /* Backwards, the right subtree nearest the collection comes first */
+  ancestors = g_ptr_array_new ();
+  for (; obj && obj != collection; obj = atk_object_get_parent (obj))
     {
-      AtkObject *parent = atk_object_get_parent (obj);
-      i = atk_object_get_index_in_parent (obj);
-      kount = sort_order_canonical (mrp, ls, kount, max, parent,
-                                    i + 1, TRUE, FALSE, TRUE, TRUE);
-      obj = parent;
+      if (!atk_object_get_parent (obj))
+        break;
+      g_ptr_array_add (ancestors, obj);
+    }
+  for (i = ancestors->len - 1; i >= 0 && !results_full (results, max); i--)
+    {
+      AtkObject *ancestor = g_ptr_array_index (ancestors, i);
+      sort_order_rev_subtree (mrp, results, max,
+                              atk_object_get_parent (ancestor),
+                              atk_object_get_index_in_parent (ancestor) + 1,
+                              TRUE, TRUE, traverse);
     }
+  g_ptr_array_unref (ancestors);
 
-  return kount;
+  /* Last of all, the children of the object itself */
+  if (current && traverse_p (current, traverse))
+    sort_order_rev_subtree (mrp, results, max, current, 0, TRUE,
+                            TRUE, traverse);
 }
 
 /*
@@ -871,23 +1052,20 @@ GetMatchesInOrder (DBusMessage *message,
                    dbus_int32_t count,
                    const dbus_bool_t traverse)
 {
-  GList *ls = NULL;
+  MatchResults results;
   AtkObject *obj;
 
-  ls = g_list_append (ls, current_object);
+  results_begin (&results, message);
 
   obj = ATK_OBJECT (spi_register_path_to_object (spi_global_register, dbus_message_get_path (message)));
 
-  inorder (obj, mrp, ls, 0, count,
-           current_object, TRUE, NULL, traverse);
-
-  ls = g_list_remove (ls, ls->data);
-
-  if (sortby == ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL)
-    ls = g_list_reverse (ls);
+  /* In-order matching has always descended regardless of traverse */
+  inorder (obj, mrp, &results, count, current_object, TRUE,
+           sortby == ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL);
 
+  results_end (&results);
   free_mrp_data (mrp);
-  return return_and_free_list (message, ls);
+  return results.reply;
 }
 
 /*
@@ -902,23 +1080,20 @@ GetMatchesInBackOrder (DBusMessage *message,
                        const AtspiCollectionSortOrder sortby,
                        dbus_int32_t count)
 {
-  GList *ls = NULL;
+  MatchResults results;
   AtkObject *collection;
 
-  ls = g_list_append (ls, current_object);
+  results_begin (&results, message);
 
   collection = ATK_OBJECT (spi_register_path_to_object (spi_global_register, dbus_message_get_path (message)));
 
-  sort_order_rev_canonical (mrp, ls, 0, count, current_object,
-                            FALSE, collection);
-
-  ls = g_list_remove (ls, ls->data);
-
-  if (sortby == ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL)
-    ls = g_list_reverse (ls);
+  /* Matches are listed nearest first in canonical order */
+  query_exec (mrp, sort_order_opposite (sortby), &results, count,
+              collection, 0, TRUE, current_object, TRUE, TRUE);
 
+  results_end (&results);
   free_mrp_data (mrp);
-  return return_and_free_list (message, ls);
+  return results.reply;
 }
 
 static DBusMessage *
@@ -931,30 +1106,25 @@ GetMatchesTo (DBusMessage *message,
               dbus_int32_t count,
               const dbus_bool_t traverse)
 {
-  GList *ls = NULL;
+  MatchResults results;
   AtkObject *obj;
-  ls = g_list_append (ls, current_object);
+
+  results_begin (&results, message);
 
   if (recurse)
-    {
-      obj = ATK_OBJECT (atk_object_get_parent (current_object));
-      query_exec (mrp, sortby, ls, 0, count,
-                  obj, 0, TRUE, current_object, TRUE, traverse);
-    }
+    obj = ATK_OBJECT (atk_object_get_parent (current_object));
   else
-    {
-      obj = ATK_OBJECT (spi_register_path_to_object (spi_global_register, dbus_message_get_path (message)));
-      query_exec (mrp, sortby, ls, 0, count,
-                  obj, 0, TRUE, current_object, TRUE, traverse);
-    }
-
-  ls = g_list_remove (ls, ls->data);
+    obj = ATK_OBJECT (spi_register_path_to_object (spi_global_register, dbus_message_get_path (message)));
 
-  if (sortby != ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL)
-    ls = g_list_reverse (ls);
+  /* Matches are listed nearest first in canonical order, so the walk
+   * runs from current_object back towards the start.
+   */
+  query_exec (mrp, sort_order_opposite (sortby), &results, count,
+              obj, 0, TRUE, current_object, TRUE, traverse);
 
+  results_end (&results);
   free_mrp_data (mrp);
-  return return_and_free_list (message, ls);
+  return results.reply;
 }
 
 static DBusMessage *
@@ -1080,91 +1250,212 @@ impl_GetMatchesTo (DBusConnection *bus, DBusMessage *message, void *user_data)
     }
 }
 
-static void
-append_accessible_properties (DBusMessageIter *iter, AtkObject *obj, GArray *properties)
+/* A property as GetTree reports it */
+typedef struct _TreeProperty TreeProperty;
+struct _TreeProperty
 {
-  DBusMessageIter iter_struct, iter_dict, iter_dict_entry;
-  AtkStateSet *set;
-  gint i;
-  gint count;
+  const char *name;
+  GType type;
+  DRoutePropertyFunction get;
+};
 
-  dbus_message_iter_open_container (iter, DBUS_TYPE_STRUCT, NULL, &iter_struct);
-  spi_object_append_reference (&iter_struct, obj);
-  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
-  if (properties && properties->len)
+static GHashTable *tree_properties_source;
+static GArray *tree_properties;
+
+/* Returns every readable property, with the names qualified by interface
+ * ("Text.CharacterCount") except for those of Accessible.  The table is
+ * built once rather than for every object of every tree.
+ */
+static GArray *
+get_tree_properties (void)
+{
+  GHashTableIter hi;
+  gpointer key, value;
+  guint i;
+
+  if (tree_properties &&
+      tree_properties_source == spi_global_app_data->property_hash)
+    return tree_properties;
+
+  if (tree_properties)
     {
-      gint i;
-      for (i = 0; i < properties->len; i++)
-        {
-          gchar *prop = g_array_index (properties, char *, i);
-          DRoutePropertyFunction func;
-          GType type;
-          func = _atk_bridge_find_property_func (prop, &type);
-          if (func && G_TYPE_CHECK_INSTANCE_TYPE (obj, type))
-            {
-              dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY,
-                                                NULL, &iter_dict_entry);
-              dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING, &prop);
-              func (&iter_dict_entry, obj);
-              dbus_message_iter_close_container (&iter_dict, &iter_dict_entry);
-            }
-        }
+      for (i = 0; i < tree_properties->len; i++)
+        g_free ((gchar *) g_array_index (tree_properties, TreeProperty, i).name);
+      g_array_free (tree_properties, TRUE);
     }
-  else
+  tree_properties = g_array_new (FALSE, FALSE, sizeof (TreeProperty));
+  tree_properties_source = spi_global_app_data->property_hash;
+  if (!tree_properties_source)
+    return tree_properties;
+
+  g_hash_table_iter_init (&hi, tree_properties_source);
+  while (g_hash_table_iter_next (&hi, &key, &value))
     {
-      GHashTableIter hi;
-      gpointer key, value;
-      g_hash_table_iter_init (&hi, spi_global_app_data->property_hash);
-      while (g_hash_table_iter_next (&hi, &key, &value))
+      const DRouteProperty *prop = value;
+      const char *iface = strrchr (key, '.');
+      GType type = _atk_bridge_type_from_iface (key);
+
+      if (!type || !iface)
+        continue;
+      iface++;
+      for (; prop->name; prop++)
         {
-          const DRouteProperty *prop = value;
-          GType type = _atk_bridge_type_from_iface (key);
-          if (!G_TYPE_CHECK_INSTANCE_TYPE (obj, type))
+          TreeProperty tp;
+
+          if (!prop->get)
             continue;
-          for (; prop->name; prop++)
-            {
-              const char *p = key + strlen (key);
-              gchar *property_name;
-              while (p[-1] != '.')
-                p--;
-              if (!strcmp (p, "Accessible"))
-                property_name = g_strdup (prop->name);
-              else
-                property_name = g_strconcat (p, ".", prop->name, NULL);
-              dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY,
-                                                NULL, &iter_dict_entry);
-              dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING, &property_name);
-              g_free (property_name);
-              prop->get (&iter_dict_entry, obj);
-              dbus_message_iter_close_container (&iter_dict, &iter_dict_entry);
-            }
+          if (!strcmp (iface, "Accessible"))
+            tp.name = g_strdup (prop->name);
+          else
+            tp.name = g_strconcat (iface, ".", prop->name, NULL);
+          tp.type = type;
+          tp.get = prop->get;
+          g_array_append_val (tree_properties, tp);
         }
     }
-  dbus_message_iter_close_container (&iter_struct, &iter_dict);
-  dbus_message_iter_close_container (iter, &iter_struct);
+  return tree_properties;
+}
 
-  set = atk_object_ref_state_set (obj);
-  if (set)
+/* Looks up the properties a client asked for.  The names are borrowed
+ * from the message.  Returns NULL if the list is empty, meaning all of
+ * them.
+ */
+static GArray *
+tree_properties_new (DBusMessageIter *iter)
+{
+  DBusMessageIter iter_array;
+  GArray *properties = NULL;
+
+  dbus_message_iter_recurse (iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
     {
-      gboolean md = atk_state_set_contains_state (set, ATK_STATE_MANAGES_DESCENDANTS);
-      g_object_unref (set);
-      if (md)
-        return;
+      TreeProperty tp;
+
+      if (!properties)
+        properties = g_array_new (FALSE, FALSE, sizeof (TreeProperty));
+      dbus_message_iter_get_basic (&iter_array, &tp.name);
+      tp.get = _atk_bridge_find_property_func (tp.name, &tp.type);
+      if (tp.get)
+        g_array_append_val (properties, tp);
+      dbus_message_iter_next (&iter_array);
     }
+  return properties;
+}
+
+/* The bounds of a tree being sent.  A max_depth or max_nodes of 0 means
+ * there is no limit.
+ */
+typedef struct _TreeWalk TreeWalk;
+struct _TreeWalk
+{
+  GArray *properties;
+  gint max_depth;
+  gint max_nodes;
+  gint n_nodes;
+};
+
+#define tree_walk_full(walk) ((walk)->max_nodes > 0 && (walk)->n_nodes >= (walk)->max_nodes)
+
+/* Returns how many children of obj are to be sent after it.  set, if
+ * given, is the state set of obj.
+ */
+static gint
+tree_walk_children (TreeWalk *walk, AtkObject *obj, gint depth, AtkStateSet *set)
+{
+  gint count;
+  gboolean manages_descendants;
+
+  if (walk->max_depth > 0 && depth >= walk->max_depth)
+    return 0;
+
   count = atk_object_get_n_accessible_children (obj);
+  if (count <= 0)
+    return 0;
   if (count > MAX_CHILDREN)
     count = MAX_CHILDREN;
-  for (i = 0; i < count; i++)
+
+  /* Only objects with children need their states checked */
+  if (set)
+    g_object_ref (set);
+  else
+    set = atk_object_ref_state_set (obj);
+  if (set)
     {
-      AtkObject *child = atk_object_ref_accessible_child (obj, i);
+      manages_descendants = atk_state_set_contains_state (set, ATK_STATE_MANAGES_DESCENDANTS);
+      g_object_unref (set);
+      if (manages_descendants)
+        return 0;
+    }
+  return count;
+}
+
+static void
+append_accessible_properties (DBusMessageIter *iter, AtkObject *obj, TreeWalk *walk, gint depth)
+{
+  DBusMessageIter iter_struct, iter_dict, iter_dict_entry;
+  guint i;
+  gint j;
+  gint count;
+
+  walk->n_nodes++;
+  dbus_message_iter_open_container (iter, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+  spi_object_append_reference (&iter_struct, obj);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
+  for (i = 0; i < walk->properties->len; i++)
+    {
+      const TreeProperty *tp = &g_array_index (walk->properties, TreeProperty, i);
+
+      if (!G_TYPE_CHECK_INSTANCE_TYPE (obj, tp->type))
+        continue;
+      dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY,
+                                        NULL, &iter_dict_entry);
+      dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING, &tp->name);
+      tp->get (&iter_dict_entry, obj);
+      dbus_message_iter_close_container (&iter_dict, &iter_dict_entry);
+    }
+  dbus_message_iter_close_container (&iter_struct, &iter_dict);
+  dbus_message_iter_close_container (iter, &iter_struct);
+
+  count = tree_walk_children (walk, obj, depth, NULL);
+  for (j = 0; j < count && !tree_walk_full (walk); j++)
+    {
+      AtkObject *child = atk_object_ref_accessible_child (obj, j);
       if (child)
         {
-          append_accessible_properties (iter, child, properties);
+          append_accessible_properties (iter, child, walk, depth + 1);
           g_object_unref (child);
         }
     }
 }
 
+static DBusMessage *
+get_tree (DBusMessage *message, AtkObject *object, DBusMessageIter *iter_properties, gint max_depth, gint max_nodes)
+{
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_array;
+  GArray *properties;
+  TreeWalk walk;
+
+  properties = tree_properties_new (iter_properties);
+  walk.properties = (properties ? properties : get_tree_properties ());
+  walk.max_depth = max_depth;
+  walk.max_nodes = max_nodes;
+  walk.n_nodes = 0;
+
+  reply = dbus_message_new_method_return (message);
+  if (reply)
+    {
+      dbus_message_iter_init_append (reply, &iter);
+      dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "((so)a{sv})",
+                                        &iter_array);
+      append_accessible_properties (&iter_array, object, &walk, 0);
+      dbus_message_iter_close_container (&iter, &iter_array);
+    }
+  if (properties)
+    g_array_free (properties, TRUE);
+  return reply;
+}
+
 static DBusMessage *
 impl_GetTree (DBusConnection *bus,
               DBusMessage *message,
@@ -1172,9 +1463,8 @@ impl_GetTree (DBusConnection *bus,
 {
   AtkObject *object = (AtkObject *) user_data;
   DBusMessage *reply;
-  DBusMessageIter iter, iter_array;
+  DBusMessageIter iter;
   MatchRulePrivate rule;
-  GArray *properties;
 
   g_return_val_if_fail (ATK_IS_OBJECT (user_data),
                         droute_not_yet_handled_error (message));
@@ -1182,31 +1472,164 @@ impl_GetTree (DBusConnection *bus,
   if (strcmp (dbus_message_get_signature (message), "(aiia{ss}iaiiasib)as") != 0)
     return droute_invalid_arguments_error (message);
 
-  properties = g_array_new (TRUE, TRUE, sizeof (char *));
   dbus_message_iter_init (message, &iter);
   if (!read_mr (&iter, &rule))
     {
       return spi_dbus_general_error (message);
     }
 
-  dbus_message_iter_recurse (&iter, &iter_array);
-  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+  reply = get_tree (message, object, &iter, 0, 0);
+  free_mrp_data (&rule);
+  return reply;
+}
+
+static DBusMessage *
+impl_GetTreeWithLimits (DBusConnection *bus,
+                        DBusMessage *message,
+                        void *user_data)
+{
+  AtkObject *object = (AtkObject *) user_data;
+  DBusMessageIter iter, iter_properties;
+  dbus_int32_t max_depth, max_nodes;
+
+  g_return_val_if_fail (ATK_IS_OBJECT (user_data),
+                        droute_not_yet_handled_error (message));
+
+  if (strcmp (dbus_message_get_signature (message), "asii") != 0)
+    return droute_invalid_arguments_error (message);
+
+  dbus_message_iter_init (message, &iter);
+  iter_properties = iter;
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, &max_depth);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, &max_nodes);
+
+  return get_tree (message, object, &iter_properties,
+                   MAX (max_depth, 0), MAX (max_nodes, 0));
+}
+
+/*
+ * GetTreeBlob returns the same tree as an array of bytes, with a fixed
+ * set of fields for each object.  All integers are 32 bits, little
+ * endian; strings are a length followed by that many bytes of UTF-8.
+ *
+ *   version (TREE_BLOB_VERSION), number of objects
+ *   then for each object, in canonical order:
+ *     path, role, states (two words), name, description,
+ *     child count, number of children that follow in the blob
+ */
+#define TREE_BLOB_VERSION 1
+
+static void
+blob_append_uint32 (GByteArray *blob, guint32 value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (blob, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+blob_set_uint32 (GByteArray *blob, guint offset, guint32 value)
+{
+  value = GUINT32_TO_LE (value);
+  memcpy (blob->data + offset, &value, sizeof (value));
+}
+
+static void
+blob_append_string (GByteArray *blob, const gchar *str)
+{
+  gsize len = (str ? strlen (str) : 0);
+
+  blob_append_uint32 (blob, len);
+  g_byte_array_append (blob, (const guint8 *) str, len);
+}
+
+static void
+append_accessible_blob (GByteArray *blob, AtkObject *obj, TreeWalk *walk, gint depth)
+{
+  dbus_uint32_t states[2] = { 0, 0 };
+  AtkStateSet *set;
+  const gchar *path;
+  guint offset;
+  guint32 n_sent = 0;
+  gint count;
+  gint i;
+
+  walk->n_nodes++;
+  spi_object_lease_if_needed (G_OBJECT (obj));
+  path = spi_register_object_to_static_path (spi_global_register, G_OBJECT (obj));
+  blob_append_string (blob, path ? path : SPI_DBUS_PATH_NULL);
+  blob_append_uint32 (blob, spi_accessible_role_from_atk_role (atk_object_get_role (obj)));
+
+  set = atk_object_ref_state_set (obj);
+  if (set)
+    spi_atk_state_set_to_dbus_array (set, states);
+  blob_append_uint32 (blob, states[0]);
+  blob_append_uint32 (blob, states[1]);
+  blob_append_string (blob, atk_object_get_name (obj));
+  blob_append_string (blob, atk_object_get_description (obj));
+  count = atk_object_get_n_accessible_children (obj);
+  blob_append_uint32 (blob, MAX (count, 0));
+
+  count = tree_walk_children (walk, obj, depth, set);
+  if (set)
+    g_object_unref (set);
+
+  offset = blob->len;
+  blob_append_uint32 (blob, 0);
+  for (i = 0; i < count && !tree_walk_full (walk); i++)
     {
-      const char *prop;
-      dbus_message_iter_get_basic (&iter_array, &prop);
-      g_array_append_val (properties, prop);
-      dbus_message_iter_next (&iter_array);
+      AtkObject *child = atk_object_ref_accessible_child (obj, i);
+      if (child)
+        {
+          append_accessible_blob (blob, child, walk, depth + 1);
+          g_object_unref (child);
+          n_sent++;
+        }
     }
+  blob_set_uint32 (blob, offset, n_sent);
+}
+
+static DBusMessage *
+impl_GetTreeBlob (DBusConnection *bus,
+                  DBusMessage *message,
+                  void *user_data)
+{
+  AtkObject *object = (AtkObject *) user_data;
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_array;
+  dbus_int32_t max_depth, max_nodes;
+  GByteArray *blob;
+  TreeWalk walk;
+
+  g_return_val_if_fail (ATK_IS_OBJECT (user_data),
+                        droute_not_yet_handled_error (message));
+
+  if (!dbus_message_get_args (message, NULL, DBUS_TYPE_INT32, &max_depth,
+                              DBUS_TYPE_INT32, &max_nodes, DBUS_TYPE_INVALID))
+    return droute_invalid_arguments_error (message);
+
+  walk.properties = NULL;
+  walk.max_depth = MAX (max_depth, 0);
+  walk.max_nodes = MAX (max_nodes, 0);
+  walk.n_nodes = 0;
+
+  blob = g_byte_array_new ();
+  blob_append_uint32 (blob, TREE_BLOB_VERSION);
+  blob_append_uint32 (blob, 0);
+  append_accessible_blob (blob, object, &walk, 0);
+  blob_set_uint32 (blob, 4, walk.n_nodes);
 
   reply = dbus_message_new_method_return (message);
   if (reply)
     {
       dbus_message_iter_init_append (reply, &iter);
-      dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "((so)a{sv})",
-                                        &iter_array);
-      append_accessible_properties (&iter_array, object, properties);
+      dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "y", &iter_array);
+      dbus_message_iter_append_fixed_array (&iter_array, DBUS_TYPE_BYTE,
+                                            &blob->data, blob->len);
       dbus_message_iter_close_container (&iter, &iter_array);
     }
+  g_byte_array_unref (blob);
   return reply;
 }
 
@@ -1216,10 +1639,10 @@ impl_GetMatches (DBusConnection *bus, DBusMessage *message, void *user_data)
   AtkObject *obj = ATK_OBJECT (spi_register_path_to_object (spi_global_register, dbus_message_get_path (message)));
   DBusMessageIter iter;
   MatchRulePrivate rule;
+  MatchResults results;
   dbus_uint32_t sortby;
   dbus_int32_t count;
   dbus_bool_t traverse;
-  GList *ls = NULL;
   const char *signature;
 
   signature = dbus_message_get_signature (message);
@@ -1239,22 +1662,98 @@ impl_GetMatches (DBusConnection *bus, DBusMessage *message, void *user_data)
   dbus_message_iter_next (&iter);
   dbus_message_iter_get_basic (&iter, &traverse);
   dbus_message_iter_next (&iter);
-  ls = g_list_prepend (ls, obj);
-  count = query_exec (&rule, sortby, ls, 0, count,
-                      obj, 0, TRUE, NULL, TRUE, traverse);
-  ls = g_list_remove (ls, ls->data);
 
-  if (sortby == ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL)
-    ls = g_list_reverse (ls);
+  results_begin (&results, message);
+  query_exec (&rule, sortby, &results, count,
+              obj, 0, TRUE, NULL, TRUE, traverse);
+  results_end (&results);
+  free_mrp_data (&rule);
+  return results.reply;
+}
+
+/* Returns matches in canonical order, at most @count at a time.  The
+ * returned token, when not empty, is passed back to get the next page; it
+ * names the object the page ended with, so the traversal resumes there
+ * rather than walking the collection again from the start.
+ */
+static DBusMessage *
+impl_GetMatchesPaged (DBusConnection *bus, DBusMessage *message, void *user_data)
+{
+  AtkObject *collection = ATK_OBJECT (spi_register_path_to_object (spi_global_register, dbus_message_get_path (message)));
+  AtkObject *last = NULL;
+  DBusMessageIter iter;
+  MatchRulePrivate rule;
+  MatchResults results;
+  dbus_int32_t count;
+  dbus_bool_t traverse;
+  const char *token;
+  gchar *next_token;
+
+  if (strcmp (dbus_message_get_signature (message), "(aiia{ss}iaiiasib)ibs") != 0)
+    return droute_invalid_arguments_error (message);
+
+  dbus_message_iter_init (message, &iter);
+  if (!read_mr (&iter, &rule))
+    return spi_dbus_general_error (message);
+  dbus_message_iter_get_basic (&iter, &count);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, &traverse);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, &token);
+
+  if (token[0])
+    {
+      AtkObject *obj;
+
+      last = ATK_OBJECT (spi_register_path_to_object (spi_global_register, token));
+      for (obj = last; obj && obj != collection; obj = atk_object_get_parent (obj))
+        ;
+      if (!last || !obj || last == collection)
+        {
+          free_mrp_data (&rule);
+          return dbus_message_new_error (message, DBUS_ERROR_INVALID_ARGS,
+                                         "The continuation token is no longer valid");
+        }
+    }
+
+  if (count < 0)
+    count = 0;
+
+  /* Only results of the current page are held, never the whole
+   * collection, so the reply can be built as the traversal goes.
+   */
+  results_begin (&results, message);
+  if (last)
+    inorder (collection, &rule, &results, count, last, traverse, FALSE);
+  else
+    sort_order_canonical (&rule, &results, count, collection, 0, TRUE,
+                          NULL, TRUE, traverse);
+  results_end (&results);
+
+  /* A full page ends where the traversal stopped */
+  next_token = NULL;
+  if (count > 0 && results.count == count)
+    next_token = spi_register_object_to_path (spi_global_register,
+                                              G_OBJECT (results.last));
   free_mrp_data (&rule);
-  return return_and_free_list (message, ls);
+
+  if (results.reply)
+    {
+      const char *str = (next_token ? next_token : "");
+      dbus_message_iter_append_basic (&results.iter, DBUS_TYPE_STRING, &str);
+    }
+  g_free (next_token);
+  return results.reply;
 }
 
 static DRouteMethod methods[] = {
   { impl_GetMatchesFrom, "GetMatchesFrom" },
   { impl_GetMatchesTo, "GetMatchesTo" },
   { impl_GetTree, "GetTree" },
+  { impl_GetTreeWithLimits, "GetTreeWithLimits" },
+  { impl_GetTreeBlob, "GetTreeBlob" },
   { impl_GetMatches, "GetMatches" },
+  { impl_GetMatchesPaged, "GetMatchesPaged" },
   { NULL, NULL }
 };
 
@@ -79,10 +79,13 @@ add_event (const char *bus_name, const char *event)
   evdata->bus_name = g_strdup (bus_name);
   evdata->data = data;
   spi_global_app_data->events = g_list_append (spi_global_app_data->events, evdata);
+  spi_atk_event_listeners_changed ();
   return evdata;
 }
 
 static GSList *clients = NULL;
+/* The clients that understand AddAccessibles and RemoveAccessibles */
+static GHashTable *batch_clients = NULL;
 
 static void
 tally_event_reply ()
@@ -802,6 +805,7 @@ remove_events (const char *bus_name, const char *event)
 
           next = list->next;
           spi_global_app_data->events = g_list_delete_link (events, list);
+          spi_atk_event_listeners_changed ();
           list = next;
         }
       else
@@ -1269,6 +1273,7 @@ atk_bridge_adaptor_cleanup (void)
     g_free (ls->data);
   g_slist_free (clients);
   clients = NULL;
+  g_clear_pointer (&batch_clients, g_hash_table_unref);
 
   g_clear_object (&spi_global_cache);
   g_clear_object (&spi_global_leasing);
@@ -1325,6 +1330,8 @@ spi_atk_remove_client (const char *bus_name)
           gchar *match = g_strdup_printf (name_match_tmpl, l->data);
           dbus_bus_remove_match (spi_global_app_data->bus, match, NULL);
           g_free (match);
+          if (batch_clients)
+            g_hash_table_remove (batch_clients, l->data);
           g_free (l->data);
           clients = g_slist_delete_link (clients, l);
           if (!clients)
@@ -1336,6 +1343,32 @@ spi_atk_remove_client (const char *bus_name)
     }
 }
 
+/*
+ * Clients opt into the batched AddAccessibles and RemoveAccessibles signals
+ * by calling GetItemsPaged, which came along with them.
+ */
+void
+spi_atk_add_batch_client (const char *bus_name)
+{
+  spi_atk_add_client (bus_name);
+  if (!batch_clients)
+    batch_clients = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  if (!g_hash_table_contains (batch_clients, bus_name))
+    g_hash_table_add (batch_clients, g_strdup (bus_name));
+}
+
+/*
+ * Whether the batched cache signals can be sent, since every client that
+ * talked to us understands them.
+ */
+gboolean
+spi_atk_clients_take_batches (void)
+{
+  guint n_batch_clients = (batch_clients ? g_hash_table_size (batch_clients) : 0);
+
+  return n_batch_clients == g_slist_length (clients);
+}
+
 void
 spi_atk_add_interface (DRoutePath *path,
                        const char *name,
@@ -80,6 +80,8 @@ extern SpiBridge *spi_global_app_data;
 
 void spi_atk_add_client (const char *bus_name);
 void spi_atk_remove_client (const char *bus_name);
+void spi_atk_add_batch_client (const char *bus_name);
+gboolean spi_atk_clients_take_batches (void);
 
 int spi_atk_create_socket (SpiBridge *app);
 
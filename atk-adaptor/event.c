@@ -31,6 +31,7 @@
 #include <atspi/atspi.h>
 #include <droute/droute.h>
 
+#include "accessible-cache.h"
 #include "accessible-register.h"
 #include "bridge.h"
 
@@ -407,87 +408,279 @@ ensure_proper_format (const char *name)
   return ret;
 }
 
-void
-append_properties (GArray *properties, event_data *evdata)
+static void
+append_properties (GPtrArray *properties, event_data *evdata)
 {
   GSList *ls;
-  gint i;
 
   for (ls = evdata->properties; ls; ls = ls->next)
     {
+      guint i;
       gboolean dup = FALSE;
       for (i = 0; i < properties->len; i++)
         {
-          if (ls->data == g_array_index (properties, AtspiPropertyDefinition *, i))
+          if (ls->data == g_ptr_array_index (properties, i))
             {
               dup = TRUE;
               break;
             }
         }
       if (!dup)
-        g_array_append_val (properties, ls->data);
+        g_ptr_array_add (properties, ls->data);
     }
 }
 
-static gboolean
-signal_is_needed (AtkObject *obj, const gchar *klass, const gchar *major, const gchar *minor, GArray **properties)
+/*---------------------------------------------------------------------------*/
+
+/*
+ * The event listeners registered by clients are compiled into a trie keyed
+ * by the quarks of the class, major and minor names of the events they
+ * listen to, so that deciding whether an ATK signal needs to be sent does
+ * not walk the whole listener list or allocate.  A listener registered for
+ * a prefix, like "Object:StateChanged:", sits at an inner node.
+ *
+ * The trie is rebuilt the next time it is needed after
+ * spi_atk_event_listeners_changed() has been called.
+ */
+
+typedef struct _EventMatchNode EventMatchNode;
+struct _EventMatchNode
+{
+  /* event_data of the listeners registered for exactly this prefix */
+  GPtrArray *listeners;
+  /* GQuark of the next name -> EventMatchNode */
+  GHashTable *children;
+  /* Whether any listener is registered for this prefix or a shorter one */
+  gboolean needed;
+  /* AtspiPropertyDefinitions requested by those listeners, or NULL */
+  GPtrArray *properties;
+};
+
+static EventMatchNode *event_matcher = NULL;
+static gboolean event_matcher_dirty = TRUE;
+
+static void
+event_match_node_free (gpointer data)
+{
+  EventMatchNode *node = data;
+
+  if (node->listeners)
+    g_ptr_array_free (node->listeners, TRUE);
+  if (node->children)
+    g_hash_table_unref (node->children);
+  if (node->properties)
+    g_ptr_array_unref (node->properties);
+  g_free (node);
+}
+
+/*
+ * Computes, for every node, what is needed by the listeners along the path
+ * from the root, so that matching an event only has to find the deepest
+ * node for it.
+ */
+static void
+fill_event_match_node (EventMatchNode *node, gboolean needed, GPtrArray *properties)
+{
+  GHashTableIter iter;
+  gpointer child;
+  guint i;
+
+  node->needed = needed || node->listeners;
+
+  if (node->listeners)
+    {
+      GPtrArray *merged = g_ptr_array_new ();
+
+      if (properties)
+        for (i = 0; i < properties->len; i++)
+          g_ptr_array_add (merged, g_ptr_array_index (properties, i));
+      for (i = 0; i < node->listeners->len; i++)
+        append_properties (merged, g_ptr_array_index (node->listeners, i));
+
+      if (merged->len > 0)
+        node->properties = merged;
+      else
+        g_ptr_array_unref (merged);
+    }
+  else if (properties)
+    node->properties = g_ptr_array_ref (properties);
+
+  if (!node->children)
+    return;
+
+  g_hash_table_iter_init (&iter, node->children);
+  while (g_hash_table_iter_next (&iter, NULL, &child))
+    fill_event_match_node (child, node->needed, node->properties);
+}
+
+static void
+build_event_matcher (void)
 {
-  gchar *data[4];
-  event_data *evdata;
-  gboolean ret = FALSE;
   GList *list;
-  GArray *props = NULL;
+
+  if (event_matcher)
+    event_match_node_free (event_matcher);
+  event_matcher = g_new0 (EventMatchNode, 1);
+
+  for (list = spi_global_app_data->events; list; list = list->next)
+    {
+      event_data *evdata = list->data;
+      EventMatchNode *node = event_matcher;
+      gint i;
+
+      for (i = 0; i < 3 && evdata->data[i] && evdata->data[i][0]; i++)
+        {
+          GQuark quark = g_quark_from_string (evdata->data[i]);
+          EventMatchNode *child = NULL;
+
+          if (!node->children)
+            node->children = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                    NULL, event_match_node_free);
+          else
+            child = g_hash_table_lookup (node->children, GUINT_TO_POINTER (quark));
+
+          if (!child)
+            {
+              child = g_new0 (EventMatchNode, 1);
+              g_hash_table_insert (node->children, GUINT_TO_POINTER (quark), child);
+            }
+          node = child;
+        }
+
+      if (!node->listeners)
+        node->listeners = g_ptr_array_new ();
+      g_ptr_array_add (node->listeners, evdata);
+    }
+
+  fill_event_match_node (event_matcher, FALSE, NULL);
+  event_matcher_dirty = FALSE;
+}
+
+void
+spi_atk_event_listeners_changed (void)
+{
+  event_matcher_dirty = TRUE;
+}
+
+/*
+ * Returns the quark of the D-Bus form of an ATK event name, as in
+ * ensure_proper_format().  The conversion is only done the first time a
+ * name is seen.
+ */
+static GQuark
+event_name_quark (const char *name)
+{
+  static GHashTable *quarks = NULL;
+  gpointer quark;
+  gchar *formatted;
+
+  if (!quarks)
+    quarks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  if (g_hash_table_lookup_extended (quarks, name, NULL, &quark))
+    return GPOINTER_TO_UINT (quark);
+
+  formatted = ensure_proper_format (name);
+  quark = GUINT_TO_POINTER (g_quark_from_string (formatted));
+  g_free (formatted);
+  g_hash_table_insert (quarks, g_strdup (name), quark);
+  return GPOINTER_TO_UINT (quark);
+}
+
+/*
+ * Hack: events such as "object::text-changed::insert:system" as
+ * generated by Gecko are matched on the part before the colon.
+ */
+static GQuark
+event_minor_quark (const char *minor)
+{
+  const char *colon = strchr (minor, ':');
+  gchar buf[64];
+  gchar *prefix;
+  gsize len;
+  GQuark quark;
+
+  if (!colon)
+    return event_name_quark (minor);
+
+  /* Minor names are short, so the part is copied on the stack */
+  len = colon - minor;
+  prefix = (len < sizeof (buf)) ? buf : g_malloc (len + 1);
+  memcpy (prefix, minor, len);
+  prefix[len] = '\0';
+  quark = event_name_quark (prefix);
+  if (prefix != buf)
+    g_free (prefix);
+  return quark;
+}
+
+static gboolean
+signal_is_needed (AtkObject *obj, const gchar *klass, const gchar *major, const gchar *minor, GPtrArray **properties)
+{
+  static GQuark children_changed, property_change, state_changed;
+  static GQuark accessible_name, accessible_description;
+  static GQuark accessible_parent, accessible_role;
+  GQuark names[3];
+  EventMatchNode *node, *child;
+  gboolean ret;
+  gint i;
 
   if (!spi_global_app_data->events_initialized)
     return TRUE;
 
-  data[0] = ensure_proper_format (klass[0] ? klass + 21 : klass);
-  data[1] = ensure_proper_format (major);
-  data[2] = ensure_proper_format (minor);
-  data[3] = NULL;
+  if (!children_changed)
+    {
+      children_changed = g_quark_from_static_string ("ChildrenChanged");
+      property_change = g_quark_from_static_string ("PropertyChange");
+      state_changed = g_quark_from_static_string ("StateChanged");
+      accessible_name = g_quark_from_static_string ("AccessibleName");
+      accessible_description = g_quark_from_static_string ("AccessibleDescription");
+      accessible_parent = g_quark_from_static_string ("AccessibleParent");
+      accessible_role = g_quark_from_static_string ("AccessibleRole");
+    }
+
+  if (event_matcher_dirty)
+    build_event_matcher ();
+
+  names[0] = event_name_quark (klass[0] ? klass + 21 : klass);
+  names[1] = event_name_quark (major);
+  names[2] = event_minor_quark (minor);
+
+  node = event_matcher;
+  for (i = 0; i < 3 && node->children; i++)
+    {
+      child = g_hash_table_lookup (node->children, GUINT_TO_POINTER (names[i]));
+      if (!child)
+        break;
+      node = child;
+    }
+  ret = node->needed;
 
   /* Hack: Always pass events that update the cache.
    * TODO: FOr 2.2, have at-spi2-core define a special "cache listener" for
    * this instead, so that we don't send these if no one is listening */
-  if (!g_strcmp0 (data[1], "ChildrenChanged") ||
-      ((!g_strcmp0 (data[1], "PropertyChange")) &&
-       (!g_strcmp0 (data[2], "AccessibleName") ||
-        !g_strcmp0 (data[2], "AccessibleDescription") ||
-        !g_strcmp0 (data[2], "AccessibleParent") ||
-        !g_strcmp0 (data[2], "AccessibleRole"))) ||
-      !g_strcmp0 (data[1], "StateChanged"))
+  if (!ret &&
+      (names[1] == children_changed ||
+       (names[1] == property_change &&
+        (names[2] == accessible_name ||
+         names[2] == accessible_description ||
+         names[2] == accessible_parent ||
+         names[2] == accessible_role)) ||
+       names[1] == state_changed))
     {
       if (minor && !g_strcmp0 (minor, "defunct"))
         ret = TRUE;
       else
         {
           AtkStateSet *set = atk_object_ref_state_set (obj);
-          AtkState state = ((!g_strcmp0 (data[1], "ChildrenChanged")) ? ATK_STATE_MANAGES_DESCENDANTS : ATK_STATE_TRANSIENT);
+          AtkState state = ((names[1] == children_changed) ? ATK_STATE_MANAGES_DESCENDANTS : ATK_STATE_TRANSIENT);
           ret = !atk_state_set_contains_state (set, state);
           g_object_unref (set);
         }
     }
 
-  /* Hack: events such as "object::text-changed::insert:system" as
-     generated by Gecko */
-  data[2][strcspn (data[2], ":")] = '\0';
-
-  for (list = spi_global_app_data->events; list; list = list->next)
-    {
-      evdata = list->data;
-      if (spi_event_is_subtype (data, evdata->data))
-        {
-          ret = TRUE;
-          if (!props)
-            props = g_array_new (TRUE, TRUE, sizeof (AtspiPropertyDefinition *));
-          append_properties (props, evdata);
-        }
-    }
-
-  g_free (data[2]);
-  g_free (data[1]);
-  g_free (data[0]);
-  *properties = props;
+  /* The trie may be rebuilt while the properties are being marshalled */
+  *properties = ((ret && node->properties) ? g_ptr_array_ref (node->properties) : NULL);
   return ret;
 }
 
@@ -513,8 +706,88 @@ adapt_minor_for_dbus (const char *source)
  * Marshals a basic type into the 'any_data' attribute of
  * the AT-SPI event.
  */
+/*
+ * D-Bus member names of the signals emitted by the listeners registered in
+ * spi_atk_register_event_listeners(), so that they need not be converted
+ * with signal_name_to_dbus() for every event.
+ */
+static const struct
+{
+  const char *major;
+  const char *member;
+} signal_member_names[] = {
+  { "focus", "Focus" },
+  { "PropertyChange", "PropertyChange" },
+  { "state-changed", "StateChanged" },
+  { "children-changed", "ChildrenChanged" },
+  { "bounds-changed", "BoundsChanged" },
+  { "visible-data-changed", "VisibleDataChanged" },
+  { "active-descendant-changed", "ActiveDescendantChanged" },
+  { "announcement", "Announcement" },
+  { "attributes-changed", "AttributesChanged" },
+  { "link-selected", "LinkSelected" },
+  { "text-changed", "TextChanged" },
+  { "text-selection-changed", "TextSelectionChanged" },
+  { "text-attributes-changed", "TextAttributesChanged" },
+  { "text-caret-moved", "TextCaretMoved" },
+  { "selection-changed", "SelectionChanged" },
+  { "row-inserted", "RowInserted" },
+  { "row-reordered", "RowReordered" },
+  { "row-deleted", "RowDeleted" },
+  { "column-inserted", "ColumnInserted" },
+  { "column-reordered", "ColumnReordered" },
+  { "column-deleted", "ColumnDeleted" },
+  { "model-changed", "ModelChanged" },
+  { "create", "Create" },
+  { "destroy", "Destroy" },
+  { "minimize", "Minimize" },
+  { "maximize", "Maximize" },
+  { "restore", "Restore" },
+  { "activate", "Activate" },
+  { "deactivate", "Deactivate" },
+  { "load-complete", "LoadComplete" },
+  { "reload", "Reload" },
+  { "load-stopped", "LoadStopped" },
+  { "page-changed", "PageChanged" },
+};
+
+/*
+ * Returns the D-Bus member name for an ATK signal name.  Names missing from
+ * signal_member_names are converted the first time they are seen.
+ */
+static const char *
+signal_member_name (const char *major)
+{
+  static GHashTable *members = NULL;
+  const char *member;
+
+  if (!members)
+    {
+      gint i;
+
+      members = g_hash_table_new (g_str_hash, g_str_equal);
+      for (i = 0; i < G_N_ELEMENTS (signal_member_names); i++)
+        g_hash_table_insert (members, (gpointer) signal_member_names[i].major,
+                             (gpointer) signal_member_names[i].member);
+    }
+
+  member = g_hash_table_lookup (members, major);
+  if (!member)
+    {
+      /*
+       * This is very annoying, but as '-' isn't a legal signal
+       * name in D-Bus (Why not??!?) The names need converting
+       * on this side, and again on the client side.
+       */
+      member = signal_name_to_dbus (major);
+      g_hash_table_insert (members, g_strdup (major), (gpointer) member);
+    }
+
+  return member;
+}
+
 static void
-emit_event (AtkObject *obj,
+send_event (AtkObject *obj,
             const char *klass,
             const char *major,
             const char *minor,
@@ -525,13 +798,16 @@ emit_event (AtkObject *obj,
             void (*append_variant) (DBusMessageIter *, const char *, const void *))
 {
   DBusConnection *bus = spi_global_app_data->bus;
-  char *path;
-  char *minor_dbus;
+  const char *path;
+  const char *member;
+  const char *minor_dbus;
+  gchar minor_buf[64];
+  gchar *minor_copy = NULL;
+  const char *colon;
 
-  gchar *cname;
   DBusMessage *sig;
   DBusMessageIter iter, iter_dict, iter_dict_entry;
-  GArray *properties = NULL;
+  GPtrArray *properties = NULL;
 
   if (!klass)
     klass = "";
@@ -545,22 +821,39 @@ emit_event (AtkObject *obj,
   if (!signal_is_needed (obj, klass, major, minor, &properties))
     return;
 
-  path = spi_register_object_to_path (spi_global_register, G_OBJECT (obj));
-  g_return_if_fail (path != NULL);
+  path = spi_register_object_to_static_path (spi_global_register, G_OBJECT (obj));
+  if (!path)
+    {
+      if (properties)
+        g_ptr_array_unref (properties);
+      g_return_if_fail (path != NULL);
+    }
 
-  /*
-   * This is very annoying, but as '-' isn't a legal signal
-   * name in D-Bus (Why not??!?) The names need converting
-   * on this side, and again on the client side.
-   */
-  cname = signal_name_to_dbus (major);
-  sig = dbus_message_new_signal (path, klass, cname);
+  member = signal_member_name (major);
+  sig = dbus_message_new_signal (path, klass, member);
+  if (!sig)
+    {
+      if (properties)
+        g_ptr_array_unref (properties);
+      return;
+    }
 
   dbus_message_iter_init_append (sig, &iter);
 
-  minor_dbus = adapt_minor_for_dbus (minor);
+  /* See adapt_minor_for_dbus(); most minor names have no colon */
+  colon = strchr (minor, ':');
+  if (!colon)
+    minor_dbus = minor;
+  else if (strlen (minor) < sizeof (minor_buf))
+    {
+      strcpy (minor_buf, minor);
+      minor_buf[colon - minor] = '/';
+      minor_dbus = minor_buf;
+    }
+  else
+    minor_dbus = minor_copy = adapt_minor_for_dbus (minor);
   dbus_message_iter_append_basic (&iter, DBUS_TYPE_STRING, &minor_dbus);
-  g_free (minor_dbus);
+  g_free (minor_copy);
   dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &detail1);
   dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &detail2);
   append_variant (&iter, type, val);
@@ -568,33 +861,355 @@ emit_event (AtkObject *obj,
   dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "{sv}", &iter_dict);
   /* Add requested properties, unless the object is being marked defunct, in
      which case it's safest not to touch it */
-  if (minor == NULL || strcmp (minor, "defunct") != 0 || detail1 == 0)
+  if (properties && (strcmp (minor, "defunct") != 0 || detail1 == 0))
     {
-      if (properties)
+      guint i;
+      for (i = 0; i < properties->len; i++)
         {
-          gint i;
-          for (i = 0; i < properties->len; i++)
-            {
-              AtspiPropertyDefinition *prop = g_array_index (properties, AtspiPropertyDefinition *, i);
-              dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY, NULL,
-                                                &iter_dict_entry);
-              dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING, &prop->name);
-              prop->func (&iter_dict_entry, obj);
-              dbus_message_iter_close_container (&iter_dict, &iter_dict_entry);
-            }
-          g_array_free (properties, TRUE);
+          AtspiPropertyDefinition *prop = g_ptr_array_index (properties, i);
+          dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY, NULL,
+                                            &iter_dict_entry);
+          dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING, &prop->name);
+          prop->func (&iter_dict_entry, obj);
+          dbus_message_iter_close_container (&iter_dict, &iter_dict_entry);
         }
     }
+  if (properties)
+    g_ptr_array_unref (properties);
   dbus_message_iter_close_container (&iter, &iter_dict);
 
   dbus_connection_send (bus, sig, NULL);
   dbus_message_unref (sig);
 
-  if (g_strcmp0 (cname, "ChildrenChanged") != 0)
+  if (strcmp (member, "ChildrenChanged") != 0)
     spi_object_lease_if_needed (G_OBJECT (obj));
+}
+
+/*---------------------------------------------------------------------------*/
+
+/*
+ * Optional coalescing of high rate events.
+ *
+ * Events of the classes enabled in coalesce_classes are not sent right away
+ * but queued, and the queue is flushed at most once per frame.  While they
+ * are queued, repeated events are merged:
+ *
+ * - bounds and property changes of an object are collapsed into the latest
+ *   value;
+ * - repeated visible-data-changed events of an object are dropped;
+ * - a text insertion that directly follows the previous queued insertion
+ *   into the same object is appended to it.
+ *
+ * Any other event flushes the queue before it is sent, so that clients
+ * still see events in the order they happened.
+ *
+ * The classes can be chosen with the ATSPI_COALESCE_EVENTS environment
+ * variable, a comma separated list of the option names below, or "none".
+ */
+
+#define COALESCE_INTERVAL_MS 16
+
+typedef enum
+{
+  COALESCE_LATEST,
+  COALESCE_FIRST,
+  COALESCE_TEXT_INSERT
+} CoalesceMode;
 
-  g_free (cname);
-  g_free (path);
+typedef struct _CoalesceClass
+{
+  const char *option;
+  const char *major;
+  CoalesceMode mode;
+  gboolean enabled;
+} CoalesceClass;
+
+static CoalesceClass coalesce_classes[] = {
+  { "bounds-changed", "bounds-changed", COALESCE_LATEST, TRUE },
+  { "visible-data-changed", "visible-data-changed", COALESCE_FIRST, TRUE },
+  { "property-change", "PropertyChange", COALESCE_LATEST, FALSE },
+  { "text-changed", "text-changed", COALESCE_TEXT_INSERT, FALSE },
+};
+
+typedef struct _PendingEvent
+{
+  AtkObject *obj;
+  const char *klass;
+  const char *major;
+  gchar *minor;
+  dbus_int32_t detail1;
+  dbus_int32_t detail2;
+  const char *type;
+  /* Copy of the value, owned by the event; a rectangle is kept in rect */
+  gpointer val;
+  AtkRectangle rect;
+  void (*append_variant) (DBusMessageIter *, const char *, const void *);
+} PendingEvent;
+
+static GQueue pending_events = G_QUEUE_INIT;
+/* The pending events that can be merged with a later one, by object,
+ * major and minor name */
+static GHashTable *pending_event_index = NULL;
+static guint pending_events_timeout = 0;
+
+static guint
+pending_event_hash (gconstpointer key)
+{
+  const PendingEvent *event = key;
+
+  return g_direct_hash (event->obj) ^ g_str_hash (event->major) ^ g_str_hash (event->minor);
+}
+
+static gboolean
+pending_event_equal (gconstpointer a, gconstpointer b)
+{
+  const PendingEvent *event_a = a;
+  const PendingEvent *event_b = b;
+
+  return (event_a->obj == event_b->obj &&
+          !strcmp (event_a->major, event_b->major) &&
+          !strcmp (event_a->minor, event_b->minor));
+}
+
+static void
+pending_event_set_value (PendingEvent *event, const void *val)
+{
+  if (!strcmp (event->type, "(iiii)"))
+    {
+      event->rect = *(const AtkRectangle *) val;
+      event->val = &event->rect;
+    }
+  else if (!strcmp (event->type, DBUS_TYPE_STRING_AS_STRING))
+    event->val = g_strdup (val);
+  else if (!strcmp (event->type, "(so)"))
+    event->val = (val ? g_object_ref ((gpointer) val) : NULL);
+  else
+    event->val = (gpointer) val;
+}
+
+static void
+pending_event_clear_value (PendingEvent *event)
+{
+  if (!strcmp (event->type, DBUS_TYPE_STRING_AS_STRING))
+    g_free (event->val);
+  else if (!strcmp (event->type, "(so)") && event->val)
+    g_object_unref (event->val);
+  event->val = NULL;
+}
+
+static void
+pending_event_free (PendingEvent *event)
+{
+  pending_event_clear_value (event);
+  g_object_unref (event->obj);
+  g_free (event->minor);
+  g_slice_free (PendingEvent, event);
+}
+
+static void
+flush_pending_events (void)
+{
+  GQueue events = G_QUEUE_INIT;
+  PendingEvent *event;
+
+  /* The queue may be flushed before its timeout, which must then not
+   * fire for events queued later */
+  if (pending_events_timeout)
+    {
+      g_source_remove (pending_events_timeout);
+      pending_events_timeout = 0;
+    }
+
+  /* Sending may cause more events, which are queued for the next flush */
+  events = pending_events;
+  g_queue_init (&pending_events);
+  if (pending_event_index)
+    g_hash_table_remove_all (pending_event_index);
+
+  while ((event = g_queue_pop_head (&events)))
+    {
+      send_event (event->obj, event->klass, event->major, event->minor,
+                  event->detail1, event->detail2, event->type, event->val,
+                  event->append_variant);
+      pending_event_free (event);
+    }
+}
+
+static gboolean
+pending_events_timeout_cb (gpointer data)
+{
+  pending_events_timeout = 0;
+  flush_pending_events ();
+  return FALSE;
+}
+
+static void
+discard_pending_events (void)
+{
+  if (pending_events_timeout)
+    {
+      g_source_remove (pending_events_timeout);
+      pending_events_timeout = 0;
+    }
+  if (pending_event_index)
+    g_hash_table_remove_all (pending_event_index);
+  g_queue_clear_full (&pending_events, (GDestroyNotify) pending_event_free);
+}
+
+static CoalesceClass *
+lookup_coalesce_class (const char *klass, const char *major)
+{
+  gint i;
+
+  if (strcmp (klass, ITF_EVENT_OBJECT) != 0)
+    return NULL;
+
+  for (i = 0; i < G_N_ELEMENTS (coalesce_classes); i++)
+    {
+      if (coalesce_classes[i].enabled && !strcmp (coalesce_classes[i].major, major))
+        return &coalesce_classes[i];
+    }
+  return NULL;
+}
+
+/*
+ * Merges the event into a queued one if possible.  Returns TRUE if the
+ * event has been merged, or dropped as redundant.
+ */
+static gboolean
+merge_pending_event (CoalesceClass *coalesce, PendingEvent *event, const void *val)
+{
+  PendingEvent *pending;
+
+  switch (coalesce->mode)
+    {
+    case COALESCE_LATEST:
+      pending = g_hash_table_lookup (pending_event_index, event);
+      if (!pending || strcmp (pending->type, event->type) != 0)
+        return FALSE;
+      pending_event_clear_value (pending);
+      pending_event_set_value (pending, val);
+      pending->detail1 = event->detail1;
+      pending->detail2 = event->detail2;
+      return TRUE;
+
+    case COALESCE_FIRST:
+      return g_hash_table_contains (pending_event_index, event);
+
+    case COALESCE_TEXT_INSERT:
+      pending = g_queue_peek_tail (&pending_events);
+      if (!pending || pending->obj != event->obj ||
+          strcmp (pending->major, event->major) != 0 ||
+          strcmp (pending->minor, event->minor) != 0 ||
+          pending->detail1 + pending->detail2 != event->detail1)
+        return FALSE;
+      {
+        gchar *text = g_strconcat (pending->val, val, NULL);
+
+        g_free (pending->val);
+        pending->val = text;
+        pending->detail2 += event->detail2;
+      }
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+emit_event (AtkObject *obj,
+            const char *klass,
+            const char *major,
+            const char *minor,
+            dbus_int32_t detail1,
+            dbus_int32_t detail2,
+            const char *type,
+            const void *val,
+            void (*append_variant) (DBusMessageIter *, const char *, const void *))
+{
+  CoalesceClass *coalesce;
+  PendingEvent key, *event;
+  GPtrArray *properties;
+
+  if (!klass)
+    klass = "";
+  if (!major)
+    major = "";
+  if (!minor)
+    minor = "";
+  if (!type)
+    type = "u";
+
+  coalesce = lookup_coalesce_class (klass, major);
+  if (coalesce && coalesce->mode == COALESCE_TEXT_INSERT &&
+      (strncmp (minor, "insert", 6) != 0 || strcmp (type, DBUS_TYPE_STRING_AS_STRING) != 0))
+    coalesce = NULL;
+
+  if (!coalesce)
+    {
+      if (!g_queue_is_empty (&pending_events))
+        flush_pending_events ();
+      send_event (obj, klass, major, minor, detail1, detail2, type, val,
+                  append_variant);
+      return;
+    }
+
+  /* Do not queue what no one listens for; listeners are checked again when
+   * the queue is flushed */
+  if (!signal_is_needed (obj, klass, major, minor, &properties))
+    return;
+  if (properties)
+    g_ptr_array_unref (properties);
+
+  key.obj = obj;
+  key.major = major;
+  key.minor = (gchar *) minor;
+  key.detail1 = detail1;
+  key.detail2 = detail2;
+  key.type = type;
+
+  if (!pending_event_index)
+    pending_event_index = g_hash_table_new (pending_event_hash, pending_event_equal);
+
+  if (merge_pending_event (coalesce, &key, val))
+    return;
+
+  event = g_slice_new0 (PendingEvent);
+  event->obj = g_object_ref (obj);
+  event->klass = klass;
+  event->major = major;
+  event->minor = g_strdup (minor);
+  event->detail1 = detail1;
+  event->detail2 = detail2;
+  event->type = type;
+  event->append_variant = append_variant;
+  pending_event_set_value (event, val);
+  g_queue_push_tail (&pending_events, event);
+  if (coalesce->mode != COALESCE_TEXT_INSERT)
+    g_hash_table_replace (pending_event_index, event, event);
+
+  if (pending_events_timeout == 0)
+    pending_events_timeout = spi_timeout_add_full (G_PRIORITY_DEFAULT,
+                                                   COALESCE_INTERVAL_MS,
+                                                   pending_events_timeout_cb,
+                                                   NULL, NULL);
+}
+
+static void
+init_coalesce_classes (void)
+{
+  const gchar *envvar = g_getenv ("ATSPI_COALESCE_EVENTS");
+  gchar **options;
+  gint i;
+
+  if (!envvar)
+    return;
+
+  options = g_strsplit (envvar, ",", -1);
+  for (i = 0; i < G_N_ELEMENTS (coalesce_classes); i++)
+    coalesce_classes[i].enabled = g_strv_contains ((const gchar *const *) options,
+                                                   coalesce_classes[i].option);
+  g_strfreev (options);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -642,6 +1257,13 @@ property_event_listener (GSignalInvocationHint *signal_hint,
 
   pname = values[0].property_name;
 
+  /* These are part of the data sent to clients by the Cache interface */
+  if (strcmp (pname, "accessible-name") == 0 ||
+      strcmp (pname, "accessible-description") == 0 ||
+      strcmp (pname, "accessible-parent") == 0 ||
+      strcmp (pname, "accessible-role") == 0)
+    spi_cache_invalidate (spi_global_cache, G_OBJECT (accessible));
+
   /* TODO Could improve this control statement by matching
    * on only the end of the signal names,
    */
@@ -753,6 +1375,7 @@ state_event_listener (GSignalInvocationHint *signal_hint,
   pname = g_value_get_string (&param_values[1]);
 
   detail1 = (g_value_get_boolean (&param_values[2])) ? 1 : 0;
+  spi_cache_invalidate (spi_global_cache, G_OBJECT (accessible));
   emit_event (accessible, ITF_EVENT_OBJECT, STATE_CHANGED, pname, detail1, 0,
               DBUS_TYPE_INT32_AS_STRING, 0, append_basic);
 
@@ -1028,27 +1651,15 @@ text_insert_event_listener (GSignalInvocationHint *signal_hint,
                             gpointer data)
 {
   AtkObject *accessible;
-  guint text_changed_signal_id;
-  GSignalQuery signal_query;
-  const gchar *name;
   const gchar *minor_raw, *text;
-  gchar *minor;
+  gchar *minor = NULL;
   gint detail1 = 0, detail2 = 0;
 
   accessible = ATK_OBJECT (g_value_get_object (&param_values[0]));
-  /* Get signal name for 'Gtk:AtkText:text-changed' so
-   * we convert it to the AT-SPI signal - 'object:text-changed'
-   */
-  text_changed_signal_id = g_signal_lookup ("text-changed", G_OBJECT_TYPE (accessible));
-  g_signal_query (text_changed_signal_id, &signal_query);
-  name = signal_query.signal_name;
-
   /* Add the insert and keep any detail coming from atk */
   minor_raw = g_quark_to_string (signal_hint->detail);
   if (minor_raw)
     minor = g_strconcat ("insert:", minor_raw, NULL);
-  else
-    minor = g_strdup ("insert");
 
   if (G_VALUE_TYPE (&param_values[1]) == G_TYPE_INT)
     detail1 = g_value_get_int (&param_values[1]);
@@ -1061,7 +1672,8 @@ text_insert_event_listener (GSignalInvocationHint *signal_hint,
   else
     text = "";
 
-  emit_event (accessible, ITF_EVENT_OBJECT, name, minor, detail1, detail2,
+  emit_event (accessible, ITF_EVENT_OBJECT, "text-changed",
+              minor ? minor : "insert", detail1, detail2,
               DBUS_TYPE_STRING_AS_STRING, text, append_basic);
   g_free (minor);
   return TRUE;
@@ -1079,28 +1691,16 @@ text_remove_event_listener (GSignalInvocationHint *signal_hint,
                             gpointer data)
 {
   AtkObject *accessible;
-  guint text_changed_signal_id;
-  GSignalQuery signal_query;
-  const gchar *name;
   const gchar *minor_raw, *text;
-  gchar *minor;
+  gchar *minor = NULL;
   gint detail1 = 0, detail2 = 0;
 
   accessible = ATK_OBJECT (g_value_get_object (&param_values[0]));
-  /* Get signal name for 'Gtk:AtkText:text-changed' so
-   * we convert it to the AT-SPI signal - 'object:text-changed'
-   */
-  text_changed_signal_id = g_signal_lookup ("text-changed", G_OBJECT_TYPE (accessible));
-  g_signal_query (text_changed_signal_id, &signal_query);
-  name = signal_query.signal_name;
-
   minor_raw = g_quark_to_string (signal_hint->detail);
 
   /* Add the delete and keep any detail coming from atk */
   if (minor_raw)
     minor = g_strconcat ("delete:", minor_raw, NULL);
-  else
-    minor = g_strdup ("delete");
 
   if (G_VALUE_TYPE (&param_values[1]) == G_TYPE_INT)
     detail1 = g_value_get_int (&param_values[1]);
@@ -1113,7 +1713,8 @@ text_remove_event_listener (GSignalInvocationHint *signal_hint,
   else
     text = "";
 
-  emit_event (accessible, ITF_EVENT_OBJECT, name, minor, detail1, detail2,
+  emit_event (accessible, ITF_EVENT_OBJECT, "text-changed",
+              minor ? minor : "delete", detail1, detail2,
               DBUS_TYPE_STRING_AS_STRING, text, append_basic);
   g_free (minor);
   return TRUE;
@@ -1180,6 +1781,7 @@ children_changed_event_listener (GSignalInvocationHint *signal_hint,
   /* If the accessible is on STATE_MANAGES_DESCENDANTS state,
      children-changed signal are not forwarded. */
   accessible = ATK_OBJECT (g_value_get_object (&param_values[0]));
+  spi_cache_invalidate_children (spi_global_cache, G_OBJECT (accessible));
   set = atk_object_ref_state_set (accessible);
   ret = atk_state_set_contains_state (set, ATK_STATE_MANAGES_DESCENDANTS);
   g_object_unref (set);
@@ -1360,6 +1962,8 @@ spi_atk_register_event_listeners (void)
   /* Register for focus event notifications, and register app with central registry  */
   listener_ids = g_array_sized_new (FALSE, TRUE, sizeof (guint), 16);
 
+  init_coalesce_classes ();
+
   atk_bridge_focus_tracker_id = atk_add_focus_tracker (focus_tracker);
 
   add_signal_listener (property_event_listener,
@@ -1498,6 +2102,12 @@ spi_atk_deregister_event_listeners (void)
       atk_remove_key_event_listener (atk_bridge_key_event_listener_id);
       atk_bridge_key_event_listener_id = 0;
     }
+
+  discard_pending_events ();
+
+  /* The trie points into the listener list, which goes away on cleanup */
+  g_clear_pointer (&event_matcher, event_match_node_free);
+  event_matcher_dirty = TRUE;
 }
 
 /*---------------------------------------------------------------------------*/
@@ -30,6 +30,7 @@ void spi_atk_deregister_event_listeners (void);
 void spi_atk_tidy_windows (void);
 
 gboolean spi_event_is_subtype (gchar **needle, gchar **haystack);
+void spi_atk_event_listeners_changed (void);
 
 extern GMainContext *spi_context;
 guint spi_idle_add (GSourceFunc function, gpointer data);
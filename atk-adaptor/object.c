@@ -94,7 +94,7 @@ spi_object_append_reference (DBusMessageIter *iter, AtkObject *obj)
 {
   DBusMessageIter iter_struct;
   const gchar *name;
-  gchar *path;
+  const gchar *path;
 
   if (!obj)
     {
@@ -105,18 +105,17 @@ spi_object_append_reference (DBusMessageIter *iter, AtkObject *obj)
   spi_object_lease_if_needed (G_OBJECT (obj));
 
   name = dbus_bus_get_unique_name (spi_global_app_data->bus);
-  path = spi_register_object_to_path (spi_global_register, G_OBJECT (obj));
+  path = spi_register_object_to_static_path (spi_global_register,
+                                             G_OBJECT (obj));
 
   if (!path)
-    path = g_strdup (SPI_DBUS_PATH_NULL);
+    path = SPI_DBUS_PATH_NULL;
 
   dbus_message_iter_open_container (iter, DBUS_TYPE_STRUCT, NULL,
                                     &iter_struct);
   dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
   dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &path);
   dbus_message_iter_close_container (iter, &iter_struct);
-
-  g_free (path);
 }
 
 /* TODO: Perhaps combine with spi_object_append_reference.  Leaving separate
@@ -126,7 +125,7 @@ spi_hyperlink_append_reference (DBusMessageIter *iter, AtkHyperlink *obj)
 {
   DBusMessageIter iter_struct;
   const gchar *name;
-  gchar *path;
+  const gchar *path;
 
   if (!obj)
     {
@@ -137,18 +136,17 @@ spi_hyperlink_append_reference (DBusMessageIter *iter, AtkHyperlink *obj)
   spi_object_lease_if_needed (G_OBJECT (obj));
 
   name = dbus_bus_get_unique_name (spi_global_app_data->bus);
-  path = spi_register_object_to_path (spi_global_register, G_OBJECT (obj));
+  path = spi_register_object_to_static_path (spi_global_register,
+                                             G_OBJECT (obj));
 
   if (!path)
-    path = g_strdup (SPI_DBUS_PATH_NULL);
+    path = SPI_DBUS_PATH_NULL;
 
   dbus_message_iter_open_container (iter, DBUS_TYPE_STRUCT, NULL,
                                     &iter_struct);
   dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
   dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &path);
   dbus_message_iter_close_container (iter, &iter_struct);
-
-  g_free (path);
 }
 
 void
@@ -212,105 +210,87 @@ spi_hyperlink_return_reference (DBusMessage *msg, AtkHyperlink *obj)
 
 /*---------------------------------------------------------------------------*/
 
-void
-spi_object_append_interfaces (DBusMessageIter *iter, AtkObject *obj)
+/*
+ * Stores the names of the D-Bus interfaces implemented by @obj in
+ * @interfaces, which must have room for at least @max names, and returns
+ * how many were stored.  The names are static strings.
+ */
+guint
+spi_object_get_interfaces (AtkObject *obj, const gchar **interfaces, guint max)
 {
-  const gchar *itf;
+  guint n = 0;
 
-  itf = ATSPI_DBUS_INTERFACE_ACCESSIBLE;
-  dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
+#define ADD_INTERFACE(itf)     \
+  G_STMT_START                 \
+  {                            \
+    if (n < max)               \
+      interfaces[n++] = (itf); \
+  }                            \
+  G_STMT_END
+
+  ADD_INTERFACE (ATSPI_DBUS_INTERFACE_ACCESSIBLE);
 
   if (ATK_IS_ACTION (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_ACTION;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_ACTION);
 
   if (atk_object_get_role (obj) == ATK_ROLE_APPLICATION)
-    {
-      itf = ATSPI_DBUS_INTERFACE_APPLICATION;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_APPLICATION);
 
   if (ATK_IS_COMPONENT (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_COMPONENT;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_COMPONENT);
 
   if (ATK_IS_EDITABLE_TEXT (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_EDITABLE_TEXT;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_EDITABLE_TEXT);
 
   if (ATK_IS_TEXT (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_TEXT;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_TEXT);
 
   if (ATK_IS_HYPERTEXT (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_HYPERTEXT;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_HYPERTEXT);
 
   if (ATK_IS_IMAGE (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_IMAGE;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_IMAGE);
 
   if (ATK_IS_SELECTION (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_SELECTION;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_SELECTION);
 
   if (ATK_IS_TABLE (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_TABLE;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_TABLE);
 
   if (ATK_IS_TABLE_CELL (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_TABLE_CELL;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_TABLE_CELL);
 
   if (ATK_IS_VALUE (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_VALUE;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_VALUE);
 
 #if 0
   if (ATK_IS_STREAMABLE_CONTENT (obj))
-    {
-      itf = "org.a11y.atspi.StreamableContent";
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE ("org.a11y.atspi.StreamableContent");
 #endif
 
   if (ATK_IS_OBJECT (obj))
-    {
-      itf = "org.a11y.atspi.Collection";
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE ("org.a11y.atspi.Collection");
 
   if (ATK_IS_DOCUMENT (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_DOCUMENT;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_DOCUMENT);
 
   if (ATK_IS_HYPERLINK_IMPL (obj))
-    {
-      itf = ATSPI_DBUS_INTERFACE_HYPERLINK;
-      dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &itf);
-    }
+    ADD_INTERFACE (ATSPI_DBUS_INTERFACE_HYPERLINK);
+
+#undef ADD_INTERFACE
+
+  return n;
+}
+
+void
+spi_object_append_interfaces (DBusMessageIter *iter, AtkObject *obj)
+{
+  const gchar *interfaces[SPI_OBJECT_MAX_INTERFACES];
+  guint i, n;
+
+  n = spi_object_get_interfaces (obj, interfaces, SPI_OBJECT_MAX_INTERFACES);
+  for (i = 0; i < n; i++)
+    dbus_message_iter_append_basic (iter, DBUS_TYPE_STRING, &interfaces[i]);
 }
 
 /*---------------------------------------------------------------------------*/
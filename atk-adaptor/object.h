@@ -27,6 +27,9 @@
 #include <atk/atk.h>
 #include <dbus/dbus.h>
 
+/* Upper bound on the number of D-Bus interfaces of one object */
+#define SPI_OBJECT_MAX_INTERFACES 16
+
 void
 spi_object_lease_if_needed (GObject *obj);
 
@@ -51,6 +54,9 @@ spi_object_return_reference (DBusMessage *msg, AtkObject *obj);
 DBusMessage *
 spi_hyperlink_return_reference (DBusMessage *msg, AtkHyperlink *obj);
 
+guint
+spi_object_get_interfaces (AtkObject *obj, const gchar **interfaces, guint max);
+
 void
 spi_object_append_interfaces (DBusMessageIter *iter, AtkObject *obj);
 
@@ -29,6 +29,7 @@
 #include <glib.h>
 
 #include "atspi-accessible.h"
+#include "atspi-children-private.h"
 #include "atspimarshal.h"
 
 G_BEGIN_DECLS
@@ -38,6 +39,10 @@ struct _AtspiAccessiblePrivate
   GHashTable *cache;
   guint cache_ref_count;
   guint iteration_stamp;
+  gpointer children_leaf; /* where this object is in its parent's children */
+  guint children_refs;    /* how many lists of children hold this object */
+  AtspiChildren children; /* accessible->children is a view of these */
+  gint64 states; /* the last states received; accessible->states is a view */
 };
 
 GHashTable *
@@ -45,6 +50,17 @@ _atspi_accessible_ref_cache (AtspiAccessible *accessible);
 
 void
 _atspi_accessible_unref_cache (AtspiAccessible *accessible);
+
+void
+_atspi_accessible_set_states (AtspiAccessible *accessible, gint64 states);
+
+void
+_atspi_accessible_set_state_by_name (AtspiAccessible *accessible,
+                                     const gchar *name,
+                                     gboolean enabled);
+
+gboolean
+_atspi_accessible_has_state (AtspiAccessible *accessible, AtspiStateType state);
 G_END_DECLS
 
 #endif /* _ATSPI_ACCESSIBLE_H_ */
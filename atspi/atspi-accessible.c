@@ -189,7 +189,8 @@ atspi_accessible_init (AtspiAccessible *accessible)
 
   accessible->priv = atspi_accessible_get_instance_private (accessible);
 
-  accessible->children = g_ptr_array_new_with_free_func ((GDestroyNotify) atspi_accessible_unref);
+  _atspi_children_init (&accessible->priv->children);
+  accessible->children = accessible->priv->children.array;
 }
 
 static void
@@ -208,6 +209,9 @@ atspi_accessible_dispose (GObject *object)
   e.detail2 = 0;
   _atspi_send_event (&e);
 
+  /* Anyone still holding the state set keeps the states as they are now */
+  if (accessible->states)
+    accessible->states->accessible = NULL;
   g_clear_object (&accessible->states);
 
   parent = accessible->accessible_parent;
@@ -215,14 +219,14 @@ atspi_accessible_dispose (GObject *object)
     {
       accessible->accessible_parent = NULL;
       if (parent->children)
-        g_ptr_array_remove (parent->children, accessible);
+        _atspi_children_remove (&parent->priv->children, accessible);
       g_object_unref (parent);
     }
 
   if (accessible->children)
-    for (i = accessible->children->len - 1; i >= 0; i--)
+    for (i = _atspi_children_get_length (&accessible->priv->children) - 1; i >= 0; i--)
       {
-        AtspiAccessible *child = g_ptr_array_index (accessible->children, i);
+        AtspiAccessible *child = _atspi_children_get (&accessible->priv->children, i);
         if (child && child->accessible_parent == accessible)
           {
             child->accessible_parent = NULL;
@@ -232,8 +236,8 @@ atspi_accessible_dispose (GObject *object)
 
   if (accessible->children)
     {
-      g_ptr_array_free (accessible->children, TRUE);
       accessible->children = NULL;
+      _atspi_children_clear (&accessible->priv->children);
     }
 
   G_OBJECT_CLASS (atspi_accessible_parent_class)->dispose (object);
@@ -244,8 +248,8 @@ atspi_accessible_finalize (GObject *object)
 {
   AtspiAccessible *accessible = ATSPI_ACCESSIBLE (object);
 
-  g_free (accessible->description);
-  g_free (accessible->name);
+  _atspi_string_unref (accessible->description);
+  _atspi_string_unref (accessible->name);
 
   if (accessible->attributes)
     g_hash_table_unref (accessible->attributes);
@@ -253,6 +257,8 @@ atspi_accessible_finalize (GObject *object)
   if (accessible->priv->cache)
     g_hash_table_destroy (accessible->priv->cache);
 
+  _atspi_children_free (&accessible->priv->children);
+
 #ifdef DEBUG_REF_COUNTS
   accessible_count--;
   g_hash_table_remove (_atspi_get_live_refs (), accessible);
@@ -346,16 +352,14 @@ atspi_accessible_get_name (AtspiAccessible *obj, GError **error)
 
   if (!_atspi_accessible_test_cache (obj, ATSPI_CACHE_NAME))
     {
-      g_free (obj->name);
-      obj->name = NULL;
+      _atspi_string_set (&obj->name, NULL);
       if (!_atspi_dbus_get_property (obj, atspi_interface_accessible, "Name", error,
                                      "s", &name))
         return g_strdup ("");
       _atspi_accessible_add_cache (obj, ATSPI_CACHE_NAME);
       if (!obj->name)
-        obj->name = name;
-      else
-        free (name);
+        obj->name = _atspi_string_intern (name);
+      g_free (name);
     }
   return g_strdup (obj->name);
 }
@@ -377,17 +381,15 @@ atspi_accessible_get_description (AtspiAccessible *obj, GError **error)
 
   if (!_atspi_accessible_test_cache (obj, ATSPI_CACHE_DESCRIPTION))
     {
-      g_free (obj->description);
-      obj->description = NULL;
+      _atspi_string_set (&obj->description, NULL);
       if (!_atspi_dbus_get_property (obj, atspi_interface_accessible,
                                      "Description", error, "s",
-                                     &obj->description))
+                                     &description))
         return g_strdup ("");
       _atspi_accessible_add_cache (obj, ATSPI_CACHE_DESCRIPTION);
       if (!obj->description)
-        obj->description = description;
-      else
-        free (description);
+        obj->description = _atspi_string_intern (description);
+      g_free (description);
     }
   return g_strdup (obj->description);
 }
@@ -472,7 +474,7 @@ atspi_accessible_get_child_count (AtspiAccessible *obj, GError **error)
   if (!obj->children)
     return 0; /* assume it's disposed */
 
-  return obj->children->len;
+  return _atspi_children_get_length (&obj->priv->children);
 }
 
 /**
@@ -500,12 +502,9 @@ atspi_accessible_get_child_at_index (AtspiAccessible *obj,
       if (!obj->children)
         return NULL; /* assume disposed */
 
-      if (child_index < obj->children->len)
-        {
-          child = g_ptr_array_index (obj->children, child_index);
-          if (child)
-            return g_object_ref (child);
-        }
+      child = _atspi_children_get (&obj->priv->children, child_index);
+      if (child)
+        return g_object_ref (child);
     }
 
   reply = _atspi_dbus_call_partial (obj, atspi_interface_accessible,
@@ -515,14 +514,8 @@ atspi_accessible_get_child_at_index (AtspiAccessible *obj,
   if (!child)
     return NULL;
 
-  if (_atspi_accessible_test_cache (obj, ATSPI_CACHE_CHILDREN))
-    {
-      if (child_index >= obj->children->len)
-        g_ptr_array_set_size (obj->children, child_index + 1);
-      else if (g_ptr_array_index (obj->children, child_index))
-        g_object_unref (g_ptr_array_index (obj->children, child_index));
-      g_ptr_array_index (obj->children, child_index) = g_object_ref (child);
-    }
+  if (child_index >= 0 && _atspi_accessible_test_cache (obj, ATSPI_CACHE_CHILDREN))
+    _atspi_children_set (&obj->priv->children, child_index, child);
   return child;
 }
 
@@ -540,7 +533,7 @@ atspi_accessible_get_child_at_index (AtspiAccessible *obj,
 gint
 atspi_accessible_get_index_in_parent (AtspiAccessible *obj, GError **error)
 {
-  gint i = 0;
+  gint i;
   dbus_int32_t ret = -1;
 
   g_return_val_if_fail (obj != NULL, -1);
@@ -552,9 +545,9 @@ atspi_accessible_get_index_in_parent (AtspiAccessible *obj, GError **error)
       if (!_atspi_accessible_test_cache (obj->accessible_parent, ATSPI_CACHE_CHILDREN) || !obj->accessible_parent->children)
         goto dbus;
 
-      for (i = 0; i < obj->accessible_parent->children->len; i++)
-        if (g_ptr_array_index (obj->accessible_parent->children, i) == obj)
-          return i;
+      i = _atspi_children_index_of (&obj->accessible_parent->priv->children, obj);
+      if (i >= 0)
+        return i;
     }
 
 dbus:
@@ -737,6 +730,8 @@ atspi_accessible_get_state_set (AtspiAccessible *obj)
       _atspi_accessible_add_cache (obj, ATSPI_CACHE_STATES);
     }
 
+  if (!obj->states)
+    obj->states = _atspi_state_set_new_internal (obj, obj->priv->states);
   return g_object_ref (obj->states);
 }
 
@@ -772,7 +767,7 @@ atspi_accessible_get_attributes (AtspiAccessible *obj, GError **error)
                                           "GetAttributes", error, "");
       g_clear_pointer (&(obj->attributes), g_hash_table_unref);
 
-      obj->attributes = _atspi_dbus_return_hash_from_message (message);
+      obj->attributes = _atspi_dbus_return_interned_hash_from_message (message);
       _atspi_accessible_add_cache (obj, ATSPI_CACHE_ATTRIBUTES);
     }
 
@@ -871,6 +866,22 @@ atspi_accessible_get_application (AtspiAccessible *obj, GError **error)
 
 /* Application-specific methods */
 
+static void
+get_application_string (AtspiAccessible *obj, const char *property, gchar **field, GError **error)
+{
+  gchar *value = NULL;
+
+  if (*field)
+    return;
+
+  if (_atspi_dbus_get_property (obj, atspi_interface_application, property,
+                                error, "s", &value))
+    {
+      *field = _atspi_string_intern (value);
+      g_free (value);
+    }
+}
+
 /**
  * atspi_accessible_get_toolkit_name:
  * @obj: a pointer to the #AtspiAccessible object on which to operate.
@@ -888,9 +899,7 @@ atspi_accessible_get_toolkit_name (AtspiAccessible *obj, GError **error)
   if (!obj->parent.app)
     return NULL;
 
-  if (!obj->parent.app->toolkit_name)
-    _atspi_dbus_get_property (obj, atspi_interface_application, "ToolkitName",
-                              error, "s", &obj->parent.app->toolkit_name);
+  get_application_string (obj, "ToolkitName", &obj->parent.app->toolkit_name, error);
 
   return g_strdup (obj->parent.app->toolkit_name);
 }
@@ -912,9 +921,7 @@ atspi_accessible_get_toolkit_version (AtspiAccessible *obj, GError **error)
   if (!obj->parent.app)
     return NULL;
 
-  if (!obj->parent.app->toolkit_version)
-    _atspi_dbus_get_property (obj, atspi_interface_application, "Version",
-                              error, "s", &obj->parent.app->toolkit_version);
+  get_application_string (obj, "Version", &obj->parent.app->toolkit_version, error);
 
   return g_strdup (obj->parent.app->toolkit_version);
 }
@@ -937,9 +944,7 @@ atspi_accessible_get_atspi_version (AtspiAccessible *obj, GError **error)
   if (!obj->parent.app)
     return NULL;
 
-  if (!obj->parent.app->atspi_version)
-    _atspi_dbus_get_property (obj, atspi_interface_application, "AtspiVersion",
-                              error, "s", &obj->parent.app->atspi_version);
+  get_application_string (obj, "AtspiVersion", &obj->parent.app->atspi_version, error);
 
   return g_strdup (obj->parent.app->atspi_version);
 }
@@ -1760,8 +1765,8 @@ atspi_accessible_clear_cache_internal (AtspiAccessible *obj, guint iteration_sta
       obj->priv->iteration_stamp = iteration_stamp;
       atspi_accessible_clear_cache_single (obj);
       if (obj->children)
-        for (i = 0; i < obj->children->len; i++)
-          atspi_accessible_clear_cache_internal (g_ptr_array_index (obj->children, i), iteration_stamp);
+        for (i = 0; i < _atspi_children_get_length (&obj->priv->children); i++)
+          atspi_accessible_clear_cache_internal (_atspi_children_get (&obj->priv->children, i), iteration_stamp);
     }
 }
 
@@ -1793,6 +1798,727 @@ atspi_accessible_clear_cache (AtspiAccessible *obj)
   atspi_accessible_clear_cache_internal (obj, ++iteration_stamp);
 }
 
+/* The properties that atspi_accessible_prefetch() can fetch for each flag */
+static const struct
+{
+  AtspiCache flag;
+  const char *name;
+} prefetch_properties[] = {
+  { ATSPI_CACHE_NAME, "Name" },
+  { ATSPI_CACHE_DESCRIPTION, "Description" },
+  { ATSPI_CACHE_ROLE, "Role" },
+  { ATSPI_CACHE_STATES, "State" },
+  { ATSPI_CACHE_INTERFACES, "Interfaces" },
+  { ATSPI_CACHE_ATTRIBUTES, "Attributes" },
+  { ATSPI_CACHE_PARENT, "Parent" },
+};
+
+/* Upper bound on the number of objects the application takes per call */
+#define PREFETCH_MAX_OBJECTS 1000
+
+static void
+prefetch_set_property (AtspiAccessible *obj,
+                       const char *name,
+                       DBusMessageIter *iter_variant)
+{
+  AtspiCache mask = _atspi_accessible_get_cache_mask (obj);
+  const char *signature;
+  guint i;
+
+  /* Do not overwrite what the cache mask of the accessible excludes */
+  for (i = 0; i < G_N_ELEMENTS (prefetch_properties); i++)
+    if (!strcmp (name, prefetch_properties[i].name))
+      break;
+  if (i == G_N_ELEMENTS (prefetch_properties) ||
+      !(mask & prefetch_properties[i].flag))
+    return;
+
+  signature = dbus_message_iter_get_signature (iter_variant);
+  if (!strcmp (name, "Name") && !strcmp (signature, "s"))
+    {
+      const char *str;
+
+      dbus_message_iter_get_basic (iter_variant, &str);
+      _atspi_string_set (&obj->name, str);
+      _atspi_accessible_add_cache (obj, ATSPI_CACHE_NAME);
+    }
+  else if (!strcmp (name, "Description") && !strcmp (signature, "s"))
+    {
+      const char *str;
+
+      dbus_message_iter_get_basic (iter_variant, &str);
+      _atspi_string_set (&obj->description, str);
+      _atspi_accessible_add_cache (obj, ATSPI_CACHE_DESCRIPTION);
+    }
+  else if (!strcmp (name, "Role") && !strcmp (signature, "u"))
+    {
+      dbus_uint32_t role;
+
+      dbus_message_iter_get_basic (iter_variant, &role);
+      obj->role = role;
+      _atspi_accessible_add_cache (obj, ATSPI_CACHE_ROLE);
+    }
+  else if (!strcmp (name, "State") && !strcmp (signature, "au"))
+    _atspi_dbus_set_state (obj, iter_variant);
+  else if (!strcmp (name, "Interfaces") && !strcmp (signature, "as"))
+    _atspi_dbus_set_interfaces (obj, iter_variant);
+  else if (!strcmp (name, "Attributes") && !strcmp (signature, "a{ss}"))
+    {
+      g_clear_pointer (&obj->attributes, g_hash_table_unref);
+      obj->attributes = _atspi_dbus_interned_hash_from_iter (iter_variant);
+      _atspi_accessible_add_cache (obj, ATSPI_CACHE_ATTRIBUTES);
+    }
+  else if (!strcmp (name, "Parent") && !strcmp (signature, "(so)"))
+    {
+      g_clear_object (&obj->accessible_parent);
+      obj->accessible_parent = _atspi_dbus_consume_accessible (iter_variant);
+      _atspi_accessible_add_cache (obj, ATSPI_CACHE_PARENT);
+    }
+
+  dbus_free ((char *) signature);
+}
+
+static gboolean
+prefetch_from_application (AtspiApplication *app,
+                           GPtrArray *objs,
+                           guint start,
+                           guint end,
+                           const char **names,
+                           gint n_names,
+                           gboolean *unsupported,
+                           GError **error)
+{
+  DBusMessage *message, *reply;
+  DBusMessageIter iter, iter_array, iter_dict, iter_entry, iter_variant;
+  DBusError err;
+  guint i;
+
+  message = dbus_message_new_method_call (app->bus_name,
+                                          "/org/a11y/atspi/cache",
+                                          atspi_interface_cache,
+                                          "GetProperties");
+  if (!message)
+    return FALSE;
+
+  dbus_message_iter_init_append (message, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "o", &iter_array);
+  for (i = start; i < end; i++)
+    {
+      AtspiAccessible *obj = g_ptr_array_index (objs, i);
+
+      dbus_message_iter_append_basic (&iter_array, DBUS_TYPE_OBJECT_PATH,
+                                      &obj->parent.path);
+    }
+  dbus_message_iter_close_container (&iter, &iter_array);
+  dbus_message_append_args (message, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                            &names, n_names, DBUS_TYPE_INVALID);
+
+  dbus_error_init (&err);
+  reply = _atspi_dbus_send_with_reply_and_block_full (message, &err);
+  if (dbus_error_is_set (&err))
+    {
+      /* Bridges older than Cache.GetProperties */
+      if (dbus_error_has_name (&err, DBUS_ERROR_UNKNOWN_METHOD))
+        *unsupported = TRUE;
+      else
+        g_set_error_literal (error, ATSPI_ERROR, ATSPI_ERROR_IPC, err.message);
+      dbus_error_free (&err);
+    }
+  if (!reply)
+    return FALSE;
+  _ATSPI_DBUS_CHECK_SIG (reply, "aa{sv}", error, FALSE);
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  for (i = start;
+       i < end && dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID;
+       i++)
+    {
+      AtspiAccessible *obj = g_ptr_array_index (objs, i);
+
+      dbus_message_iter_recurse (&iter_array, &iter_dict);
+      while (dbus_message_iter_get_arg_type (&iter_dict) != DBUS_TYPE_INVALID)
+        {
+          const char *name;
+
+          dbus_message_iter_recurse (&iter_dict, &iter_entry);
+          dbus_message_iter_get_basic (&iter_entry, &name);
+          dbus_message_iter_next (&iter_entry);
+          dbus_message_iter_recurse (&iter_entry, &iter_variant);
+          prefetch_set_property (obj, name, &iter_variant);
+          dbus_message_iter_next (&iter_dict);
+        }
+      dbus_message_iter_next (&iter_array);
+    }
+
+  dbus_message_unref (reply);
+  return TRUE;
+}
+
+/* Fetches the data one property at a time, for applications that do not
+ * implement Cache.GetProperties */
+static gboolean
+prefetch_with_getters (AtspiAccessible *obj, AtspiCache flags, GError **error)
+{
+  GError *local_error = NULL;
+
+  if (flags & ATSPI_CACHE_NAME)
+    g_free (atspi_accessible_get_name (obj, &local_error));
+  if (!local_error && (flags & ATSPI_CACHE_DESCRIPTION))
+    g_free (atspi_accessible_get_description (obj, &local_error));
+  if (!local_error && (flags & ATSPI_CACHE_ROLE))
+    atspi_accessible_get_role (obj, &local_error);
+  if (!local_error && (flags & ATSPI_CACHE_STATES))
+    g_object_unref (atspi_accessible_get_state_set (obj));
+  if (!local_error && (flags & ATSPI_CACHE_INTERFACES))
+    g_strfreev ((gchar **) g_array_free (atspi_accessible_get_interfaces (obj), FALSE));
+  if (!local_error && (flags & ATSPI_CACHE_ATTRIBUTES))
+    {
+      GHashTable *attributes = atspi_accessible_get_attributes (obj, &local_error);
+      if (attributes)
+        g_hash_table_unref (attributes);
+    }
+  if (!local_error && (flags & ATSPI_CACHE_PARENT))
+    {
+      AtspiAccessible *parent = atspi_accessible_get_parent (obj, &local_error);
+      if (parent)
+        g_object_unref (parent);
+    }
+
+  if (local_error)
+    {
+      g_propagate_error (error, local_error);
+      return FALSE;
+    }
+  return TRUE;
+}
+
+/**
+ * atspi_accessible_prefetch:
+ * @accessibles: (element-type AtspiAccessible): the accessibles to fetch
+ * data for.
+ * @flags: an #AtspiCache mask of the data to fetch.  Name, description,
+ * role, states, interfaces, attributes and parent are supported.
+ * @error: a pointer to a %NULL #GError pointer
+ *
+ * Fills the client-side cache of many accessibles at once, with one call
+ * to each application involved instead of one call per accessible and
+ * property.  Data that is already cached is not fetched again, and data
+ * that the cache mask of an accessible excludes is not kept.  Applications
+ * that cannot return the data in bulk are queried one property at a time,
+ * and an application that fails does not stop the others from being
+ * queried.
+ *
+ * Returns: %FALSE if some of the data could not be fetched.
+ *
+ * Since: 2.56
+ **/
+gboolean
+atspi_accessible_prefetch (GPtrArray *accessibles,
+                           AtspiCache flags,
+                           GError **error)
+{
+  GHashTable *by_app;
+  GHashTableIter hash_iter;
+  gpointer app, objs;
+  const char *names[G_N_ELEMENTS (prefetch_properties)];
+  gint n_names = 0;
+  gboolean ret = TRUE;
+  guint i;
+
+  g_return_val_if_fail (accessibles != NULL, FALSE);
+
+  for (i = 0; i < G_N_ELEMENTS (prefetch_properties); i++)
+    if (flags & prefetch_properties[i].flag)
+      names[n_names++] = prefetch_properties[i].name;
+  if (n_names == 0)
+    return TRUE;
+
+  /* Group the accessibles that need data by application */
+  by_app = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                  (GDestroyNotify) g_ptr_array_unref);
+  for (i = 0; i < accessibles->len; i++)
+    {
+      AtspiAccessible *obj = g_ptr_array_index (accessibles, i);
+      GPtrArray *app_objs;
+      guint j;
+
+      if (!obj || !obj->parent.app || !obj->parent.app->bus)
+        continue;
+      for (j = 0; j < G_N_ELEMENTS (prefetch_properties); j++)
+        if ((flags & prefetch_properties[j].flag) &&
+            !_atspi_accessible_test_cache (obj, prefetch_properties[j].flag))
+          break;
+      if (j == G_N_ELEMENTS (prefetch_properties))
+        continue;
+
+      app_objs = g_hash_table_lookup (by_app, obj->parent.app);
+      if (!app_objs)
+        {
+          app_objs = g_ptr_array_new_with_free_func (g_object_unref);
+          g_hash_table_insert (by_app, obj->parent.app, app_objs);
+        }
+      g_ptr_array_add (app_objs, g_object_ref (obj));
+    }
+
+  /* A failing application does not keep the others from being fetched;
+   * only the first error is reported */
+  g_hash_table_iter_init (&hash_iter, by_app);
+  while (g_hash_table_iter_next (&hash_iter, &app, &objs))
+    {
+      GPtrArray *app_objs = objs;
+      gboolean unsupported = FALSE;
+      guint start;
+
+      for (start = 0; start < app_objs->len; start += PREFETCH_MAX_OBJECTS)
+        {
+          if (!prefetch_from_application (app, app_objs, start,
+                                          MIN (start + PREFETCH_MAX_OBJECTS, app_objs->len),
+                                          names, n_names, &unsupported,
+                                          ret ? error : NULL))
+            break;
+        }
+      if (unsupported)
+        {
+          for (; start < app_objs->len; start++)
+            {
+              if (!prefetch_with_getters (g_ptr_array_index (app_objs, start),
+                                          flags, ret ? error : NULL))
+                {
+                  ret = FALSE;
+                  break;
+                }
+            }
+        }
+      else if (start < app_objs->len)
+        ret = FALSE;
+    }
+
+  g_hash_table_unref (by_app);
+  return ret;
+}
+
+static void
+string_reply (GTask *task, DBusMessage *reply, AtspiCache flag, gchar **field)
+{
+  AtspiAccessible *obj = g_task_get_source_object (task);
+  DBusMessageIter iter_variant;
+  const char *value;
+
+  if (!_atspi_dbus_property_reply_init (reply, task, "s", &iter_variant))
+    return;
+  dbus_message_iter_get_basic (&iter_variant, &value);
+
+  /* An event may have updated the cache while the call was in flight */
+  if (!_atspi_accessible_test_cache (obj, flag))
+    {
+      _atspi_string_set (field, value);
+      _atspi_accessible_add_cache (obj, flag);
+    }
+  if (_atspi_accessible_test_cache (obj, flag))
+    value = *field;
+  g_task_return_pointer (task, g_strdup (value), g_free);
+}
+
+static void
+name_reply (GTask *task, DBusMessage *reply)
+{
+  AtspiAccessible *obj = g_task_get_source_object (task);
+
+  string_reply (task, reply, ATSPI_CACHE_NAME, &obj->name);
+}
+
+static void
+description_reply (GTask *task, DBusMessage *reply)
+{
+  AtspiAccessible *obj = g_task_get_source_object (task);
+
+  string_reply (task, reply, ATSPI_CACHE_DESCRIPTION, &obj->description);
+}
+
+/**
+ * atspi_accessible_get_name_async:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: (scope async): the function to call when the name is known
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of atspi_accessible_get_name().  The call is sent
+ * without waiting for earlier ones to be answered, so that many requests
+ * can be in flight at once.  @callback runs from the main context set
+ * with atspi_set_main_context(), if the calling thread can own it, or
+ * else from the thread-default main context of the caller.
+ *
+ * Since: 2.56
+ **/
+void
+atspi_accessible_get_name_async (AtspiAccessible *obj,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (ATSPI_IS_ACCESSIBLE (obj));
+
+  task = _atspi_task_new (obj, cancellable, callback, user_data);
+  g_task_set_source_tag (task, atspi_accessible_get_name_async);
+
+  if (_atspi_accessible_test_cache (obj, ATSPI_CACHE_NAME))
+    g_task_return_pointer (task, g_strdup (obj->name), g_free);
+  else
+    _atspi_dbus_get_property_async (task, atspi_interface_accessible, "Name",
+                                    name_reply);
+  g_object_unref (task);
+}
+
+/**
+ * atspi_accessible_get_name_finish:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a pointer to a %NULL #GError pointer
+ *
+ * Finishes an operation started with atspi_accessible_get_name_async().
+ *
+ * Returns: (nullable) (transfer full): the name of @obj, or %NULL on
+ * exception.
+ *
+ * Since: 2.56
+ **/
+gchar *
+atspi_accessible_get_name_finish (AtspiAccessible *obj,
+                                  GAsyncResult *result,
+                                  GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, obj), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/**
+ * atspi_accessible_get_description_async:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: (scope async): the function to call when the description
+ * is known
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of atspi_accessible_get_description().  See
+ * atspi_accessible_get_name_async() for how the call is made.
+ *
+ * Since: 2.56
+ **/
+void
+atspi_accessible_get_description_async (AtspiAccessible *obj,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (ATSPI_IS_ACCESSIBLE (obj));
+
+  task = _atspi_task_new (obj, cancellable, callback, user_data);
+  g_task_set_source_tag (task, atspi_accessible_get_description_async);
+
+  if (_atspi_accessible_test_cache (obj, ATSPI_CACHE_DESCRIPTION))
+    g_task_return_pointer (task, g_strdup (obj->description), g_free);
+  else
+    _atspi_dbus_get_property_async (task, atspi_interface_accessible,
+                                    "Description", description_reply);
+  g_object_unref (task);
+}
+
+/**
+ * atspi_accessible_get_description_finish:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a pointer to a %NULL #GError pointer
+ *
+ * Finishes an operation started with
+ * atspi_accessible_get_description_async().
+ *
+ * Returns: (nullable) (transfer full): the description of @obj, or %NULL
+ * on exception.
+ *
+ * Since: 2.56
+ **/
+gchar *
+atspi_accessible_get_description_finish (AtspiAccessible *obj,
+                                         GAsyncResult *result,
+                                         GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, obj), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+static void
+role_reply (GTask *task, DBusMessage *reply)
+{
+  AtspiAccessible *obj = g_task_get_source_object (task);
+  dbus_uint32_t role;
+
+  if (strcmp (dbus_message_get_signature (reply), "u") != 0)
+    {
+      g_task_return_new_error (task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                               "Unexpected reply type %s, expected u",
+                               dbus_message_get_signature (reply));
+      return;
+    }
+  dbus_message_get_args (reply, NULL, DBUS_TYPE_UINT32, &role,
+                         DBUS_TYPE_INVALID);
+  obj->role = role;
+  _atspi_accessible_add_cache (obj, ATSPI_CACHE_ROLE);
+  g_task_return_int (task, role);
+}
+
+/**
+ * atspi_accessible_get_role_async:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: (scope async): the function to call when the role is known
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of atspi_accessible_get_role().  See
+ * atspi_accessible_get_name_async() for how the call is made.
+ *
+ * Since: 2.56
+ **/
+void
+atspi_accessible_get_role_async (AtspiAccessible *obj,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (ATSPI_IS_ACCESSIBLE (obj));
+
+  task = _atspi_task_new (obj, cancellable, callback, user_data);
+  g_task_set_source_tag (task, atspi_accessible_get_role_async);
+
+  if (_atspi_accessible_test_cache (obj, ATSPI_CACHE_ROLE))
+    g_task_return_int (task, obj->role);
+  else
+    _atspi_dbus_call_async (task, atspi_interface_accessible, "GetRole",
+                            role_reply, "");
+  g_object_unref (task);
+}
+
+/**
+ * atspi_accessible_get_role_finish:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a pointer to a %NULL #GError pointer
+ *
+ * Finishes an operation started with atspi_accessible_get_role_async().
+ *
+ * Returns: the #AtspiRole of @obj, or %ATSPI_ROLE_INVALID on exception.
+ *
+ * Since: 2.56
+ **/
+AtspiRole
+atspi_accessible_get_role_finish (AtspiAccessible *obj,
+                                  GAsyncResult *result,
+                                  GError **error)
+{
+  GError *local_error = NULL;
+  gssize role;
+
+  g_return_val_if_fail (g_task_is_valid (result, obj), ATSPI_ROLE_INVALID);
+
+  role = g_task_propagate_int (G_TASK (result), &local_error);
+  if (local_error)
+    {
+      g_propagate_error (error, local_error);
+      return ATSPI_ROLE_INVALID;
+    }
+  return role;
+}
+
+static void
+child_count_reply (GTask *task, DBusMessage *reply)
+{
+  DBusMessageIter iter_variant;
+  dbus_int32_t count;
+
+  if (!_atspi_dbus_property_reply_init (reply, task, "i", &iter_variant))
+    return;
+  dbus_message_iter_get_basic (&iter_variant, &count);
+  g_task_return_int (task, count);
+}
+
+/**
+ * atspi_accessible_get_child_count_async:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: (scope async): the function to call when the number of
+ * children is known
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of atspi_accessible_get_child_count().  See
+ * atspi_accessible_get_name_async() for how the call is made.
+ *
+ * Since: 2.56
+ **/
+void
+atspi_accessible_get_child_count_async (AtspiAccessible *obj,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (ATSPI_IS_ACCESSIBLE (obj));
+
+  task = _atspi_task_new (obj, cancellable, callback, user_data);
+  g_task_set_source_tag (task, atspi_accessible_get_child_count_async);
+
+  if (_atspi_accessible_test_cache (obj, ATSPI_CACHE_CHILDREN))
+    g_task_return_int (task, obj->children ? _atspi_children_get_length (&obj->priv->children) : 0);
+  else
+    _atspi_dbus_get_property_async (task, atspi_interface_accessible,
+                                    "ChildCount", child_count_reply);
+  g_object_unref (task);
+}
+
+/**
+ * atspi_accessible_get_child_count_finish:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a pointer to a %NULL #GError pointer
+ *
+ * Finishes an operation started with
+ * atspi_accessible_get_child_count_async().
+ *
+ * Returns: the number of children of @obj, or -1 on exception.
+ *
+ * Since: 2.56
+ **/
+gint
+atspi_accessible_get_child_count_finish (AtspiAccessible *obj,
+                                         GAsyncResult *result,
+                                         GError **error)
+{
+  GError *local_error = NULL;
+  gssize count;
+
+  g_return_val_if_fail (g_task_is_valid (result, obj), -1);
+
+  count = g_task_propagate_int (G_TASK (result), &local_error);
+  if (local_error)
+    {
+      g_propagate_error (error, local_error);
+      return -1;
+    }
+  return count;
+}
+
+static void
+child_at_index_reply (GTask *task, DBusMessage *reply)
+{
+  AtspiAccessible *obj = g_task_get_source_object (task);
+  gint child_index = GPOINTER_TO_INT (g_task_get_task_data (task));
+  AtspiAccessible *child;
+  DBusMessageIter iter;
+
+  if (strcmp (dbus_message_get_signature (reply), "(so)") != 0)
+    {
+      g_task_return_new_error (task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                               "Unexpected reply type %s, expected (so)",
+                               dbus_message_get_signature (reply));
+      return;
+    }
+  dbus_message_iter_init (reply, &iter);
+  child = _atspi_dbus_consume_accessible (&iter);
+
+  if (child && obj->children && child_index >= 0 &&
+      _atspi_accessible_test_cache (obj, ATSPI_CACHE_CHILDREN))
+    _atspi_children_set (&obj->priv->children, child_index, child);
+  g_task_return_pointer (task, child, g_object_unref);
+}
+
+/**
+ * atspi_accessible_get_child_at_index_async:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @child_index: a #long indicating which child is specified.
+ * @cancellable: (nullable): a #GCancellable, or %NULL
+ * @callback: (scope async): the function to call when the child is known
+ * @user_data: data to pass to @callback
+ *
+ * Asynchronous version of atspi_accessible_get_child_at_index().  See
+ * atspi_accessible_get_name_async() for how the call is made; requesting
+ * every child of a node before handling any reply lets a tree be walked
+ * in one round trip per level.
+ *
+ * Since: 2.56
+ **/
+void
+atspi_accessible_get_child_at_index_async (AtspiAccessible *obj,
+                                           gint child_index,
+                                           GCancellable *cancellable,
+                                           GAsyncReadyCallback callback,
+                                           gpointer user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (ATSPI_IS_ACCESSIBLE (obj));
+
+  task = _atspi_task_new (obj, cancellable, callback, user_data);
+  g_task_set_source_tag (task, atspi_accessible_get_child_at_index_async);
+  g_task_set_task_data (task, GINT_TO_POINTER (child_index), NULL);
+
+  if (_atspi_accessible_test_cache (obj, ATSPI_CACHE_CHILDREN))
+    {
+      AtspiAccessible *child = NULL;
+
+      if (!obj->children)
+        {
+          /* assume disposed */
+          g_task_return_pointer (task, NULL, NULL);
+          g_object_unref (task);
+          return;
+        }
+      if (child_index >= 0)
+        child = _atspi_children_get (&obj->priv->children, child_index);
+      if (child)
+        {
+          g_task_return_pointer (task, g_object_ref (child), g_object_unref);
+          g_object_unref (task);
+          return;
+        }
+    }
+
+  _atspi_dbus_call_async (task, atspi_interface_accessible, "GetChildAtIndex",
+                          child_at_index_reply, "i", child_index);
+  g_object_unref (task);
+}
+
+/**
+ * atspi_accessible_get_child_at_index_finish:
+ * @obj: a pointer to the #AtspiAccessible object on which to operate.
+ * @result: the #GAsyncResult passed to the callback
+ * @error: a pointer to a %NULL #GError pointer
+ *
+ * Finishes an operation started with
+ * atspi_accessible_get_child_at_index_async().
+ *
+ * Returns: (nullable) (transfer full): the requested child, or %NULL on
+ * exception.
+ *
+ * Since: 2.56
+ **/
+AtspiAccessible *
+atspi_accessible_get_child_at_index_finish (AtspiAccessible *obj,
+                                            GAsyncResult *result,
+                                            GError **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, obj), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 /**
  * atspi_accessible_get_process_id:
  * @accessible: The #AtspiAccessible to query.
@@ -1871,7 +2597,7 @@ _atspi_accessible_test_cache (AtspiAccessible *accessible, AtspiCache flag)
 {
   AtspiCache mask = _atspi_accessible_get_cache_mask (accessible);
   AtspiCache result = accessible->cached_properties & mask & flag;
-  if (accessible->states && atspi_state_set_contains (accessible->states, ATSPI_STATE_TRANSIENT))
+  if (_atspi_accessible_has_state (accessible, ATSPI_STATE_TRANSIENT))
     return FALSE;
   return (result != 0 && (atspi_main_loop || enable_caching || flag == ATSPI_CACHE_INTERFACES) &&
           !atspi_no_cache);
@@ -2005,3 +2731,49 @@ _atspi_accessible_unref_cache (AtspiAccessible *accessible)
         priv->cache = NULL;
     }
 }
+
+void
+_atspi_accessible_set_states (AtspiAccessible *accessible, gint64 states)
+{
+  accessible->priv->states = states;
+  if (accessible->states)
+    accessible->states->states = states;
+  else
+    accessible->states = _atspi_state_set_new_internal (accessible, states);
+}
+
+/* Updates a cached state as atspi_state_set_set_by_name() would, without
+ * making a state set */
+void
+_atspi_accessible_set_state_by_name (AtspiAccessible *accessible,
+                                     const gchar *name,
+                                     gboolean enabled)
+{
+  GTypeClass *type_class;
+  GEnumValue *value;
+  gint64 states = accessible->priv->states;
+
+  if (!(accessible->cached_properties & ATSPI_CACHE_STATES))
+    return;
+
+  type_class = g_type_class_ref (ATSPI_TYPE_STATE_TYPE);
+
+  value = g_enum_get_value_by_nick (G_ENUM_CLASS (type_class), name);
+
+  if (!value)
+    g_warning ("AT-SPI: Attempt to set unknown state '%s'", name);
+  else if (enabled)
+    states |= ((gint64) 1 << value->value);
+  else
+    states &= ~((gint64) 1 << value->value);
+  _atspi_accessible_set_states (accessible, states);
+
+  g_type_class_unref (type_class);
+}
+
+/* Tests the last states received for accessible, without a round trip */
+gboolean
+_atspi_accessible_has_state (AtspiAccessible *accessible, AtspiStateType state)
+{
+  return (accessible->priv->states & ((gint64) 1 << state)) ? TRUE : FALSE;
+}
@@ -28,6 +28,7 @@
 
 G_BEGIN_DECLS
 
+#include "gio/gio.h"
 #include "glib-object.h"
 
 #include "atspi-application.h"
@@ -198,6 +199,28 @@ void atspi_accessible_clear_cache (AtspiAccessible *obj);
 
 void atspi_accessible_clear_cache_single (AtspiAccessible *obj);
 
+gboolean atspi_accessible_prefetch (GPtrArray *accessibles, AtspiCache flags, GError **error);
+
+void atspi_accessible_get_name_async (AtspiAccessible *obj, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+gchar *atspi_accessible_get_name_finish (AtspiAccessible *obj, GAsyncResult *result, GError **error);
+
+void atspi_accessible_get_description_async (AtspiAccessible *obj, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+gchar *atspi_accessible_get_description_finish (AtspiAccessible *obj, GAsyncResult *result, GError **error);
+
+void atspi_accessible_get_role_async (AtspiAccessible *obj, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+AtspiRole atspi_accessible_get_role_finish (AtspiAccessible *obj, GAsyncResult *result, GError **error);
+
+void atspi_accessible_get_child_count_async (AtspiAccessible *obj, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+gint atspi_accessible_get_child_count_finish (AtspiAccessible *obj, GAsyncResult *result, GError **error);
+
+void atspi_accessible_get_child_at_index_async (AtspiAccessible *obj, gint child_index, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+AtspiAccessible *atspi_accessible_get_child_at_index_finish (AtspiAccessible *obj, GAsyncResult *result, GError **error);
+
 guint atspi_accessible_get_process_id (AtspiAccessible *accessible, GError **error);
 
 gchar *atspi_accessible_get_accessible_id (AtspiAccessible *obj, GError **error);
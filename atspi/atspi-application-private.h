@@ -0,0 +1,45 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _ATSPI_APPLICATION_PRIVATE_H_
+#define _ATSPI_APPLICATION_PRIVATE_H_
+
+#include <dbus/dbus.h>
+#include <glib.h>
+
+#include "atspi-application.h"
+
+G_BEGIN_DECLS
+
+typedef struct _AtspiApplicationPrivate AtspiApplicationPrivate;
+struct _AtspiApplicationPrivate
+{
+  guint cache_generation;          /* the generation to ask GetItemsPaged for */
+  DBusPendingCall *cache_request;  /* the GetItemsPaged or GetItems in flight */
+  gboolean cache_refetch;          /* ask again once cache_request is done */
+  GHashTable *stale;               /* objects not sent again since a reset */
+};
+
+AtspiApplicationPrivate *
+_atspi_application_get_private (AtspiApplication *application);
+
+G_END_DECLS
+
+#endif /* _ATSPI_APPLICATION_PRIVATE_H_ */
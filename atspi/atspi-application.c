@@ -33,7 +33,7 @@
  * hierarchy associated with a running application.
  */
 
-G_DEFINE_TYPE (AtspiApplication, atspi_application, G_TYPE_OBJECT)
+G_DEFINE_TYPE_WITH_PRIVATE (AtspiApplication, atspi_application, G_TYPE_OBJECT)
 
 static void
 atspi_application_init (AtspiApplication *application)
@@ -50,6 +50,15 @@ static void
 atspi_application_dispose (GObject *object)
 {
   AtspiApplication *application = ATSPI_APPLICATION (object);
+  AtspiApplicationPrivate *priv = atspi_application_get_instance_private (application);
+
+  if (priv->cache_request)
+    {
+      dbus_pending_call_cancel (priv->cache_request);
+      dbus_pending_call_unref (priv->cache_request);
+      priv->cache_request = NULL;
+    }
+  g_clear_pointer (&priv->stale, g_hash_table_unref);
 
   if (application->bus)
     {
@@ -82,9 +91,9 @@ atspi_application_finalize (GObject *object)
   AtspiApplication *application = ATSPI_APPLICATION (object);
 
   g_free (application->bus_name);
-  g_free (application->toolkit_name);
-  g_free (application->toolkit_version);
-  g_free (application->atspi_version);
+  _atspi_string_unref (application->toolkit_name);
+  _atspi_string_unref (application->toolkit_version);
+  _atspi_string_unref (application->atspi_version);
 
   G_OBJECT_CLASS (atspi_application_parent_class)->finalize (object);
 }
@@ -98,13 +107,20 @@ atspi_application_class_init (AtspiApplicationClass *klass)
   object_class->finalize = atspi_application_finalize;
 }
 
+AtspiApplicationPrivate *
+_atspi_application_get_private (AtspiApplication *application)
+{
+  return atspi_application_get_instance_private (application);
+}
+
 AtspiApplication *
 _atspi_application_new (const gchar *bus_name)
 {
   AtspiApplication *application;
 
   application = g_object_new (ATSPI_TYPE_APPLICATION, NULL);
-  application->hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  /* Keys are the paths of the objects that they map to */
+  application->hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
   application->bus_name = g_strdup (bus_name);
   application->root = NULL;
   return application;
@@ -0,0 +1,75 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _ATSPI_CHILDREN_PRIVATE_H_
+#define _ATSPI_CHILDREN_PRIVATE_H_
+
+#include <glib.h>
+
+#include "atspi-accessible.h"
+
+G_BEGIN_DECLS
+
+typedef struct _AtspiChildren AtspiChildren;
+
+/* Kept inside the private data of its accessible.  array is what the
+ * public children field of the accessible points to. */
+struct _AtspiChildren
+{
+  struct _ChildrenNode *root;
+  GPtrArray *array;
+};
+
+void
+_atspi_children_init (AtspiChildren *children);
+
+void
+_atspi_children_clear (AtspiChildren *children);
+
+void
+_atspi_children_free (AtspiChildren *children);
+
+guint
+_atspi_children_get_length (AtspiChildren *children);
+
+void
+_atspi_children_set_length (AtspiChildren *children, guint length);
+
+AtspiAccessible *
+_atspi_children_get (AtspiChildren *children, guint index);
+
+void
+_atspi_children_set (AtspiChildren *children, guint index, AtspiAccessible *child);
+
+void
+_atspi_children_insert (AtspiChildren *children, guint index, AtspiAccessible *child);
+
+void
+_atspi_children_remove_index (AtspiChildren *children, guint index);
+
+gboolean
+_atspi_children_remove (AtspiChildren *children, AtspiAccessible *child);
+
+gint
+_atspi_children_index_of (AtspiChildren *children, AtspiAccessible *child);
+
+G_END_DECLS
+
+#endif /* _ATSPI_CHILDREN_PRIVATE_H_ */
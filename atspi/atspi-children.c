@@ -0,0 +1,395 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * The cached children of an accessible.
+ *
+ * Children are kept in a counted B-tree: the leaves hold the children in
+ * order, and every node knows how many children are below it, so that a
+ * child can be found, inserted or removed by index in logarithmic time.
+ * Each child points back to the leaf that holds it, which gives its index
+ * without searching its siblings, and counts the lists that hold it, so
+ * that an object which is in none is not searched for.
+ *
+ * Children that are not known yet are held as NULL, as children are often
+ * fetched one at a time once their number is known.
+ *
+ * The children are also kept, in the same order, in a GPtrArray that the
+ * public children field of AtspiAccessible points to.  It holds no
+ * references of its own, and gives a child by index directly; the tree is
+ * what finds the index of a child.
+ */
+
+#include "atspi-private.h"
+
+#define NODE_SIZE 16
+
+typedef struct _ChildrenNode ChildrenNode;
+
+struct _ChildrenNode
+{
+  ChildrenNode *parent;
+  guint count;  /* the number of children below this node */
+  guint n;      /* the number of slots used */
+  gboolean leaf;
+  gpointer slots[NODE_SIZE]; /* children in leaves, nodes otherwise */
+};
+
+static ChildrenNode *
+node_new (gboolean leaf)
+{
+  ChildrenNode *node = g_new0 (ChildrenNode, 1);
+
+  node->leaf = leaf;
+  return node;
+}
+
+static void
+node_adopt (ChildrenNode *node, gpointer slot)
+{
+  if (!node->leaf)
+    ((ChildrenNode *) slot)->parent = node;
+  else if (slot)
+    ((AtspiAccessible *) slot)->priv->children_leaf = node;
+}
+
+static AtspiAccessible *
+child_ref (AtspiAccessible *child)
+{
+  if (!child)
+    return NULL;
+  child->priv->children_refs++;
+  return g_object_ref (child);
+}
+
+static void
+child_unref (ChildrenNode *leaf, AtspiAccessible *child)
+{
+  if (!child)
+    return;
+  if (child->priv->children_leaf == leaf)
+    child->priv->children_leaf = NULL;
+  child->priv->children_refs--;
+  g_object_unref (child);
+}
+
+static guint
+node_position (ChildrenNode *node)
+{
+  guint i;
+
+  for (i = 0; node->parent->slots[i] != node; i++)
+    ;
+  return i;
+}
+
+static void
+node_free (ChildrenNode *node)
+{
+  guint i;
+
+  for (i = 0; i < node->n; i++)
+    {
+      if (node->leaf)
+        child_unref (node, node->slots[i]);
+      else
+        node_free (node->slots[i]);
+    }
+  g_free (node);
+}
+
+/* Returns the leaf holding the child at index, and its position there.  An
+ * index equal to the number of children gives the end of the last leaf. */
+static ChildrenNode *
+locate (AtspiChildren *children, guint index, guint *pos)
+{
+  ChildrenNode *node = children->root;
+
+  while (!node->leaf)
+    {
+      guint i;
+
+      for (i = 0; i < node->n - 1; i++)
+        {
+          ChildrenNode *child = node->slots[i];
+          if (index < child->count)
+            break;
+          index -= child->count;
+        }
+      node = node->slots[i];
+    }
+  *pos = index;
+  return node;
+}
+
+static void
+insert_slot (ChildrenNode *node, guint pos, gpointer slot)
+{
+  memmove (node->slots + pos + 1, node->slots + pos,
+           (node->n - pos) * sizeof (gpointer));
+  node->slots[pos] = slot;
+  node->n++;
+  node_adopt (node, slot);
+}
+
+/* Splits node in two if it is full, keeping the counts of its ancestors */
+static void
+make_room (AtspiChildren *children, ChildrenNode *node)
+{
+  ChildrenNode *sibling;
+  guint i;
+
+  if (node->n < NODE_SIZE)
+    return;
+
+  if (!node->parent)
+    {
+      children->root = node_new (FALSE);
+      children->root->count = node->count;
+      insert_slot (children->root, 0, node);
+    }
+  make_room (children, node->parent);
+
+  sibling = node_new (node->leaf);
+  sibling->n = node->n / 2;
+  node->n -= sibling->n;
+  memcpy (sibling->slots, node->slots + node->n, sibling->n * sizeof (gpointer));
+  for (i = 0; i < sibling->n; i++)
+    {
+      node_adopt (sibling, sibling->slots[i]);
+      sibling->count += (node->leaf ? 1 : ((ChildrenNode *) sibling->slots[i])->count);
+    }
+  node->count -= sibling->count;
+  insert_slot (node->parent, node_position (node) + 1, sibling);
+}
+
+/* Removes node, which has become empty, along with any ancestors that it
+ * leaves empty, and drops levels of the tree that have a single node */
+static void
+remove_node (AtspiChildren *children, ChildrenNode *node)
+{
+  while (node->n == 0 && node->parent)
+    {
+      ChildrenNode *parent = node->parent;
+      guint pos = node_position (node);
+
+      memmove (parent->slots + pos, parent->slots + pos + 1,
+               (parent->n - pos - 1) * sizeof (gpointer));
+      parent->n--;
+      g_free (node);
+      node = parent;
+    }
+
+  while (children->root && !children->root->leaf && children->root->n == 1)
+    {
+      node = children->root;
+      children->root = node->slots[0];
+      children->root->parent = NULL;
+      g_free (node);
+    }
+  if (children->root && children->root->n == 0)
+    g_clear_pointer (&children->root, g_free);
+}
+
+void
+_atspi_children_init (AtspiChildren *children)
+{
+  children->root = NULL;
+  children->array = g_ptr_array_new ();
+}
+
+/* Removes all of the children, leaving an empty list */
+void
+_atspi_children_clear (AtspiChildren *children)
+{
+  ChildrenNode *root = children->root;
+
+  children->root = NULL;
+  g_ptr_array_set_size (children->array, 0);
+  if (root)
+    node_free (root);
+}
+
+/* Removes all of the children and frees the list */
+void
+_atspi_children_free (AtspiChildren *children)
+{
+  _atspi_children_clear (children);
+  g_clear_pointer (&children->array, g_ptr_array_unref);
+}
+
+guint
+_atspi_children_get_length (AtspiChildren *children)
+{
+  return children->array->len;
+}
+
+/* Adds NULL children or removes children from the end, like
+ * g_ptr_array_set_size() */
+void
+_atspi_children_set_length (AtspiChildren *children, guint length)
+{
+  guint len = _atspi_children_get_length (children);
+
+  while (len < length)
+    _atspi_children_insert (children, len++, NULL);
+  while (len > length)
+    _atspi_children_remove_index (children, --len);
+}
+
+/* Returns the child at index, or NULL if it is not known.  The child is
+ * not reffed. */
+AtspiAccessible *
+_atspi_children_get (AtspiChildren *children, guint index)
+{
+  if (index >= children->array->len)
+    return NULL;
+  return g_ptr_array_index (children->array, index);
+}
+
+/* Replaces the child at index, adding NULL children up to index if needed */
+void
+_atspi_children_set (AtspiChildren *children, guint index, AtspiAccessible *child)
+{
+  ChildrenNode *leaf;
+  AtspiAccessible *old_child;
+  guint pos;
+
+  if (index >= _atspi_children_get_length (children))
+    _atspi_children_set_length (children, index + 1);
+
+  leaf = locate (children, index, &pos);
+  old_child = leaf->slots[pos];
+  if (old_child == child)
+    return;
+
+  leaf->slots[pos] = child_ref (child);
+  node_adopt (leaf, child);
+  g_ptr_array_index (children->array, index) = child;
+  child_unref (leaf, old_child);
+}
+
+void
+_atspi_children_insert (AtspiChildren *children, guint index, AtspiAccessible *child)
+{
+  ChildrenNode *leaf, *node;
+  guint pos;
+
+  g_return_if_fail (index <= _atspi_children_get_length (children));
+
+  if (!children->root)
+    children->root = node_new (TRUE);
+
+  leaf = locate (children, index, &pos);
+  if (leaf->n == NODE_SIZE)
+    {
+      make_room (children, leaf);
+      if (pos > leaf->n)
+        {
+          pos -= leaf->n;
+          leaf = leaf->parent->slots[node_position (leaf) + 1];
+        }
+    }
+
+  insert_slot (leaf, pos, child_ref (child));
+  for (node = leaf; node; node = node->parent)
+    node->count++;
+  g_ptr_array_insert (children->array, index, child);
+}
+
+void
+_atspi_children_remove_index (AtspiChildren *children, guint index)
+{
+  ChildrenNode *leaf, *node;
+  AtspiAccessible *child;
+  guint pos;
+
+  g_return_if_fail (index < _atspi_children_get_length (children));
+
+  leaf = locate (children, index, &pos);
+  child = leaf->slots[pos];
+  memmove (leaf->slots + pos, leaf->slots + pos + 1,
+           (leaf->n - pos - 1) * sizeof (gpointer));
+  leaf->n--;
+  for (node = leaf; node; node = node->parent)
+    node->count--;
+  remove_node (children, leaf);
+  g_ptr_array_remove_index (children->array, index);
+
+  /* Unreffing the child may dispose it, so the tree must be consistent */
+  child_unref (leaf, child);
+}
+
+/* Removes the first occurrence of child, like g_ptr_array_remove() */
+gboolean
+_atspi_children_remove (AtspiChildren *children, AtspiAccessible *child)
+{
+  gint index = _atspi_children_index_of (children, child);
+
+  if (index < 0)
+    return FALSE;
+  _atspi_children_remove_index (children, index);
+  return TRUE;
+}
+
+static gint
+index_by_search (AtspiChildren *children, AtspiAccessible *child)
+{
+  guint i;
+
+  for (i = 0; i < children->array->len; i++)
+    if (g_ptr_array_index (children->array, i) == child)
+      return i;
+  return -1;
+}
+
+/* Returns the index of child, or -1 if it is not one of the children */
+gint
+_atspi_children_index_of (AtspiChildren *children, AtspiAccessible *child)
+{
+  ChildrenNode *leaf, *node;
+  gint index;
+  guint i;
+
+  if (!child || !child->priv->children_refs)
+    return -1;
+
+  /* An object can only be found through the leaf that it last went into;
+   * if it is also held by the children of another object, it may have to
+   * be searched for */
+  leaf = child->priv->children_leaf;
+  if (!leaf)
+    return index_by_search (children, child);
+  for (node = leaf; node->parent; node = node->parent)
+    ;
+  if (node != children->root)
+    return index_by_search (children, child);
+
+  for (i = 0; i < leaf->n && leaf->slots[i] != child; i++)
+    ;
+  if (i == leaf->n)
+    return index_by_search (children, child);
+
+  index = i;
+  for (node = leaf; node->parent; node = node->parent)
+    for (i = 0; node->parent->slots[i] != node; i++)
+      index += ((ChildrenNode *) node->parent->slots[i])->count;
+  return index;
+}
@@ -268,6 +268,247 @@ atspi_collection_get_matches_from (AtspiCollection *collection,
   return return_accessibles (reply);
 }
 
+/* Reads the byte array sent by GetTreeBlob; see collection-adaptor.c in
+ * the ATK bridge for its layout.
+ */
+#define TREE_BLOB_VERSION 1
+
+typedef struct
+{
+  const guint8 *data;
+  gint len;
+  gint pos;
+  gboolean error;
+} TreeBlob;
+
+static guint32
+blob_read_uint32 (TreeBlob *blob)
+{
+  guint32 value;
+
+  if (blob->error || blob->len - blob->pos < (gint) sizeof (value))
+    {
+      blob->error = TRUE;
+      return 0;
+    }
+  memcpy (&value, blob->data + blob->pos, sizeof (value));
+  blob->pos += sizeof (value);
+  return GUINT32_FROM_LE (value);
+}
+
+static gchar *
+blob_read_string (TreeBlob *blob)
+{
+  guint32 len = blob_read_uint32 (blob);
+  gchar *str;
+
+  if (blob->error || len > (guint32) (blob->len - blob->pos))
+    {
+      blob->error = TRUE;
+      return NULL;
+    }
+  str = g_strndup ((const gchar *) blob->data + blob->pos, len);
+  blob->pos += len;
+  return str;
+}
+
+/* The bridge never sends more children than this for one object */
+#define TREE_BLOB_MAX_CHILDREN 65536
+
+/* An object whose children are being read */
+typedef struct
+{
+  AtspiAccessible *accessible;
+  guint32 child_count;
+  guint32 n_children;
+  guint32 next;
+  gboolean managed;
+} TreeBlobFrame;
+
+/* Reads an object, filling in its cached properties, into frame.  The new
+ * reference is added to ret.  Returns FALSE if the blob is malformed.
+ */
+static gboolean
+read_tree_node (TreeBlob *blob, AtspiApplication *app, AtspiAccessible *parent, GArray *ret, TreeBlobFrame *frame)
+{
+  AtspiAccessible *accessible;
+  gchar *path, *name, *description;
+  guint32 role, states[2], child_count, n_children;
+  guint64 val;
+
+  path = blob_read_string (blob);
+  role = blob_read_uint32 (blob);
+  states[0] = blob_read_uint32 (blob);
+  states[1] = blob_read_uint32 (blob);
+  name = blob_read_string (blob);
+  description = blob_read_string (blob);
+  child_count = blob_read_uint32 (blob);
+  n_children = blob_read_uint32 (blob);
+  if (child_count > TREE_BLOB_MAX_CHILDREN || n_children > child_count)
+    blob->error = TRUE;
+  if (blob->error)
+    {
+      g_free (path);
+      g_free (name);
+      g_free (description);
+      return FALSE;
+    }
+
+  accessible = _atspi_ref_accessible (app->bus_name, path);
+  g_free (path);
+  g_array_append_val (ret, accessible);
+
+  accessible->role = role;
+  _atspi_string_set (&accessible->name, name);
+  g_free (name);
+  _atspi_string_set (&accessible->description, description);
+  g_free (description);
+  val = ((guint64) states[1]) << 32;
+  val += states[0];
+  _atspi_accessible_set_states (accessible, val);
+  _atspi_accessible_add_cache (accessible, ATSPI_CACHE_NAME | ATSPI_CACHE_ROLE |
+                                               ATSPI_CACHE_DESCRIPTION | ATSPI_CACHE_STATES);
+
+  if (parent)
+    {
+      if (accessible->accessible_parent != parent)
+        {
+          g_clear_object (&accessible->accessible_parent);
+          accessible->accessible_parent = g_object_ref (parent);
+        }
+      _atspi_accessible_add_cache (accessible, ATSPI_CACHE_PARENT);
+    }
+
+  frame->accessible = accessible;
+  frame->child_count = child_count;
+  frame->n_children = n_children;
+  frame->next = 0;
+  /* Descendants that are managed are not sent, nor counted on */
+  frame->managed = _atspi_accessible_has_state (accessible, ATSPI_STATE_MANAGES_DESCENDANTS);
+  if (frame->managed)
+    {
+      if (n_children > 0)
+        blob->error = TRUE;
+    }
+  else
+    _atspi_children_set_length (&accessible->priv->children, child_count);
+  return !blob->error;
+}
+
+/* Reads the objects in the blob, in canonical order, into ret.  The tree
+ * is walked with a stack of its own rather than by recursion, since its
+ * depth is up to the application.
+ */
+static void
+read_tree (TreeBlob *blob, AtspiApplication *app, GArray *ret)
+{
+  GArray *stack = g_array_new (FALSE, FALSE, sizeof (TreeBlobFrame));
+  TreeBlobFrame frame;
+
+  if (read_tree_node (blob, app, NULL, ret, &frame))
+    g_array_append_val (stack, frame);
+
+  while (stack->len > 0)
+    {
+      TreeBlobFrame *top = &g_array_index (stack, TreeBlobFrame, stack->len - 1);
+
+      if (top->next == top->n_children)
+        {
+          /* The children are known only if the tree was not cut off here */
+          if (!top->managed && top->n_children == top->child_count)
+            _atspi_accessible_add_cache (top->accessible, ATSPI_CACHE_CHILDREN);
+          g_array_set_size (stack, stack->len - 1);
+          continue;
+        }
+
+      if (!read_tree_node (blob, app, top->accessible, ret, &frame))
+        break;
+      _atspi_children_set (&top->accessible->priv->children, top->next, frame.accessible);
+      top->next++;
+      g_array_append_val (stack, frame);
+    }
+
+  g_array_free (stack, TRUE);
+}
+
+/**
+ * atspi_collection_get_tree:
+ * @collection: A pointer to the #AtspiCollection to query.
+ * @max_depth: The number of levels of descendants to fetch, or 0 for no
+ *             limit.
+ * @max_nodes: The maximum number of objects to fetch, or 0 for no limit.
+ *
+ * Fetches the subtree rooted at @collection in one call, and fills in the
+ * name, description, role, states, parent and children of every object in
+ * it, so that walking the subtree afterwards needs no further calls to the
+ * application.  The children of an object are only marked as cached if
+ * all of them were fetched.
+ *
+ * Returns: (element-type AtspiAccessible*) (transfer full): The objects
+ *          fetched, in canonical order, starting with @collection itself.
+ *
+ * Since: 2.56
+ **/
+GArray *
+atspi_collection_get_tree (AtspiCollection *collection,
+                           gint max_depth,
+                           gint max_nodes,
+                           GError **error)
+{
+  DBusMessage *message = new_message (collection, "GetTreeBlob");
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_array;
+  dbus_int32_t d_max_depth = max_depth;
+  dbus_int32_t d_max_nodes = max_nodes;
+  AtspiApplication *app;
+  TreeBlob blob;
+  GArray *ret;
+
+  if (!message)
+    return NULL;
+
+  dbus_message_append_args (message, DBUS_TYPE_INT32, &d_max_depth,
+                            DBUS_TYPE_INT32, &d_max_nodes,
+                            DBUS_TYPE_INVALID);
+  reply = _atspi_dbus_send_with_reply_and_block (message, error);
+  if (!reply)
+    return NULL;
+  _ATSPI_DBUS_CHECK_SIG (reply, "ay", error, NULL);
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  dbus_message_iter_get_fixed_array (&iter_array, &blob.data, &blob.len);
+  blob.pos = 0;
+  blob.error = FALSE;
+
+  app = ATSPI_ACCESSIBLE (collection)->parent.app;
+  ret = g_array_new (TRUE, TRUE, sizeof (AtspiAccessible *));
+  if (blob_read_uint32 (&blob) != TREE_BLOB_VERSION)
+    blob.error = TRUE;
+  else
+    {
+      guint32 n_nodes = blob_read_uint32 (&blob);
+      if (!blob.error)
+        read_tree (&blob, app, ret);
+      if (!blob.error && ret->len != n_nodes)
+        blob.error = TRUE;
+    }
+  dbus_message_unref (reply);
+
+  if (blob.error)
+    {
+      guint i;
+
+      for (i = 0; i < ret->len; i++)
+        g_object_unref (g_array_index (ret, AtspiAccessible *, i));
+      g_array_free (ret, TRUE);
+      g_set_error_literal (error, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                           "The application sent a malformed tree");
+      return NULL;
+    }
+  return ret;
+}
+
 /**
  * atspi_collection_get_active_descendant:
  *
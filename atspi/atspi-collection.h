@@ -55,6 +55,8 @@ GArray *atspi_collection_get_matches_to (AtspiCollection *collection, AtspiAcces
 
 GArray *atspi_collection_get_matches_from (AtspiCollection *collection, AtspiAccessible *current_object, AtspiMatchRule *rule, AtspiCollectionSortOrder sortby, AtspiCollectionTreeTraversalType tree, gint count, gboolean traverse, GError **error);
 
+GArray *atspi_collection_get_tree (AtspiCollection *collection, gint max_depth, gint max_nodes, GError **error);
+
 AtspiAccessible *atspi_collection_get_active_descendant (AtspiCollection *collection, GError **error);
 
 G_END_DECLS
@@ -35,6 +35,7 @@ G_BEGIN_DECLS
 void _atspi_send_event (AtspiEvent *e);
 
 void _atspi_dbus_handle_event (DBusMessage *message);
+void _atspi_init_event_kinds (void);
 void _atspi_reregister_event_listeners ();
 
 G_END_DECLS
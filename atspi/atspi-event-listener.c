@@ -51,6 +51,10 @@ typedef struct
   char *detail;
   GArray *properties;
   AtspiAccessible *app;
+  guint serial;      /* order of registration, newest highest */
+  gboolean shared;   /* passed the event itself rather than a copy */
+  gboolean removed;  /* deregistered while an event was being sent */
+  GPtrArray *slot;   /* the listener_index list that holds the entry */
 } EventListenerEntry;
 
 G_DEFINE_TYPE (AtspiEventListener, atspi_event_listener, G_TYPE_OBJECT)
@@ -181,19 +185,127 @@ atspi_event_listener_new_simple (AtspiEventListenerSimpleCB callback,
 static GList *event_listeners = NULL;
 static GList *pending_removals = NULL;
 static int in_send = 0;
+static guint listener_serial = 0;
 
-static gchar *
-convert_name_from_dbus (const char *name, gboolean path_hack)
+/*
+ * Listeners are also indexed by the D-Bus category and name of their
+ * event type ("Object", "StateChanged"), with the listeners for any name
+ * of a category under "".  Event types are split on ':', so the detail of
+ * a listener, like that of an event, is a single segment; each node keeps
+ * the listeners without a detail in "any" and the others by detail.
+ */
+typedef struct _ListenerNode ListenerNode;
+struct _ListenerNode
 {
-  gchar *ret;
-  const char *p = name;
-  gchar *q;
+  GPtrArray *any;
+  GHashTable *details; /* detail -> GPtrArray */
+};
+
+static GHashTable *listener_index; /* category -> name -> ListenerNode */
+
+static ListenerNode *
+listener_index_lookup (const char *category, const char *name, gboolean create)
+{
+  GHashTable *names;
+  ListenerNode *node;
 
   if (!name)
-    return g_strdup ("");
+    name = "";
+  if (!listener_index)
+    {
+      if (!create)
+        return NULL;
+      listener_index = g_hash_table_new (g_str_hash, g_str_equal);
+    }
 
-  ret = g_malloc (g_utf8_strlen (name, -1) * 2 + 1);
-  q = ret;
+  names = g_hash_table_lookup (listener_index, category);
+  if (!names)
+    {
+      if (!create)
+        return NULL;
+      names = g_hash_table_new (g_str_hash, g_str_equal);
+      g_hash_table_insert (listener_index, (gpointer) g_intern_string (category), names);
+    }
+
+  node = g_hash_table_lookup (names, name);
+  if (!node && create)
+    {
+      node = g_new0 (ListenerNode, 1);
+      g_hash_table_insert (names, (gpointer) g_intern_string (name), node);
+    }
+  return node;
+}
+
+static void
+listener_index_add (EventListenerEntry *e)
+{
+  ListenerNode *node = listener_index_lookup (e->category, e->name, TRUE);
+  GPtrArray *slot;
+
+  if (e->detail && e->detail[0])
+    {
+      if (!node->details)
+        node->details = g_hash_table_new (g_str_hash, g_str_equal);
+      slot = g_hash_table_lookup (node->details, e->detail);
+      if (!slot)
+        {
+          slot = g_ptr_array_new ();
+          g_hash_table_insert (node->details, (gpointer) g_intern_string (e->detail), slot);
+        }
+    }
+  else
+    {
+      if (!node->any)
+        node->any = g_ptr_array_new ();
+      slot = node->any;
+    }
+
+  g_ptr_array_add (slot, e);
+  e->slot = slot;
+}
+
+static void
+listener_index_remove (EventListenerEntry *e)
+{
+  if (e->slot)
+    g_ptr_array_remove (e->slot, e);
+  e->slot = NULL;
+}
+
+static void
+add_listeners (GPtrArray **matches, GPtrArray *listeners)
+{
+  guint i;
+
+  if (!listeners || !listeners->len)
+    return;
+  if (!*matches)
+    *matches = g_ptr_array_sized_new (listeners->len);
+  for (i = 0; i < listeners->len; i++)
+    g_ptr_array_add (*matches, g_ptr_array_index (listeners, i));
+}
+
+/* Adds the listeners in node whose detail matches that of an event */
+static void
+collect_listeners (GPtrArray **matches, ListenerNode *node, const char *detail)
+{
+  if (!node)
+    return;
+  add_listeners (matches, node->any);
+  if (detail && detail[0] && node->details)
+    add_listeners (matches, g_hash_table_lookup (node->details, detail));
+}
+
+/*
+ * Writes the AT-SPI form of a D-Bus name (eg, "StateChanged" ->
+ * "state-changed") to ret, which must have room for twice the length of
+ * name plus one bytes.  Returns ret.
+ */
+static gchar *
+convert_name_from_dbus_to_buffer (const char *name, gboolean path_hack, gchar *ret)
+{
+  const char *p = name;
+  gchar *q = ret;
 
   while (*p)
     {
@@ -215,6 +327,16 @@ convert_name_from_dbus (const char *name, gboolean path_hack)
   return ret;
 }
 
+static gchar *
+convert_name_from_dbus (const char *name, gboolean path_hack)
+{
+  if (!name)
+    return g_strdup ("");
+
+  return convert_name_from_dbus_to_buffer (name, path_hack,
+                                           g_malloc (strlen (name) * 2 + 1));
+}
+
 static void
 cache_process_children_changed (AtspiEvent *event)
 {
@@ -222,7 +344,7 @@ cache_process_children_changed (AtspiEvent *event)
 
   if (!G_VALUE_HOLDS (&event->any_data, ATSPI_TYPE_ACCESSIBLE) ||
       !(event->source->cached_properties & ATSPI_CACHE_CHILDREN) ||
-      atspi_state_set_contains (event->source->states, ATSPI_STATE_MANAGES_DESCENDANTS))
+      _atspi_accessible_has_state (event->source, ATSPI_STATE_MANAGES_DESCENDANTS))
     return;
 
   child = g_value_get_object (&event->any_data);
@@ -231,22 +353,17 @@ cache_process_children_changed (AtspiEvent *event)
 
   if (!strncmp (event->type, "object:children-changed:add", 27))
     {
-      g_ptr_array_remove (event->source->children, child); /* just to be safe */
-      if (event->detail1 < 0 || event->detail1 > event->source->children->len)
+      _atspi_children_remove (&event->source->priv->children, child); /* just to be safe */
+      if (event->detail1 < 0 || event->detail1 > _atspi_children_get_length (&event->source->priv->children))
         {
           event->source->cached_properties &= ~ATSPI_CACHE_CHILDREN;
           return;
         }
-      /* Unfortunately, there's no g_ptr_array_insert or similar */
-      g_ptr_array_add (event->source->children, NULL);
-      memmove (event->source->children->pdata + event->detail1 + 1,
-               event->source->children->pdata + event->detail1,
-               (event->source->children->len - event->detail1 - 1) * sizeof (gpointer));
-      g_ptr_array_index (event->source->children, event->detail1) = g_object_ref (child);
+      _atspi_children_insert (&event->source->priv->children, event->detail1, child);
     }
   else
     {
-      g_ptr_array_remove (event->source->children, child);
+      _atspi_children_remove (&event->source->priv->children, child);
       if (child == child->parent.app->root)
         g_object_run_dispose (G_OBJECT (child->parent.app));
     }
@@ -272,31 +389,27 @@ cache_process_property_change (AtspiEvent *event)
     }
   else if (!strcmp (event->type, "object:property-change:accessible-name"))
     {
-      if (event->source->name)
-        g_free (event->source->name);
       if (G_VALUE_HOLDS_STRING (&event->any_data))
         {
-          event->source->name = g_value_dup_string (&event->any_data);
+          _atspi_string_set (&event->source->name, g_value_get_string (&event->any_data));
           _atspi_accessible_add_cache (event->source, ATSPI_CACHE_NAME);
         }
       else
         {
-          event->source->name = NULL;
+          _atspi_string_set (&event->source->name, NULL);
           event->source->cached_properties &= ~ATSPI_CACHE_NAME;
         }
     }
   else if (!strcmp (event->type, "object:property-change:accessible-description"))
     {
-      if (event->source->description)
-        g_free (event->source->description);
       if (G_VALUE_HOLDS_STRING (&event->any_data))
         {
-          event->source->description = g_value_dup_string (&event->any_data);
+          _atspi_string_set (&event->source->description, g_value_get_string (&event->any_data));
           _atspi_accessible_add_cache (event->source, ATSPI_CACHE_DESCRIPTION);
         }
       else
         {
-          event->source->description = NULL;
+          _atspi_string_set (&event->source->description, NULL);
           event->source->cached_properties &= ~ATSPI_CACHE_DESCRIPTION;
         }
     }
@@ -317,9 +430,8 @@ cache_process_property_change (AtspiEvent *event)
 static void
 cache_process_state_changed (AtspiEvent *event)
 {
-  if (event->source->states)
-    atspi_state_set_set_by_name (event->source->states, event->type + 21,
-                                 event->detail1);
+  _atspi_accessible_set_state_by_name (event->source, event->type + 21,
+                                       event->detail1);
 }
 
 static void
@@ -337,7 +449,7 @@ cache_process_attributes_changed (AtspiEvent *event)
   if (name && name[0] && value && value[0])
     {
       g_hash_table_remove (event->source->attributes, name);
-      g_hash_table_insert (event->source->attributes, g_strdup (name), g_strdup (value));
+      g_hash_table_insert (event->source->attributes, _atspi_string_intern (name), _atspi_string_intern (value));
     }
   else
     {
@@ -346,6 +458,195 @@ cache_process_attributes_changed (AtspiEvent *event)
     }
 }
 
+static void
+cache_process_focus (AtspiEvent *event)
+{
+  /* BGO#663992 - TODO: figure out the real problem */
+  event->source->cached_properties &= ~(ATSPI_CACHE_STATES);
+}
+
+typedef void (*EventCacheFunc) (AtspiEvent *event);
+
+/*
+ * What is known about the events that arrive with a given D-Bus interface
+ * and member, so that they can be turned into AtspiEvents without building
+ * the event type from the D-Bus names every time.
+ */
+typedef struct
+{
+  gchar *type;                  /* the event type when there is no detail */
+  gsize prefix_len;             /* the length of type that a detail follows */
+  EventCacheFunc process_cache; /* updates the cache, or NULL */
+  gboolean screen_reader;
+} EventKind;
+
+/*
+ * Members of the event interfaces in xml/Event.xml, whose kinds are set up
+ * by atspi_init.  Other members get a kind the first time they are seen.
+ */
+static const char *object_event_members[] = {
+  "PropertyChange", "BoundsChanged", "LinkSelected", "StateChanged",
+  "ChildrenChanged", "VisibleDataChanged", "SelectionChanged",
+  "ModelChanged", "ActiveDescendantChanged", "Announcement",
+  "AttributesChanged", "RowInserted", "RowReordered", "RowDeleted",
+  "ColumnInserted", "ColumnReordered", "ColumnDeleted", "TextBoundsChanged",
+  "TextSelectionChanged", "TextChanged", "TextAttributesChanged",
+  "TextCaretMoved", NULL
+};
+
+static const char *window_event_members[] = {
+  "PropertyChange", "Minimize", "Maximize", "Restore", "Close", "Create",
+  "Reparent", "DesktopCreate", "DesktopDestroy", "Destroy", "Activate",
+  "Deactivate", "Raise", "Lower", "Move", "Resize", "Shade", "Unshade",
+  "Restyle", NULL
+};
+
+static const char *mouse_event_members[] = {
+  "Abs", "Rel", "Button", NULL
+};
+
+static const char *keyboard_event_members[] = {
+  "Modifiers", NULL
+};
+
+static const char *terminal_event_members[] = {
+  "LineChanged", "ColumncountChanged", "LinecountChanged",
+  "ApplicationChanged", "CharwidthChanged", NULL
+};
+
+static const char *document_event_members[] = {
+  "LoadComplete", "Reload", "LoadStopped", "ContentChanged",
+  "AttributesChanged", "PageChanged", NULL
+};
+
+static const char *focus_event_members[] = {
+  "Focus", NULL
+};
+
+static const struct
+{
+  const char *interface;
+  const char **members;
+} event_vocabulary[] = {
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, object_event_members },
+  { "org.a11y.atspi.Event.Window", window_event_members },
+  { ATSPI_DBUS_INTERFACE_EVENT_MOUSE, mouse_event_members },
+  { ATSPI_DBUS_INTERFACE_EVENT_KEYBOARD, keyboard_event_members },
+  { "org.a11y.atspi.Event.Terminal", terminal_event_members },
+  { "org.a11y.atspi.Event.Document", document_event_members },
+  { "org.a11y.atspi.Event.Focus", focus_event_members },
+};
+
+static GHashTable *event_kinds; /* interface -> member -> EventKind */
+
+static EventCacheFunc
+cache_func_for_type (const char *type)
+{
+  if (!strncmp (type, "object:children-changed", 23))
+    return cache_process_children_changed;
+  else if (!strncmp (type, "object:property-change", 22))
+    return cache_process_property_change;
+  else if (!strncmp (type, "object:state-changed", 20))
+    return cache_process_state_changed;
+  else if (!strncmp (type, "object:attributes-changed", 25))
+    return cache_process_attributes_changed;
+  else if (!strncmp (type, "focus", 5))
+    return cache_process_focus;
+  return NULL;
+}
+
+static EventKind *
+event_kind_new (const char *interface, const char *member)
+{
+  EventKind *kind = g_new0 (EventKind, 1);
+  const char *category;
+  gchar *converted_type;
+  gchar *name;
+
+  /* Find the plain interface name, e.g. "org.a11y.atspi.Event.ScreenReader" -> "ScreenReader" */
+  category = g_utf8_strrchr (interface, -1, '.');
+  g_assert (category != NULL);
+  category++;
+
+  converted_type = convert_name_from_dbus (category, FALSE);
+  name = convert_name_from_dbus (member, FALSE);
+
+  if (strcasecmp (category, name) != 0)
+    {
+      kind->type = g_strconcat (converted_type, ":", name, NULL);
+      kind->prefix_len = strlen (kind->type);
+    }
+  else
+    {
+      kind->type = g_strconcat (converted_type, ":", NULL);
+      kind->prefix_len = strlen (converted_type);
+    }
+  kind->process_cache = cache_func_for_type (kind->type);
+  kind->screen_reader = !strcmp (category, "ScreenReader");
+
+  g_free (converted_type);
+  g_free (name);
+  return kind;
+}
+
+static void
+event_kind_free (EventKind *kind)
+{
+  g_free (kind->type);
+  g_free (kind);
+}
+
+/* Returns the kind of an event in event_vocabulary, or NULL for any other
+ * event; those are rare, and their kinds are built for each signal rather
+ * than kept, since their members are up to the sender.
+ */
+static const EventKind *
+lookup_event_kind (const char *interface, const char *member)
+{
+  GHashTable *members;
+
+  if (!event_kinds)
+    _atspi_init_event_kinds ();
+
+  members = g_hash_table_lookup (event_kinds, interface);
+  return (members ? g_hash_table_lookup (members, member) : NULL);
+}
+
+static void
+add_event_kind (const char *interface, const char *member)
+{
+  GHashTable *members = g_hash_table_lookup (event_kinds, interface);
+
+  if (!members)
+    {
+      members = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify) event_kind_free);
+      g_hash_table_insert (event_kinds, g_strdup (interface), members);
+    }
+  g_hash_table_insert (members, g_strdup (member),
+                       event_kind_new (interface, member));
+}
+
+/*
+ * Sets up the kinds of the events in event_vocabulary.  Called from
+ * atspi_init.
+ */
+void
+_atspi_init_event_kinds (void)
+{
+  guint i, j;
+
+  if (event_kinds)
+    return;
+
+  event_kinds = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                       (GDestroyNotify) g_hash_table_unref);
+  for (i = 0; i < G_N_ELEMENTS (event_vocabulary); i++)
+    for (j = 0; event_vocabulary[i].members[j]; j++)
+      add_event_kind (event_vocabulary[i].interface,
+                      event_vocabulary[i].members[j]);
+}
+
 static dbus_bool_t
 demarshal_rect (DBusMessageIter *iter, AtspiRect *rect)
 {
@@ -441,6 +742,61 @@ convert_event_type_to_dbus (const char *eventType, char **categoryp, char **name
   return TRUE;
 }
 
+/* Like convert_event_type_to_dbus, but splits the type in buf rather than
+ * in newly allocated strings.  Returns FALSE if buf is too small.
+ */
+static gboolean
+split_event_type (const char *event_type, gchar *buf, gsize size, gchar **categoryp, gchar **namep, gchar **detailp)
+{
+  const char *p = event_type;
+  gchar *q = buf;
+  gchar *saveptr = NULL;
+  gboolean upper = FALSE;
+  int parts = 0;
+
+  if (strlen (event_type) >= size)
+    return FALSE;
+
+  /* The adjustments of _atspi_strdup_and_adjust_for_dbus */
+  for (; *p; p++)
+    {
+      if (*p == '-')
+        {
+          p++;
+          if (!*p)
+            break;
+          *q++ = toupper (*p);
+        }
+      else if (*p == ':')
+        {
+          *q++ = ':';
+          if (++parts == 2)
+            {
+              strcpy (q, p + 1);
+              q += strlen (q);
+              break;
+            }
+          upper = TRUE;
+          continue;
+        }
+      else
+        *q++ = (upper ? toupper (*p) : *p);
+      upper = FALSE;
+    }
+  *q = '\0';
+  buf[0] = toupper (buf[0]);
+
+  *categoryp = strtok_r (buf, ":", &saveptr);
+  *namep = NULL;
+  *detailp = NULL;
+  if (!*categoryp)
+    return FALSE;
+  *namep = strtok_r (NULL, ":", &saveptr);
+  if (*namep)
+    *detailp = strtok_r (NULL, ":", &saveptr);
+  return TRUE;
+}
+
 static void
 listener_entry_free (EventListenerEntry *e)
 {
@@ -727,27 +1083,15 @@ atspi_event_listener_register_from_callback_full (AtspiEventListenerCB callback,
                                                                NULL, error);
 }
 
-/**
- * atspi_event_listener_register_from_callback_with_app:
- * @callback: (scope async): an #AtspiEventListenerCB function pointer.
- * @user_data: (closure callback)
- * @callback_destroyed: (destroy callback)
- * @event_type:
- * @properties: (element-type utf8)
- * @app: (allow-none)
- * @error:
- *
- * Returns: #TRUE if successful, otherwise #FALSE.
- *
- **/
-gboolean
-atspi_event_listener_register_from_callback_with_app (AtspiEventListenerCB callback,
-                                                      void *user_data,
-                                                      GDestroyNotify callback_destroyed,
-                                                      const gchar *event_type,
-                                                      GArray *properties,
-                                                      AtspiAccessible *app,
-                                                      GError **error)
+static gboolean
+register_listener (AtspiEventListenerCB callback,
+                   void *user_data,
+                   GDestroyNotify callback_destroyed,
+                   const gchar *event_type,
+                   GArray *properties,
+                   AtspiAccessible *app,
+                   gboolean shared,
+                   GError **error)
 {
   EventListenerEntry *e;
   DBusError d_error;
@@ -781,7 +1125,10 @@ atspi_event_listener_register_from_callback_with_app (AtspiEventListenerCB callb
   if (app)
     e->app = g_object_ref (app);
   e->properties = copy_event_properties (properties);
+  e->serial = ++listener_serial;
+  e->shared = shared;
   event_listeners = g_list_prepend (event_listeners, e);
+  listener_index_add (e);
   for (i = 0; i < matchrule_array->len; i++)
     {
       char *matchrule = g_ptr_array_index (matchrule_array, i);
@@ -802,6 +1149,70 @@ atspi_event_listener_register_from_callback_with_app (AtspiEventListenerCB callb
   return TRUE;
 }
 
+/**
+ * atspi_event_listener_register_from_callback_with_app:
+ * @callback: (scope async): an #AtspiEventListenerCB function pointer.
+ * @user_data: (closure callback)
+ * @callback_destroyed: (destroy callback)
+ * @event_type:
+ * @properties: (element-type utf8)
+ * @app: (allow-none)
+ * @error:
+ *
+ * Returns: #TRUE if successful, otherwise #FALSE.
+ *
+ **/
+gboolean
+atspi_event_listener_register_from_callback_with_app (AtspiEventListenerCB callback,
+                                                      void *user_data,
+                                                      GDestroyNotify callback_destroyed,
+                                                      const gchar *event_type,
+                                                      GArray *properties,
+                                                      AtspiAccessible *app,
+                                                      GError **error)
+{
+  return register_listener (callback, user_data, callback_destroyed,
+                            event_type, properties, app, FALSE, error);
+}
+
+/**
+ * atspi_event_listener_register_from_callback_shared: (skip)
+ * @callback: (scope notified): the #AtspiEventListenerCB to be registered
+ * against an event type.
+ * @user_data: (closure): User data to be passed to the callback.
+ * @callback_destroyed: A #GDestroyNotify called when the callback is destroyed.
+ * @event_type: a character string indicating the type of events for which
+ *            notification is requested.  See #atspi_event_listener_register
+ * for a description of the format.
+ * @properties: (element-type utf8) (allow-none): a list of properties that
+ *             should be sent along with the event.
+ * @app: (allow-none): the application whose events should be reported, or
+ *      %null for all applications.
+ *
+ * Registers an #AtspiEventListenerCB against an @event_type, like
+ * atspi_event_listener_register_from_callback_with_app(), except that
+ * @callback is passed the event that is being sent to every listener
+ * instead of a copy of its own.  The event is only valid until @callback
+ * returns, and must be neither modified nor freed; use g_boxed_copy() to
+ * keep it.
+ *
+ * Returns: #TRUE if successful, otherwise #FALSE.
+ *
+ * Since: 2.56
+ **/
+gboolean
+atspi_event_listener_register_from_callback_shared (AtspiEventListenerCB callback,
+                                                    void *user_data,
+                                                    GDestroyNotify callback_destroyed,
+                                                    const gchar *event_type,
+                                                    GArray *properties,
+                                                    AtspiAccessible *app,
+                                                    GError **error)
+{
+  return register_listener (callback, user_data, callback_destroyed,
+                            event_type, properties, app, TRUE, error);
+}
+
 void
 _atspi_reregister_event_listeners ()
 {
@@ -919,6 +1330,8 @@ atspi_event_listener_deregister_from_callback (AtspiEventListenerCB callback,
         {
           DBusMessage *message, *reply;
           l = g_list_next (l);
+          listener_index_remove (e);
+          e->removed = TRUE;
           if (in_send)
             {
               pending_removals = g_list_remove (pending_removals, e);
@@ -1005,21 +1418,6 @@ atspi_event_free (AtspiEvent *event)
   g_free (event);
 }
 
-static gboolean
-detail_matches_listener (const char *event_detail, const char *listener_detail)
-{
-  if (!listener_detail)
-    return TRUE;
-
-  if (!event_detail)
-    return (listener_detail ? FALSE : TRUE);
-
-  return !(listener_detail[strcspn (listener_detail, ":")] == '\0'
-               ? strncmp (listener_detail, event_detail,
-                          strcspn (event_detail, ":"))
-               : strcmp (listener_detail, event_detail));
-}
-
 static void
 resolve_pending_removal (gpointer data)
 {
@@ -1027,12 +1425,25 @@ resolve_pending_removal (gpointer data)
   listener_entry_free (data);
 }
 
+static gint
+compare_listener_serials (gconstpointer a, gconstpointer b)
+{
+  const EventListenerEntry *ea = *(EventListenerEntry **) a;
+  const EventListenerEntry *eb = *(EventListenerEntry **) b;
+
+  /* Newest first, the order in which they were always called */
+  return (ea->serial < eb->serial) - (ea->serial > eb->serial);
+}
+
 void
 _atspi_send_event (AtspiEvent *e)
 {
+  gchar buf[256];
+  gchar *tmp = NULL;
+  gsize size;
   char *category, *name, *detail;
-  GList *l;
-  GList *called_listeners = NULL;
+  GPtrArray *matches = NULL;
+  guint i, j;
 
   /* Ensure that the value is set to avoid a Python exception */
   /* TODO: Figure out how to do this without using a private field */
@@ -1042,65 +1453,74 @@ _atspi_send_event (AtspiEvent *e)
       g_value_set_int (&e->any_data, 0);
     }
 
-  if (!convert_event_type_to_dbus (e->type, &category, &name, &detail, NULL,
-                                   NULL))
+  size = (e->type ? strlen (e->type) + 1 : 0);
+  if (!size ||
+      !split_event_type (e->type, size <= sizeof (buf) ? buf : (tmp = g_malloc (size)),
+                         MAX (size, sizeof (buf)), &category, &name, &detail))
     {
       g_warning ("AT-SPI: Couldn't parse event: %s\n", e->type);
+      g_free (tmp);
       return;
     }
+
+  if (name)
+    collect_listeners (&matches, listener_index_lookup (category, name, FALSE), detail);
+  collect_listeners (&matches, listener_index_lookup (category, NULL, FALSE), detail);
+  g_free (tmp);
+  if (!matches)
+    return;
+
+  g_ptr_array_sort (matches, compare_listener_serials);
   in_send++;
-  for (l = event_listeners; l; l = g_list_next (l))
+  for (i = 0; i < matches->len; i++)
     {
-      EventListenerEntry *entry = l->data;
-      if (!strcmp (category, entry->category) &&
-          (entry->name == NULL || !strcmp (name, entry->name)) &&
-          detail_matches_listener (detail, entry->detail) &&
-          (entry->app == NULL || !strcmp (entry->app->parent.app->bus_name,
-                                          e->source->parent.app->bus_name)))
+      EventListenerEntry *entry = g_ptr_array_index (matches, i);
+
+      if (entry->removed ||
+          (entry->app && strcmp (entry->app->parent.app->bus_name,
+                                 e->source->parent.app->bus_name) != 0))
         {
-          GList *l2;
-          for (l2 = called_listeners; l2; l2 = l2->next)
-            {
-              EventListenerEntry *e2 = l2->data;
-              if (entry->callback == e2->callback && entry->user_data == e2->user_data)
-                break;
-            }
-          if (!l2)
-            {
-              for (l2 = pending_removals; l2; l2 = l2->next)
-                {
-                  if (l2->data == entry)
-                    break;
-                }
-            }
-          if (!l2)
-            {
-              entry->callback (atspi_event_copy (e), entry->user_data);
-              called_listeners = g_list_prepend (called_listeners, entry);
-            }
+          g_ptr_array_index (matches, i) = NULL;
+          continue;
+        }
+
+      /* Call each callback only once, even if registered more than once */
+      for (j = 0; j < i; j++)
+        {
+          EventListenerEntry *e2 = g_ptr_array_index (matches, j);
+          if (e2 && entry->callback == e2->callback && entry->user_data == e2->user_data)
+            break;
+        }
+      if (j < i)
+        {
+          g_ptr_array_index (matches, i) = NULL;
+          continue;
         }
+
+      entry->callback (entry->shared ? e : atspi_event_copy (e), entry->user_data);
     }
   in_send--;
-  if (detail)
-    g_free (detail);
-  g_free (name);
-  g_free (category);
-  g_list_free (called_listeners);
+  g_ptr_array_free (matches, TRUE);
 
-  g_list_free_full (pending_removals, resolve_pending_removal);
-  pending_removals = NULL;
+  if (!in_send)
+    {
+      g_list_free_full (pending_removals, resolve_pending_removal);
+      pending_removals = NULL;
+    }
 }
 
 void
 _atspi_dbus_handle_event (DBusMessage *message)
 {
   char *detail = NULL;
-  const char *category = dbus_message_get_interface (message);
+  const char *interface = dbus_message_get_interface (message);
   const char *sender = dbus_message_get_sender (message);
   const char *member = dbus_message_get_member (message);
   const char *signature = dbus_message_get_signature (message);
-  gchar *name;
-  gchar *converted_type;
+  const EventKind *kind;
+  EventKind *unlisted_kind = NULL;
+  gchar type_buf[256];
+  gchar *type_alloc = NULL;
   DBusMessageIter iter, iter_variant;
   dbus_message_iter_init (message, &iter);
   AtspiEvent e;
@@ -1108,21 +1528,20 @@ _atspi_dbus_handle_event (DBusMessage *message)
   char *p;
   GHashTable *cache = NULL;
 
-  g_assert (strncmp (category, "org.a11y.atspi.Event.", 21) == 0);
+  g_assert (strncmp (interface, "org.a11y.atspi.Event.", 21) == 0);
 
   if (strcmp (signature, "siiv(so)") != 0 &&
       strcmp (signature, "siiva{sv}") != 0)
     {
-      g_warning ("Got invalid signature %s for signal %s from interface %s\n", signature, member, category);
+      g_warning ("Got invalid signature %s for signal %s from interface %s\n", signature, member, interface);
       return;
     }
 
   memset (&e, 0, sizeof (e));
 
-  /* Find the plain interface name, e.g. "org.a11y.atspi.Event.ScreenReader" -> "ScreenReader" */
-  category = g_utf8_strrchr (category, -1, '.');
-  g_assert (category != NULL);
-  category++;
+  kind = lookup_event_kind (interface, member);
+  if (!kind)
+    kind = unlisted_kind = event_kind_new (interface, member);
 
   dbus_message_iter_get_basic (&iter, &detail);
   dbus_message_iter_next (&iter);
@@ -1133,39 +1552,31 @@ _atspi_dbus_handle_event (DBusMessage *message)
   e.detail2 = detail2;
   dbus_message_iter_next (&iter);
 
-  converted_type = convert_name_from_dbus (category, FALSE);
-  name = convert_name_from_dbus (member, FALSE);
-  detail = convert_name_from_dbus (detail, TRUE);
-
-  if (strcasecmp (category, name) != 0)
-    {
-      p = g_strconcat (converted_type, ":", name, NULL);
-      g_free (converted_type);
-      converted_type = p;
-    }
-  else if (detail[0] == '\0')
+  if (detail[0] == '\0')
+    e.type = kind->type;
+  else
     {
-      p = g_strconcat (converted_type, ":", NULL);
-      g_free (converted_type);
-      converted_type = p;
-    }
+      gsize size = kind->prefix_len + strlen (detail) * 2 + 2;
 
-  if (detail[0] != '\0')
-    {
-      p = g_strconcat (converted_type, ":", detail, NULL);
-      g_free (converted_type);
-      converted_type = p;
+      if (size <= sizeof (type_buf))
+        e.type = type_buf;
+      else
+        e.type = type_alloc = g_malloc (size);
+      memcpy (e.type, kind->type, kind->prefix_len);
+      e.type[kind->prefix_len] = ':';
+      convert_name_from_dbus_to_buffer (detail, TRUE,
+                                        e.type + kind->prefix_len + 1);
     }
-  e.type = converted_type;
-  if (strcmp (category, "ScreenReader") != 0)
+
+  if (!kind->screen_reader)
     {
       e.source = _atspi_ref_accessible (sender, dbus_message_get_path (message));
       if (e.source == NULL)
         {
-          g_warning ("Got no valid source accessible for signal %s from interface %s\n", member, category);
-          g_free (converted_type);
-          g_free (name);
-          g_free (detail);
+          g_warning ("Got no valid source accessible for signal %s from interface %s\n", member, interface);
+          g_free (type_alloc);
+          if (unlisted_kind)
+            event_kind_free (unlisted_kind);
           return;
         }
     }
@@ -1185,7 +1596,7 @@ _atspi_dbus_handle_event (DBusMessage *message)
           {
             AtspiAccessible *accessible;
             accessible = _atspi_dbus_consume_accessible (&iter_variant);
-            if (!strcmp (category, "ScreenReader"))
+            if (kind->screen_reader)
               {
                 g_object_unref (e.source);
                 e.source = accessible;
@@ -1222,36 +1633,17 @@ _atspi_dbus_handle_event (DBusMessage *message)
 
   e.sender = _atspi_ref_accessible (sender, ATSPI_DBUS_PATH_ROOT);
 
-  if (!strncmp (e.type, "object:children-changed", 23))
-    {
-      cache_process_children_changed (&e);
-    }
-  else if (!strncmp (e.type, "object:property-change", 22))
-    {
-      cache_process_property_change (&e);
-    }
-  else if (!strncmp (e.type, "object:state-changed", 20))
-    {
-      cache_process_state_changed (&e);
-    }
-  else if (!strncmp (e.type, "object:attributes-changed", 25))
-    {
-      cache_process_attributes_changed (&e);
-    }
-  else if (!strncmp (e.type, "focus", 5))
-    {
-      /* BGO#663992 - TODO: figure out the real problem */
-      e.source->cached_properties &= ~(ATSPI_CACHE_STATES);
-    }
+  if (kind->process_cache)
+    kind->process_cache (&e);
 
   _atspi_send_event (&e);
 
   if (cache)
     _atspi_accessible_unref_cache (e.source);
 
-  g_free (converted_type);
-  g_free (name);
-  g_free (detail);
+  g_free (type_alloc);
+  if (unlisted_kind)
+    event_kind_free (unlisted_kind);
   g_object_unref (e.source);
   g_object_unref (e.sender);
   g_value_unset (&e.any_data);
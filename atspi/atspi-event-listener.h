@@ -129,6 +129,15 @@ atspi_event_listener_register_from_callback_with_app (AtspiEventListenerCB callb
                                                       AtspiAccessible *app,
                                                       GError **error);
 
+gboolean
+atspi_event_listener_register_from_callback_shared (AtspiEventListenerCB callback,
+                                                    void *user_data,
+                                                    GDestroyNotify callback_destroyed,
+                                                    const gchar *event_type,
+                                                    GArray *properties,
+                                                    AtspiAccessible *app,
+                                                    GError **error);
+
 gboolean
 atspi_event_listener_register_no_data (AtspiEventListenerSimpleCB callback,
                                        GDestroyNotify callback_destroyed,
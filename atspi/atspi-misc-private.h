@@ -97,10 +97,28 @@ dbus_bool_t _atspi_dbus_get_property (gpointer obj, const char *interface, const
 
 DBusMessage *_atspi_dbus_send_with_reply_and_block (DBusMessage *message, GError **error);
 
+DBusMessage *_atspi_dbus_send_with_reply_and_block_full (DBusMessage *message, DBusError *err);
+
+typedef void (*AtspiAsyncReplyFunc) (GTask *task, DBusMessage *reply);
+
+GTask *_atspi_task_new (gpointer source_object, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+
+void _atspi_dbus_send_async (DBusMessage *message, GTask *task, AtspiAsyncReplyFunc handler);
+
+void _atspi_dbus_call_async (GTask *task, const char *interface, const char *method, AtspiAsyncReplyFunc handler, const char *type, ...);
+
+void _atspi_dbus_get_property_async (GTask *task, const char *interface, const char *name, AtspiAsyncReplyFunc handler);
+
+gboolean _atspi_dbus_property_reply_init (DBusMessage *reply, GTask *task, const char *type, DBusMessageIter *iter_variant);
+
 GHashTable *_atspi_dbus_return_hash_from_message (DBusMessage *message);
 
 GHashTable *_atspi_dbus_hash_from_iter (DBusMessageIter *iter);
 
+GHashTable *_atspi_dbus_return_interned_hash_from_message (DBusMessage *message);
+
+GHashTable *_atspi_dbus_interned_hash_from_iter (DBusMessageIter *iter);
+
 GArray *_atspi_dbus_return_attribute_array_from_message (DBusMessage *message);
 
 GArray *_atspi_dbus_attribute_array_from_iter (DBusMessageIter *iter);
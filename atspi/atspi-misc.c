@@ -181,7 +181,7 @@ _gettext_initialization (void)
     }
 }
 
-static void handle_get_items (DBusPendingCall *pending, void *user_data);
+static void request_cache_items (AtspiApplication *app);
 
 static DBusConnection *bus = NULL;
 static GHashTable *live_refs = NULL;
@@ -316,9 +316,9 @@ cleanup ()
     goto end;
 
   /* TODO: Do we need this code, or should we just dispose the desktop? */
-  for (i = desktop->children->len - 1; i >= 0; i--)
+  for (i = _atspi_children_get_length (&desktop->priv->children) - 1; i >= 0; i--)
     {
-      AtspiAccessible *child = g_ptr_array_index (desktop->children, i);
+      AtspiAccessible *child = _atspi_children_get (&desktop->priv->children, i);
       if (child->parent.app)
         g_object_run_dispose (G_OBJECT (child->parent.app));
       g_object_run_dispose (G_OBJECT (child));
@@ -348,9 +348,7 @@ handle_get_bus_address (DBusPendingCall *pending, void *user_data)
 {
   AtspiApplication *app = user_data;
   DBusMessage *reply = dbus_pending_call_steal_reply (pending);
-  DBusMessage *message;
   const char *address;
-  DBusPendingCall *new_pending;
 
   if (dbus_message_get_type (reply) == DBUS_MESSAGE_TYPE_METHOD_RETURN)
     {
@@ -387,15 +385,7 @@ handle_get_bus_address (DBusPendingCall *pending, void *user_data)
   if (!app->bus)
     return; /* application has gone away / been disposed */
 
-  message = dbus_message_new_method_call (app->bus_name,
-                                          "/org/a11y/atspi/cache",
-                                          atspi_interface_cache, "GetItems");
-
-  dbus_connection_send_with_reply (app->bus, message, &new_pending, 2000);
-  dbus_message_unref (message);
-  if (!new_pending)
-    return;
-  dbus_pending_call_set_notify (new_pending, handle_get_items, app, NULL);
+  request_cache_items (app);
 }
 
 static AtspiApplication *
@@ -452,7 +442,9 @@ ref_accessible (ReferenceFromMessage *ref)
         {
           app->root = _atspi_accessible_new (app, atspi_path_root);
           app->root->accessible_parent = atspi_get_desktop (0);
-          g_ptr_array_add (app->root->accessible_parent->children, g_object_ref (app->root));
+          _atspi_children_insert (&app->root->accessible_parent->priv->children,
+                                  _atspi_children_get_length (&app->root->accessible_parent->priv->children),
+                                  app->root);
         }
       return g_object_ref (app->root);
     }
@@ -463,7 +455,7 @@ ref_accessible (ReferenceFromMessage *ref)
       return g_object_ref (a);
     }
   a = _atspi_accessible_new (app, ref->path);
-  g_hash_table_insert (app->hash, g_strdup (a->parent.path), g_object_ref (a));
+  g_hash_table_replace (app->hash, a->parent.path, g_object_ref (a));
   return a;
 }
 
@@ -482,7 +474,7 @@ ref_hyperlink (const char *app_name, const char *path)
       return g_object_ref (hyperlink);
     }
   hyperlink = _atspi_hyperlink_new (app, path);
-  g_hash_table_insert (app->hash, g_strdup (hyperlink->parent.path), hyperlink);
+  g_hash_table_replace (app->hash, hyperlink->parent.path, hyperlink);
   /* TODO: This should be a weak ref */
   g_object_ref (hyperlink); /* for the hash */
   return hyperlink;
@@ -500,14 +492,32 @@ typedef struct
   GArray *state_bitflags;
 } CACHE_ADDITION;
 
-static DBusHandlerResult
-handle_remove_accessible (DBusConnection *bus, DBusMessage *message)
+static void
+remove_accessible_from_iter (DBusMessageIter *iter)
 {
   ReferenceFromMessage ref;
   AtspiApplication *app;
+  AtspiApplicationPrivate *priv;
+  AtspiAccessible *a;
+
+  get_reference_from_iter (iter, &ref);
+  app = get_application (ref.app_name);
+  a = ref_accessible (&ref);
+  if (!a)
+    return;
+  g_object_run_dispose (G_OBJECT (a));
+  priv = _atspi_application_get_private (app);
+  if (priv->stale)
+    g_hash_table_remove (priv->stale, a);
+  g_hash_table_remove (app->hash, a->parent.path);
+  g_object_unref (a); /* unref our own ref */
+}
+
+static DBusHandlerResult
+handle_remove_accessible (DBusConnection *bus, DBusMessage *message)
+{
   DBusMessageIter iter;
   const char *signature = dbus_message_get_signature (message);
-  AtspiAccessible *a;
 
   if (strcmp (signature, "(so)") != 0)
     {
@@ -516,18 +526,19 @@ handle_remove_accessible (DBusConnection *bus, DBusMessage *message)
     }
 
   dbus_message_iter_init (message, &iter);
-
-  get_reference_from_iter (&iter, &ref);
-  app = get_application (ref.app_name);
-  a = ref_accessible (&ref);
-  if (!a)
-    return DBUS_HANDLER_RESULT_HANDLED;
-  g_object_run_dispose (G_OBJECT (a));
-  g_hash_table_remove (app->hash, a->parent.path);
-  g_object_unref (a); /* unref our own ref */
+  remove_accessible_from_iter (&iter);
   return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+static void
+refresh_cache_items (gpointer key, gpointer value, gpointer data)
+{
+  AtspiApplication *app = value;
+
+  if (app->bus && _atspi_application_get_private (app)->cache_generation > 0)
+    request_cache_items (app);
+}
+
 static DBusHandlerResult
 handle_name_owner_changed (DBusConnection *bus, DBusMessage *message)
 {
@@ -550,6 +561,10 @@ handle_name_owner_changed (DBusConnection *bus, DBusMessage *message)
           _atspi_reregister_event_listeners ();
           _atspi_reregister_device_listeners ();
           registry_lost = FALSE;
+          /* Applications stop sending events while no one listens for them,
+           * so catch up with what changed in the meantime */
+          if (app_hash)
+            g_hash_table_foreach (app_hash, refresh_cache_items, NULL);
         }
       else if (!new[0])
         registry_lost = TRUE;
@@ -577,7 +592,11 @@ add_app_to_desktop (AtspiAccessible *a, const char *bus_name)
   return (obj != NULL);
 }
 
-static void
+/*
+ * Returns the accessible that was added, which is owned by the cache of its
+ * application, or NULL.
+ */
+static AtspiAccessible *
 add_accessible_from_iter (DBusMessageIter *iter)
 {
   DBusMessageIter iter_struct, iter_array;
@@ -593,7 +612,7 @@ add_accessible_from_iter (DBusMessageIter *iter)
   /* get accessible */
   accessible = _atspi_dbus_consume_accessible (&iter_struct);
   if (!accessible)
-    return;
+    return NULL;
 
   /* Get application: TODO */
   dbus_message_iter_next (&iter_struct);
@@ -618,20 +637,8 @@ add_accessible_from_iter (DBusMessageIter *iter)
       dbus_message_iter_get_basic (&iter_struct, &index);
       if (index >= 0 && accessible->accessible_parent)
         {
-          AtspiAccessible *old_child = NULL;
-          if (index >= accessible->accessible_parent->children->len)
-            {
-              /* There is no room for this object */
-              g_ptr_array_set_size (accessible->accessible_parent->children, index + 1);
-            }
-          else
-            {
-              /* This place is already taken - let's free this place with dignity */
-              if (g_ptr_array_index (accessible->accessible_parent->children, index))
-                old_child = g_ptr_array_index (accessible->accessible_parent->children, index);
-            }
-          g_ptr_array_index (accessible->accessible_parent->children, index) = g_object_ref (accessible);
-          g_clear_object (&old_child);
+          /* This replaces any object that had this place */
+          _atspi_children_set (&accessible->accessible_parent->priv->children, index, accessible);
         }
 
       /* get child count */
@@ -639,7 +646,7 @@ add_accessible_from_iter (DBusMessageIter *iter)
       dbus_message_iter_get_basic (&iter_struct, &count);
       if (count >= 0)
         {
-          g_ptr_array_set_size (accessible->children, count);
+          _atspi_children_set_length (&accessible->priv->children, count);
           children_cached = TRUE;
         }
     }
@@ -652,8 +659,11 @@ add_accessible_from_iter (DBusMessageIter *iter)
         {
           AtspiAccessible *child;
           child = _atspi_dbus_consume_accessible (&iter_array);
-          g_ptr_array_remove (accessible->children, child);
-          g_ptr_array_add (accessible->children, child);
+          _atspi_children_remove (&accessible->priv->children, child);
+          _atspi_children_insert (&accessible->priv->children,
+                                  _atspi_children_get_length (&accessible->priv->children),
+                                  child);
+          g_object_unref (child);
         }
       children_cached = TRUE;
     }
@@ -664,10 +674,8 @@ add_accessible_from_iter (DBusMessageIter *iter)
   dbus_message_iter_next (&iter_struct);
 
   /* name */
-  if (accessible->name)
-    g_free (accessible->name);
   dbus_message_iter_get_basic (&iter_struct, &name);
-  accessible->name = g_strdup (name);
+  _atspi_string_set (&accessible->name, name);
   dbus_message_iter_next (&iter_struct);
 
   /* role */
@@ -676,10 +684,8 @@ add_accessible_from_iter (DBusMessageIter *iter)
   dbus_message_iter_next (&iter_struct);
 
   /* description */
-  if (accessible->description)
-    g_free (accessible->description);
   dbus_message_iter_get_basic (&iter_struct, &description);
-  accessible->description = g_strdup (description);
+  _atspi_string_set (&accessible->description, description);
   dbus_message_iter_next (&iter_struct);
 
   _atspi_dbus_set_state (accessible, &iter_struct);
@@ -687,50 +693,259 @@ add_accessible_from_iter (DBusMessageIter *iter)
 
   _atspi_accessible_add_cache (accessible, ATSPI_CACHE_NAME | ATSPI_CACHE_ROLE |
                                                ATSPI_CACHE_PARENT | ATSPI_CACHE_DESCRIPTION);
-  if (!atspi_state_set_contains (accessible->states,
-                                 ATSPI_STATE_MANAGES_DESCENDANTS) &&
+  if (!_atspi_accessible_has_state (accessible,
+                                    ATSPI_STATE_MANAGES_DESCENDANTS) &&
       children_cached)
     _atspi_accessible_add_cache (accessible, ATSPI_CACHE_CHILDREN);
 
   /* This is a bit of a hack since the cache holds a ref, so we don't need
    * the one provided for us anymore */
   g_object_unref (accessible);
+  return accessible;
+}
+
+static gboolean
+check_get_items_error (DBusMessage *reply)
+{
+  const char *sender = dbus_message_get_sender (reply);
+  const char *error = NULL;
+  const char *error_name = dbus_message_get_error_name (reply);
+
+  if (dbus_message_get_type (reply) != DBUS_MESSAGE_TYPE_ERROR)
+    return FALSE;
+
+  if (!strcmp (error_name, DBUS_ERROR_SERVICE_UNKNOWN) || !strcmp (error_name, DBUS_ERROR_NO_REPLY))
+    {
+    }
+  else
+    {
+      dbus_message_get_args (reply, NULL, DBUS_TYPE_STRING, &error,
+                             DBUS_TYPE_INVALID);
+      g_warning ("AT-SPI: Error in GetItems, sender=%s, error=%s", sender, error);
+    }
+  return TRUE;
+}
+
+/*
+ * Forgets the request in flight for @app, which must be @pending, if any.
+ * Returns whether another request was asked for in the meantime.
+ */
+static gboolean
+finish_cache_request (AtspiApplication *app, DBusPendingCall *pending)
+{
+  AtspiApplicationPrivate *priv = _atspi_application_get_private (app);
+  gboolean refetch = priv->cache_refetch;
+
+  if (priv->cache_request == pending)
+    {
+      dbus_pending_call_unref (priv->cache_request);
+      priv->cache_request = NULL;
+    }
+  priv->cache_refetch = FALSE;
+  return refetch;
 }
 
 static void
 handle_get_items (DBusPendingCall *pending, void *user_data)
 {
+  AtspiApplication *app = user_data;
   DBusMessage *reply = dbus_pending_call_steal_reply (pending);
   DBusMessageIter iter, iter_array;
 
-  if (dbus_message_get_type (reply) == DBUS_MESSAGE_TYPE_ERROR)
+  /* Applications without GetItemsPaged have no changes to catch up with */
+  finish_cache_request (app, pending);
+
+  if (check_get_items_error (reply))
     {
-      const char *sender = dbus_message_get_sender (reply);
-      const char *error = NULL;
-      const char *error_name = dbus_message_get_error_name (reply);
-      if (!strcmp (error_name, DBUS_ERROR_SERVICE_UNKNOWN) || !strcmp (error_name, DBUS_ERROR_NO_REPLY))
-        {
-        }
-      else
+      dbus_message_unref (reply);
+      return;
+    }
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      add_accessible_from_iter (&iter_array);
+      dbus_message_iter_next (&iter_array);
+    }
+  dbus_message_unref (reply);
+}
+
+/*
+ * Clears what is cached for an object of the application, and remembers it
+ * in the stale set until it is sent again.
+ */
+static void
+clear_cached_object (gpointer key, gpointer value, gpointer data)
+{
+  AtspiApplication *app = data;
+  AtspiAccessible *accessible;
+
+  if (!ATSPI_IS_ACCESSIBLE (value))
+    return;
+
+  accessible = value;
+  atspi_accessible_clear_cache_single (accessible);
+  if (accessible != app->root)
+    g_hash_table_add (_atspi_application_get_private (app)->stale, accessible);
+}
+
+static gboolean
+is_stale (gpointer key, gpointer value, gpointer data)
+{
+  GHashTable *stale = data;
+
+  return g_hash_table_contains (stale, value);
+}
+
+/*
+ * The objects that were not sent again after a reset are gone from the
+ * application.  Their caches were cleared, so anyone still holding one only
+ * gets what the application itself answers.
+ */
+static void
+drop_stale_objects (AtspiApplication *app)
+{
+  AtspiApplicationPrivate *priv = _atspi_application_get_private (app);
+
+  if (!priv->stale)
+    return;
+
+  if (app->hash)
+    g_hash_table_foreach_remove (app->hash, is_stale, priv->stale);
+  g_clear_pointer (&priv->stale, g_hash_table_unref);
+}
+
+static void
+handle_get_items_paged (DBusPendingCall *pending, void *user_data)
+{
+  AtspiApplication *app = user_data;
+  AtspiApplicationPrivate *priv = _atspi_application_get_private (app);
+  DBusMessage *reply = dbus_pending_call_steal_reply (pending);
+  DBusMessage *message;
+  DBusPendingCall *new_pending = NULL;
+  DBusMessageIter iter, iter_array;
+  dbus_uint32_t next_generation;
+  dbus_bool_t complete, reset;
+  gboolean refetch;
+
+  refetch = finish_cache_request (app, pending);
+
+  if (dbus_message_is_error (reply, DBUS_ERROR_UNKNOWN_METHOD))
+    {
+      /* The application predates GetItemsPaged; fetch everything at once */
+      dbus_message_unref (reply);
+      if (!app->bus)
+        return;
+      message = dbus_message_new_method_call (app->bus_name,
+                                              "/org/a11y/atspi/cache",
+                                              atspi_interface_cache, "GetItems");
+      dbus_connection_send_with_reply (app->bus, message, &new_pending, 2000);
+      dbus_message_unref (message);
+      if (new_pending)
         {
-          dbus_message_get_args (reply, NULL, DBUS_TYPE_STRING, &error,
-                                 DBUS_TYPE_INVALID);
-          g_warning ("AT-SPI: Error in GetItems, sender=%s, error=%s", sender, error);
+          priv->cache_request = new_pending;
+          dbus_pending_call_set_notify (new_pending, handle_get_items,
+                                        g_object_ref (app), g_object_unref);
         }
+      return;
+    }
+
+  if (check_get_items_error (reply) ||
+      strcmp (dbus_message_get_signature (reply), "ba(so)uba((so)(so)(so)iiassusau)") != 0)
+    {
+      if (dbus_message_get_type (reply) != DBUS_MESSAGE_TYPE_ERROR)
+        g_warning ("AT-SPI: GetItemsPaged with unknown signature %s", dbus_message_get_signature (reply));
       dbus_message_unref (reply);
-      dbus_pending_call_unref (pending);
+      /* Without the rest of the pages, nothing tells what is stale */
+      g_clear_pointer (&priv->stale, g_hash_table_unref);
       return;
     }
 
   dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_get_basic (&iter, &reset);
+  dbus_message_iter_next (&iter);
+
+  /* The application has forgotten some of the objects that it removed, so
+   * anything that we have cached may be stale; what is still there comes
+   * back in this and the following pages */
+  if (reset && app->hash)
+    {
+      if (priv->stale)
+        g_hash_table_remove_all (priv->stale);
+      else
+        priv->stale = g_hash_table_new (g_direct_hash, g_direct_equal);
+      g_hash_table_foreach (app->hash, clear_cached_object, app);
+    }
+
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    remove_accessible_from_iter (&iter_array);
+  dbus_message_iter_next (&iter);
+
+  dbus_message_iter_get_basic (&iter, &next_generation);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, &complete);
+  dbus_message_iter_next (&iter);
+
   dbus_message_iter_recurse (&iter, &iter_array);
   while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
     {
-      add_accessible_from_iter (&iter_array);
+      AtspiAccessible *accessible = add_accessible_from_iter (&iter_array);
+      if (accessible && priv->stale)
+        g_hash_table_remove (priv->stale, accessible);
       dbus_message_iter_next (&iter_array);
     }
   dbus_message_unref (reply);
-  dbus_pending_call_unref (pending);
+
+  priv->cache_generation = next_generation;
+  if (complete)
+    drop_stale_objects (app);
+  if ((!complete || refetch) && app->bus)
+    request_cache_items (app);
+}
+
+/*
+ * Asks the application for the objects that changed since the last cache
+ * generation we have seen, one page at a time.  The first request for an
+ * application fetches everything; later ones, as when the registry comes
+ * back, only fetch what changed.
+ *
+ * Only one request is in flight for an application at a time; asking again
+ * meanwhile makes the chain of requests go on once the current one is done.
+ */
+static void
+request_cache_items (AtspiApplication *app)
+{
+  AtspiApplicationPrivate *priv = _atspi_application_get_private (app);
+  DBusMessage *message;
+  DBusPendingCall *pending = NULL;
+  dbus_uint32_t generation = priv->cache_generation;
+  dbus_uint32_t max_items = 0;
+
+  if (priv->cache_request)
+    {
+      priv->cache_refetch = TRUE;
+      return;
+    }
+
+  message = dbus_message_new_method_call (app->bus_name,
+                                          "/org/a11y/atspi/cache",
+                                          atspi_interface_cache, "GetItemsPaged");
+  if (!message)
+    return;
+  dbus_message_append_args (message,
+                            DBUS_TYPE_UINT32, &generation,
+                            DBUS_TYPE_UINT32, &max_items,
+                            DBUS_TYPE_INVALID);
+
+  dbus_connection_send_with_reply (app->bus, message, &pending, 2000);
+  dbus_message_unref (message);
+  if (!pending)
+    return;
+  priv->cache_request = pending;
+  dbus_pending_call_set_notify (pending, handle_get_items_paged,
+                                g_object_ref (app), g_object_unref);
 }
 
 /* TODO: Do we stil need this function? */
@@ -748,10 +963,10 @@ ref_accessible_desktop (AtspiApplication *app)
       return desktop;
     }
   desktop = _atspi_accessible_new (app, atspi_path_root);
-  g_hash_table_insert (app->hash, g_strdup (desktop->parent.path),
-                       g_object_ref (desktop));
+  g_hash_table_replace (app->hash, desktop->parent.path,
+                        g_object_ref (desktop));
   app->root = g_object_ref (desktop);
-  desktop->name = g_strdup ("main");
+  desktop->name = _atspi_string_intern ("main");
   message = dbus_message_new_method_call (atspi_bus_registry,
                                           atspi_path_root,
                                           atspi_interface_accessible,
@@ -898,6 +1113,70 @@ handle_add_accessible (DBusConnection *bus, DBusMessage *message)
   return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+static DBusHandlerResult
+handle_add_accessibles (DBusConnection *bus, DBusMessage *message)
+{
+  DBusMessageIter iter, iter_array;
+  const char *signature = dbus_message_get_signature (message);
+
+  if (signature[0] != DBUS_TYPE_ARRAY ||
+      strcmp (signature + 1, cache_signal_type) != 0)
+    {
+      g_warning ("AT-SPI: AddAccessibles with unknown signature %s\n", signature);
+      return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+  dbus_message_iter_init (message, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      add_accessible_from_iter (&iter_array);
+      dbus_message_iter_next (&iter_array);
+    }
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static DBusHandlerResult
+handle_remove_accessibles (DBusConnection *bus, DBusMessage *message)
+{
+  DBusMessageIter iter, iter_array;
+  const char *signature = dbus_message_get_signature (message);
+
+  if (strcmp (signature, "a(so)") != 0)
+    {
+      g_warning ("AT-SPI: Unknown signature %s for RemoveAccessibles", signature);
+      return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+  dbus_message_iter_init (message, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    remove_accessible_from_iter (&iter_array);
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+/*
+ * Objects registered while an application first fills its cache are not
+ * signalled one by one; fetch the ones made available since our last
+ * request.
+ */
+static DBusHandlerResult
+handle_population_progress (DBusConnection *bus, DBusMessage *message)
+{
+  const char *sender = dbus_message_get_sender (message);
+  AtspiApplication *app;
+
+  if (!sender || !app_hash)
+    return DBUS_HANDLER_RESULT_HANDLED;
+
+  /* While a request is in flight, this only makes it go on afterwards, so
+   * a burst of progress signals costs one more request */
+  app = g_hash_table_lookup (app_hash, sender);
+  if (app && app->bus && _atspi_application_get_private (app)->cache_generation > 0)
+    request_cache_items (app);
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 typedef struct
 {
   DBusConnection *bus;
@@ -929,6 +1208,18 @@ process_deferred_message (BusDataClosure *closure)
     {
       handle_remove_accessible (closure->bus, closure->message);
     }
+  else if (dbus_message_is_signal (closure->message, atspi_interface_cache, "AddAccessibles"))
+    {
+      handle_add_accessibles (closure->bus, closure->message);
+    }
+  else if (dbus_message_is_signal (closure->message, atspi_interface_cache, "RemoveAccessibles"))
+    {
+      handle_remove_accessibles (closure->bus, closure->message);
+    }
+  else if (dbus_message_is_signal (closure->message, atspi_interface_cache, "PopulationProgress"))
+    {
+      handle_population_progress (closure->bus, closure->message);
+    }
   else if (dbus_message_is_signal (closure->message, "org.freedesktop.DBus", "NameOwnerChanged"))
     {
       handle_name_owner_changed (closure->bus, closure->message);
@@ -1032,6 +1323,18 @@ atspi_dbus_filter (DBusConnection *bus, DBusMessage *message, void *data)
     {
       return defer_message (bus, message);
     }
+  if (dbus_message_is_signal (message, atspi_interface_cache, "AddAccessibles"))
+    {
+      return defer_message (bus, message);
+    }
+  if (dbus_message_is_signal (message, atspi_interface_cache, "RemoveAccessibles"))
+    {
+      return defer_message (bus, message);
+    }
+  if (dbus_message_is_signal (message, atspi_interface_cache, "PopulationProgress"))
+    {
+      return defer_message (bus, message);
+    }
   if (dbus_message_is_signal (message, "org.freedesktop.DBus", "NameOwnerChanged"))
     {
       defer_message (bus, message);
@@ -1061,6 +1364,7 @@ atspi_init (void)
   atspi_inited = TRUE;
 
   _atspi_get_live_refs ();
+  _atspi_init_event_kinds ();
 
   bus = atspi_get_a11y_bus ();
   if (!bus)
@@ -1074,6 +1378,15 @@ atspi_init (void)
   match = g_strdup_printf ("type='signal',interface='%s',member='RemoveAccessible'", atspi_interface_cache);
   dbus_bus_add_match (bus, match, NULL);
   g_free (match);
+  match = g_strdup_printf ("type='signal',interface='%s',member='AddAccessibles'", atspi_interface_cache);
+  dbus_bus_add_match (bus, match, NULL);
+  g_free (match);
+  match = g_strdup_printf ("type='signal',interface='%s',member='RemoveAccessibles'", atspi_interface_cache);
+  dbus_bus_add_match (bus, match, NULL);
+  g_free (match);
+  match = g_strdup_printf ("type='signal',interface='%s',member='PopulationProgress'", atspi_interface_cache);
+  dbus_bus_add_match (bus, match, NULL);
+  g_free (match);
   match = g_strdup_printf ("type='signal',interface='%s',member='ChildrenChanged'", atspi_interface_event_object);
   dbus_bus_add_match (bus, match, NULL);
   g_free (match);
@@ -1244,8 +1557,8 @@ check_app (AtspiApplication *app, GError **error)
   return TRUE;
 }
 
-static void
-set_timeout (AtspiApplication *app)
+static gint
+get_timeout (AtspiApplication *app)
 {
   struct timeval tv;
   int diff;
@@ -1254,10 +1567,15 @@ set_timeout (AtspiApplication *app)
     {
       gettimeofday (&tv, NULL);
       diff = (tv.tv_sec - app->time_added.tv_sec) * 1000 + (tv.tv_usec - app->time_added.tv_usec) / 1000;
-      dbind_set_timeout (MAX (method_call_timeout, app_startup_time - diff));
+      return MAX (method_call_timeout, app_startup_time - diff);
     }
-  else
-    dbind_set_timeout (method_call_timeout);
+  return method_call_timeout;
+}
+
+static void
+set_timeout (AtspiApplication *app)
+{
+  dbind_set_timeout (get_timeout (app));
 }
 
 /* Makes a DBus call and returns a success value.  Simple return values can be demarshaled automatically
@@ -1449,25 +1767,237 @@ done:
   return retval;
 }
 
+/* Creates a task for an asynchronous call.  The task is bound to the
+ * context set with atspi_set_main_context(), when the calling thread can
+ * own it, so that the callback runs where the replies are dispatched.
+ */
+GTask *
+_atspi_task_new (gpointer source_object,
+                 GCancellable *cancellable,
+                 GAsyncReadyCallback callback,
+                 gpointer user_data)
+{
+  GTask *task;
+
+  if (atspi_main_context && g_main_context_acquire (atspi_main_context))
+    {
+      g_main_context_push_thread_default (atspi_main_context);
+      task = g_task_new (source_object, cancellable, callback, user_data);
+      g_main_context_pop_thread_default (atspi_main_context);
+      g_main_context_release (atspi_main_context);
+    }
+  else
+    task = g_task_new (source_object, cancellable, callback, user_data);
+
+  return task;
+}
+
+typedef struct
+{
+  GTask *task;
+  AtspiAsyncReplyFunc handler;
+} AsyncCall;
+
+static void
+async_call_free (void *data)
+{
+  AsyncCall *call = data;
+
+  g_object_unref (call->task);
+  g_free (call);
+}
+
+static void
+async_call_notify (DBusPendingCall *pending, void *user_data)
+{
+  AsyncCall *call = user_data;
+  DBusMessage *reply;
+
+  reply = dbus_pending_call_steal_reply (pending);
+  if (!reply)
+    {
+      g_task_return_new_error (call->task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                               "No reply received");
+      return;
+    }
+
+  if (g_task_return_error_if_cancelled (call->task))
+    {
+      /* The caller has lost interest; nothing to update */
+    }
+  else if (dbus_message_get_type (reply) == DBUS_MESSAGE_TYPE_ERROR)
+    {
+      AtspiObject *aobj = g_task_get_source_object (call->task);
+      DBusError err;
+
+      dbus_error_init (&err);
+      dbus_set_error_from_message (&err, reply);
+      if (aobj->app && aobj->app->bus)
+        check_for_hang (NULL, &err, aobj->app->bus, aobj->app->bus_name);
+      g_task_return_new_error (call->task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                               "%s", err.message ? err.message : err.name);
+      dbus_error_free (&err);
+    }
+  else
+    call->handler (call->task, reply);
+
+  dbus_message_unref (reply);
+}
+
+/* Sends @message to the application of @task's source object without
+ * waiting for the reply.  Any number of calls can be in flight on the
+ * connection at once; each reply is handed to @handler, which must
+ * complete the task, once it is dispatched.  Error replies complete the
+ * task with an error without reaching @handler, as does cancellation.
+ */
+void
+_atspi_dbus_send_async (DBusMessage *message,
+                        GTask *task,
+                        AtspiAsyncReplyFunc handler)
+{
+  AtspiObject *aobj = g_task_get_source_object (task);
+  DBusPendingCall *pending = NULL;
+  GError *error = NULL;
+  AsyncCall *call;
+
+  if (!check_app (aobj->app, &error))
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  if (!dbus_connection_send_with_reply (aobj->app->bus, message, &pending,
+                                        get_timeout (aobj->app)) ||
+      !pending)
+    {
+      g_task_return_new_error (task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                               "The call could not be sent");
+      return;
+    }
+
+  call = g_new (AsyncCall, 1);
+  call->task = g_object_ref (task);
+  call->handler = handler;
+  dbus_pending_call_set_notify (pending, async_call_notify, call,
+                                async_call_free);
+  dbus_pending_call_unref (pending);
+}
+
+/* Asynchronous counterpart of _atspi_dbus_call_partial().  The reply
+ * given to @handler has been checked not to be an error.
+ */
+void
+_atspi_dbus_call_async (GTask *task,
+                        const char *interface,
+                        const char *method,
+                        AtspiAsyncReplyFunc handler,
+                        const char *type,
+                        ...)
+{
+  AtspiObject *aobj = g_task_get_source_object (task);
+  DBusMessage *message;
+  DBusMessageIter iter;
+  va_list args;
+  const char *p;
+
+  if (!aobj->app || !aobj->app->bus_name)
+    {
+      g_task_return_new_error (task, ATSPI_ERROR, ATSPI_ERROR_APPLICATION_GONE,
+                               _ ("The application no longer exists"));
+      return;
+    }
+
+  message = dbus_message_new_method_call (aobj->app->bus_name, aobj->path,
+                                          interface, method);
+  if (!message)
+    {
+      g_task_return_new_error (task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                               "The call could not be created");
+      return;
+    }
+
+  va_start (args, type);
+  p = type;
+  dbus_message_iter_init_append (message, &iter);
+  dbind_any_marshal_va (&iter, &p, args);
+  va_end (args);
+
+  _atspi_dbus_send_async (message, task, handler);
+  dbus_message_unref (message);
+}
+
+/* Asynchronously fetches a property; @handler gets the raw reply, which
+ * it can open with _atspi_dbus_property_reply_init().
+ */
+void
+_atspi_dbus_get_property_async (GTask *task,
+                                const char *interface,
+                                const char *name,
+                                AtspiAsyncReplyFunc handler)
+{
+  _atspi_dbus_call_async (task, DBUS_INTERFACE_PROPERTIES, "Get", handler,
+                          "ss", interface, name);
+}
+
+/* Points @iter_variant at the value of a Properties.Get reply of the
+ * given D-Bus @type, completing @task with an error if it has another.
+ */
+gboolean
+_atspi_dbus_property_reply_init (DBusMessage *reply,
+                                 GTask *task,
+                                 const char *type,
+                                 DBusMessageIter *iter_variant)
+{
+  DBusMessageIter iter;
+
+  if (strcmp (dbus_message_get_signature (reply), "v") != 0)
+    goto wrong_type;
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, iter_variant);
+  if (dbus_message_iter_get_arg_type (iter_variant) ==
+      (type[0] == '(' ? DBUS_TYPE_STRUCT : type[0]))
+    return TRUE;
+
+wrong_type:
+  g_task_return_new_error (task, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                           "Unexpected reply type %s, expected %s",
+                           dbus_message_get_signature (reply), type);
+  return FALSE;
+}
+
+/* Like _atspi_dbus_send_with_reply_and_block, but leaves the D-Bus error
+ * in err, so that callers can check its name */
 DBusMessage *
-_atspi_dbus_send_with_reply_and_block (DBusMessage *message, GError **error)
+_atspi_dbus_send_with_reply_and_block_full (DBusMessage *message, DBusError *err)
 {
   DBusMessage *reply;
-  DBusError err;
   AtspiApplication *app;
   DBusConnection *bus;
 
   app = get_application (dbus_message_get_destination (message));
 
   if (app && !app->bus)
-    return NULL; /* will fail anyway; app has been disposed */
+    {
+      dbus_message_unref (message);
+      return NULL; /* will fail anyway; app has been disposed */
+    }
 
   bus = (app ? app->bus : _atspi_bus ());
-  dbus_error_init (&err);
   set_timeout (app);
-  reply = dbind_send_and_allow_reentry (bus, message, &err);
+  reply = dbind_send_and_allow_reentry (bus, message, err);
   process_deferred_messages ();
   dbus_message_unref (message);
+  return reply;
+}
+
+DBusMessage *
+_atspi_dbus_send_with_reply_and_block (DBusMessage *message, GError **error)
+{
+  DBusMessage *reply;
+  DBusError err;
+
+  dbus_error_init (&err);
+  reply = _atspi_dbus_send_with_reply_and_block_full (message, &err);
   if (dbus_error_is_set (&err))
     {
       if (error)
@@ -1494,14 +2024,19 @@ _atspi_dbus_return_hash_from_message (DBusMessage *message)
   return ret;
 }
 
-GHashTable *
-_atspi_dbus_hash_from_iter (DBusMessageIter *iter)
+static GHashTable *
+hash_from_iter (DBusMessageIter *iter, gboolean intern)
 {
-  GHashTable *hash = g_hash_table_new_full (g_str_hash, g_str_equal,
-                                            (GDestroyNotify) g_free,
-                                            (GDestroyNotify) g_free);
+  GHashTable *hash;
   DBusMessageIter iter_array, iter_dict;
 
+  if (intern)
+    hash = _atspi_string_hash_new ();
+  else
+    hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                  (GDestroyNotify) g_free,
+                                  (GDestroyNotify) g_free);
+
   dbus_message_iter_recurse (iter, &iter_array);
   while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
     {
@@ -1510,12 +2045,46 @@ _atspi_dbus_hash_from_iter (DBusMessageIter *iter)
       dbus_message_iter_get_basic (&iter_dict, &name);
       dbus_message_iter_next (&iter_dict);
       dbus_message_iter_get_basic (&iter_dict, &value);
-      g_hash_table_insert (hash, g_strdup (name), g_strdup (value));
+      if (intern)
+        g_hash_table_insert (hash, _atspi_string_intern (name), _atspi_string_intern (value));
+      else
+        g_hash_table_insert (hash, g_strdup (name), g_strdup (value));
       dbus_message_iter_next (&iter_array);
     }
   return hash;
 }
 
+GHashTable *
+_atspi_dbus_hash_from_iter (DBusMessageIter *iter)
+{
+  return hash_from_iter (iter, FALSE);
+}
+
+/* Like _atspi_dbus_hash_from_iter, but for hashes that are kept in the
+ * cache, whose strings are pooled */
+GHashTable *
+_atspi_dbus_interned_hash_from_iter (DBusMessageIter *iter)
+{
+  return hash_from_iter (iter, TRUE);
+}
+
+GHashTable *
+_atspi_dbus_return_interned_hash_from_message (DBusMessage *message)
+{
+  DBusMessageIter iter;
+  GHashTable *ret;
+
+  if (!message)
+    return NULL;
+
+  _ATSPI_DBUS_CHECK_SIG (message, "a{ss}", NULL, NULL);
+
+  dbus_message_iter_init (message, &iter);
+  ret = _atspi_dbus_interned_hash_from_iter (&iter);
+  dbus_message_unref (message);
+  return ret;
+}
+
 GArray *
 _atspi_dbus_return_attribute_array_from_message (DBusMessage *message)
 {
@@ -1664,19 +2233,12 @@ _atspi_dbus_set_state (AtspiAccessible *accessible, DBusMessageIter *iter)
   dbus_message_iter_recurse (iter, &iter_array);
   dbus_message_iter_get_fixed_array (&iter_array, &states, &count);
   if (count != 2)
-    {
-      g_warning ("AT-SPI: expected 2 values in states array; got %d\n", count);
-      if (!accessible->states)
-        accessible->states = _atspi_state_set_new_internal (accessible, 0);
-    }
+    g_warning ("AT-SPI: expected 2 values in states array; got %d\n", count);
   else
     {
       guint64 val = ((guint64) states[1]) << 32;
       val += states[0];
-      if (!accessible->states)
-        accessible->states = _atspi_state_set_new_internal (accessible, val);
-      else
-        accessible->states->states = val;
+      _atspi_accessible_set_states (accessible, val);
     }
   _atspi_accessible_add_cache (accessible, ATSPI_CACHE_STATES);
 }
@@ -1954,9 +2516,9 @@ atspi_set_main_context (GMainContext *cnx)
   if (desktop)
     {
       gint i;
-      for (i = desktop->children->len - 1; i >= 0; i--)
+      for (i = _atspi_children_get_length (&desktop->priv->children) - 1; i >= 0; i--)
         {
-          AtspiAccessible *child = g_ptr_array_index (desktop->children, i);
+          AtspiAccessible *child = _atspi_children_get (&desktop->priv->children, i);
           if (child->parent.app && child->parent.app->bus)
             atspi_dbus_connection_setup_with_g_main (child->parent.app->bus, cnx);
         }
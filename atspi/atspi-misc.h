@@ -51,6 +51,8 @@ gchar *atspi_role_get_name (AtspiRole role);
 gchar *atspi_role_get_localized_name (AtspiRole role);
 
 void atspi_get_version (gint *major, gint *minor, gint *micro);
+
+void atspi_get_string_pool_stats (guint *n_strings, gdouble *hit_rate, gsize *n_bytes_saved);
 G_END_DECLS
 
 #endif /* _ATSPI_MISC_H_ */
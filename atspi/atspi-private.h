@@ -25,10 +25,13 @@
 #ifndef _ATSPI_PRIVATE_H_
 #define _ATSPI_PRIVATE_H_
 
+#include "atspi-application-private.h"
+#include "atspi-children-private.h"
 #include "atspi-device-listener-private.h"
 #include "atspi-event-listener-private.h"
 #include "atspi-matchrule-private.h"
 #include "atspi-misc-private.h"
+#include "atspi-string-pool-private.h"
 #include <config.h>
 
 #include "glib/gi18n.h"
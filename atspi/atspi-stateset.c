@@ -69,6 +69,15 @@ atspi_state_set_new (GArray *states)
   return set;
 }
 
+/* The set of an accessible is a view of the states that it caches, so a
+ * change to the set is a change to the cache */
+static void
+store_states (AtspiStateSet *set)
+{
+  if (set->accessible)
+    set->accessible->priv->states = set->states;
+}
+
 AtspiStateSet *
 _atspi_state_set_new_internal (AtspiAccessible *accessible, gint64 states)
 {
@@ -113,6 +122,7 @@ atspi_state_set_set_by_name (AtspiStateSet *set, const gchar *name, gboolean ena
     set->states |= ((gint64) 1 << value->value);
   else
     set->states &= ~((gint64) 1 << value->value);
+  store_states (set);
 
   g_type_class_unref (type_class);
 }
@@ -134,6 +144,7 @@ refresh_states (AtspiStateSet *set)
 
   set->states = ((gint64) states[1]) << 32;
   set->states |= (gint64) states[0];
+  store_states (set);
   g_array_free (state_array, TRUE);
 }
 
@@ -151,6 +162,7 @@ atspi_state_set_add (AtspiStateSet *set, AtspiStateType state)
 {
   g_return_if_fail (set != NULL);
   set->states |= (((gint64) 1) << state);
+  store_states (set);
 }
 
 /**
@@ -281,4 +293,5 @@ atspi_state_set_remove (AtspiStateSet *set, AtspiStateType state)
 {
   g_return_if_fail (set != NULL);
   set->states &= ~((gint64) 1 << state);
+  store_states (set);
 }
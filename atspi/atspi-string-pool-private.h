@@ -1,8 +1,6 @@
 /*
  * AT-SPI - Assistive Technology Service Provider Interface
- * (Gnome Accessibility Project; http://developer.gnome.org/projects/gap)
- *
- * Copyright 2008 Codethink Ltd.
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
  *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
@@ -19,23 +17,26 @@
  * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
-#ifndef _DROUTE_PAIRHASH_H
-#define _DROUTE_PAIRHASH_H
+
+#ifndef _ATSPI_STRING_POOL_PRIVATE_H_
+#define _ATSPI_STRING_POOL_PRIVATE_H_
 
 #include <glib.h>
 
-typedef struct _StrPair StrPair;
-struct _StrPair
-{
-  const gchar *one;
-  const gchar *two;
-};
+G_BEGIN_DECLS
+
+gchar *
+_atspi_string_intern (const char *str);
+
+void
+_atspi_string_unref (gchar *str);
+
+void
+_atspi_string_set (gchar **field, const char *str);
 
-StrPair *str_pair_new (const gchar *one,
-                       const gchar *two);
+GHashTable *
+_atspi_string_hash_new (void);
 
-guint str_pair_hash (gconstpointer key);
-gboolean str_pair_equal (gconstpointer a,
-                         gconstpointer b);
+G_END_DECLS
 
-#endif /* _DROUTE_PAIRHASH_H */
+#endif /* _ATSPI_STRING_POOL_PRIVATE_H_ */
@@ -0,0 +1,148 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * A pool of reference-counted strings shared by the cache.
+ *
+ * Most names, descriptions and attributes of the objects in a large tree
+ * are repeated many times ("", "link", "xml-roles" and so on), so the
+ * cache keeps a single copy of each and counts its users.  Strings that did
+ * not come from the pool may be released with _atspi_string_unref() too,
+ * which frees them, so that a field can hold either kind.
+ */
+
+#include "atspi-private.h"
+
+typedef struct
+{
+  guint ref_count;
+  gchar str[1];
+} PoolEntry;
+
+static GHashTable *pool; /* string -> PoolEntry */
+static guint64 n_lookups;
+static guint64 n_hits;
+static gsize bytes_saved;
+
+/*
+ * Returns the pooled copy of str, which must be released with
+ * _atspi_string_unref().  Returns NULL if str is NULL.
+ */
+gchar *
+_atspi_string_intern (const char *str)
+{
+  PoolEntry *entry;
+  gsize len;
+
+  if (!str)
+    return NULL;
+
+  if (!pool)
+    pool = g_hash_table_new (g_str_hash, g_str_equal);
+
+  n_lookups++;
+  entry = g_hash_table_lookup (pool, str);
+  if (entry)
+    {
+      n_hits++;
+      bytes_saved += strlen (entry->str) + 1;
+      entry->ref_count++;
+      return entry->str;
+    }
+
+  len = strlen (str);
+  entry = g_malloc (G_STRUCT_OFFSET (PoolEntry, str) + len + 1);
+  entry->ref_count = 1;
+  memcpy (entry->str, str, len + 1);
+  g_hash_table_insert (pool, entry->str, entry);
+  return entry->str;
+}
+
+/*
+ * Releases a string returned by _atspi_string_intern(), or frees one that
+ * was allocated with g_malloc().  Does nothing if str is NULL.
+ */
+void
+_atspi_string_unref (gchar *str)
+{
+  PoolEntry *entry;
+
+  if (!str)
+    return;
+
+  entry = (pool ? g_hash_table_lookup (pool, str) : NULL);
+  if (!entry || entry->str != str)
+    {
+      g_free (str);
+      return;
+    }
+
+  if (--entry->ref_count > 0)
+    {
+      bytes_saved -= strlen (str) + 1;
+      return;
+    }
+  g_hash_table_remove (pool, str);
+  g_free (entry);
+}
+
+/* Replaces the string in *field with the pooled copy of str */
+void
+_atspi_string_set (gchar **field, const char *str)
+{
+  gchar *old = *field;
+
+  *field = _atspi_string_intern (str);
+  _atspi_string_unref (old);
+}
+
+/* Returns a hash table of pooled strings, such as the attributes of an object */
+GHashTable *
+_atspi_string_hash_new (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal,
+                                (GDestroyNotify) _atspi_string_unref,
+                                (GDestroyNotify) _atspi_string_unref);
+}
+
+/**
+ * atspi_get_string_pool_stats:
+ * @n_strings: (out) (optional): the number of distinct strings held.
+ * @hit_rate: (out) (optional): the fraction of the strings added to the
+ *            cache that were already held.
+ * @n_bytes_saved: (out) (optional): the number of bytes that the strings
+ *                 held would take if each user had its own copy, less the
+ *                 number that they take.
+ *
+ * Reports how much the names, descriptions, attributes and toolkit names
+ * held in the cache are shared.  This is meant for debugging.
+ *
+ * Since: 2.56
+ **/
+void
+atspi_get_string_pool_stats (guint *n_strings, gdouble *hit_rate, gsize *n_bytes_saved)
+{
+  if (n_strings)
+    *n_strings = (pool ? g_hash_table_size (pool) : 0);
+  if (hit_rate)
+    *hit_rate = (n_lookups ? (gdouble) n_hits / n_lookups : 0);
+  if (n_bytes_saved)
+    *n_bytes_saved = bytes_saved;
+}
@@ -20,6 +20,7 @@
 /* type driven marshalling */
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "config.h"
 #include "dbind-any.h"
@@ -62,283 +63,337 @@ warn_braces ()
                    " an explicit type member of 'struct'\n");
 }
 
+static const char *
+pass_complex_arg (const char *p, char begin, char end)
+{
+  int level = 1;
+
+  p++;
+  while (*p && level > 0)
+    {
+      if (*p == begin)
+        level++;
+      else if (*p == end)
+        level--;
+      p++;
+    }
+  if (*p == end)
+    p++;
+  return p;
+}
+
+static const char *
+pass_arg (const char *p)
+{
+  switch (*p)
+    {
+    case '(':
+      return pass_complex_arg (p, '(', ')');
+    case '{':
+      return pass_complex_arg (p, '{', '}');
+    case 'a':
+      return pass_arg (p + 1);
+    default:
+      return p + 1;
+    }
+}
+
 /*---------------------------------------------------------------------------*/
 
-static unsigned int
-dbind_find_c_alignment_r (const char **type)
+/*
+ * A marshal plan is a signature compiled into the size, alignment and
+ * member offsets of its C representation, so that values can be walked
+ * without parsing the signature again.  Plans are cached by signature,
+ * one per complete type, and never freed once cached.
+ */
+typedef struct _DBindPlan DBindPlan;
+
+struct _DBindPlan
 {
-  unsigned int retval = 1;
+  char code;              /* first character of the type */
+  dbus_bool_t fixed;      /* laid out as on the wire; arrays copy in bulk */
+  dbus_bool_t cached;     /* owned by the plan cache */
+  unsigned int size;      /* size of the C representation */
+  unsigned int align;     /* alignment of the C representation */
+  char *signature;        /* the complete type */
+  DBindPlan *element;     /* array element */
+  unsigned int n_members; /* struct or dict entry members */
+  DBindPlan **members;
+  unsigned int *offsets;
+};
+
+G_LOCK_DEFINE_STATIC (plans);
+static GHashTable *plans;
 
+static void
+dbind_plan_set_basic (DBindPlan *plan,
+                      unsigned int size,
+                      unsigned int align,
+                      dbus_bool_t fixed)
+{
+  plan->size = size;
+  plan->align = align;
+  plan->fixed = fixed;
+}
+
+static DBindPlan *
+dbind_plan_compile_r (const char **type)
+{
+  const char *start = *type;
+  DBindPlan *plan = g_new0 (DBindPlan, 1);
   char t = **type;
-  (*type)++;
 
-#ifdef DEBUG
-  fprintf (stderr, "\tfind align for %c (0x%x)\n", t, t);
-#endif
+  plan->code = t;
+  if (t != '\0')
+    (*type)++;
 
   switch (t)
     {
     case DBUS_TYPE_BYTE:
-      return ALIGNOF_CHAR;
+      dbind_plan_set_basic (plan, sizeof (char), ALIGNOF_CHAR, TRUE);
+      break;
     case DBUS_TYPE_BOOLEAN:
-      return ALIGNOF_DBUS_BOOL_T;
+      dbind_plan_set_basic (plan, sizeof (dbus_bool_t), ALIGNOF_DBUS_BOOL_T, TRUE);
+      break;
     case DBUS_TYPE_INT16:
     case DBUS_TYPE_UINT16:
-      return ALIGNOF_DBUS_INT16_T;
+      dbind_plan_set_basic (plan, sizeof (dbus_int16_t), ALIGNOF_DBUS_INT16_T, TRUE);
+      break;
     case DBUS_TYPE_INT32:
     case DBUS_TYPE_UINT32:
-      return ALIGNOF_DBUS_INT32_T;
+      dbind_plan_set_basic (plan, sizeof (dbus_int32_t), ALIGNOF_DBUS_INT32_T, TRUE);
+      break;
     case DBUS_TYPE_INT64:
     case DBUS_TYPE_UINT64:
-      return ALIGNOF_DBUS_INT64_T;
+      dbind_plan_set_basic (plan, sizeof (dbus_int64_t), ALIGNOF_DBUS_INT64_T, TRUE);
+      break;
     case DBUS_TYPE_DOUBLE:
-      return ALIGNOF_DOUBLE;
+      dbind_plan_set_basic (plan, sizeof (double), ALIGNOF_DOUBLE, TRUE);
+      break;
     /* ptr types */
     case DBUS_TYPE_STRING:
     case DBUS_TYPE_OBJECT_PATH:
     case DBUS_TYPE_SIGNATURE:
+      dbind_plan_set_basic (plan, sizeof (void *), ALIGNOF_DBIND_POINTER, FALSE);
+      break;
     case DBUS_TYPE_ARRAY:
-      return ALIGNOF_DBIND_POINTER;
+      dbind_plan_set_basic (plan, sizeof (void *), ALIGNOF_DBIND_POINTER, FALSE);
+      plan->element = dbind_plan_compile_r (type);
+      break;
     case DBUS_STRUCT_BEGIN_CHAR:
-      /* TODO: I think this would break with a nested struct */
-#if ALIGNOF_DBIND_STRUCT > 1
-      retval = MAX (retval, ALIGNOF_DBIND_STRUCT);
-#endif
-      while (**type != DBUS_STRUCT_END_CHAR)
-        {
-          int elem_align = dbind_find_c_alignment_r (type);
-          retval = MAX (retval, elem_align);
-        }
-      (*type)++;
-      return retval;
     case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      {
+        char end = (t == DBUS_STRUCT_BEGIN_CHAR ? DBUS_STRUCT_END_CHAR
+                                                : DBUS_DICT_ENTRY_END_CHAR);
+        GPtrArray *members = g_ptr_array_new ();
+        GArray *offsets = g_array_new (FALSE, FALSE, sizeof (unsigned int));
+        unsigned int offset = 0;
+
+        plan->align = 1;
 #if ALIGNOF_DBIND_STRUCT > 1
-      retval = MAX (retval, ALIGNOF_DBIND_STRUCT);
+        plan->align = MAX (plan->align, ALIGNOF_DBIND_STRUCT);
 #endif
-      while (**type != DBUS_DICT_ENTRY_END_CHAR)
-        {
-          int elem_align = dbind_find_c_alignment_r (type);
-          retval = MAX (retval, elem_align);
-        }
-      (*type)++;
-      return retval;
+        while (**type != end && **type != '\0')
+          {
+            DBindPlan *member = dbind_plan_compile_r (type);
+
+            offset = ALIGN_VALUE (offset, member->align);
+            g_ptr_array_add (members, member);
+            g_array_append_val (offsets, offset);
+            offset += member->size;
+            plan->align = MAX (plan->align, member->align);
+          }
+        if (**type == end)
+          (*type)++;
+
+        plan->size = ALIGN_VALUE (offset, plan->align);
+        plan->n_members = members->len;
+        plan->members = (DBindPlan **) g_ptr_array_free (members, FALSE);
+        plan->offsets = (unsigned int *) g_array_free (offsets, FALSE);
+        break;
+      }
     case DBUS_TYPE_STRUCT:
     case DBUS_TYPE_DICT_ENTRY:
       warn_braces ();
-      return ALIGNOF_DBIND_POINTER;
-    case '\0':
-      g_assert_not_reached ();
+      dbind_plan_set_basic (plan, 0, ALIGNOF_DBIND_POINTER, FALSE);
       break;
     default:
-      return 1;
+      dbind_plan_set_basic (plan, 0, 1, FALSE);
+      break;
     }
-}
 
-/*---------------------------------------------------------------------------*/
+  plan->signature = g_strndup (start, *type - start);
+  return plan;
+}
 
-/* gather immediate allocation information for this type */
-static size_t
-dbind_gather_alloc_info_r (const char **type)
+static void
+dbind_plan_free (DBindPlan *plan)
 {
-  char t = **type;
-  (*type)++;
-  if (t == DBUS_TYPE_ARRAY)
-    {
-      switch (**type)
-        {
-        case DBUS_STRUCT_BEGIN_CHAR:
-          while (**type != DBUS_STRUCT_END_CHAR && **type != '\0')
-            (*type)++;
-          if (**type != '\0')
-            (*type)++;
-          break;
-        case DBUS_DICT_ENTRY_BEGIN_CHAR:
-          while (**type != DBUS_DICT_ENTRY_END_CHAR && **type != '\0')
-            (*type)++;
-          if (**type != '\0')
-            (*type)++;
-          break;
-        case '\0':
-          break;
-        default:
-          (*type)++;
-          break;
-        }
-    }
-
-  switch (t)
-    {
-    case DBUS_TYPE_BYTE:
-      return sizeof (char);
-    case DBUS_TYPE_BOOLEAN:
-      return sizeof (dbus_bool_t);
-    case DBUS_TYPE_INT16:
-    case DBUS_TYPE_UINT16:
-      return sizeof (dbus_int16_t);
-    case DBUS_TYPE_INT32:
-    case DBUS_TYPE_UINT32:
-      return sizeof (dbus_int32_t);
-    case DBUS_TYPE_INT64:
-    case DBUS_TYPE_UINT64:
-      return sizeof (dbus_int64_t);
-    case DBUS_TYPE_DOUBLE:
-      return sizeof (double);
-    /* ptr types */
-    case DBUS_TYPE_STRING:
-    case DBUS_TYPE_OBJECT_PATH:
-    case DBUS_TYPE_SIGNATURE:
-    case DBUS_TYPE_ARRAY:
-      return sizeof (void *);
-    case DBUS_STRUCT_BEGIN_CHAR:
-      {
-        int sum = 0, stralign;
-
-        stralign = dbind_find_c_alignment (*type - 1);
-
-        while (**type != DBUS_STRUCT_END_CHAR)
-          {
-            sum = ALIGN_VALUE (sum, dbind_find_c_alignment (*type));
-            sum += dbind_gather_alloc_info_r (type);
-          }
-        sum = ALIGN_VALUE (sum, stralign);
+  unsigned int i;
+
+  if (plan->element)
+    dbind_plan_free (plan->element);
+  for (i = 0; i < plan->n_members; i++)
+    dbind_plan_free (plan->members[i]);
+  g_free (plan->members);
+  g_free (plan->offsets);
+  g_free (plan->signature);
+  g_free (plan);
+}
 
-        g_assert (**type == DBUS_STRUCT_END_CHAR);
-        (*type)++;
+/* Returns the plan for the complete type at *type, and moves *type past
+ * it.  Release the plan with dbind_plan_release().
+ */
+static DBindPlan *
+dbind_plan_lookup (const char **type)
+{
+  char key[DBUS_MAXIMUM_SIGNATURE_LENGTH + 1];
+  const char *end, *p;
+  DBindPlan *plan;
+  size_t len;
 
-        return sum;
-      }
-    case DBUS_DICT_ENTRY_BEGIN_CHAR:
-      {
-        int sum = 0, stralign;
+  if (**type == '\0')
+    return NULL;
 
-        stralign = dbind_find_c_alignment (*type - 1);
+  end = pass_arg (*type);
+  len = end - *type;
+  if (len > DBUS_MAXIMUM_SIGNATURE_LENGTH)
+    {
+      char *signature = g_strndup (*type, len);
 
-        while (**type != DBUS_DICT_ENTRY_END_CHAR)
-          {
-            sum = ALIGN_VALUE (sum, dbind_find_c_alignment (*type));
-            sum += dbind_gather_alloc_info_r (type);
-          }
-        sum = ALIGN_VALUE (sum, stralign);
+      p = signature;
+      plan = dbind_plan_compile_r (&p);
+      g_free (signature);
+      *type = end;
+      return plan;
+    }
 
-        g_assert (**type == DBUS_DICT_ENTRY_END_CHAR);
-        (*type)++;
+  memcpy (key, *type, len);
+  key[len] = '\0';
+  *type = end;
 
-        return sum;
-      }
-    case DBUS_TYPE_STRUCT:
-    case DBUS_TYPE_DICT_ENTRY:
-      warn_braces ();
-    default:
-      return 0;
+  G_LOCK (plans);
+  if (!plans)
+    plans = g_hash_table_new (g_str_hash, g_str_equal);
+  plan = g_hash_table_lookup (plans, key);
+  if (!plan)
+    {
+      p = key;
+      plan = dbind_plan_compile_r (&p);
+      plan->cached = TRUE;
+      g_hash_table_insert (plans, plan->signature, plan);
     }
+  G_UNLOCK (plans);
+
+  return plan;
 }
 
-static size_t
-dbind_gather_alloc_info (const char *type)
+static void
+dbind_plan_release (DBindPlan *plan)
 {
-  return dbind_gather_alloc_info_r (&type);
+  if (!plan->cached)
+    dbind_plan_free (plan);
 }
 
 /*---------------------------------------------------------------------------*/
 
 static void
-dbind_any_free_r (const char **type, void **data)
+dbind_plan_free_value (const DBindPlan *plan, void *data)
 {
+  unsigned int i;
+
 #ifdef DEBUG
-  fprintf (stderr, "any free '%c' to %p\n", **type, *data);
+  fprintf (stderr, "any free '%c' to %p\n", plan->code, data);
 #endif
 
-  switch (**type)
+  switch (plan->code)
     {
-    case DBIND_POD_CASES:
-      *data = ((guchar *) *data) + dbind_gather_alloc_info (*type);
-      (*type)++;
-      break;
     case DBUS_TYPE_STRING:
     case DBUS_TYPE_OBJECT_PATH:
     case DBUS_TYPE_SIGNATURE:
 #ifdef DEBUG
-      fprintf (stderr, "string free %p\n", **(void ***) data);
+      fprintf (stderr, "string free %p\n", *(void **) data);
 #endif
-      g_free (**(void ***) data);
-      *data = ((guchar *) *data) + dbind_gather_alloc_info (*type);
-      (*type)++;
+      g_free (*(void **) data);
       break;
     case DBUS_TYPE_ARRAY:
       {
-        int i;
-        GArray *vals = **(void ***) data;
-        size_t elem_size, elem_align;
-        const char *saved_child_type;
-
-        (*type)++;
-        saved_child_type = *type;
+        const DBindPlan *element = plan->element;
+        GArray *vals = *(GArray **) data;
 
-        elem_size = dbind_gather_alloc_info (*type);
-        elem_align = dbind_find_c_alignment_r (type);
-
-        for (i = 0; i < vals->len; i++)
-          {
-            void *ptr = vals->data + elem_size * i;
-            *type = saved_child_type; /* rewind type info */
-            ptr = ALIGN_ADDRESS (ptr, elem_align);
-            dbind_any_free_r (type, &ptr);
-          }
+        if (!vals)
+          break;
+        if (!element->fixed)
+          for (i = 0; i < vals->len; i++)
+            dbind_plan_free_value (element,
+                                   ALIGN_ADDRESS (vals->data + element->size * i,
+                                                  element->align));
         g_array_free (vals, TRUE);
         break;
       }
     case DBUS_STRUCT_BEGIN_CHAR:
-      {
-        gconstpointer data0 = *data;
-        int offset = 0, stralign;
-
-        stralign = dbind_find_c_alignment (*type);
-        (*type)++;
-
-        offset = 0;
-        while (**type != DBUS_STRUCT_END_CHAR)
-          {
-            const char *subt = *type;
-            offset = ALIGN_VALUE (offset, dbind_find_c_alignment (*type));
-            *data = PTR_PLUS (data0, offset);
-            dbind_any_free_r (type, data);
-            offset += dbind_gather_alloc_info (subt);
-          }
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      for (i = 0; i < plan->n_members; i++)
+        dbind_plan_free_value (plan->members[i],
+                               PTR_PLUS (data, plan->offsets[i]));
+      break;
+    }
+}
 
-        offset = ALIGN_VALUE (offset, stralign);
-        *data = PTR_PLUS (data0, offset);
+static void
+dbind_plan_marshal (DBusMessageIter *iter,
+                    const DBindPlan *plan,
+                    const void *data)
+{
+  DBusMessageIter sub;
+  unsigned int i;
 
-        g_assert (**type == DBUS_STRUCT_END_CHAR);
-        (*type)++;
+#ifdef DEBUG
+  fprintf (stderr, "any marshal '%c' to %p\n", plan->code, data);
+#endif
 
-        break;
-      }
-    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+  switch (plan->code)
+    {
+    case DBIND_POD_CASES:
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_SIGNATURE:
+      dbus_message_iter_append_basic (iter, plan->code, data);
+      break;
+    case DBUS_TYPE_ARRAY:
       {
-        gconstpointer data0 = *data;
-        int offset = 0, stralign;
+        const DBindPlan *element = plan->element;
+        GArray *vals = *(GArray **) data;
 
-        stralign = dbind_find_c_alignment (*type);
-        (*type)++;
+        dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY,
+                                          element->signature, &sub);
+        if (vals && element->fixed)
+          {
+            const void *elems = vals->data;
 
-        offset = 0;
-        while (**type != DBUS_DICT_ENTRY_END_CHAR)
+            dbus_message_iter_append_fixed_array (&sub, element->code,
+                                                  &elems, vals->len);
+          }
+        else if (vals)
           {
-            const char *subt = *type;
-            offset = ALIGN_VALUE (offset, dbind_find_c_alignment (*type));
-            *data = PTR_PLUS (data0, offset);
-            dbind_any_free_r (type, data);
-            offset += dbind_gather_alloc_info (subt);
+            for (i = 0; i < vals->len; i++)
+              dbind_plan_marshal (&sub, element,
+                                  ALIGN_ADDRESS (vals->data + element->size * i,
+                                                 element->align));
           }
-
-        offset = ALIGN_VALUE (offset, stralign);
-        *data = PTR_PLUS (data0, offset);
-
-        g_assert (**type == DBUS_DICT_ENTRY_END_CHAR);
-        (*type)++;
-
+        dbus_message_iter_close_container (iter, &sub);
         break;
       }
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      dbus_message_iter_open_container (iter,
+                                        plan->code == DBUS_STRUCT_BEGIN_CHAR ? DBUS_TYPE_STRUCT : DBUS_TYPE_DICT_ENTRY,
+                                        NULL, &sub);
+      for (i = 0; i < plan->n_members; i++)
+        dbind_plan_marshal (&sub, plan->members[i],
+                            PTR_PLUS (data, plan->offsets[i]));
+      dbus_message_iter_close_container (iter, &sub);
+      break;
     case DBUS_TYPE_STRUCT:
     case DBUS_TYPE_DICT_ENTRY:
       warn_braces ();
@@ -346,131 +401,102 @@ dbind_any_free_r (const char **type, void **data)
     }
 }
 
-/*---------------------------------------------------------------------------*/
-
-void
-dbind_any_marshal (DBusMessageIter *iter,
-                   const char **type,
-                   void **data)
+static void
+dbind_plan_demarshal (DBusMessageIter *iter,
+                      const DBindPlan *plan,
+                      void *data)
 {
-  size_t len;
+  DBusMessageIter child;
+  unsigned int i;
 
 #ifdef DEBUG
-  fprintf (stderr, "any marshal '%c' to %p\n", **type, *data);
+  fprintf (stderr, "any demarshal '%c' to %p\n", plan->code, data);
 #endif
 
-  switch (**type)
+  switch (plan->code)
     {
     case DBIND_POD_CASES:
+      dbus_message_iter_get_basic (iter, data);
+      break;
     case DBUS_TYPE_STRING:
     case DBUS_TYPE_OBJECT_PATH:
     case DBUS_TYPE_SIGNATURE:
-      len = dbind_gather_alloc_info (*type);
-      dbus_message_iter_append_basic (iter, **type, *data);
-      *data = ((guchar *) *data) + len;
-      (*type)++;
+      dbus_message_iter_get_basic (iter, data);
+#ifdef DEBUG
+      fprintf (stderr, "dup string '%s' (%p)\n", *(char **) data, *(char **) data);
+#endif
+      *(char **) data = g_strdup (*(char **) data);
       break;
     case DBUS_TYPE_ARRAY:
       {
-        int i;
-        GArray *vals = **(void ***) data;
-        size_t elem_size, elem_align;
-        DBusMessageIter sub;
-        const char *saved_child_type;
-        char *child_type_string;
-
-        (*type)++;
-        saved_child_type = *type;
-
-        elem_size = dbind_gather_alloc_info (*type);
-        elem_align = dbind_find_c_alignment_r (type);
-
-        /* wow this part of the API sucks too ... */
-        child_type_string = g_strndup (saved_child_type, *type - saved_child_type);
-        /* fprintf (stderr, "array child type '%s'\n", child_type_string); */
-        dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY,
-                                          child_type_string, &sub);
-        for (i = 0; i < vals->len; i++)
-          {
-            void *ptr = vals->data + elem_size * i;
-            *type = saved_child_type; /* rewind type info */
-            ptr = ALIGN_ADDRESS (ptr, elem_align);
-            dbind_any_marshal (&sub, type, &ptr);
-          }
-
-        dbus_message_iter_close_container (iter, &sub);
-        g_free (child_type_string);
-        break;
-      }
-    case DBUS_STRUCT_BEGIN_CHAR:
-      {
-        gconstpointer data0 = *data;
-        int offset = 0, stralign;
-        DBusMessageIter sub;
-
-        stralign = dbind_find_c_alignment (*type);
-
-        (*type)++;
-
-        dbus_message_iter_open_container (iter, DBUS_TYPE_STRUCT, NULL, &sub);
+        const DBindPlan *element = plan->element;
+        GArray *vals;
 
-        offset = 0;
-        while (**type != DBUS_STRUCT_END_CHAR)
+        dbus_message_iter_recurse (iter, &child);
+        if (element->fixed &&
+            dbus_message_iter_get_element_type (iter) == element->code)
           {
-            const char *subt = *type;
-            offset = ALIGN_VALUE (offset, dbind_find_c_alignment (*type));
-            *data = PTR_PLUS (data0, offset);
-            dbind_any_marshal (&sub, type, data);
-            offset += dbind_gather_alloc_info (subt);
-          }
-
-        offset = ALIGN_VALUE (offset, stralign);
-        *data = PTR_PLUS (data0, offset);
-
-        dbus_message_iter_close_container (iter, &sub);
+            const void *elems = NULL;
+            int n_elems = 0;
 
-        g_assert (**type == DBUS_STRUCT_END_CHAR);
-        (*type)++;
-
-        break;
-      }
-    case DBUS_DICT_ENTRY_BEGIN_CHAR:
-      {
-        gconstpointer data0 = *data;
-        int offset = 0, stralign;
-        DBusMessageIter sub;
-
-        stralign = dbind_find_c_alignment (*type);
-
-        (*type)++;
-
-        dbus_message_iter_open_container (iter, DBUS_TYPE_DICT_ENTRY, NULL, &sub);
-
-        offset = 0;
-        while (**type != DBUS_DICT_ENTRY_END_CHAR)
+            /* Copy the elements straight out of the message */
+            dbus_message_iter_get_fixed_array (&child, &elems, &n_elems);
+            vals = g_array_sized_new (FALSE, FALSE, element->size, n_elems);
+            g_array_append_vals (vals, elems, n_elems);
+          }
+        else
           {
-            const char *subt = *type;
-            offset = ALIGN_VALUE (offset, dbind_find_c_alignment (*type));
-            *data = PTR_PLUS (data0, offset);
-            dbind_any_marshal (&sub, type, data);
-            offset += dbind_gather_alloc_info (subt);
+            DBusMessageIter count_iter = child;
+            unsigned int n_elems = 0;
+
+            /* Size the array once rather than per element */
+            while (dbus_message_iter_get_arg_type (&count_iter) != DBUS_TYPE_INVALID)
+              {
+                n_elems++;
+                dbus_message_iter_next (&count_iter);
+              }
+            vals = g_array_sized_new (FALSE, FALSE, element->size, n_elems);
+            g_array_set_size (vals, n_elems);
+            for (i = 0; i < n_elems; i++)
+              dbind_plan_demarshal (&child, element,
+                                    ALIGN_ADDRESS (vals->data + element->size * i,
+                                                   element->align));
           }
-
-        offset = ALIGN_VALUE (offset, stralign);
-        *data = PTR_PLUS (data0, offset);
-
-        dbus_message_iter_close_container (iter, &sub);
-
-        g_assert (**type == DBUS_DICT_ENTRY_END_CHAR);
-        (*type)++;
-
+        *(GArray **) data = vals;
         break;
       }
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      dbus_message_iter_recurse (iter, &child);
+      for (i = 0; i < plan->n_members; i++)
+        dbind_plan_demarshal (&child, plan->members[i],
+                              PTR_PLUS (data, plan->offsets[i]));
+      break;
+    case DBUS_TYPE_VARIANT:
+      /* skip; unimplemented for now */
+      break;
     case DBUS_TYPE_STRUCT:
     case DBUS_TYPE_DICT_ENTRY:
       warn_braces ();
       break;
     }
+  dbus_message_iter_next (iter);
+}
+
+/*---------------------------------------------------------------------------*/
+
+void
+dbind_any_marshal (DBusMessageIter *iter,
+                   const char **type,
+                   void **data)
+{
+  DBindPlan *plan = dbind_plan_lookup (type);
+
+  if (!plan)
+    return;
+  dbind_plan_marshal (iter, plan, *data);
+  *data = PTR_PLUS (*data, plan->size);
+  dbind_plan_release (plan);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -553,173 +579,18 @@ dbind_any_marshal_va (DBusMessageIter *iter,
   }
 }
 
-/*---------------------------------------------------------------------------*/
-
 void
 dbind_any_demarshal (DBusMessageIter *iter,
                      const char **type,
                      void **data)
 {
-  size_t len;
-
-#ifdef DEBUG
-  fprintf (stderr, "any demarshal '%c' to %p\n", **type, *data);
-#endif
-
-  switch (**type)
-    {
-    case DBIND_POD_CASES:
-      len = dbind_gather_alloc_info (*type);
-      dbus_message_iter_get_basic (iter, *data);
-      *data = ((guchar *) *data) + len;
-      (*type)++;
-      break;
-    case DBUS_TYPE_STRING:
-    case DBUS_TYPE_OBJECT_PATH:
-    case DBUS_TYPE_SIGNATURE:
-      len = dbind_gather_alloc_info (*type);
-      dbus_message_iter_get_basic (iter, *data);
-#ifdef DEBUG
-      fprintf (stderr, "dup string '%s' (%p)\n", **(void ***) data, **(void ***) data);
-#endif
-      **(void ***) data = g_strdup (**(void ***) data);
-      *data = ((guchar *) *data) + len;
-      (*type)++;
-      break;
-    case DBUS_TYPE_ARRAY:
-      {
-        GArray *vals;
-        DBusMessageIter child;
-        size_t elem_size, elem_align;
-        const char *stored_child_type;
-        int i;
-
-        (*type)++;
-        stored_child_type = *type;
-
-        elem_size = dbind_gather_alloc_info (*type);
-        elem_align = dbind_find_c_alignment_r (type);
-        vals = g_array_new (FALSE, FALSE, elem_size);
-        (**(void ***) data) = vals;
-        *data = ((guchar *) *data) + sizeof (void *);
-
-        i = 0;
-        dbus_message_iter_recurse (iter, &child);
-        while (dbus_message_iter_get_arg_type (&child) != DBUS_TYPE_INVALID)
-          {
-            void *ptr;
-            const char *subt = stored_child_type;
-            g_array_set_size (vals, i + 1);
-            ptr = vals->data + elem_size * i;
-            ptr = ALIGN_ADDRESS (ptr, elem_align);
-            dbind_any_demarshal (&child, &subt, &ptr);
-            i++;
-          };
-        break;
-      }
-    case DBUS_STRUCT_BEGIN_CHAR:
-      {
-        gconstpointer data0 = *data;
-        int offset = 0, stralign;
-        DBusMessageIter child;
-
-        stralign = dbind_find_c_alignment (*type);
-
-        (*type)++;
-
-        dbus_message_iter_recurse (iter, &child);
-
-        while (**type != DBUS_STRUCT_END_CHAR)
-          {
-            const char *subt = *type;
-            offset = ALIGN_VALUE (offset, dbind_find_c_alignment (*type));
-            *data = PTR_PLUS (data0, offset);
-            dbind_any_demarshal (&child, type, data);
-            offset += dbind_gather_alloc_info (subt);
-          }
-
-        offset = ALIGN_VALUE (offset, stralign);
-        *data = PTR_PLUS (data0, offset);
-
-        g_assert (**type == DBUS_STRUCT_END_CHAR);
-        (*type)++;
-
-        break;
-      }
-    case DBUS_DICT_ENTRY_BEGIN_CHAR:
-      {
-        gconstpointer data0 = *data;
-        int offset = 0, stralign;
-        DBusMessageIter child;
-
-        stralign = dbind_find_c_alignment (*type);
-
-        (*type)++;
-
-        dbus_message_iter_recurse (iter, &child);
-
-        while (**type != DBUS_DICT_ENTRY_END_CHAR)
-          {
-            const char *subt = *type;
-            offset = ALIGN_VALUE (offset, dbind_find_c_alignment (*type));
-            *data = PTR_PLUS (data0, offset);
-            dbind_any_demarshal (&child, type, data);
-            offset += dbind_gather_alloc_info (subt);
-          }
-
-        offset = ALIGN_VALUE (offset, stralign);
-        *data = PTR_PLUS (data0, offset);
-
-        g_assert (**type == DBUS_DICT_ENTRY_END_CHAR);
-        (*type)++;
-
-        break;
-      case DBUS_TYPE_VARIANT:
-        /* skip; unimplemented for now */
-        (*type)++;
-        break;
-      }
-    case DBUS_TYPE_STRUCT:
-    case DBUS_TYPE_DICT_ENTRY:
-      warn_braces ();
-      break;
-    }
-  dbus_message_iter_next (iter);
-}
-
-static const char *
-pass_complex_arg (const char *p, char begin, char end)
-{
-  int level = 1;
-
-  p++;
-  while (*p && level > 0)
-    {
-      if (*p == begin)
-        level++;
-      else if (*p == end)
-        level--;
-      p++;
-    }
-  if (*p == end)
-    p++;
-  return p;
-}
+  DBindPlan *plan = dbind_plan_lookup (type);
 
-static const char *
-pass_arg (const char *p)
-{
-  switch (*p)
-    {
-    case '(':
-      return pass_complex_arg (p, '(', ')');
-    case '{':
-      return pass_complex_arg (p, '{', '}');
-    case 'a':
-      return pass_arg (p + 1);
-    default:
-      return p + 1;
-    }
+  if (!plan)
+    return;
+  dbind_plan_demarshal (iter, plan, *data);
+  *data = PTR_PLUS (*data, plan->size);
+  dbind_plan_release (plan);
 }
 
 /*---------------------------------------------------------------------------*/
@@ -794,7 +665,12 @@ void
 dbind_any_free (const char *type,
                 void *ptr)
 {
-  dbind_any_free_r (&type, &ptr);
+  DBindPlan *plan = dbind_plan_lookup (&type);
+
+  if (!plan)
+    return;
+  dbind_plan_free_value (plan, ptr);
+  dbind_plan_release (plan);
 }
 
 /* should this be the default normalization ? */
@@ -809,7 +685,14 @@ dbind_any_free_ptr (const char *type, void *ptr)
 unsigned int
 dbind_find_c_alignment (const char *type)
 {
-  return dbind_find_c_alignment_r (&type);
+  DBindPlan *plan = dbind_plan_lookup (&type);
+  unsigned int align;
+
+  if (!plan)
+    return 1;
+  align = plan->align;
+  dbind_plan_release (plan);
+  return align;
 }
 
 /*END------------------------------------------------------------------------*/
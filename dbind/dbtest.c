@@ -17,11 +17,16 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include "config.h"
+
 #include <dbind/dbind.h>
 #include <glib.h>
 #include <stdio.h>
 #include <string.h>
 
+#define LEGACY_ALIGN_VALUE(this, boundary) \
+  ((((gulong) (this)) + (((gulong) (boundary)) - 1)) & (~(((gulong) (boundary)) - 1)))
+
 void
 marshal (DBusMessage *msg, const char *type, void *ptr)
 {
@@ -369,6 +374,356 @@ test_marshalling ()
   printf ("Marshalling ok\n");
 }
 
+#define BENCHMARK_MESSAGES 2000
+#define BENCHMARK_ELEMENTS 100
+
+/*
+ * The string-walking marshaller that dbind_any_marshal() replaced, kept
+ * as the baseline for benchmark_marshalling().  It parses the signature
+ * again for every value, and measures every element of an array again.
+ */
+
+static unsigned int
+legacy_find_c_alignment_r (const char **type)
+{
+  unsigned int retval = 1;
+
+  char t = **type;
+  (*type)++;
+
+  switch (t)
+    {
+    case DBUS_TYPE_BYTE:
+      return ALIGNOF_CHAR;
+    case DBUS_TYPE_BOOLEAN:
+      return ALIGNOF_DBUS_BOOL_T;
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      return ALIGNOF_DBUS_INT16_T;
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+      return ALIGNOF_DBUS_INT32_T;
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+      return ALIGNOF_DBUS_INT64_T;
+    case DBUS_TYPE_DOUBLE:
+      return ALIGNOF_DOUBLE;
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_ARRAY:
+      return ALIGNOF_DBIND_POINTER;
+    case DBUS_STRUCT_BEGIN_CHAR:
+#if ALIGNOF_DBIND_STRUCT > 1
+      retval = MAX (retval, ALIGNOF_DBIND_STRUCT);
+#endif
+      while (**type != DBUS_STRUCT_END_CHAR)
+        {
+          int elem_align = legacy_find_c_alignment_r (type);
+          retval = MAX (retval, elem_align);
+        }
+      (*type)++;
+      return retval;
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+#if ALIGNOF_DBIND_STRUCT > 1
+      retval = MAX (retval, ALIGNOF_DBIND_STRUCT);
+#endif
+      while (**type != DBUS_DICT_ENTRY_END_CHAR)
+        {
+          int elem_align = legacy_find_c_alignment_r (type);
+          retval = MAX (retval, elem_align);
+        }
+      (*type)++;
+      return retval;
+    default:
+      return 1;
+    }
+}
+
+static unsigned int
+legacy_find_c_alignment (const char *type)
+{
+  return legacy_find_c_alignment_r (&type);
+}
+
+static size_t
+legacy_gather_alloc_info_r (const char **type)
+{
+  char t = **type;
+  (*type)++;
+  if (t == DBUS_TYPE_ARRAY)
+    {
+      switch (**type)
+        {
+        case DBUS_STRUCT_BEGIN_CHAR:
+          while (**type != DBUS_STRUCT_END_CHAR && **type != '\0')
+            (*type)++;
+          if (**type != '\0')
+            (*type)++;
+          break;
+        case DBUS_DICT_ENTRY_BEGIN_CHAR:
+          while (**type != DBUS_DICT_ENTRY_END_CHAR && **type != '\0')
+            (*type)++;
+          if (**type != '\0')
+            (*type)++;
+          break;
+        case '\0':
+          break;
+        default:
+          (*type)++;
+          break;
+        }
+    }
+
+  switch (t)
+    {
+    case DBUS_TYPE_BYTE:
+      return sizeof (char);
+    case DBUS_TYPE_BOOLEAN:
+      return sizeof (dbus_bool_t);
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+      return sizeof (dbus_int16_t);
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+      return sizeof (dbus_int32_t);
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+      return sizeof (dbus_int64_t);
+    case DBUS_TYPE_DOUBLE:
+      return sizeof (double);
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_SIGNATURE:
+    case DBUS_TYPE_ARRAY:
+      return sizeof (void *);
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      {
+        char end = (t == DBUS_STRUCT_BEGIN_CHAR ? DBUS_STRUCT_END_CHAR : DBUS_DICT_ENTRY_END_CHAR);
+        int sum = 0, stralign;
+
+        stralign = legacy_find_c_alignment (*type - 1);
+
+        while (**type != end)
+          {
+            sum = LEGACY_ALIGN_VALUE (sum, legacy_find_c_alignment (*type));
+            sum += legacy_gather_alloc_info_r (type);
+          }
+        sum = LEGACY_ALIGN_VALUE (sum, stralign);
+        (*type)++;
+
+        return sum;
+      }
+    default:
+      return 0;
+    }
+}
+
+static size_t
+legacy_gather_alloc_info (const char *type)
+{
+  return legacy_gather_alloc_info_r (&type);
+}
+
+static void
+legacy_marshal_r (DBusMessageIter *iter, const char **type, void **data)
+{
+  switch (**type)
+    {
+    case DBUS_TYPE_BYTE:
+    case DBUS_TYPE_INT16:
+    case DBUS_TYPE_UINT16:
+    case DBUS_TYPE_INT32:
+    case DBUS_TYPE_UINT32:
+    case DBUS_TYPE_BOOLEAN:
+    case DBUS_TYPE_INT64:
+    case DBUS_TYPE_UINT64:
+    case DBUS_TYPE_DOUBLE:
+    case DBUS_TYPE_STRING:
+    case DBUS_TYPE_OBJECT_PATH:
+    case DBUS_TYPE_SIGNATURE:
+      {
+        size_t len = legacy_gather_alloc_info (*type);
+
+        dbus_message_iter_append_basic (iter, **type, *data);
+        *data = ((guchar *) *data) + len;
+        (*type)++;
+        break;
+      }
+    case DBUS_TYPE_ARRAY:
+      {
+        int i;
+        GArray *vals = **(void ***) data;
+        size_t elem_size, elem_align;
+        DBusMessageIter sub;
+        const char *saved_child_type;
+        char *child_type_string;
+
+        (*type)++;
+        saved_child_type = *type;
+
+        elem_size = legacy_gather_alloc_info (*type);
+        elem_align = legacy_find_c_alignment_r (type);
+
+        child_type_string = g_strndup (saved_child_type, *type - saved_child_type);
+        dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY,
+                                          child_type_string, &sub);
+        for (i = 0; i < vals->len; i++)
+          {
+            void *ptr = vals->data + elem_size * i;
+            *type = saved_child_type; /* rewind type info */
+            ptr = (gpointer) LEGACY_ALIGN_VALUE (ptr, elem_align);
+            legacy_marshal_r (&sub, type, &ptr);
+          }
+
+        dbus_message_iter_close_container (iter, &sub);
+        g_free (child_type_string);
+        break;
+      }
+    case DBUS_STRUCT_BEGIN_CHAR:
+    case DBUS_DICT_ENTRY_BEGIN_CHAR:
+      {
+        gboolean is_struct = (**type == DBUS_STRUCT_BEGIN_CHAR);
+        char end = (is_struct ? DBUS_STRUCT_END_CHAR : DBUS_DICT_ENTRY_END_CHAR);
+        gconstpointer data0 = *data;
+        int offset = 0, stralign;
+        DBusMessageIter sub;
+
+        stralign = legacy_find_c_alignment (*type);
+
+        (*type)++;
+
+        dbus_message_iter_open_container (iter,
+                                          is_struct ? DBUS_TYPE_STRUCT : DBUS_TYPE_DICT_ENTRY,
+                                          NULL, &sub);
+
+        while (**type != end)
+          {
+            const char *subt = *type;
+            offset = LEGACY_ALIGN_VALUE (offset, legacy_find_c_alignment (*type));
+            *data = ((guchar *) data0) + offset;
+            legacy_marshal_r (&sub, type, data);
+            offset += legacy_gather_alloc_info (subt);
+          }
+
+        offset = LEGACY_ALIGN_VALUE (offset, stralign);
+        *data = ((guchar *) data0) + offset;
+
+        dbus_message_iter_close_container (iter, &sub);
+        (*type)++;
+        break;
+      }
+    }
+}
+
+static void
+legacy_marshal (DBusMessage *msg, const char *type, void *ptr)
+{
+  DBusMessageIter iter;
+
+  dbus_message_iter_init_append (msg, &iter);
+  legacy_marshal_r (&iter, &type, &ptr);
+}
+
+static double
+benchmark_signature (const char *type,
+                     void *ptr,
+                     void (*marshal_func) (DBusMessage *, const char *, void *))
+{
+  GTimer *timer;
+  double elapsed;
+  int i;
+
+  timer = g_timer_new ();
+  for (i = 0; i < BENCHMARK_MESSAGES; i++)
+    {
+      DBusMessage *msg;
+
+      msg = dbus_message_new (DBUS_MESSAGE_TYPE_METHOD_CALL);
+      marshal_func (msg, type, ptr);
+      dbus_message_unref (msg);
+    }
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  return BENCHMARK_MESSAGES / MAX (elapsed, 1e-9);
+}
+
+/* Checks that both marshallers produce the same message, and that it
+ * demarshals back to as many elements of the expected size.
+ */
+static void
+check_signature (const char *type, void *ptr, size_t elem_size)
+{
+  DBusMessage *msg, *legacy_msg;
+  GArray *out = NULL;
+
+  msg = dbus_message_new (DBUS_MESSAGE_TYPE_METHOD_CALL);
+  legacy_msg = dbus_message_new (DBUS_MESSAGE_TYPE_METHOD_CALL);
+  marshal (msg, type, ptr);
+  legacy_marshal (legacy_msg, type, ptr);
+  g_assert (!strcmp (dbus_message_get_signature (msg),
+                     dbus_message_get_signature (legacy_msg)));
+
+  demarshal (msg, type, &out);
+  g_assert (out->len == BENCHMARK_ELEMENTS);
+  g_assert (g_array_get_element_size (out) == elem_size);
+  dbind_any_free (type, &out);
+
+  dbus_message_unref (legacy_msg);
+  dbus_message_unref (msg);
+}
+
+/* Compares dbind_any_marshal() with the string-walking marshaller that it
+ * replaced.
+ */
+void
+benchmark_marshalling ()
+{
+  typedef struct
+  {
+    char *name;
+    char *path;
+  } Reference;
+  struct
+  {
+    const char *type;
+    size_t elem_size;
+  } cases[] = {
+    { "ai", sizeof (dbus_int32_t) },
+    { "a(so)", sizeof (Reference) },
+    { "a{ss}", sizeof (Reference) },
+  };
+  GArray *ints, *refs;
+  int i;
+
+  ints = g_array_new (FALSE, FALSE, sizeof (dbus_int32_t));
+  refs = g_array_new (FALSE, FALSE, sizeof (Reference));
+  for (i = 0; i < BENCHMARK_ELEMENTS; i++)
+    {
+      dbus_int32_t v = i;
+      Reference ref = { ":1.42", "/org/a11y/atspi/accessible/1" };
+      g_array_append_val (ints, v);
+      g_array_append_val (refs, ref);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (cases); i++)
+    {
+      GArray *vals = (i == 0 ? ints : refs);
+      double planned, legacy;
+
+      check_signature (cases[i].type, &vals, cases[i].elem_size);
+      legacy = benchmark_signature (cases[i].type, &vals, legacy_marshal);
+      planned = benchmark_signature (cases[i].type, &vals, marshal);
+      printf ("%s: %.0f messages/s marshalled with plans, %.0f by walking the signature\n",
+              cases[i].type, planned, legacy);
+    }
+
+  g_array_free (ints, TRUE);
+  g_array_free (refs, TRUE);
+}
+
 void
 test_helpers ()
 {
@@ -387,6 +742,7 @@ main (int argc, char **argv)
 
   test_helpers ();
   test_marshalling ();
+  benchmark_marshalling ();
 
   return 0;
 }
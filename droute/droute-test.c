@@ -21,6 +21,9 @@
 
 #define NONE_REPLY_STRING "NoneMethod"
 
+#define BENCHMARK_CALLS 50000
+#define BENCHMARK_BATCH 500
+
 const gchar *test_interface_One =
     "<interface name=\"test.interface.One\">"
     "  <method name=\"null\"/>"
@@ -64,6 +67,7 @@ typedef struct _AnObject
 static DBusConnection *bus;
 static GMainLoop *main_loop;
 static gboolean success = TRUE;
+static gboolean run_benchmark = FALSE;
 
 static DBusMessage *
 impl_null (DBusConnection *bus, DBusMessage *message, void *user_data)
@@ -181,10 +185,33 @@ static DRouteMethod test_methods_two[] = {
   { NULL, NULL }
 };
 
+static dbus_bool_t
+impl_get_Int (DBusMessageIter *iter, void *user_data)
+{
+  AnObject *object = (AnObject *) user_data;
+  dbus_int32_t anint = GPOINTER_TO_INT (object->anint);
+
+  return droute_return_v_int32 (iter, anint);
+}
+
+static dbus_bool_t
+impl_get_String (DBusMessageIter *iter, void *user_data)
+{
+  AnObject *object = (AnObject *) user_data;
+
+  return droute_return_v_string (iter, object->astring);
+}
+
 static DRouteProperty test_properties[] = {
   { NULL, NULL, NULL }
 };
 
+static DRouteProperty test_properties_one[] = {
+  { impl_get_String, NULL, "String" },
+  { impl_get_Int, NULL, "Int" },
+  { NULL, NULL, NULL }
+};
+
 static void
 set_reply (DBusPendingCall *pending, void *user_data)
 {
@@ -213,6 +240,156 @@ send_and_allow_reentry (DBusConnection *bus, DBusMessage *message, DBusError *er
   return reply;
 }
 
+/*
+ * GetAllMulti should return the properties of each interface in the order
+ * they were added, and leave out the interfaces that the object does not
+ * implement.
+ */
+static void
+check_get_all_multi (const gchar *bus_name)
+{
+  const gchar *ifaces[] = { TEST_INTERFACE_ONE, "test.interface.Missing", TEST_INTERFACE_TWO };
+  const gchar *expected[] = { TEST_INTERFACE_ONE, "String", "Int", TEST_INTERFACE_TWO };
+  const gchar **ifaces_ptr = ifaces;
+  DBusMessage *message, *reply;
+  DBusMessageIter iter, iter_out, iter_entry, iter_dict, iter_prop;
+  guint n = 0;
+
+  message = dbus_message_new_method_call (bus_name,
+                                          TEST_OBJECT_PATH,
+                                          DROUTE_INTERFACE_PROPERTIES,
+                                          "GetAllMulti");
+  dbus_message_append_args (message, DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+                            &ifaces_ptr, G_N_ELEMENTS (ifaces), DBUS_TYPE_INVALID);
+  reply = send_and_allow_reentry (bus, message, NULL);
+  dbus_message_unref (message);
+
+  if (!reply || strcmp (dbus_message_get_signature (reply), "a{sa{sv}}") != 0)
+    {
+      g_print ("Failed: bad reply to GetAllMulti\n");
+      exit (1);
+    }
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_out);
+  while (dbus_message_iter_get_arg_type (&iter_out) != DBUS_TYPE_INVALID)
+    {
+      const gchar *name;
+
+      dbus_message_iter_recurse (&iter_out, &iter_entry);
+      dbus_message_iter_get_basic (&iter_entry, &name);
+      if (n >= G_N_ELEMENTS (expected) || strcmp (name, expected[n++]) != 0)
+        {
+          g_print ("Failed: unexpected interface %s from GetAllMulti\n", name);
+          exit (1);
+        }
+      dbus_message_iter_next (&iter_entry);
+      dbus_message_iter_recurse (&iter_entry, &iter_dict);
+      while (dbus_message_iter_get_arg_type (&iter_dict) != DBUS_TYPE_INVALID)
+        {
+          dbus_message_iter_recurse (&iter_dict, &iter_prop);
+          dbus_message_iter_get_basic (&iter_prop, &name);
+          if (n >= G_N_ELEMENTS (expected) || strcmp (name, expected[n++]) != 0)
+            {
+              g_print ("Failed: unexpected property %s from GetAllMulti\n", name);
+              exit (1);
+            }
+          dbus_message_iter_next (&iter_dict);
+        }
+      dbus_message_iter_next (&iter_out);
+    }
+  dbus_message_unref (reply);
+
+  if (n != G_N_ELEMENTS (expected))
+    {
+      g_print ("Failed: GetAllMulti returned %d names; expected %d\n",
+               n, (int) G_N_ELEMENTS (expected));
+      exit (1);
+    }
+}
+
+static void
+count_reply (DBusPendingCall *pending, void *user_data)
+{
+  guint *n_replies = user_data;
+  DBusMessage *reply = dbus_pending_call_steal_reply (pending);
+
+  if (dbus_message_get_type (reply) != DBUS_MESSAGE_TYPE_METHOD_RETURN)
+    {
+      g_print ("Failed: benchmark call returned %s\n",
+               dbus_message_get_error_name (reply));
+      exit (1);
+    }
+  dbus_message_unref (reply);
+  (*n_replies)++;
+  dbus_pending_call_unref (pending);
+}
+
+/*
+ * Measures how many calls per second can be routed, by sending batches of
+ * calls to methods of both interfaces and waiting for all their replies.
+ * Only run with --benchmark, by "meson test --benchmark".
+ */
+static void
+benchmark_calls (const gchar *bus_name)
+{
+  static const struct
+  {
+    const gchar *interface;
+    const gchar *member;
+  } calls[] = {
+    { TEST_INTERFACE_ONE, "null" },
+    { TEST_INTERFACE_ONE, "getInt" },
+    { TEST_INTERFACE_ONE, "getString" },
+    { TEST_INTERFACE_TWO, "null" },
+    { TEST_INTERFACE_TWO, "getInt" },
+    { TEST_INTERFACE_TWO, "getInterfaceTwo" },
+  };
+  GTimer *timer;
+  guint n_sent = 0, n_replies = 0;
+  gdouble elapsed;
+
+  timer = g_timer_new ();
+  while (n_sent < BENCHMARK_CALLS)
+    {
+      guint i;
+
+      for (i = 0; i < BENCHMARK_BATCH; i++, n_sent++)
+        {
+          DBusMessage *message;
+          DBusPendingCall *pending;
+
+          message = dbus_message_new_method_call (bus_name,
+                                                  TEST_OBJECT_PATH,
+                                                  calls[n_sent % G_N_ELEMENTS (calls)].interface,
+                                                  calls[n_sent % G_N_ELEMENTS (calls)].member);
+          if (!dbus_connection_send_with_reply (bus, message, &pending, -1) ||
+              !pending)
+            {
+              g_print ("Failed: could not send benchmark call\n");
+              exit (1);
+            }
+          dbus_pending_call_set_notify (pending, count_reply, &n_replies, NULL);
+          dbus_message_unref (message);
+        }
+
+      while (n_replies < n_sent)
+        {
+          if (!dbus_connection_read_write_dispatch (bus, -1))
+            {
+              g_print ("Failed: connection closed during benchmark\n");
+              exit (1);
+            }
+        }
+    }
+  g_timer_stop (timer);
+
+  elapsed = g_timer_elapsed (timer, NULL);
+  g_print ("routed %d calls in %.3f s (%.0f calls/s)\n", BENCHMARK_CALLS,
+           elapsed, BENCHMARK_CALLS / elapsed);
+  g_timer_destroy (timer);
+}
+
 gboolean
 do_tests_func (gpointer data)
 {
@@ -226,6 +403,13 @@ do_tests_func (gpointer data)
   dbus_error_init (&error);
   bus_name = dbus_bus_get_unique_name (bus);
 
+  if (run_benchmark)
+    {
+      benchmark_calls (bus_name);
+      g_main_loop_quit (main_loop);
+      return FALSE;
+    }
+
   /* --------------------------------------------------------*/
 
   message = dbus_message_new_method_call (bus_name,
@@ -259,6 +443,10 @@ do_tests_func (gpointer data)
 
   /* --------------------------------------------------------*/
 
+  check_get_all_multi (bus_name);
+
+  /* --------------------------------------------------------*/
+
   g_main_loop_quit (main_loop);
   return FALSE;
 }
@@ -277,6 +465,8 @@ main (int argc, char **argv)
   object->astring = g_strdup (STRING_ONE);
   object->anint = INT_ONE;
 
+  run_benchmark = (argc > 1 && !strcmp (argv[1], "--benchmark"));
+
   dbus_error_init (&error);
   main_loop = g_main_loop_new (NULL, FALSE);
   bus = dbus_bus_get (DBUS_BUS_SESSION, &error);
@@ -289,7 +479,7 @@ main (int argc, char **argv)
                              TEST_INTERFACE_ONE,
                              test_interface_One,
                              test_methods_one,
-                             test_properties);
+                             test_properties_one);
 
   droute_path_add_interface (path,
                              TEST_INTERFACE_TWO,
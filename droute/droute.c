@@ -25,7 +25,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include "droute-pairhash.h"
 #include "droute.h"
 
 #define CHUNKS_DEFAULT (512)
@@ -53,8 +52,8 @@ struct _DRoutePath
   GStringChunk *chunks;
   GPtrArray *interfaces;
   GPtrArray *introspection;
-  GHashTable *methods;
-  GHashTable *properties;
+  /* Maps interface names to DRouteInterfaces */
+  GHashTable *dispatch;
 
   DRouteIntrospectChildrenFunction introspect_children_cb;
   void *introspect_children_data;
@@ -67,10 +66,38 @@ struct _DRoutePath
 
 typedef struct PropertyPair
 {
+  const gchar *name;
   DRoutePropertyFunction get;
   DRoutePropertyFunction set;
 } PropertyPair;
 
+/*
+ * Incoming calls are routed with one lookup of the interface name in the
+ * dispatch table of the path, which says how to handle it, and one lookup of
+ * the member name in the tables of that interface.  The standard Properties
+ * and Introspectable interfaces have entries of their own, so that they need
+ * no special casing before the lookup.
+ */
+typedef enum
+{
+  DROUTE_DISPATCH_METHODS,
+  DROUTE_DISPATCH_PROPERTIES,
+  DROUTE_DISPATCH_ATSPI_PROPERTIES,
+  DROUTE_DISPATCH_INTROSPECTION
+} DRouteDispatch;
+
+typedef struct _DRouteInterface
+{
+  const gchar *name;
+  DRouteDispatch dispatch;
+  /* Maps method names to DRouteFunctions */
+  GHashTable *methods;
+  /* Maps property names to PropertyPairs */
+  GHashTable *properties;
+  /* The PropertyPairs with a getter, in the order they were added */
+  GPtrArray *readable;
+} DRouteInterface;
+
 /*---------------------------------------------------------------------------*/
 
 static DBusHandlerResult
@@ -81,6 +108,42 @@ droute_object_does_not_exist_error (DBusMessage *message);
 
 /*---------------------------------------------------------------------------*/
 
+static DRouteInterface *
+interface_new (const gchar *name, DRouteDispatch dispatch)
+{
+  DRouteInterface *interface;
+
+  interface = g_new0 (DRouteInterface, 1);
+  interface->name = name;
+  interface->dispatch = dispatch;
+  interface->methods = g_hash_table_new (g_str_hash, g_str_equal);
+  interface->properties = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                 NULL, g_free);
+  interface->readable = g_ptr_array_new ();
+  return interface;
+}
+
+static void
+interface_free (gpointer data)
+{
+  DRouteInterface *interface = data;
+
+  g_hash_table_destroy (interface->methods);
+  g_ptr_array_free (interface->readable, TRUE);
+  g_hash_table_destroy (interface->properties);
+  g_free (interface);
+}
+
+static DRouteInterface *
+path_add_dispatch (DRoutePath *path, const gchar *name, DRouteDispatch dispatch)
+{
+  DRouteInterface *interface;
+
+  interface = interface_new (name, dispatch);
+  g_hash_table_insert (path->dispatch, (gpointer) name, interface);
+  return interface;
+}
+
 static DRoutePath *
 path_new (DRouteContext *cnx,
           const char *path,
@@ -101,15 +164,15 @@ path_new (DRouteContext *cnx,
   new_path->interfaces = g_ptr_array_new ();
   new_path->introspection = g_ptr_array_new ();
 
-  new_path->methods = g_hash_table_new_full ((GHashFunc) str_pair_hash,
-                                             str_pair_equal,
-                                             g_free,
-                                             NULL);
-
-  new_path->properties = g_hash_table_new_full ((GHashFunc) str_pair_hash,
-                                                str_pair_equal,
-                                                g_free,
-                                                g_free);
+  /* Interface names are kept in new_path->chunks */
+  new_path->dispatch = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              NULL, interface_free);
+  path_add_dispatch (new_path, DBUS_INTERFACE_PROPERTIES,
+                     DROUTE_DISPATCH_PROPERTIES);
+  path_add_dispatch (new_path, DROUTE_INTERFACE_PROPERTIES,
+                     DROUTE_DISPATCH_ATSPI_PROPERTIES);
+  path_add_dispatch (new_path, DBUS_INTERFACE_INTROSPECTABLE,
+                     DROUTE_DISPATCH_INTROSPECTION);
 
   new_path->introspect_children_cb = introspect_children_cb;
   new_path->introspect_children_data = introspect_children_data;
@@ -124,11 +187,10 @@ static void
 path_free (DRoutePath *path, gpointer user_data)
 {
   g_free (path->path);
+  g_hash_table_destroy (path->dispatch);
   g_string_chunk_free (path->chunks);
   g_ptr_array_free (path->interfaces, TRUE);
   g_free (g_ptr_array_free (path->introspection, FALSE));
-  g_hash_table_destroy (path->methods);
-  g_hash_table_destroy (path->properties);
   g_free (path);
 }
 
@@ -214,6 +276,7 @@ droute_path_add_interface (DRoutePath *path,
                            const DRouteMethod *methods,
                            const DRouteProperty *properties)
 {
+  DRouteInterface *interface;
   gchar *itf;
 
   g_return_if_fail (name != NULL);
@@ -222,12 +285,17 @@ droute_path_add_interface (DRoutePath *path,
   g_ptr_array_add (path->interfaces, itf);
   g_ptr_array_add (path->introspection, (gpointer) introspect);
 
+  interface = g_hash_table_lookup (path->dispatch, itf);
+  if (!interface)
+    interface = path_add_dispatch (path, itf, DROUTE_DISPATCH_METHODS);
+  g_return_if_fail (interface->dispatch == DROUTE_DISPATCH_METHODS);
+
   for (; methods != NULL && methods->name != NULL; methods++)
     {
       gchar *meth;
 
       meth = g_string_chunk_insert (path->chunks, methods->name);
-      g_hash_table_insert (path->methods, str_pair_new (itf, meth), methods->func);
+      g_hash_table_insert (interface->methods, meth, methods->func);
     }
 
   for (; properties != NULL && properties->name != NULL; properties++)
@@ -236,30 +304,58 @@ droute_path_add_interface (DRoutePath *path,
       PropertyPair *pair;
 
       prop = g_string_chunk_insert (path->chunks, properties->name);
+      if (g_hash_table_lookup (interface->properties, prop))
+        {
+          g_warning ("DRoute: property %s of %s added twice", prop, itf);
+          continue;
+        }
       pair = g_new (PropertyPair, 1);
+      pair->name = prop;
       pair->get = properties->get;
       pair->set = properties->set;
-      g_hash_table_insert (path->properties, str_pair_new (itf, prop), pair);
+      g_hash_table_insert (interface->properties, prop, pair);
+      if (pair->get)
+        g_ptr_array_add (interface->readable, pair);
     }
 }
 
 /*---------------------------------------------------------------------------*/
 
-/* The data structures don't support an efficient implementation of GetAll
- * and I don't really care.
+/*
+ * Appends the readable properties of @interface as a{sv} entries, in the
+ * order they were added.
  */
+static void
+append_all_properties (DBusMessageIter *iter_dict,
+                       DRouteInterface *interface,
+                       void *datum)
+{
+  DBusMessageIter iter_dict_entry;
+  guint i;
+
+  for (i = 0; i < interface->readable->len; i++)
+    {
+      PropertyPair *pair = g_ptr_array_index (interface->readable, i);
+
+      if (!dbus_message_iter_open_container (iter_dict, DBUS_TYPE_DICT_ENTRY, NULL, &iter_dict_entry))
+        oom ();
+      dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING,
+                                      &pair->name);
+      (pair->get) (&iter_dict_entry, datum);
+      if (!dbus_message_iter_close_container (iter_dict, &iter_dict_entry))
+        oom ();
+    }
+}
+
 static DBusMessage *
 impl_prop_GetAll (DBusMessage *message,
                   DRoutePath *path,
                   const char *pathstr)
 {
-  DBusMessageIter iter, iter_dict, iter_dict_entry;
+  DBusMessageIter iter, iter_dict;
   DBusMessage *reply;
   DBusError error;
-  GHashTableIter prop_iter;
-
-  StrPair *key;
-  PropertyPair *value;
+  DRouteInterface *interface;
   gchar *iface;
 
   void *datum = path_get_datum (path, pathstr);
@@ -286,25 +382,74 @@ impl_prop_GetAll (DBusMessage *message,
   dbus_message_iter_init_append (reply, &iter);
   if (!dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "{sv}", &iter_dict))
     oom ();
+  interface = g_hash_table_lookup (path->dispatch, iface);
+  if (interface && interface->dispatch == DROUTE_DISPATCH_METHODS)
+    append_all_properties (&iter_dict, interface, datum);
+  if (!dbus_message_iter_close_container (&iter, &iter_dict))
+    oom ();
+  return reply;
+}
+
+/*
+ * org.a11y.atspi.Properties.GetAllMulti does GetAll for several interfaces
+ * in one round trip.  It takes an array of interface names, and returns a
+ * dictionary of the properties of each one that the object implements:
+ * as -> a{sa{sv}}.
+ */
+static DBusMessage *
+impl_prop_GetAllMulti (DBusMessage *message,
+                       DRoutePath *path,
+                       const char *pathstr)
+{
+  DBusMessageIter iter, iter_ifaces, iter_out, iter_out_entry, iter_dict;
+  DBusMessageIter reply_iter;
+  DBusMessage *reply;
+
+  void *datum = path_get_datum (path, pathstr);
+  if (!datum)
+    return droute_object_does_not_exist_error (message);
+
+  if (!dbus_message_iter_init (message, &iter) ||
+      strcmp (dbus_message_get_signature (message), "as") != 0)
+    return droute_invalid_arguments_error (message);
+
+  reply = dbus_message_new_method_return (message);
+  if (!reply)
+    oom ();
 
-  g_hash_table_iter_init (&prop_iter, path->properties);
-  while (g_hash_table_iter_next (&prop_iter, (gpointer *) &key, (gpointer *) &value))
+  dbus_message_iter_init_append (reply, &reply_iter);
+  if (!dbus_message_iter_open_container (&reply_iter, DBUS_TYPE_ARRAY, "{sa{sv}}", &iter_out))
+    oom ();
+
+  dbus_message_iter_recurse (&iter, &iter_ifaces);
+  while (dbus_message_iter_get_arg_type (&iter_ifaces) == DBUS_TYPE_STRING)
     {
-      if (!g_strcmp0 (key->one, iface))
-        {
-          if (!value->get)
-            continue;
-          if (!dbus_message_iter_open_container (&iter_dict, DBUS_TYPE_DICT_ENTRY, NULL, &iter_dict_entry))
-            oom ();
-          dbus_message_iter_append_basic (&iter_dict_entry, DBUS_TYPE_STRING,
-                                          &key->two);
-          (value->get) (&iter_dict_entry, datum);
-          if (!dbus_message_iter_close_container (&iter_dict, &iter_dict_entry))
-            oom ();
-        }
+      DRouteInterface *interface;
+      const char *iface;
+
+      dbus_message_iter_get_basic (&iter_ifaces, &iface);
+      dbus_message_iter_next (&iter_ifaces);
+
+      interface = g_hash_table_lookup (path->dispatch, iface);
+      if (!interface || interface->dispatch != DROUTE_DISPATCH_METHODS)
+        continue;
+      if (path->query_interface_cb &&
+          !path->query_interface_cb (datum, iface))
+        continue;
+
+      if (!dbus_message_iter_open_container (&iter_out, DBUS_TYPE_DICT_ENTRY, NULL, &iter_out_entry))
+        oom ();
+      dbus_message_iter_append_basic (&iter_out_entry, DBUS_TYPE_STRING, &iface);
+      if (!dbus_message_iter_open_container (&iter_out_entry, DBUS_TYPE_ARRAY, "{sv}", &iter_dict))
+        oom ();
+      append_all_properties (&iter_dict, interface, datum);
+      if (!dbus_message_iter_close_container (&iter_out_entry, &iter_dict))
+        oom ();
+      if (!dbus_message_iter_close_container (&iter_out, &iter_out_entry))
+        oom ();
     }
 
-  if (!dbus_message_iter_close_container (&iter, &iter_dict))
+  if (!dbus_message_iter_close_container (&reply_iter, &iter_out))
     oom ();
   return reply;
 }
@@ -318,7 +463,12 @@ impl_prop_GetSet (DBusMessage *message,
   DBusMessage *reply = NULL;
   DBusError error;
 
-  StrPair pair;
+  struct
+  {
+    const gchar *one;
+    const gchar *two;
+  } pair;
+  DRouteInterface *interface;
   PropertyPair *prop_funcs = NULL;
 
   void *datum;
@@ -340,7 +490,9 @@ impl_prop_GetSet (DBusMessage *message,
 
   _DROUTE_DEBUG ("DRoute (handle prop): %s|%s on %s\n", pair.one, pair.two, pathstr);
 
-  prop_funcs = (PropertyPair *) g_hash_table_lookup (path->properties, &pair);
+  interface = g_hash_table_lookup (path->dispatch, pair.one);
+  if (interface)
+    prop_funcs = (PropertyPair *) g_hash_table_lookup (interface->properties, pair.two);
   if (!prop_funcs)
     {
       DBusMessage *ret;
@@ -452,6 +604,25 @@ handle_properties (DBusConnection *bus,
   return result;
 }
 
+static DBusHandlerResult
+handle_atspi_properties (DBusConnection *bus,
+                         DBusMessage *message,
+                         DRoutePath *path,
+                         const gchar *iface,
+                         const gchar *member,
+                         const gchar *pathstr)
+{
+  DBusMessage *reply;
+
+  if (g_strcmp0 (member, "GetAllMulti"))
+    return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+  reply = impl_prop_GetAllMulti (message, path, pathstr);
+  dbus_connection_send (bus, reply, NULL);
+  dbus_message_unref (reply);
+  return DBUS_HANDLER_RESULT_HANDLED;
+}
+
 /*---------------------------------------------------------------------------*/
 
 static const char *introspection_header =
@@ -531,24 +702,20 @@ static DBusHandlerResult
 handle_other (DBusConnection *bus,
               DBusMessage *message,
               DRoutePath *path,
-              const gchar *iface,
+              DRouteInterface *interface,
               const gchar *member,
               const gchar *pathstr)
 {
   gint result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
 
-  StrPair pair;
   DRouteFunction func;
   DBusMessage *reply = NULL;
 
   void *datum;
 
-  pair.one = iface;
-  pair.two = member;
-
-  _DROUTE_DEBUG ("DRoute (handle other): %s|%s on %s\n", member, iface, pathstr);
+  _DROUTE_DEBUG ("DRoute (handle other): %s|%s on %s\n", member, interface->name, pathstr);
 
-  func = (DRouteFunction) g_hash_table_lookup (path->methods, &pair);
+  func = (DRouteFunction) g_hash_table_lookup (interface->methods, member);
   if (func != NULL)
     {
       datum = path_get_datum (path, pathstr);
@@ -580,6 +747,7 @@ static DBusHandlerResult
 handle_message (DBusConnection *bus, DBusMessage *message, void *user_data)
 {
   DRoutePath *path = (DRoutePath *) user_data;
+  DRouteInterface *interface;
   const gchar *iface = dbus_message_get_interface (message);
   const gchar *member = dbus_message_get_member (message);
   const gint type = dbus_message_get_type (message);
@@ -595,14 +763,29 @@ handle_message (DBusConnection *bus, DBusMessage *message, void *user_data)
       iface == NULL)
     return result;
 
-  if (!strcmp (pathstr, DBUS_PATH_DBUS))
-    result = handle_dbus (bus, message, iface, member, pathstr);
-  else if (!strcmp (iface, "org.freedesktop.DBus.Properties"))
-    result = handle_properties (bus, message, path, iface, member, pathstr);
-  else if (!strcmp (iface, "org.freedesktop.DBus.Introspectable"))
-    result = handle_introspection (bus, message, path, iface, member, pathstr);
-  else
-    result = handle_other (bus, message, path, iface, member, pathstr);
+  /* Only droute_intercept_dbus() registers a handler without a path */
+  if (!path || !strcmp (pathstr, DBUS_PATH_DBUS))
+    return handle_dbus (bus, message, iface, member, pathstr);
+
+  interface = g_hash_table_lookup (path->dispatch, iface);
+  if (!interface)
+    return result;
+
+  switch (interface->dispatch)
+    {
+    case DROUTE_DISPATCH_PROPERTIES:
+      result = handle_properties (bus, message, path, iface, member, pathstr);
+      break;
+    case DROUTE_DISPATCH_ATSPI_PROPERTIES:
+      result = handle_atspi_properties (bus, message, path, iface, member, pathstr);
+      break;
+    case DROUTE_DISPATCH_INTROSPECTION:
+      result = handle_introspection (bus, message, path, iface, member, pathstr);
+      break;
+    default:
+      result = handle_other (bus, message, path, interface, member, pathstr);
+      break;
+    }
 #if 0
     if (result == DBUS_HANDLER_RESULT_NOT_YET_HANDLED)
         g_print ("DRoute | Unhandled message: %s|%s of type %d on %s\n", member, iface, type, pathstr);
@@ -56,6 +56,9 @@ typedef struct _DRouteContext DRouteContext;
 
 typedef struct _DRoutePath DRoutePath;
 
+/* Every path implements GetAllMulti on this interface, see xml/Properties.xml */
+#define DROUTE_INTERFACE_PROPERTIES "org.a11y.atspi.Properties"
+
 /*---------------------------------------------------------------------------*/
 
 DRouteContext *
@@ -23,6 +23,8 @@
 #include "atk_suite.h"
 #include "atk_test_util.h"
 
+#include "atspi/atspi-application-private.h"
+
 #include <libintl.h>
 #define _(x) dgettext ("at-spi2-core", x)
 
@@ -72,6 +74,228 @@ atk_test_accessible_get_child_at_index (TestAppFixture *fixture, gconstpointer u
   g_object_unref (child);
 }
 
+static void
+atk_test_accessible_prefetch (TestAppFixture *fixture, gconstpointer user_data)
+{
+  const gchar *names[] = { "obj1", "obj2", "obj3" };
+  const gchar *descriptions[] = { "first child", "second child", "third child" };
+  AtspiAccessible *obj = fixture->root_obj;
+  GPtrArray *children = g_ptr_array_new_with_free_func (g_object_unref);
+  GError *error = NULL;
+  gint i;
+
+  atspi_accessible_set_cache_mask (obj, ATSPI_CACHE_ALL);
+  for (i = 0; i < 3; i++)
+    {
+      AtspiAccessible *child = atspi_accessible_get_child_at_index (obj, i, NULL);
+      atspi_accessible_clear_cache_single (child);
+      g_ptr_array_add (children, child);
+    }
+
+  g_assert_true (atspi_accessible_prefetch (children,
+                                            ATSPI_CACHE_NAME | ATSPI_CACHE_DESCRIPTION |
+                                                ATSPI_CACHE_ROLE | ATSPI_CACHE_STATES,
+                                            &error));
+  g_assert_no_error (error);
+
+  for (i = 0; i < 3; i++)
+    {
+      AtspiAccessible *child = g_ptr_array_index (children, i);
+      gchar *str;
+
+      g_assert_true (_atspi_accessible_test_cache (child, ATSPI_CACHE_NAME));
+      g_assert_true (_atspi_accessible_test_cache (child, ATSPI_CACHE_DESCRIPTION));
+      check_name (child, names[i]);
+      str = atspi_accessible_get_description (child, NULL);
+      g_assert_cmpstr (str, ==, descriptions[i]);
+      g_free (str);
+    }
+  g_assert_cmpint (atspi_accessible_get_role (g_ptr_array_index (children, 0), NULL), ==, ATSPI_ROLE_ALERT);
+
+  /* What the cache mask leaves out is not kept */
+  atspi_accessible_set_cache_mask (obj, ATSPI_CACHE_NAME | ATSPI_CACHE_ROLE);
+  for (i = 0; i < 3; i++)
+    atspi_accessible_clear_cache_single (g_ptr_array_index (children, i));
+
+  g_assert_true (atspi_accessible_prefetch (children,
+                                            ATSPI_CACHE_NAME | ATSPI_CACHE_DESCRIPTION,
+                                            &error));
+  g_assert_no_error (error);
+
+  for (i = 0; i < 3; i++)
+    {
+      AtspiAccessible *child = g_ptr_array_index (children, i);
+
+      g_assert_true (_atspi_accessible_test_cache (child, ATSPI_CACHE_NAME));
+      g_assert_false (_atspi_accessible_test_cache (child, ATSPI_CACHE_DESCRIPTION));
+    }
+
+  atspi_accessible_set_cache_mask (obj, ATSPI_CACHE_UNDEFINED);
+  g_ptr_array_unref (children);
+}
+
+/*
+ * Calls GetItemsPaged on the application of @obj, adding the paths of the
+ * items to @paths.  Returns the number of items, and stores the number of
+ * removed objects in @n_removed.
+ */
+static guint
+get_items_page (AtspiAccessible *obj,
+                dbus_uint32_t generation,
+                dbus_uint32_t max_items,
+                GHashTable *paths,
+                guint *n_removed,
+                dbus_bool_t *reset,
+                dbus_uint32_t *next_generation,
+                dbus_bool_t *complete)
+{
+  AtspiApplication *app = obj->parent.app;
+  DBusMessage *message, *reply;
+  DBusMessageIter iter, iter_array, iter_struct, iter_ref;
+  guint n_items = 0;
+
+  message = dbus_message_new_method_call (app->bus_name, "/org/a11y/atspi/cache",
+                                          ATSPI_DBUS_INTERFACE_CACHE, "GetItemsPaged");
+  dbus_message_append_args (message,
+                            DBUS_TYPE_UINT32, &generation,
+                            DBUS_TYPE_UINT32, &max_items,
+                            DBUS_TYPE_INVALID);
+  reply = dbus_connection_send_with_reply_and_block (app->bus, message, -1, NULL);
+  dbus_message_unref (message);
+  g_assert_nonnull (reply);
+  g_assert_cmpstr (dbus_message_get_signature (reply), ==, "ba(so)uba((so)(so)(so)iiassusau)");
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_get_basic (&iter, reset);
+  dbus_message_iter_next (&iter);
+  *n_removed = 0;
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      (*n_removed)++;
+      dbus_message_iter_next (&iter_array);
+    }
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, next_generation);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, complete);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      const char *path;
+
+      dbus_message_iter_recurse (&iter_array, &iter_struct);
+      dbus_message_iter_recurse (&iter_struct, &iter_ref);
+      dbus_message_iter_next (&iter_ref);
+      dbus_message_iter_get_basic (&iter_ref, &path);
+      /* An object is only sent once in a chain of pages */
+      g_assert_false (g_hash_table_contains (paths, path));
+      g_hash_table_add (paths, g_strdup (path));
+      n_items++;
+      dbus_message_iter_next (&iter_array);
+    }
+  dbus_message_unref (reply);
+  return n_items;
+}
+
+static void
+atk_test_accessible_get_items_paged (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiApplicationPrivate *priv;
+  GHashTable *paths = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  dbus_uint32_t generation = 0, next_generation;
+  dbus_bool_t reset, complete = FALSE;
+  guint n_removed, n_pages = 0;
+
+  /* The root and its six descendants come in pages of at most two items */
+  while (!complete)
+    {
+      guint n_items = get_items_page (obj, generation, 2, paths, &n_removed,
+                                      &reset, &next_generation, &complete);
+
+      g_assert_false (reset);
+      g_assert_cmpuint (n_removed, ==, 0);
+      g_assert_cmpuint (n_items, <=, 2);
+      g_assert_cmpuint (next_generation, >=, generation);
+      generation = next_generation;
+      n_pages++;
+      g_assert_cmpuint (n_pages, <=, 7);
+    }
+  g_assert_cmpuint (g_hash_table_size (paths), ==, 7);
+  g_assert_cmpuint (n_pages, >=, 4);
+
+  /* Nothing changed since the last page */
+  g_hash_table_remove_all (paths);
+  g_assert_cmpuint (get_items_page (obj, generation, 0, paths, &n_removed,
+                                    &reset, &next_generation, &complete),
+                    ==, 0);
+  g_assert_false (reset);
+  g_assert_cmpuint (n_removed, ==, 0);
+  g_assert_true (complete);
+  g_assert_cmpuint (next_generation, ==, generation);
+
+  /* The chain of requests of the client itself ends too */
+  priv = _atspi_application_get_private (obj->parent.app);
+  while (priv->cache_request)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpuint (priv->cache_generation, >, 0);
+
+  g_hash_table_unref (paths);
+}
+
+static void
+async_result_cb (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  GAsyncResult **result_out = user_data;
+
+  *result_out = g_object_ref (result);
+}
+
+static void
+atk_test_accessible_get_async (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiAccessible *child;
+  GAsyncResult *results[5] = { NULL, };
+  GError *error = NULL;
+  gchar *str;
+  gint i;
+
+  atspi_accessible_clear_cache_single (obj);
+
+  /* All five calls are in flight before any reply is handled */
+  atspi_accessible_get_name_async (obj, NULL, async_result_cb, &results[0]);
+  atspi_accessible_get_description_async (obj, NULL, async_result_cb, &results[1]);
+  atspi_accessible_get_child_count_async (obj, NULL, async_result_cb, &results[2]);
+  atspi_accessible_get_child_at_index_async (obj, 1, NULL, async_result_cb, &results[3]);
+  atspi_accessible_get_role_async (obj, NULL, async_result_cb, &results[4]);
+  for (i = 0; i < 5; i++)
+    while (!results[i])
+      g_main_context_iteration (NULL, TRUE);
+
+  str = atspi_accessible_get_name_finish (obj, results[0], &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (str, ==, "root_object");
+  g_free (str);
+  str = atspi_accessible_get_description_finish (obj, results[1], &error);
+  g_assert_no_error (error);
+  g_assert_cmpstr (str, ==, "Root of the accessible tree");
+  g_free (str);
+  g_assert_cmpint (atspi_accessible_get_child_count_finish (obj, results[2], &error), ==, 3);
+  g_assert_no_error (error);
+  child = atspi_accessible_get_child_at_index_finish (obj, results[3], &error);
+  g_assert_no_error (error);
+  check_name (child, "obj2");
+  g_object_unref (child);
+  g_assert_cmpint (atspi_accessible_get_role_finish (obj, results[4], &error), ==, ATSPI_ROLE_ACCELERATOR_LABEL);
+  g_assert_no_error (error);
+
+  for (i = 0; i < 5; i++)
+    g_object_unref (results[i]);
+}
+
 static void
 atk_test_accessible_get_index_in_parent (TestAppFixture *fixture, gconstpointer user_data)
 {
@@ -201,6 +425,32 @@ atk_test_accessible_get_attributes (TestAppFixture *fixture, gconstpointer user_
   g_hash_table_unref (attr_hash_tab);
 }
 
+static void
+atk_test_accessible_string_pool (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  GHashTable *attributes, *new_attributes;
+  gdouble hit_rate;
+  gsize bytes_saved, new_bytes_saved;
+  gsize shared = sizeof ("atspi1") + sizeof ("test1") + sizeof ("atspi2") + sizeof ("test2");
+
+  attributes = atspi_accessible_get_attributes (obj, NULL);
+  atspi_get_string_pool_stats (NULL, NULL, &bytes_saved);
+
+  /* Attributes fetched again while the old ones are held share their strings */
+  atspi_accessible_clear_cache (obj);
+  new_attributes = atspi_accessible_get_attributes (obj, NULL);
+  g_assert_true (new_attributes != attributes);
+  atspi_get_string_pool_stats (NULL, &hit_rate, &new_bytes_saved);
+  g_assert_cmpfloat (hit_rate, >, 0);
+  g_assert_cmpuint (new_bytes_saved, >=, bytes_saved + shared);
+
+  g_hash_table_unref (attributes);
+  atspi_get_string_pool_stats (NULL, NULL, &bytes_saved);
+  g_assert_cmpuint (bytes_saved, ==, new_bytes_saved - shared);
+  g_hash_table_unref (new_attributes);
+}
+
 static void
 atk_test_accessible_get_attributes_as_array (TestAppFixture *fixture, gconstpointer user_data)
 {
@@ -437,6 +687,8 @@ atk_test_accessible (void)
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_parent, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_child_at_index",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_child_at_index, fixture_teardown);
+  g_test_add ("/accessible/atk_test_accessible_get_async",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_async, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_index_in_parent",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_index_in_parent, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_relation_set_1",
@@ -453,6 +705,8 @@ atk_test_accessible (void)
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_state_set, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_attributes",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_attributes, fixture_teardown);
+  g_test_add ("/accessible/atk_test_accessible_string_pool",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_string_pool, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_attributes_as_array",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_attributes_as_array, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_toolkit_name",
@@ -497,6 +751,10 @@ atk_test_accessible (void)
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_clear_cache, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_process_id",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_process_id, fixture_teardown);
+  g_test_add ("/accessible/atk_test_accessible_prefetch",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_prefetch, fixture_teardown);
+  g_test_add ("/accessible/atk_test_accessible_get_items_paged",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_items_paged, fixture_teardown);
   g_test_add ("/accessible/atk_test_accessible_get_help_text",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_accessible_get_help_text, fixture_teardown);
 }
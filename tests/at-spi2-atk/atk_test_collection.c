@@ -22,8 +22,11 @@
 
 #include "atk_suite.h"
 #include "atk_test_util.h"
+#include "atspi/atspi-matchrule-private.h"
+#include "atspi/atspi-misc-private.h"
 
 #define DATA_FILE TESTS_DATA_DIR "/test-collection.xml"
+#define FLOW_DATA_FILE TESTS_DATA_DIR "/test-collection-flow.xml"
 
 static void
 atk_test_collection_get_collection_iface (TestAppFixture *fixture, gconstpointer user_data)
@@ -122,6 +125,322 @@ atk_test_collection_get_matches_to (TestAppFixture *fixture, gconstpointer user_
   g_object_unref (iface);
 }
 
+static void
+atk_test_collection_get_matches_sorted (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiCollection *iface = atspi_accessible_get_collection_iface (obj);
+  g_assert_nonnull (iface);
+
+  AtspiMatchRule *rule = atspi_match_rule_new (NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               FALSE);
+  GArray *ret = atspi_collection_get_matches (iface,
+                                              rule,
+                                              ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL,
+                                              2,
+                                              TRUE,
+                                              NULL);
+  g_assert_cmpint (2, ==, ret->len);
+  check_and_unref (ret, 0, "obj3/1");
+  check_and_unref (ret, 1, "obj3");
+  g_array_free (ret, TRUE);
+
+  ret = atspi_collection_get_matches (iface,
+                                      rule,
+                                      ATSPI_Collection_SORT_ORDER_REVERSE_CANONICAL,
+                                      0,
+                                      FALSE,
+                                      NULL);
+  g_assert_cmpint (3, ==, ret->len);
+  check_and_unref (ret, 0, "obj3");
+  check_and_unref (ret, 1, "obj2");
+  check_and_unref (ret, 2, "obj1");
+  g_array_free (ret, TRUE);
+
+  /* Without extents, flow order falls back to the order of the children */
+  ret = atspi_collection_get_matches (iface,
+                                      rule,
+                                      ATSPI_Collection_SORT_ORDER_FLOW,
+                                      3,
+                                      TRUE,
+                                      NULL);
+  g_assert_cmpint (3, ==, ret->len);
+  check_and_unref (ret, 0, "obj1");
+  check_and_unref (ret, 1, "obj2");
+  check_and_unref (ret, 2, "obj2/1");
+  g_array_free (ret, TRUE);
+
+  g_object_unref (rule);
+  g_object_unref (iface);
+}
+
+/* The children of the flow fixture are laid out bottom, top right, top
+ * left, middle; their extents use equal x and width, and y and height,
+ * so that they read back the same whichever way round they are stored.
+ */
+static GArray *
+get_matches_in_order (AtspiCollection *iface, AtspiCollectionSortOrder sortby)
+{
+  AtspiMatchRule *rule = atspi_match_rule_new (NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               FALSE);
+  GError *error = NULL;
+  GArray *ret = atspi_collection_get_matches (iface, rule, sortby, 0, TRUE,
+                                              &error);
+
+  g_assert_no_error (error);
+  g_object_unref (rule);
+  return ret;
+}
+
+static void
+atk_test_collection_get_matches_flow (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiCollection *iface = atspi_accessible_get_collection_iface (obj);
+  g_assert_nonnull (iface);
+
+  /* Top to bottom, then left to right, with each child before its own
+   * children
+   */
+  GArray *ret = get_matches_in_order (iface, ATSPI_Collection_SORT_ORDER_FLOW);
+  g_assert_cmpint (5, ==, ret->len);
+  check_and_unref (ret, 0, "top left");
+  check_and_unref (ret, 1, "top right");
+  check_and_unref (ret, 2, "middle");
+  check_and_unref (ret, 3, "middle/1");
+  check_and_unref (ret, 4, "bottom");
+  g_array_free (ret, TRUE);
+
+  ret = get_matches_in_order (iface, ATSPI_Collection_SORT_ORDER_REVERSE_FLOW);
+  g_assert_cmpint (5, ==, ret->len);
+  check_and_unref (ret, 0, "bottom");
+  check_and_unref (ret, 1, "middle/1");
+  check_and_unref (ret, 2, "middle");
+  check_and_unref (ret, 3, "top right");
+  check_and_unref (ret, 4, "top left");
+  g_array_free (ret, TRUE);
+
+  g_object_unref (iface);
+}
+
+static void
+atk_test_collection_get_matches_tab (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiCollection *iface = atspi_accessible_get_collection_iface (obj);
+  g_assert_nonnull (iface);
+
+  /* Tab order is flow order without the objects that cannot take focus */
+  GArray *ret = get_matches_in_order (iface, ATSPI_Collection_SORT_ORDER_TAB);
+  g_assert_cmpint (4, ==, ret->len);
+  check_and_unref (ret, 0, "top left");
+  check_and_unref (ret, 1, "middle");
+  check_and_unref (ret, 2, "middle/1");
+  check_and_unref (ret, 3, "bottom");
+  g_array_free (ret, TRUE);
+
+  ret = get_matches_in_order (iface, ATSPI_Collection_SORT_ORDER_REVERSE_TAB);
+  g_assert_cmpint (4, ==, ret->len);
+  check_and_unref (ret, 0, "bottom");
+  check_and_unref (ret, 1, "middle/1");
+  check_and_unref (ret, 2, "middle");
+  check_and_unref (ret, 3, "top left");
+  g_array_free (ret, TRUE);
+
+  g_object_unref (iface);
+}
+
+/* Checks that the object at index in the array has its properties cached,
+ * and its children as well if children_cached is set.
+ */
+static void
+check_tree_cache (GArray *array, gint index, gboolean children_cached)
+{
+  AtspiAccessible *accessible = g_array_index (array, AtspiAccessible *, index);
+
+  g_assert_true (_atspi_accessible_test_cache (accessible, ATSPI_CACHE_NAME));
+  g_assert_true (_atspi_accessible_test_cache (accessible, ATSPI_CACHE_ROLE));
+  g_assert_true (_atspi_accessible_test_cache (accessible, ATSPI_CACHE_STATES));
+  if (children_cached)
+    g_assert_true (_atspi_accessible_test_cache (accessible, ATSPI_CACHE_CHILDREN));
+  else
+    g_assert_false (_atspi_accessible_test_cache (accessible, ATSPI_CACHE_CHILDREN));
+}
+
+static void
+atk_test_collection_get_tree (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiCollection *iface = atspi_accessible_get_collection_iface (obj);
+  GError *error = NULL;
+  gint i;
+  g_assert_nonnull (iface);
+
+  atspi_accessible_set_cache_mask (obj, ATSPI_CACHE_ALL);
+  atspi_accessible_clear_cache (obj);
+  GArray *ret = atspi_collection_get_tree (iface, 0, 0, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (8, ==, ret->len);
+  for (i = 0; i < 8; i++)
+    check_tree_cache (ret, i, TRUE);
+  g_assert_true (g_array_index (ret, AtspiAccessible *, 0) == obj);
+  g_object_unref (g_array_index (ret, AtspiAccessible *, 0));
+  check_and_unref (ret, 1, "obj1");
+  check_and_unref (ret, 2, "obj2");
+  check_and_unref (ret, 3, "obj2/1");
+  check_and_unref (ret, 4, "obj2/2");
+  check_and_unref (ret, 5, "obj2/3");
+  check_and_unref (ret, 6, "obj3");
+  check_and_unref (ret, 7, "obj3/1");
+  g_array_free (ret, TRUE);
+
+  AtspiAccessible *child = atspi_accessible_get_child_at_index (obj, 1, NULL);
+  g_assert_cmpint (atspi_accessible_get_child_count (child, NULL), ==, 3);
+  g_assert_cmpint (atspi_accessible_get_role (child, NULL), ==, ATSPI_ROLE_ANIMATION);
+  g_object_unref (child);
+
+  /* The children of objects at the cut-off depth are not known */
+  atspi_accessible_clear_cache (obj);
+  ret = atspi_collection_get_tree (iface, 1, 0, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (4, ==, ret->len);
+  check_tree_cache (ret, 0, TRUE);
+  check_tree_cache (ret, 1, TRUE);
+  check_tree_cache (ret, 2, FALSE);
+  check_tree_cache (ret, 3, FALSE);
+  g_object_unref (g_array_index (ret, AtspiAccessible *, 0));
+  check_and_unref (ret, 1, "obj1");
+  check_and_unref (ret, 2, "obj2");
+  check_and_unref (ret, 3, "obj3");
+  g_array_free (ret, TRUE);
+
+  /* Nor are those of objects whose children were cut off by max_nodes */
+  atspi_accessible_clear_cache (obj);
+  ret = atspi_collection_get_tree (iface, 0, 3, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (3, ==, ret->len);
+  check_tree_cache (ret, 0, FALSE);
+  check_tree_cache (ret, 1, TRUE);
+  check_tree_cache (ret, 2, FALSE);
+  g_object_unref (g_array_index (ret, AtspiAccessible *, 0));
+  check_and_unref (ret, 1, "obj1");
+  check_and_unref (ret, 2, "obj2");
+  g_array_free (ret, TRUE);
+
+  atspi_accessible_set_cache_mask (obj, ATSPI_CACHE_UNDEFINED);
+  g_object_unref (iface);
+}
+
+/* Calls GetTreeWithLimits on @collection, which the library does not wrap,
+ * asking only for names, and returns them in a NULL-terminated array.
+ */
+static gchar **
+get_tree_names (AtspiAccessible *collection, gint max_depth, gint max_nodes)
+{
+  DBusMessage *message, *reply;
+  DBusMessageIter iter, iter_array, iter_struct, iter_dict, iter_entry, iter_variant;
+  GPtrArray *names;
+  GError *error = NULL;
+  dbus_int32_t d_max_depth = max_depth;
+  dbus_int32_t d_max_nodes = max_nodes;
+  const char *str = "Name";
+
+  message = dbus_message_new_method_call (collection->parent.app->bus_name,
+                                          collection->parent.path,
+                                          ATSPI_DBUS_INTERFACE_COLLECTION,
+                                          "GetTreeWithLimits");
+  dbus_message_iter_init_append (message, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "s", &iter_array);
+  dbus_message_iter_append_basic (&iter_array, DBUS_TYPE_STRING, &str);
+  dbus_message_iter_close_container (&iter, &iter_array);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &d_max_depth);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &d_max_nodes);
+
+  reply = _atspi_dbus_send_with_reply_and_block (message, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (reply);
+  g_assert_cmpstr (dbus_message_get_signature (reply), ==, "a((so)a{sv})");
+
+  names = g_ptr_array_new ();
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      dbus_message_iter_recurse (&iter_array, &iter_struct);
+      dbus_message_iter_next (&iter_struct);
+
+      /* Only the property that was asked for is sent */
+      dbus_message_iter_recurse (&iter_struct, &iter_dict);
+      g_assert_cmpint (dbus_message_iter_get_arg_type (&iter_dict), ==, DBUS_TYPE_DICT_ENTRY);
+      dbus_message_iter_recurse (&iter_dict, &iter_entry);
+      dbus_message_iter_get_basic (&iter_entry, &str);
+      g_assert_cmpstr (str, ==, "Name");
+      dbus_message_iter_next (&iter_entry);
+      dbus_message_iter_recurse (&iter_entry, &iter_variant);
+      dbus_message_iter_get_basic (&iter_variant, &str);
+      g_ptr_array_add (names, g_strdup (str));
+      dbus_message_iter_next (&iter_dict);
+      g_assert_cmpint (dbus_message_iter_get_arg_type (&iter_dict), ==, DBUS_TYPE_INVALID);
+
+      dbus_message_iter_next (&iter_array);
+    }
+  g_ptr_array_add (names, NULL);
+
+  dbus_message_unref (reply);
+  return (gchar **) g_ptr_array_free (names, FALSE);
+}
+
+static void
+check_tree_names (AtspiAccessible *collection, gint max_depth, gint max_nodes, const gchar *expected)
+{
+  gchar **names = get_tree_names (collection, max_depth, max_nodes);
+  gchar *joined = g_strjoinv (" ", names);
+
+  g_assert_cmpstr (joined, ==, expected);
+  g_free (joined);
+  g_strfreev (names);
+}
+
+static void
+atk_test_collection_get_tree_with_limits (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiAccessible *child = atspi_accessible_get_child_at_index (obj, 1, NULL);
+
+  /* No limits, or limits that are not positive */
+  check_tree_names (obj, 0, 0, "root_object obj1 obj2 obj2/1 obj2/2 obj2/3 obj3 obj3/1");
+  check_tree_names (obj, -1, -1, "root_object obj1 obj2 obj2/1 obj2/2 obj2/3 obj3 obj3/1");
+
+  /* Cut off by depth: only the direct children of the root */
+  check_tree_names (obj, 1, 0, "root_object obj1 obj2 obj3");
+  check_tree_names (obj, 2, 0, "root_object obj1 obj2 obj2/1 obj2/2 obj2/3 obj3 obj3/1");
+
+  /* Cut off by the number of objects, in canonical order */
+  check_tree_names (obj, 0, 1, "root_object");
+  check_tree_names (obj, 0, 4, "root_object obj1 obj2 obj2/1");
+  check_tree_names (obj, 0, 7, "root_object obj1 obj2 obj2/1 obj2/2 obj2/3 obj3");
+
+  /* Both, with the depth counted from the collection */
+  check_tree_names (obj, 1, 2, "root_object obj1");
+  check_tree_names (child, 1, 3, "obj2 obj2/1 obj2/2");
+
+  g_object_unref (child);
+}
+
 static void
 do_interface_test (AtspiCollection *iface, AtspiAccessible *start, const char *str, gint expected)
 {
@@ -245,6 +564,179 @@ atk_test_collection_get_matches_from (TestAppFixture *fixture, gconstpointer use
   g_object_unref (iface);
 }
 
+/* Calls GetMatchesPaged on @collection, which the library does not wrap,
+ * and returns the paths of the matches in a NULL-terminated array.
+ */
+static gchar **
+get_matches_paged (AtspiAccessible *collection,
+                   AtspiMatchRule *rule,
+                   gint count,
+                   const gchar *token,
+                   gchar **next_token,
+                   GError **error)
+{
+  DBusMessage *message, *reply;
+  DBusMessageIter iter, iter_array, iter_struct;
+  GPtrArray *paths;
+  dbus_int32_t d_count = count;
+  dbus_bool_t traverse = TRUE;
+  const char *str;
+
+  message = dbus_message_new_method_call (collection->parent.app->bus_name,
+                                          collection->parent.path,
+                                          ATSPI_DBUS_INTERFACE_COLLECTION,
+                                          "GetMatchesPaged");
+  dbus_message_iter_init_append (message, &iter);
+  _atspi_match_rule_marshal (rule, &iter);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &d_count);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_BOOLEAN, &traverse);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_STRING, &token);
+
+  reply = _atspi_dbus_send_with_reply_and_block (message, error);
+  if (!reply)
+    return NULL;
+  if (dbus_message_get_type (reply) == DBUS_MESSAGE_TYPE_ERROR)
+    {
+      g_set_error_literal (error, ATSPI_ERROR, ATSPI_ERROR_IPC,
+                           dbus_message_get_error_name (reply));
+      dbus_message_unref (reply);
+      return NULL;
+    }
+  g_assert_cmpstr (dbus_message_get_signature (reply), ==, "a(so)s");
+
+  paths = g_ptr_array_new ();
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      dbus_message_iter_recurse (&iter_array, &iter_struct);
+      dbus_message_iter_next (&iter_struct);
+      dbus_message_iter_get_basic (&iter_struct, &str);
+      g_ptr_array_add (paths, g_strdup (str));
+      dbus_message_iter_next (&iter_array);
+    }
+  g_ptr_array_add (paths, NULL);
+  dbus_message_iter_next (&iter);
+  dbus_message_iter_get_basic (&iter, &str);
+  *next_token = g_strdup (str);
+
+  dbus_message_unref (reply);
+  return (gchar **) g_ptr_array_free (paths, FALSE);
+}
+
+static void
+atk_test_collection_get_matches_paged (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiCollection *iface = atspi_accessible_get_collection_iface (obj);
+  GError *error = NULL;
+  gchar *token, *next_token;
+  gchar **paths;
+  guint n = 0, n_pages = 0;
+  guint i;
+  g_assert_nonnull (iface);
+
+  AtspiMatchRule *rule = atspi_match_rule_new (NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               FALSE);
+  GArray *expected = atspi_collection_get_matches (iface,
+                                                   rule,
+                                                   ATSPI_Collection_SORT_ORDER_CANONICAL,
+                                                   0,
+                                                   TRUE,
+                                                   NULL);
+  g_assert_cmpint (7, ==, expected->len);
+
+  /* Pages of three, each resumed from the token of the previous one */
+  token = g_strdup ("");
+  do
+    {
+      paths = get_matches_paged (obj, rule, 3, token, &next_token, &error);
+      g_assert_no_error (error);
+      for (i = 0; paths[i]; i++, n++)
+        {
+          g_assert_cmpuint (n, <, expected->len);
+          g_assert_cmpstr (paths[i], ==, g_array_index (expected, AtspiAccessible *, n)->parent.path);
+        }
+      g_assert_cmpuint (i, ==, (next_token[0] ? 3 : 1));
+      n_pages++;
+      g_strfreev (paths);
+      g_free (token);
+      token = next_token;
+    }
+  while (token[0]);
+  g_free (token);
+  g_assert_cmpuint (n, ==, 7);
+  g_assert_cmpuint (n_pages, ==, 3);
+
+  /* A full last page still has a token; the page after it is empty */
+  paths = get_matches_paged (obj, rule, 7, "", &token, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_strv_length (paths), ==, 7);
+  g_assert_cmpstr (token, !=, "");
+  g_strfreev (paths);
+  paths = get_matches_paged (obj, rule, 7, token, &next_token, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_strv_length (paths), ==, 0);
+  g_assert_cmpstr (next_token, ==, "");
+  g_strfreev (paths);
+  g_free (next_token);
+  g_free (token);
+
+  for (i = 0; i < expected->len; i++)
+    g_object_unref (g_array_index (expected, AtspiAccessible *, i));
+  g_array_free (expected, TRUE);
+  g_object_unref (rule);
+  g_object_unref (iface);
+}
+
+static void
+atk_test_collection_get_matches_paged_invalid_token (TestAppFixture *fixture, gconstpointer user_data)
+{
+  AtspiAccessible *obj = fixture->root_obj;
+  AtspiAccessible *child1 = atspi_accessible_get_child_at_index (obj, 1, NULL);
+  AtspiAccessible *child2 = atspi_accessible_get_child_at_index (obj, 2, NULL);
+  GError *error = NULL;
+  gchar *token = NULL;
+
+  AtspiMatchRule *rule = atspi_match_rule_new (NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               NULL,
+                                               ATSPI_Collection_MATCH_ALL,
+                                               FALSE);
+
+  /* An object that is gone, or was never there */
+  g_assert_null (get_matches_paged (obj, rule, 3, "/org/a11y/atspi/accessible/999999",
+                                    &token, &error));
+  g_assert_error (error, ATSPI_ERROR, ATSPI_ERROR_IPC);
+  g_clear_error (&error);
+
+  /* An object outside of the collection */
+  g_assert_null (get_matches_paged (child1, rule, 3, child2->parent.path, &token, &error));
+  g_assert_error (error, ATSPI_ERROR, ATSPI_ERROR_IPC);
+  g_clear_error (&error);
+
+  /* The collection itself */
+  g_assert_null (get_matches_paged (child1, rule, 3, child1->parent.path, &token, &error));
+  g_assert_error (error, ATSPI_ERROR, ATSPI_ERROR_IPC);
+  g_clear_error (&error);
+  g_assert_null (token);
+
+  g_object_unref (rule);
+  g_object_unref (child2);
+  g_object_unref (child1);
+}
+
 void
 atk_test_collection (void)
 {
@@ -252,8 +744,22 @@ atk_test_collection (void)
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_collection_iface, fixture_teardown);
   g_test_add ("/collection/atk_test_collection_get_matches",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_matches, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_matches_sorted",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_matches_sorted, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_matches_flow",
+              TestAppFixture, FLOW_DATA_FILE, fixture_setup, atk_test_collection_get_matches_flow, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_matches_tab",
+              TestAppFixture, FLOW_DATA_FILE, fixture_setup, atk_test_collection_get_matches_tab, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_tree",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_tree, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_tree_with_limits",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_tree_with_limits, fixture_teardown);
   g_test_add ("/collection/atk_test_collection_get_matches_to",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_matches_to, fixture_teardown);
   g_test_add ("/collection/atk_test_collection_get_matches_from",
               TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_matches_from, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_matches_paged",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_matches_paged, fixture_teardown);
+  g_test_add ("/collection/atk_test_collection_get_matches_paged_invalid_token",
+              TestAppFixture, DATA_FILE, fixture_setup, atk_test_collection_get_matches_paged_invalid_token, fixture_teardown);
 }
@@ -0,0 +1,915 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Checks the ATK bridge from inside the application, by changing the ATK
+ * tree and looking at what the bridge sends.  The bridge is its own
+ * client: calls are made to its own bus name, and its signals come back
+ * to it.  Needs an accessibility bus; skipped if the bridge cannot connect.
+ */
+
+#include "accessible-cache.h"
+#include "accessible-leasing.h"
+#include "accessible-register.h"
+#include "atspi/atspi-constants.h"
+#include "bridge.h"
+#include "event.h"
+#include "my-atk.h"
+#include <atk-bridge.h>
+#include <atk/atk.h>
+#include <dbus/dbus.h>
+#include <glib.h>
+#include <string.h>
+
+static AtkObject *root_accessible;
+
+/*
+ * The number of each signal of the Cache interface received, and of each
+ * object event, by member and detail as in "TextChanged:delete/system"
+ */
+static GHashTable *signal_counts;
+
+static AtkObject *
+get_root (void)
+{
+  return root_accessible;
+}
+
+static const gchar *
+get_toolkit_name (void)
+{
+  return "atspitesting-toolkit";
+}
+
+static void
+setup_atk_util (void)
+{
+  AtkUtilClass *klass;
+
+  klass = g_type_class_ref (ATK_TYPE_UTIL);
+  klass->get_root = get_root;
+  klass->get_toolkit_name = get_toolkit_name;
+  g_type_class_unref (klass);
+}
+
+static DBusHandlerResult
+signal_filter (DBusConnection *bus, DBusMessage *message, void *data)
+{
+  if (dbus_message_get_type (message) == DBUS_MESSAGE_TYPE_SIGNAL &&
+      !g_strcmp0 (dbus_message_get_interface (message), ATSPI_DBUS_INTERFACE_CACHE))
+    {
+      const char *member = dbus_message_get_member (message);
+      guint count = GPOINTER_TO_UINT (g_hash_table_lookup (signal_counts, member));
+
+      g_hash_table_replace (signal_counts, g_strdup (member),
+                            GUINT_TO_POINTER (count + 1));
+    }
+  else if (dbus_message_get_type (message) == DBUS_MESSAGE_TYPE_SIGNAL &&
+           !g_strcmp0 (dbus_message_get_interface (message), ATSPI_DBUS_INTERFACE_EVENT_OBJECT))
+    {
+      DBusMessageIter iter;
+      const char *detail = "";
+      gchar *key;
+      guint count;
+
+      dbus_message_iter_init (message, &iter);
+      if (dbus_message_iter_get_arg_type (&iter) == DBUS_TYPE_STRING)
+        dbus_message_iter_get_basic (&iter, &detail);
+      key = g_strconcat (dbus_message_get_member (message), ":", detail, NULL);
+      count = GPOINTER_TO_UINT (g_hash_table_lookup (signal_counts, key));
+      g_hash_table_replace (signal_counts, key, GUINT_TO_POINTER (count + 1));
+    }
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* Returns how many times @member was received since the last call */
+static guint
+take_signal_count (const char *member)
+{
+  guint count = GPOINTER_TO_UINT (g_hash_table_lookup (signal_counts, member));
+
+  g_hash_table_remove (signal_counts, member);
+  return count;
+}
+
+/* Lets everything that was sent so far come back and be handled */
+static void
+settle (void)
+{
+  DBusConnection *bus = spi_global_app_data->bus;
+  gint i;
+
+  /* Handling a message may send another one, so go around a few times */
+  for (i = 0; i < 4; i++)
+    {
+      DBusMessage *message, *reply;
+
+      while (g_main_context_iteration (NULL, FALSE))
+        ;
+      /* The bus keeps messages in order, so what we sent has come back to
+       * us by the time that the reply to a later call has */
+      message = dbus_message_new_method_call (DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                                              DBUS_INTERFACE_DBUS, "GetId");
+      reply = dbus_connection_send_with_reply_and_block (bus, message, -1, NULL);
+      dbus_message_unref (message);
+      if (reply)
+        dbus_message_unref (reply);
+      while (dbus_connection_dispatch (bus) == DBUS_DISPATCH_DATA_REMAINS)
+        ;
+      while (g_main_context_iteration (NULL, FALSE))
+        ;
+    }
+}
+
+/* Makes us a client of the bridge, and waits for the cache to be filled */
+static void
+activate (void)
+{
+  spi_atk_add_client (dbus_bus_get_unique_name (spi_global_app_data->bus));
+  while (spi_global_cache->populating)
+    g_main_context_iteration (NULL, TRUE);
+  settle ();
+}
+
+/* Sends @message, which it takes, to the bridge and returns the reply */
+static DBusMessage *
+send_call (DBusMessage *message)
+{
+  DBusConnection *bus = spi_global_app_data->bus;
+  DBusMessage *reply;
+  DBusPendingCall *pending = NULL;
+
+  /* Blocking would keep the bridge from answering, so wait for the reply
+   * while handling the call */
+  dbus_connection_send_with_reply (bus, message, &pending, -1);
+  dbus_message_unref (message);
+  g_assert_nonnull (pending);
+  settle ();
+  g_assert_true (dbus_pending_call_get_completed (pending));
+  reply = dbus_pending_call_steal_reply (pending);
+  dbus_pending_call_unref (pending);
+  g_assert_cmpint (dbus_message_get_type (reply), ==, DBUS_MESSAGE_TYPE_METHOD_RETURN);
+  return reply;
+}
+
+/* Calls a method of the cache of the bridge and returns the reply */
+static DBusMessage *
+call_cache (const char *member, int first_arg_type, ...)
+{
+  DBusConnection *bus = spi_global_app_data->bus;
+  DBusMessage *message;
+  va_list args;
+
+  message = dbus_message_new_method_call (dbus_bus_get_unique_name (bus),
+                                          "/org/a11y/atspi/cache",
+                                          ATSPI_DBUS_INTERFACE_CACHE, member);
+  va_start (args, first_arg_type);
+  dbus_message_append_args_valist (message, first_arg_type, args);
+  va_end (args);
+  return send_call (message);
+}
+
+/* Adds a new child to @parent, which holds the only reference to it */
+static AtkObject *
+add_child (AtkObject *parent)
+{
+  AtkObject *child = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+
+  atk_object_set_role (child, ATK_ROLE_LABEL);
+  my_atk_object_add_child (MY_ATK_OBJECT (parent), MY_ATK_OBJECT (child));
+  g_object_unref (child);
+  return child;
+}
+
+static void
+add_children (gint n)
+{
+  gint i;
+
+  for (i = 0; i < n; i++)
+    add_child (root_accessible);
+}
+
+/* Removes the last @n children of the root, which destroys them */
+static void
+remove_children (gint n)
+{
+  MyAtkObject *root = MY_ATK_OBJECT (root_accessible);
+  gint i;
+
+  for (i = 0; i < n; i++)
+    my_atk_object_remove_child (root, g_ptr_array_index (root->children,
+                                                         root->children->len - 1));
+}
+
+static void
+test_cache_signals (void)
+{
+  const char *fake_client = ":0.fake";
+  dbus_uint32_t generation = 0, max_items = 0;
+
+  /* A client that has not called GetItemsPaged gets one signal per object */
+  activate ();
+  take_signal_count ("AddAccessible");
+  add_children (3);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 3);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 0);
+  remove_children (2);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("RemoveAccessible"), ==, 2);
+  g_assert_cmpuint (take_signal_count ("RemoveAccessibles"), ==, 0);
+
+  /* Once it called GetItemsPaged, it gets them in batches */
+  dbus_message_unref (call_cache ("GetItemsPaged",
+                                  DBUS_TYPE_UINT32, &generation,
+                                  DBUS_TYPE_UINT32, &max_items,
+                                  DBUS_TYPE_INVALID));
+  add_children (3);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 0);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 1);
+  remove_children (2);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("RemoveAccessible"), ==, 0);
+  g_assert_cmpuint (take_signal_count ("RemoveAccessibles"), ==, 1);
+
+  /* A lone object always gets the single-object signal */
+  add_children (1);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 0);
+
+  /* Any other client that did not opt in brings the single signals back */
+  spi_atk_add_client (fake_client);
+  add_children (2);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 2);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 0);
+  spi_atk_remove_client (fake_client);
+  add_children (2);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 0);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 1);
+}
+
+/*
+ * Asks GetProperties for @property of @obj.  Returns the reply, with
+ * @iter_value pointing to the value.
+ */
+static DBusMessage *
+get_property (AtkObject *obj, const char *property, DBusMessageIter *iter_value)
+{
+  gchar *path = spi_register_object_to_path (spi_global_register, G_OBJECT (obj));
+  const char **paths = (const char **) &path;
+  const char **properties = &property;
+  DBusMessage *reply;
+  DBusMessageIter iter, iter_array, iter_dict, iter_entry;
+  const char *name;
+
+  reply = call_cache ("GetProperties",
+                      DBUS_TYPE_ARRAY, DBUS_TYPE_OBJECT_PATH, &paths, 1,
+                      DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &properties, 1,
+                      DBUS_TYPE_INVALID);
+  g_free (path);
+
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  dbus_message_iter_recurse (&iter_array, &iter_dict);
+  g_assert_cmpint (dbus_message_iter_get_arg_type (&iter_dict), ==, DBUS_TYPE_DICT_ENTRY);
+  dbus_message_iter_recurse (&iter_dict, &iter_entry);
+  dbus_message_iter_get_basic (&iter_entry, &name);
+  g_assert_cmpstr (name, ==, property);
+  dbus_message_iter_next (&iter_entry);
+  dbus_message_iter_recurse (&iter_entry, iter_value);
+  return reply;
+}
+
+static void
+check_string_property (AtkObject *obj, const char *property, const char *expected)
+{
+  DBusMessageIter iter;
+  DBusMessage *reply = get_property (obj, property, &iter);
+  const char *str;
+
+  dbus_message_iter_get_basic (&iter, &str);
+  g_assert_cmpstr (str, ==, expected);
+  dbus_message_unref (reply);
+}
+
+/* For the properties of type u or i */
+static gint64
+get_number_property (AtkObject *obj, const char *property)
+{
+  DBusMessageIter iter;
+  DBusMessage *reply = get_property (obj, property, &iter);
+  gint64 value;
+
+  if (dbus_message_iter_get_arg_type (&iter) == DBUS_TYPE_UINT32)
+    {
+      dbus_uint32_t u;
+      dbus_message_iter_get_basic (&iter, &u);
+      value = u;
+    }
+  else
+    {
+      dbus_int32_t i;
+      g_assert_cmpint (dbus_message_iter_get_arg_type (&iter), ==, DBUS_TYPE_INT32);
+      dbus_message_iter_get_basic (&iter, &i);
+      value = i;
+    }
+  dbus_message_unref (reply);
+  return value;
+}
+
+static gboolean
+has_state (AtkObject *obj, AtspiStateType state)
+{
+  DBusMessageIter iter, iter_array;
+  DBusMessage *reply = get_property (obj, "State", &iter);
+  dbus_uint32_t states[2];
+
+  dbus_message_iter_recurse (&iter, &iter_array);
+  dbus_message_iter_get_basic (&iter_array, &states[0]);
+  dbus_message_iter_next (&iter_array);
+  dbus_message_iter_get_basic (&iter_array, &states[1]);
+  dbus_message_unref (reply);
+  return (states[state / 32] & (1u << (state % 32))) != 0;
+}
+
+/*
+ * The bridge keeps what it sent about each object, and must build it again
+ * after each change that the toolkit signals.
+ */
+static void
+test_cache_records (void)
+{
+  AtkObject *container, *first, *second;
+  AtkStateSet *set;
+
+  activate ();
+  container = add_child (root_accessible);
+  first = add_child (container);
+  second = add_child (container);
+  settle ();
+
+  atk_object_set_name (second, "old name");
+  check_string_property (second, "Name", "old name");
+  atk_object_set_name (second, "new name");
+  check_string_property (second, "Name", "new name");
+
+  atk_object_set_description (second, "old description");
+  check_string_property (second, "Description", "old description");
+  atk_object_set_description (second, "new description");
+  check_string_property (second, "Description", "new description");
+
+  g_assert_cmpint (get_number_property (second, "Role"), ==, ATSPI_ROLE_LABEL);
+  atk_object_set_role (second, ATK_ROLE_PUSH_BUTTON);
+  g_assert_cmpint (get_number_property (second, "Role"), ==, ATSPI_ROLE_PUSH_BUTTON);
+
+  /* A state set changed behind the back of the bridge is not seen until
+   * the change is signalled, which shows that the record is kept */
+  g_assert_false (has_state (second, ATSPI_STATE_CHECKED));
+  set = atk_object_ref_state_set (second);
+  atk_state_set_add_state (set, ATK_STATE_CHECKED);
+  g_object_unref (set);
+  g_assert_false (has_state (second, ATSPI_STATE_CHECKED));
+  atk_object_notify_state_change (second, ATK_STATE_CHECKED, TRUE);
+  g_assert_true (has_state (second, ATSPI_STATE_CHECKED));
+
+  g_assert_cmpint (get_number_property (second, "ChildCount"), ==, 0);
+  add_child (second);
+  g_assert_cmpint (get_number_property (second, "ChildCount"), ==, 1);
+
+  /* Removing a sibling before it changes its index */
+  g_assert_cmpint (get_number_property (second, "IndexInParent"), ==, 1);
+  my_atk_object_remove_child (MY_ATK_OBJECT (container), MY_ATK_OBJECT (first));
+  g_assert_cmpint (get_number_property (second, "IndexInParent"), ==, 0);
+
+  my_atk_object_remove_child (MY_ATK_OBJECT (root_accessible), MY_ATK_OBJECT (container));
+  settle ();
+}
+
+/*
+ * A slot of the register is reused once its object is gone, with a new
+ * generation so that the old path does not find the new object.
+ */
+static void
+test_register_reuse (void)
+{
+  guint n_registered = spi_global_register->n_registered;
+  AtkObject *obj = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  gchar *old_path, *wrong_path;
+  const gchar *new_path;
+  gsize slot_length;
+
+  old_path = spi_register_object_to_path (spi_global_register, G_OBJECT (obj));
+  g_assert_cmpuint (spi_global_register->n_registered, ==, n_registered + 1);
+  g_object_unref (obj);
+  g_assert_cmpuint (spi_global_register->n_registered, ==, n_registered);
+  g_assert_null (spi_register_path_to_object (spi_global_register, old_path));
+
+  obj = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  new_path = spi_register_object_to_static_path (spi_global_register, G_OBJECT (obj));
+  g_assert_cmpstr (old_path, !=, new_path);
+  /* The part before the generation names the slot */
+  slot_length = strcspn (old_path, "_");
+  g_assert_true (strncmp (old_path, new_path, slot_length) == 0);
+  g_assert_cmpint (new_path[slot_length], ==, '_');
+  g_assert_null (spi_register_path_to_object (spi_global_register, old_path));
+  g_assert_true (spi_register_path_to_object (spi_global_register, new_path) ==
+                 G_OBJECT (obj));
+
+  wrong_path = g_strdup_printf ("%.*s_1000", (int) slot_length, old_path);
+  g_assert_null (spi_register_path_to_object (spi_global_register, wrong_path));
+  g_free (wrong_path);
+
+  g_object_unref (obj);
+  g_assert_cmpuint (spi_global_register->n_registered, ==, n_registered);
+  g_free (old_path);
+}
+
+typedef struct
+{
+  SpiLeasing *leasing;
+  GObject *object;
+} LeaseRenewal;
+
+static gboolean
+renew_lease (gpointer data)
+{
+  LeaseRenewal *renewal = data;
+
+  spi_leasing_take (renewal->leasing, renewal->object);
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+quit_loop (gpointer data)
+{
+  g_main_loop_quit (data);
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+lease_timed_out (gpointer data)
+{
+  g_error ("the lease did not end");
+  return G_SOURCE_REMOVE;
+}
+
+static void
+quit_on_finalize (gpointer data, GObject *where_the_object_was)
+{
+  g_main_loop_quit (data);
+}
+
+/*
+ * A lease keeps its object alive for the lease time after it was last
+ * taken, and is then released by the expiry timeout.
+ */
+static void
+test_leasing (void)
+{
+  SpiLeasing *leasing = g_object_new (SPI_LEASING_TYPE, NULL);
+  GMainLoop *loop = g_main_loop_new (NULL, FALSE);
+  GObject *once = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  GObject *renewed = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  LeaseRenewal renewal = { leasing, renewed };
+  guint n_leases, peak_leases, renew_id, timeout_id;
+  gint64 start;
+
+  leasing->lease_time_s = 1;
+  g_object_add_weak_pointer (once, (gpointer *) &once);
+  g_object_add_weak_pointer (renewed, (gpointer *) &renewed);
+
+  /* An object holds one lease however often it is taken */
+  g_assert_true (spi_leasing_take (leasing, once) == once);
+  g_assert_true (spi_leasing_take (leasing, renewed) == renewed);
+  spi_leasing_take (leasing, renewed);
+  spi_leasing_get_counters (leasing, &n_leases, &peak_leases);
+  g_assert_cmpuint (n_leases, ==, 2);
+  g_assert_cmpuint (peak_leases, ==, 2);
+  g_object_unref (once);
+  g_object_unref (renewed);
+  g_assert_nonnull (once);
+  g_assert_nonnull (renewed);
+
+  /* The timeout runs within a second of the expiry time, so by then the
+   * lease that was not renewed has ended */
+  renew_id = g_timeout_add (250, renew_lease, &renewal);
+  g_timeout_add_seconds (4, quit_loop, loop);
+  g_main_loop_run (loop);
+  g_assert_null (once);
+  g_assert_nonnull (renewed);
+  spi_leasing_get_counters (leasing, &n_leases, &peak_leases);
+  g_assert_cmpuint (n_leases, ==, 1);
+  g_assert_cmpuint (peak_leases, ==, 2);
+
+  /* Once no longer renewed, the lease lasts for at least the lease time
+   * after it was last taken */
+  g_source_remove (renew_id);
+  start = g_get_monotonic_time ();
+  g_object_weak_ref (renewed, quit_on_finalize, loop);
+  timeout_id = g_timeout_add_seconds (10, lease_timed_out, NULL);
+  g_main_loop_run (loop);
+  g_source_remove (timeout_id);
+  g_assert_null (renewed);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 750000);
+  spi_leasing_get_counters (leasing, &n_leases, &peak_leases);
+  g_assert_cmpuint (n_leases, ==, 0);
+  g_assert_cmpuint (peak_leases, ==, 2);
+
+  /* Disposing of the leasing ends the leases at once */
+  once = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  g_object_add_weak_pointer (once, (gpointer *) &once);
+  spi_leasing_take (leasing, once);
+  g_object_unref (once);
+  g_object_run_dispose (G_OBJECT (leasing));
+  g_assert_null (once);
+  spi_leasing_get_counters (leasing, &n_leases, NULL);
+  g_assert_cmpuint (n_leases, ==, 0);
+
+  g_object_unref (leasing);
+  g_main_loop_unref (loop);
+}
+
+/*
+ * Tells the bridge that we started or stopped listening for @event, as the
+ * registry would
+ */
+static void
+send_listener_signal (const char *member, const char *event)
+{
+  DBusConnection *bus = spi_global_app_data->bus;
+  const char *name = dbus_bus_get_unique_name (bus);
+  DBusMessage *signal;
+
+  signal = dbus_message_new_signal (ATSPI_DBUS_PATH_REGISTRY,
+                                    ATSPI_DBUS_INTERFACE_REGISTRY, member);
+  dbus_message_append_args (signal, DBUS_TYPE_STRING, &name,
+                            DBUS_TYPE_STRING, &event, DBUS_TYPE_INVALID);
+  dbus_connection_send (bus, signal, NULL);
+  dbus_message_unref (signal);
+  settle ();
+}
+
+/* Returns how many TextChanged events were sent for a Gecko-style removal */
+static guint
+count_text_removed (AtkObject *text)
+{
+  g_signal_emit_by_name (text, "text-remove::system", 0, 1, "a");
+  settle ();
+  return take_signal_count ("TextChanged:delete/system");
+}
+
+/*
+ * Events are only sent when someone listens for them.  The detail that
+ * Gecko adds after the minor name, as in "delete:system", is matched on
+ * the part before the colon.
+ */
+static void
+test_event_listeners (void)
+{
+  AtkObject *text = g_object_new (MY_TYPE_ATK_TEXT, NULL);
+
+  activate ();
+  g_assert_true (spi_global_app_data->events_initialized);
+  g_assert_cmpuint (count_text_removed (text), ==, 0);
+
+  send_listener_signal ("EventListenerRegistered", "Object:TextChanged:Insert");
+  g_assert_cmpuint (count_text_removed (text), ==, 0);
+
+  send_listener_signal ("EventListenerRegistered", "Object:TextChanged:Delete");
+  g_assert_cmpuint (count_text_removed (text), ==, 1);
+
+  send_listener_signal ("EventListenerDeregistered", "Object:TextChanged:Delete");
+  g_assert_cmpuint (count_text_removed (text), ==, 0);
+
+  /* A listener for the whole major name gets every minor name */
+  send_listener_signal ("EventListenerRegistered", "Object:TextChanged");
+  g_assert_cmpuint (count_text_removed (text), ==, 1);
+
+  send_listener_signal ("EventListenerDeregistered", "Object:TextChanged");
+  g_assert_cmpuint (count_text_removed (text), ==, 0);
+  send_listener_signal ("EventListenerDeregistered", "Object:TextChanged:Insert");
+  g_object_unref (text);
+}
+
+/* Emits @n bounds changes and @n visible data changes of @obj */
+static void
+emit_burst (AtkObject *obj, gint n)
+{
+  gint i;
+
+  for (i = 0; i < n; i++)
+    {
+      AtkRectangle rect = { i, i, 10, 10 };
+
+      g_signal_emit_by_name (obj, "bounds-changed", &rect);
+      g_signal_emit_by_name (obj, "visible-data-changed");
+    }
+}
+
+/* Waits past the coalescing interval, so that queued events are sent */
+static void
+settle_queued_events (void)
+{
+  g_usleep (50 * 1000);
+  settle ();
+}
+
+/* Registers the event listeners of the bridge again, with @classes as
+ * ATSPI_COALESCE_EVENTS */
+static void
+set_coalesce_classes (const char *classes)
+{
+  spi_atk_deregister_event_listeners ();
+  g_setenv ("ATSPI_COALESCE_EVENTS", classes, TRUE);
+  spi_atk_register_event_listeners ();
+  g_unsetenv ("ATSPI_COALESCE_EVENTS");
+}
+
+static void
+test_event_coalescing (void)
+{
+  AtkObject *obj = g_object_new (MY_TYPE_ATK_COMPONENT, NULL);
+
+  activate ();
+  send_listener_signal ("EventListenerRegistered", "Object:BoundsChanged");
+  send_listener_signal ("EventListenerRegistered", "Object:VisibleDataChanged");
+
+  /* A burst is sent as one event of each kind */
+  emit_burst (obj, 5);
+  settle_queued_events ();
+  g_assert_cmpuint (take_signal_count ("BoundsChanged:"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("VisibleDataChanged:"), ==, 1);
+
+  /* Any other event sends the queue first, without waiting; what is queued
+   * after it is sent after its own interval */
+  emit_burst (obj, 5);
+  atk_object_notify_state_change (obj, ATK_STATE_BUSY, TRUE);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("BoundsChanged:"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("VisibleDataChanged:"), ==, 1);
+  emit_burst (obj, 5);
+  settle_queued_events ();
+  g_assert_cmpuint (take_signal_count ("BoundsChanged:"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("VisibleDataChanged:"), ==, 1);
+
+  /* "none" turns merging off */
+  set_coalesce_classes ("none");
+  emit_burst (obj, 5);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("BoundsChanged:"), ==, 5);
+  g_assert_cmpuint (take_signal_count ("VisibleDataChanged:"), ==, 5);
+
+  /* A class can be turned on alone */
+  set_coalesce_classes ("visible-data-changed");
+  emit_burst (obj, 5);
+  settle_queued_events ();
+  g_assert_cmpuint (take_signal_count ("BoundsChanged:"), ==, 5);
+  g_assert_cmpuint (take_signal_count ("VisibleDataChanged:"), ==, 1);
+
+  set_coalesce_classes ("bounds-changed,visible-data-changed");
+  send_listener_signal ("EventListenerDeregistered", "Object:BoundsChanged");
+  send_listener_signal ("EventListenerDeregistered", "Object:VisibleDataChanged");
+  g_object_unref (obj);
+}
+
+/*
+ * PopulationProgress is throttled but for the last one, and a client that
+ * fetched a page while the cache was being filled is sent the rest
+ */
+static void
+test_population_signals (void)
+{
+  dbus_uint32_t generation = 0, max_items = 0;
+
+  activate ();
+  g_usleep (150 * 1000);
+  take_signal_count ("PopulationProgress");
+  take_signal_count ("AddAccessibles");
+
+  g_signal_emit_by_name (spi_global_cache, "population-progress", 10, 3);
+  g_signal_emit_by_name (spi_global_cache, "population-progress", 11, 2);
+  g_signal_emit_by_name (spi_global_cache, "population-progress", 12, 1);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("PopulationProgress"), ==, 1);
+  g_signal_emit_by_name (spi_global_cache, "population-progress", 13, 0);
+  settle ();
+  g_assert_cmpuint (take_signal_count ("PopulationProgress"), ==, 1);
+
+  /* The objects cached during the population are only signalled to a
+   * client that fetched a page meanwhile, once it is over */
+  spi_global_cache->populating = TRUE;
+  dbus_message_unref (call_cache ("GetItemsPaged",
+                                  DBUS_TYPE_UINT32, &generation,
+                                  DBUS_TYPE_UINT32, &max_items,
+                                  DBUS_TYPE_INVALID));
+  add_children (3);
+  settle ();
+  g_assert_false (spi_global_cache->populating);
+  g_assert_cmpuint (take_signal_count ("PopulationProgress"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 0);
+
+  spi_global_cache->populating = TRUE;
+  add_children (3);
+  settle ();
+  g_assert_false (spi_global_cache->populating);
+  g_assert_cmpuint (take_signal_count ("PopulationProgress"), ==, 1);
+  g_assert_cmpuint (take_signal_count ("AddAccessibles"), ==, 0);
+  g_assert_cmpuint (take_signal_count ("AddAccessible"), ==, 0);
+
+  remove_children (6);
+  settle ();
+}
+
+static void
+record_progress (SpiCache *cache, guint n_cached, guint n_pending, GArray *progress)
+{
+  guint counts[2] = { n_cached, n_pending };
+
+  g_array_append_vals (progress, counts, 2);
+}
+
+static guint
+count_subtree (AtkObject *obj)
+{
+  GPtrArray *children = MY_ATK_OBJECT (obj)->children;
+  guint i, count = 1;
+
+  for (i = 0; i < children->len; i++)
+    count += count_subtree (g_ptr_array_index (children, i));
+  return count;
+}
+
+/*
+ * The initial population of a cache is walked in slices, each followed by a
+ * progress signal, without queueing all the children of a wide object at
+ * once.
+ *
+ * This has to run last: finalizing a second cache disconnects the
+ * toplevel listener of the global one.
+ */
+static void
+test_population_slices (void)
+{
+  AtkObject *wide = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  GArray *progress = g_array_new (FALSE, FALSE, sizeof (guint));
+  SpiCache *cache;
+  guint i, n_final = 0, last_cached = 0;
+
+  for (i = 0; i < 20000; i++)
+    add_child (wide);
+  my_atk_object_add_child (MY_ATK_OBJECT (root_accessible), MY_ATK_OBJECT (wide));
+  g_object_unref (wide);
+
+  cache = g_object_new (SPI_CACHE_TYPE, NULL);
+  g_signal_connect (cache, "population-progress", (GCallback) record_progress, progress);
+  while (cache->populating)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (progress->len / 2, >, 1);
+  for (i = 0; i < progress->len; i += 2)
+    {
+      guint n_cached = g_array_index (progress, guint, i);
+      guint n_pending = g_array_index (progress, guint, i + 1);
+
+      g_assert_cmpuint (n_cached, >=, last_cached);
+      g_assert_cmpuint (n_pending, <, 1000);
+      if (n_pending == 0)
+        n_final++;
+      last_cached = n_cached;
+    }
+  g_assert_cmpuint (n_final, ==, 1);
+  g_assert_cmpuint (g_array_index (progress, guint, progress->len - 1), ==, 0);
+  g_assert_cmpuint (last_cached, ==, count_subtree (root_accessible));
+  g_assert_cmpuint (g_hash_table_size (cache->objects), ==, last_cached);
+
+  g_signal_handlers_disconnect_by_func (cache, record_progress, progress);
+  g_object_unref (cache);
+  g_array_unref (progress);
+  my_atk_object_remove_child (MY_ATK_OBJECT (root_accessible), MY_ATK_OBJECT (wide));
+  settle ();
+}
+
+/*
+ * In lazy mode, added subtrees are cached one level deep, GetItemsPaged
+ * leaves them so, and GetChildren caches one more level
+ */
+static void
+test_lazy_children (void)
+{
+  DBusConnection *bus = spi_global_app_data->bus;
+  dbus_uint32_t generation = 0, max_items = 0;
+  AtkObject *child, *grandchild, *great_grandchild;
+  guint n_unexpanded, n_never_expanded, n_never_expanded_before;
+  DBusMessage *message;
+  gchar *path;
+
+  activate ();
+  spi_global_cache->lazy_children = TRUE;
+  spi_cache_get_lazy_counters (spi_global_cache, NULL, &n_never_expanded_before);
+
+  child = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  grandchild = add_child (child);
+  great_grandchild = add_child (grandchild);
+  my_atk_object_add_child (MY_ATK_OBJECT (root_accessible), MY_ATK_OBJECT (child));
+  g_object_unref (child);
+  settle ();
+  g_assert_true (spi_cache_in (spi_global_cache, G_OBJECT (child)));
+  g_assert_false (spi_cache_in (spi_global_cache, G_OBJECT (grandchild)));
+  spi_cache_get_lazy_counters (spi_global_cache, &n_unexpanded, NULL);
+  g_assert_cmpuint (n_unexpanded, ==, 1);
+
+  dbus_message_unref (call_cache ("GetItemsPaged",
+                                  DBUS_TYPE_UINT32, &generation,
+                                  DBUS_TYPE_UINT32, &max_items,
+                                  DBUS_TYPE_INVALID));
+  settle ();
+  g_assert_false (spi_cache_in (spi_global_cache, G_OBJECT (grandchild)));
+
+  path = spi_register_object_to_path (spi_global_register, G_OBJECT (child));
+  message = dbus_message_new_method_call (dbus_bus_get_unique_name (bus), path,
+                                          ATSPI_DBUS_INTERFACE_ACCESSIBLE,
+                                          "GetChildren");
+  dbus_message_unref (send_call (message));
+  g_free (path);
+  g_assert_true (spi_cache_in (spi_global_cache, G_OBJECT (grandchild)));
+  g_assert_false (spi_cache_in (spi_global_cache, G_OBJECT (great_grandchild)));
+  spi_cache_get_lazy_counters (spi_global_cache, &n_unexpanded, NULL);
+  g_assert_cmpuint (n_unexpanded, ==, 1);
+
+  /* The grandchild goes away without being expanded */
+  my_atk_object_remove_child (MY_ATK_OBJECT (root_accessible), MY_ATK_OBJECT (child));
+  settle ();
+  spi_cache_get_lazy_counters (spi_global_cache, &n_unexpanded, &n_never_expanded);
+  g_assert_cmpuint (n_unexpanded, ==, 0);
+  g_assert_cmpuint (n_never_expanded, ==, n_never_expanded_before + 1);
+
+  spi_global_cache->lazy_children = FALSE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  DBusConnection *bus;
+  int result;
+
+  g_test_init (&argc, &argv, NULL);
+
+  setup_atk_util ();
+  root_accessible = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  atk_object_set_role (root_accessible, ATK_ROLE_APPLICATION);
+
+  if (atk_bridge_adaptor_init (&argc, &argv) != 0)
+    {
+      g_print ("could not connect to the accessibility bus; skipping\n");
+      return 77;
+    }
+
+  bus = spi_global_app_data->bus;
+  signal_counts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  dbus_connection_add_filter (bus, signal_filter, NULL, NULL);
+  dbus_bus_add_match (bus, "type='signal',interface='" ATSPI_DBUS_INTERFACE_CACHE "'", NULL);
+  dbus_bus_add_match (bus, "type='signal',interface='" ATSPI_DBUS_INTERFACE_EVENT_OBJECT "'", NULL);
+  /* Lets the bridge see the listener signals that we send ourselves */
+  dbus_bus_add_match (bus, "type='signal',interface='" ATSPI_DBUS_INTERFACE_REGISTRY "'", NULL);
+
+  g_test_add_func ("/bridge/cache-signals", test_cache_signals);
+  g_test_add_func ("/bridge/cache-records", test_cache_records);
+  g_test_add_func ("/bridge/register-reuse", test_register_reuse);
+  g_test_add_func ("/bridge/leasing", test_leasing);
+  g_test_add_func ("/bridge/event-listeners", test_event_listeners);
+  g_test_add_func ("/bridge/event-coalescing", test_event_coalescing);
+  g_test_add_func ("/bridge/population-signals", test_population_signals);
+  g_test_add_func ("/bridge/lazy-children", test_lazy_children);
+  g_test_add_func ("/bridge/population-slices", test_population_slices);
+
+  result = g_test_run ();
+
+  dbus_connection_remove_filter (bus, signal_filter, NULL);
+  atk_bridge_adaptor_cleanup ();
+  g_hash_table_unref (signal_counts);
+  g_object_unref (root_accessible);
+  return result;
+}
@@ -0,0 +1,292 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures Collection.GetMatches, and snapshots of the whole tree with
+ * GetTreeWithLimits and GetTreeBlob, over a generated tree of about 100k
+ * objects, loaded with the XML loader and exported by the ATK bridge.
+ * The calls are sent to the bridge's own connection, so an accessibility
+ * bus is needed; the benchmark is skipped if the bridge cannot connect.
+ */
+
+#include "atk-object-xml-loader.h"
+#include "bridge.h"
+#include "my-atk.h"
+#include "spi-dbus.h"
+#include <atk-bridge.h>
+#include <atk/atk.h>
+#include <dbus/dbus.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BRANCHING 10
+#define DEPTH 5
+#define N_RUNS 5
+#define ROLE_WORDS ((ATSPI_ROLE_COUNT + 31) / 32)
+#define STATE_WORDS 2
+
+static AtkObject *root_accessible;
+
+static AtkObject *
+get_root (void)
+{
+  return root_accessible;
+}
+
+static const gchar *
+get_toolkit_name (void)
+{
+  return "atspitesting-toolkit";
+}
+
+static void
+setup_atk_util (void)
+{
+  AtkUtilClass *klass;
+
+  klass = g_type_class_ref (ATK_TYPE_UTIL);
+  klass->get_root = get_root;
+  klass->get_toolkit_name = get_toolkit_name;
+  g_type_class_unref (klass);
+}
+
+static void
+generate_node (GString *xml, gint depth, guint *n_nodes)
+{
+  static const char *roles[] = { "heading", "paragraph", "link", "push button" };
+  guint n = (*n_nodes)++;
+  const char *element = (n % 4 == 0 ? "accessible_text" : "accessible");
+  gint i;
+
+  g_string_append_printf (xml, "<%s name=\"node%u\" role=\"%s\">",
+                          element, n, roles[n % G_N_ELEMENTS (roles)]);
+  if (n % 2)
+    g_string_append (xml, "<state state_enum=\"showing\"/>");
+  if (depth < DEPTH)
+    for (i = 0; i < BRANCHING; i++)
+      generate_node (xml, depth + 1, n_nodes);
+  g_string_append_printf (xml, "</%s>", element);
+}
+
+static AtkObject *
+load_tree (guint *n_nodes)
+{
+  GString *xml = g_string_new ("<?xml version=\"1.0\" ?>");
+  GError *error = NULL;
+  MyAtkObject *root;
+  gchar *filename;
+  gint fd;
+
+  *n_nodes = 0;
+  generate_node (xml, 0, n_nodes);
+
+  fd = g_file_open_tmp ("collection-benchmark-XXXXXX.xml", &filename, &error);
+  g_assert_no_error (error);
+  g_close (fd, NULL);
+  g_file_set_contents (filename, xml->str, xml->len, &error);
+  g_assert_no_error (error);
+  g_string_free (xml, TRUE);
+
+  root = atk_object_xml_parse (filename);
+  g_unlink (filename);
+  g_free (filename);
+  return ATK_OBJECT (root);
+}
+
+static void
+append_bits (DBusMessageIter *iter, gint bit, gint n_words)
+{
+  dbus_int32_t words[ROLE_WORDS] = { 0 };
+  const dbus_int32_t *p = words;
+  DBusMessageIter iter_array;
+
+  if (bit >= 0)
+    words[bit / 32] |= 1u << (bit % 32);
+  dbus_message_iter_open_container (iter, DBUS_TYPE_ARRAY, "i", &iter_array);
+  dbus_message_iter_append_fixed_array (&iter_array, DBUS_TYPE_INT32, &p, n_words);
+  dbus_message_iter_close_container (iter, &iter_array);
+}
+
+static DBusMessage *
+new_get_matches (gint state, gint role, const char *iface)
+{
+  DBusMessage *message;
+  DBusMessageIter iter, iter_struct, iter_array;
+  dbus_int32_t match_all = ATSPI_Collection_MATCH_ALL;
+  dbus_uint32_t sortby = ATSPI_Collection_SORT_ORDER_CANONICAL;
+  dbus_int32_t count = 0;
+  dbus_bool_t b = FALSE, traverse = TRUE;
+
+  message = dbus_message_new_method_call (dbus_bus_get_unique_name (spi_global_app_data->bus),
+                                          SPI_DBUS_PATH_ROOT,
+                                          ATSPI_DBUS_INTERFACE_COLLECTION,
+                                          "GetMatches");
+  dbus_message_iter_init_append (message, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+  append_bits (&iter_struct, state, STATE_WORDS);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &match_all);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "{ss}", &iter_array);
+  dbus_message_iter_close_container (&iter_struct, &iter_array);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &match_all);
+  append_bits (&iter_struct, role, ROLE_WORDS);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &match_all);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "s", &iter_array);
+  if (iface)
+    dbus_message_iter_append_basic (&iter_array, DBUS_TYPE_STRING, &iface);
+  dbus_message_iter_close_container (&iter_struct, &iter_array);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &match_all);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_BOOLEAN, &b);
+  dbus_message_iter_close_container (&iter, &iter_struct);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_UINT32, &sortby);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &count);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_BOOLEAN, &traverse);
+  return message;
+}
+
+static guint
+count_matches (DBusMessage *reply)
+{
+  DBusMessageIter iter, iter_array;
+  guint n = 0;
+
+  g_assert_cmpstr (dbus_message_get_signature (reply), ==, "a(so)");
+  dbus_message_iter_init (reply, &iter);
+  dbus_message_iter_recurse (&iter, &iter_array);
+  while (dbus_message_iter_get_arg_type (&iter_array) != DBUS_TYPE_INVALID)
+    {
+      n++;
+      dbus_message_iter_next (&iter_array);
+    }
+  return n;
+}
+
+static DBusMessage *
+send_and_wait (DBusMessage *message)
+{
+  DBusPendingCall *pending = NULL;
+  DBusMessage *reply;
+
+  dbus_connection_send_with_reply (spi_global_app_data->bus, message,
+                                   &pending, 60000);
+  dbus_message_unref (message);
+  g_assert_nonnull (pending);
+  while (!dbus_pending_call_get_completed (pending))
+    g_main_context_iteration (NULL, TRUE);
+  reply = dbus_pending_call_steal_reply (pending);
+  dbus_pending_call_unref (pending);
+  return reply;
+}
+
+static void
+run_query (const char *description, gint state, gint role, const char *iface)
+{
+  GTimer *timer = g_timer_new ();
+  guint n_matches = 0;
+  gint i;
+
+  for (i = 0; i < N_RUNS; i++)
+    {
+      DBusMessage *reply = send_and_wait (new_get_matches (state, role, iface));
+
+      n_matches = count_matches (reply);
+      dbus_message_unref (reply);
+    }
+  g_timer_stop (timer);
+
+  g_print ("%s: %u matches, %.3f s per query\n", description, n_matches,
+           g_timer_elapsed (timer, NULL) / N_RUNS);
+  g_timer_destroy (timer);
+}
+
+static void
+run_snapshot (const char *method)
+{
+  GTimer *timer = g_timer_new ();
+  dbus_int32_t max_depth = 0, max_nodes = 0;
+  char *marshalled = NULL;
+  int size = 0;
+  gint i;
+
+  for (i = 0; i < N_RUNS; i++)
+    {
+      DBusMessage *message, *reply;
+      DBusMessageIter iter, iter_array;
+
+      message = dbus_message_new_method_call (dbus_bus_get_unique_name (spi_global_app_data->bus),
+                                              SPI_DBUS_PATH_ROOT,
+                                              ATSPI_DBUS_INTERFACE_COLLECTION,
+                                              method);
+      dbus_message_iter_init_append (message, &iter);
+      if (!strcmp (method, "GetTreeWithLimits"))
+        {
+          dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "s", &iter_array);
+          dbus_message_iter_close_container (&iter, &iter_array);
+        }
+      dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &max_depth);
+      dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &max_nodes);
+
+      reply = send_and_wait (message);
+      g_assert_cmpint (dbus_message_get_type (reply), ==, DBUS_MESSAGE_TYPE_METHOD_RETURN);
+      if (i == 0)
+        {
+          dbus_message_marshal (reply, &marshalled, &size);
+          dbus_free (marshalled);
+        }
+      dbus_message_unref (reply);
+    }
+  g_timer_stop (timer);
+
+  g_print ("%s: %d bytes, %.3f s per snapshot\n", method, size,
+           g_timer_elapsed (timer, NULL) / N_RUNS);
+  g_timer_destroy (timer);
+}
+
+int
+main (int argc, char *argv[])
+{
+  guint n_nodes;
+
+  setup_atk_util ();
+  root_accessible = load_tree (&n_nodes);
+  g_print ("generated %u objects\n", n_nodes);
+
+  if (atk_bridge_adaptor_init (&argc, &argv) != 0)
+    {
+      g_print ("could not connect to the accessibility bus; skipping\n");
+      return 77;
+    }
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  run_query ("role heading", -1, ATSPI_ROLE_HEADING, NULL);
+  run_query ("state showing", ATSPI_STATE_SHOWING, -1, NULL);
+  run_query ("interface text", -1, -1, "text");
+  run_query ("showing headings with text", ATSPI_STATE_SHOWING,
+             ATSPI_ROLE_HEADING, "text");
+  run_snapshot ("GetTreeWithLimits");
+  run_snapshot ("GetTreeBlob");
+
+  atk_bridge_adaptor_cleanup ();
+  g_object_unref (root_accessible);
+
+  return EXIT_SUCCESS;
+}
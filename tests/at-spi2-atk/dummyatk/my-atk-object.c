@@ -55,9 +55,12 @@ my_atk_object_remove_child (MyAtkObject *parent,
       if (g_ptr_array_index (parent->children, i) == child)
         break;
     }
-  g_return_if_fail (i < 0);
+  g_return_if_fail (i >= 0);
+  /* The array holds the reference that the parent took in add_child */
+  g_object_ref (child);
   g_ptr_array_remove_index (parent->children, i);
   g_signal_emit_by_name (parent, "children-changed::remove", i, child);
+  g_object_unref (child);
 }
 
 static void
@@ -0,0 +1,103 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures the cost of turning ATK signals into AT-SPI events, by firing
+ * text-changed signals at an object exported by the ATK bridge.  Needs an
+ * accessibility bus; the benchmark is skipped if the bridge cannot connect.
+ */
+
+#include "bridge.h"
+#include "my-atk.h"
+#include <atk-bridge.h>
+#include <atk/atk.h>
+#include <dbus/dbus.h>
+#include <glib.h>
+#include <stdlib.h>
+
+#define N_EVENTS 1000000
+#define EVENTS_PER_FLUSH 1000
+
+static AtkObject *root_accessible;
+
+static AtkObject *
+get_root (void)
+{
+  return root_accessible;
+}
+
+static const gchar *
+get_toolkit_name (void)
+{
+  return "atspitesting-toolkit";
+}
+
+static void
+setup_atk_util (void)
+{
+  AtkUtilClass *klass;
+
+  klass = g_type_class_ref (ATK_TYPE_UTIL);
+  klass->get_root = get_root;
+  klass->get_toolkit_name = get_toolkit_name;
+  g_type_class_unref (klass);
+}
+
+int
+main (int argc, char *argv[])
+{
+  AtkObject *text;
+  GTimer *timer;
+  guint i;
+
+  setup_atk_util ();
+  root_accessible = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  text = g_object_new (MY_TYPE_ATK_TEXT, NULL);
+  atk_object_set_role (text, ATK_ROLE_TEXT);
+  my_atk_object_add_child (MY_ATK_OBJECT (root_accessible), MY_ATK_OBJECT (text));
+
+  if (atk_bridge_adaptor_init (&argc, &argv) != 0)
+    {
+      g_print ("could not connect to the accessibility bus; skipping\n");
+      return 77;
+    }
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  timer = g_timer_new ();
+  for (i = 0; i < N_EVENTS; i++)
+    {
+      g_signal_emit_by_name (text, "text-insert", i % 100, 1, "x");
+      if (i % EVENTS_PER_FLUSH == EVENTS_PER_FLUSH - 1)
+        dbus_connection_flush (spi_global_app_data->bus);
+    }
+  dbus_connection_flush (spi_global_app_data->bus);
+  g_timer_stop (timer);
+
+  g_print ("sent %d text-changed events in %.3f s\n", N_EVENTS,
+           g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+
+  atk_bridge_adaptor_cleanup ();
+  g_object_unref (text);
+  g_object_unref (root_accessible);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,162 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures the cost of turning registered objects into D-Bus references,
+ * and of resolving the paths of incoming calls back to the objects, using
+ * the register of the ATK bridge without a bus connection.  Also measures
+ * renewing the leases that keep referenced objects alive.
+ */
+
+#include "accessible-leasing.h"
+#include "accessible-register.h"
+#include "bridge.h"
+#include "my-atk.h"
+#include <atk/atk.h>
+#include <dbus/dbus.h>
+#include <glib.h>
+#include <stdlib.h>
+
+#define N_OBJECTS 1000
+#define N_REFERENCES 1000000
+#define REFERENCES_PER_MESSAGE 10000
+
+static SpiBridge app_data;
+
+static void
+marshal_references (AtkObject **objects)
+{
+  const char *name = ":1.0";
+  DBusMessage *message = NULL;
+  DBusMessageIter iter, iter_array, iter_struct;
+  GTimer *timer;
+  guint i;
+
+  timer = g_timer_new ();
+  for (i = 0; i < N_REFERENCES; i++)
+    {
+      const gchar *path;
+
+      if (i % REFERENCES_PER_MESSAGE == 0)
+        {
+          if (message)
+            {
+              dbus_message_iter_close_container (&iter, &iter_array);
+              dbus_message_unref (message);
+            }
+          message = dbus_message_new_signal ("/org/a11y/atspi/cache",
+                                             "org.a11y.atspi.Cache",
+                                             "RemoveAccessibles");
+          dbus_message_iter_init_append (message, &iter);
+          dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "(so)",
+                                            &iter_array);
+        }
+
+      path = spi_register_object_to_static_path (spi_global_register,
+                                                 G_OBJECT (objects[i % N_OBJECTS]));
+      dbus_message_iter_open_container (&iter_array, DBUS_TYPE_STRUCT, NULL,
+                                        &iter_struct);
+      dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
+      dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &path);
+      dbus_message_iter_close_container (&iter_array, &iter_struct);
+    }
+  dbus_message_iter_close_container (&iter, &iter_array);
+  dbus_message_unref (message);
+  g_timer_stop (timer);
+
+  g_print ("marshalled %d references in %.3f s\n", N_REFERENCES,
+           g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+}
+
+static void
+resolve_paths (AtkObject **objects)
+{
+  gchar *paths[N_OBJECTS];
+  GTimer *timer;
+  guint i;
+
+  for (i = 0; i < N_OBJECTS; i++)
+    paths[i] = spi_register_object_to_path (spi_global_register,
+                                            G_OBJECT (objects[i]));
+
+  timer = g_timer_new ();
+  for (i = 0; i < N_REFERENCES; i++)
+    {
+      GObject *obj = spi_register_path_to_object (spi_global_register,
+                                                  paths[i % N_OBJECTS]);
+      if (obj != G_OBJECT (objects[i % N_OBJECTS]))
+        g_error ("%s resolved to the wrong object", paths[i % N_OBJECTS]);
+    }
+  g_timer_stop (timer);
+
+  g_print ("resolved %d paths in %.3f s\n", N_REFERENCES,
+           g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+
+  for (i = 0; i < N_OBJECTS; i++)
+    g_free (paths[i]);
+}
+
+static void
+renew_leases (AtkObject **objects)
+{
+  SpiLeasing *leasing = g_object_new (SPI_LEASING_TYPE, NULL);
+  GTimer *timer;
+  guint i;
+
+  timer = g_timer_new ();
+  for (i = 0; i < N_REFERENCES; i++)
+    spi_leasing_take (leasing, G_OBJECT (objects[i % N_OBJECTS]));
+  g_timer_stop (timer);
+
+  g_print ("renewed %d leases in %.3f s\n", N_REFERENCES,
+           g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+
+  g_object_unref (leasing);
+}
+
+int
+main (int argc, char *argv[])
+{
+  AtkObject *objects[N_OBJECTS];
+  guint i;
+
+  app_data.root = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+  spi_global_app_data = &app_data;
+  spi_global_register = g_object_new (SPI_REGISTER_TYPE, NULL);
+
+  for (i = 0; i < N_OBJECTS; i++)
+    objects[i] = g_object_new (MY_TYPE_ATK_OBJECT, NULL);
+
+  marshal_references (objects);
+  resolve_paths (objects);
+  renew_leases (objects);
+
+  for (i = 0; i < N_OBJECTS; i++)
+    g_object_unref (objects[i]);
+
+  g_clear_object (&spi_global_register);
+  g_object_unref (app_data.root);
+  spi_global_app_data = NULL;
+
+  return EXIT_SUCCESS;
+}
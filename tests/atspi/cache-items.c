@@ -0,0 +1,323 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Checks how the cache of an application is fetched with GetItemsPaged:
+ * paging, removals, resets, and requests asked for while one is in
+ * flight.  The application is played by this process, which answers the
+ * calls that it makes to itself. */
+
+#include "atspi/atspi-application-private.h"
+#include "atspi/atspi-misc-private.h"
+#include "atspi/atspi.h"
+#include <dbus/dbus.h>
+
+/* GetItemsPaged calls waiting for an answer, oldest first */
+static GQueue requests = G_QUEUE_INIT;
+
+static gchar *
+item_path (gint i)
+{
+  return g_strdup_printf ("/org/a11y/atspi/accessible/%d", i);
+}
+
+static DBusHandlerResult
+application_filter (DBusConnection *bus, DBusMessage *message, void *data)
+{
+  if (dbus_message_is_method_call (message, ATSPI_DBUS_INTERFACE_APPLICATION,
+                                   "GetApplicationBusAddress"))
+    {
+      DBusMessage *reply = dbus_message_new_method_return (message);
+      const char *address = "";
+
+      /* No peer-to-peer connection; everything goes through the bus */
+      dbus_message_append_args (reply, DBUS_TYPE_STRING, &address,
+                                DBUS_TYPE_INVALID);
+      dbus_connection_send (bus, reply, NULL);
+      dbus_message_unref (reply);
+      return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+  if (dbus_message_is_method_call (message, ATSPI_DBUS_INTERFACE_CACHE,
+                                   "GetItemsPaged"))
+    {
+      g_queue_push_tail (&requests, dbus_message_ref (message));
+      return DBUS_HANDLER_RESULT_HANDLED;
+    }
+
+  return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+}
+
+/* Lets everything that was sent so far come back and be handled */
+static void
+settle (void)
+{
+  DBusConnection *bus = atspi_get_a11y_bus ();
+  gint i;
+
+  /* Handling a message may send another one, so go around a few times */
+  for (i = 0; i < 4; i++)
+    {
+      DBusMessage *message, *reply;
+
+      /* The bus keeps messages in order, so what we sent has come back to
+       * us by the time that the reply to a later call has */
+      message = dbus_message_new_method_call (DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                                              DBUS_INTERFACE_DBUS, "GetId");
+      reply = dbus_connection_send_with_reply_and_block (bus, message, -1, NULL);
+      dbus_message_unref (message);
+      if (reply)
+        dbus_message_unref (reply);
+      while (dbus_connection_dispatch (bus) == DBUS_DISPATCH_DATA_REMAINS)
+        ;
+      while (g_main_context_iteration (NULL, FALSE))
+        ;
+    }
+}
+
+static void
+append_item (DBusMessageIter *iter_array, gint i, gint parent, gint index)
+{
+  DBusMessageIter iter_struct, iter_sub;
+  const char *sender = dbus_bus_get_unique_name (atspi_get_a11y_bus ());
+  const char *app_path = ATSPI_DBUS_PATH_ROOT;
+  const char *iface = ATSPI_DBUS_INTERFACE_ACCESSIBLE;
+  const char *name = "item";
+  const char *description = "";
+  gchar *path = item_path (i);
+  gchar *parent_path = (parent ? item_path (parent) : g_strdup (ATSPI_DBUS_PATH_NULL));
+  dbus_int32_t d_index = index;
+  dbus_int32_t child_count = 0;
+  dbus_uint32_t role = ATSPI_ROLE_LIST_ITEM;
+  dbus_uint32_t states[2] = { 1 << ATSPI_STATE_ENABLED, 0 };
+  guint j;
+
+  dbus_message_iter_open_container (iter_array, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL, &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_OBJECT_PATH, &path);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL, &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_OBJECT_PATH, &app_path);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL, &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_OBJECT_PATH, &parent_path);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &d_index);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &child_count);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "s", &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &iface);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_UINT32, &role);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &description);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "u", &iter_sub);
+  for (j = 0; j < 2; j++)
+    dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_UINT32, &states[j]);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_close_container (iter_array, &iter_struct);
+
+  g_free (path);
+  g_free (parent_path);
+}
+
+/* Checks that exactly one GetItemsPaged call is waiting, for @generation */
+static void
+check_request (guint generation)
+{
+  DBusMessage *request;
+  dbus_uint32_t d_generation, max_items;
+
+  g_assert_cmpuint (g_queue_get_length (&requests), ==, 1);
+  request = g_queue_peek_head (&requests);
+  g_assert_true (dbus_message_get_args (request, NULL,
+                                        DBUS_TYPE_UINT32, &d_generation,
+                                        DBUS_TYPE_UINT32, &max_items,
+                                        DBUS_TYPE_INVALID));
+  g_assert_cmpuint (d_generation, ==, generation);
+}
+
+/*
+ * Answers the oldest GetItemsPaged call.  @removed lists the objects to
+ * remove and @items the objects to add, as children of object 1, each
+ * ending with 0.
+ */
+static void
+reply_page (dbus_bool_t reset,
+            const gint *removed,
+            dbus_uint32_t next_generation,
+            dbus_bool_t complete,
+            const gint *items)
+{
+  DBusConnection *bus = atspi_get_a11y_bus ();
+  const char *sender = dbus_bus_get_unique_name (bus);
+  DBusMessage *request, *reply;
+  DBusMessageIter iter, iter_array, iter_struct;
+  gint i;
+
+  request = g_queue_pop_head (&requests);
+  g_assert_nonnull (request);
+  reply = dbus_message_new_method_return (request);
+  dbus_message_unref (request);
+
+  dbus_message_iter_init_append (reply, &iter);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_BOOLEAN, &reset);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY, "(so)", &iter_array);
+  for (i = 0; removed[i]; i++)
+    {
+      gchar *path = item_path (removed[i]);
+
+      dbus_message_iter_open_container (&iter_array, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+      dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &sender);
+      dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &path);
+      dbus_message_iter_close_container (&iter_array, &iter_struct);
+      g_free (path);
+    }
+  dbus_message_iter_close_container (&iter, &iter_array);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_UINT32, &next_generation);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_BOOLEAN, &complete);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY,
+                                    "((so)(so)(so)iiassusau)", &iter_array);
+  for (i = 0; items[i]; i++)
+    {
+      if (items[i] == 1)
+        append_item (&iter_array, 1, 0, -1);
+      else
+        append_item (&iter_array, items[i], 1, items[i] - 2);
+    }
+  dbus_message_iter_close_container (&iter, &iter_array);
+
+  dbus_connection_send (bus, reply, NULL);
+  dbus_message_unref (reply);
+}
+
+static void
+emit_population_progress (void)
+{
+  DBusMessage *message;
+  dbus_uint32_t n_cached = 1, n_pending = 1;
+
+  message = dbus_message_new_signal ("/org/a11y/atspi/cache",
+                                     ATSPI_DBUS_INTERFACE_CACHE,
+                                     "PopulationProgress");
+  dbus_message_append_args (message,
+                            DBUS_TYPE_UINT32, &n_cached,
+                            DBUS_TYPE_UINT32, &n_pending,
+                            DBUS_TYPE_INVALID);
+  dbus_connection_send (atspi_get_a11y_bus (), message, NULL);
+  dbus_message_unref (message);
+}
+
+static gboolean
+is_cached (AtspiApplication *app, gint i)
+{
+  gchar *path = item_path (i);
+  gboolean cached = g_hash_table_contains (app->hash, path);
+
+  g_free (path);
+  return cached;
+}
+
+static void
+test_cache_items (void)
+{
+  static const gint none[] = { 0 };
+  DBusConnection *bus;
+  AtspiApplication *app;
+  AtspiApplicationPrivate *priv;
+  AtspiAccessible *top;
+  gchar *path;
+  gint i;
+
+  if (atspi_init () == 2)
+    {
+      g_test_skip ("no accessibility bus");
+      return;
+    }
+  bus = atspi_get_a11y_bus ();
+  dbus_connection_add_filter (bus, application_filter, NULL, NULL);
+
+  /* Looking up an object of an application starts fetching its cache */
+  path = item_path (1);
+  top = _atspi_ref_accessible (dbus_bus_get_unique_name (bus), path);
+  g_free (path);
+  atspi_accessible_set_cache_mask (top, ATSPI_CACHE_DEFAULT);
+  app = top->parent.app;
+  priv = _atspi_application_get_private (app);
+  settle ();
+  check_request (0);
+
+  /* An incomplete page is followed by a request for the next one */
+  reply_page (FALSE, none, 5, FALSE, (const gint[]) { 1, 2, 3, 0 });
+  settle ();
+  check_request (5);
+  g_assert_true (is_cached (app, 2));
+  g_assert_true (is_cached (app, 3));
+
+  /* Asking again while a request is in flight makes one more request,
+   * once that one is answered */
+  for (i = 0; i < 3; i++)
+    emit_population_progress ();
+  settle ();
+  check_request (5);
+
+  /* Removals since the generation asked for are dropped */
+  reply_page (FALSE, (const gint[]) { 2, 0 }, 8, TRUE, (const gint[]) { 4, 0 });
+  settle ();
+  g_assert_false (is_cached (app, 2));
+  g_assert_true (is_cached (app, 3));
+  g_assert_true (is_cached (app, 4));
+  check_request (8);
+  reply_page (FALSE, none, 8, TRUE, none);
+  settle ();
+  g_assert_cmpuint (g_queue_get_length (&requests), ==, 0);
+  g_assert_null (priv->cache_request);
+  g_assert_cmpuint (priv->cache_generation, ==, 8);
+
+  /* After a reset, what does not come back by the last page is dropped */
+  emit_population_progress ();
+  settle ();
+  check_request (8);
+  reply_page (TRUE, none, 3, FALSE, (const gint[]) { 1, 0 });
+  settle ();
+  check_request (3);
+  g_assert_true (is_cached (app, 4));
+  reply_page (FALSE, none, 4, TRUE, (const gint[]) { 3, 0 });
+  settle ();
+  g_assert_cmpuint (g_queue_get_length (&requests), ==, 0);
+  g_assert_true (is_cached (app, 1));
+  g_assert_true (is_cached (app, 3));
+  g_assert_false (is_cached (app, 4));
+  g_assert_null (priv->stale);
+  g_assert_true (top->cached_properties & ATSPI_CACHE_NAME);
+
+  dbus_connection_remove_filter (bus, application_filter, NULL);
+  g_object_unref (top);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_setenv ("ATSPI_IN_TESTS", "1", TRUE);
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/cache-items/paged", test_cache_items);
+  return g_test_run ();
+}
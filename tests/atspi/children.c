@@ -0,0 +1,210 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Checks the lists of cached children against plain arrays, over random
+ * edits of two lists that share some of their objects */
+
+#include "atspi/atspi.h"
+
+#include "atspi/atspi-children-private.h"
+
+#define N_OBJECTS 6000
+#define N_STEPS 40000
+#define CHECK_INTERVAL 250
+
+typedef struct
+{
+  AtspiChildren children;
+  GPtrArray *reference;
+} ChildrenList;
+
+static AtspiAccessible *objects[N_OBJECTS];
+
+static gboolean
+reference_contains (ChildrenList *list, AtspiAccessible *obj)
+{
+  return g_ptr_array_find (list->reference, obj, NULL);
+}
+
+/* Returns an object that is not in list, or NULL if none was found */
+static AtspiAccessible *
+pick_new_child (ChildrenList *list)
+{
+  gint tries;
+
+  for (tries = 0; tries < 8; tries++)
+    {
+      AtspiAccessible *obj = objects[g_test_rand_int_range (0, N_OBJECTS)];
+      if (!reference_contains (list, obj))
+        return obj;
+    }
+  return NULL;
+}
+
+static void
+check_list (ChildrenList *list)
+{
+  guint i;
+
+  g_assert_cmpuint (_atspi_children_get_length (&list->children), ==, list->reference->len);
+  g_assert_null (_atspi_children_get (&list->children, list->reference->len));
+  for (i = 0; i < list->reference->len; i++)
+    {
+      AtspiAccessible *child = g_ptr_array_index (list->reference, i);
+
+      g_assert_true (_atspi_children_get (&list->children, i) == child);
+      if (child)
+        g_assert_cmpint (_atspi_children_index_of (&list->children, child), ==, i);
+    }
+
+  /* Objects that are not in the list are not found in it */
+  for (i = 0; i < 32; i++)
+    {
+      AtspiAccessible *obj = objects[g_test_rand_int_range (0, N_OBJECTS)];
+      if (!reference_contains (list, obj))
+        g_assert_cmpint (_atspi_children_index_of (&list->children, obj), ==, -1);
+    }
+  g_assert_cmpint (_atspi_children_index_of (&list->children, NULL), ==, -1);
+}
+
+static void
+random_step (ChildrenList *list)
+{
+  guint len = list->reference->len;
+  AtspiAccessible *obj;
+  guint index;
+
+  switch (g_test_rand_int_range (0, 8))
+    {
+    case 0:
+    case 1:
+    case 2:
+      obj = pick_new_child (list);
+      if (!obj)
+        break;
+      index = g_test_rand_int_range (0, len + 1);
+      _atspi_children_insert (&list->children, index, obj);
+      g_ptr_array_insert (list->reference, index, obj);
+      break;
+    case 3:
+      if (len == 0)
+        break;
+      index = g_test_rand_int_range (0, len);
+      _atspi_children_remove_index (&list->children, index);
+      g_ptr_array_remove_index (list->reference, index);
+      break;
+    case 4:
+      if (len == 0)
+        break;
+      obj = g_ptr_array_index (list->reference, g_test_rand_int_range (0, len));
+      if (!obj)
+        break;
+      g_assert_true (_atspi_children_remove (&list->children, obj));
+      g_ptr_array_remove (list->reference, obj);
+      g_assert_false (_atspi_children_remove (&list->children, obj));
+      break;
+    case 5:
+      if (len == 0)
+        break;
+      index = g_test_rand_int_range (0, len);
+      obj = (g_test_rand_bit () ? pick_new_child (list) : NULL);
+      _atspi_children_set (&list->children, index, obj);
+      g_ptr_array_index (list->reference, index) = obj;
+      break;
+    case 6:
+      /* Children that are not known yet, as when the count is fetched */
+      index = len + g_test_rand_int_range (1, 40);
+      _atspi_children_set_length (&list->children, index);
+      g_ptr_array_set_size (list->reference, index);
+      break;
+    case 7:
+      if (len == 0)
+        break;
+      index = g_test_rand_int_range (0, len);
+      _atspi_children_set_length (&list->children, index);
+      g_ptr_array_set_size (list->reference, index);
+      break;
+    }
+}
+
+static void
+test_children_random (void)
+{
+  ChildrenList lists[2];
+  AtspiAccessible *obj;
+  gint i, step;
+
+  for (i = 0; i < N_OBJECTS; i++)
+    objects[i] = g_object_new (ATSPI_TYPE_ACCESSIBLE, NULL);
+  for (i = 0; i < 2; i++)
+    {
+      _atspi_children_init (&lists[i].children);
+      lists[i].reference = g_ptr_array_new ();
+    }
+
+  /* Start with a few thousand children, so that the tree has some depth */
+  for (i = 0; i < N_OBJECTS / 2; i++)
+    {
+      _atspi_children_insert (&lists[0].children, i, objects[i]);
+      g_ptr_array_add (lists[0].reference, objects[i]);
+    }
+  check_list (&lists[0]);
+
+  for (step = 0; step < N_STEPS; step++)
+    {
+      random_step (&lists[step % 2]);
+      if (step % CHECK_INTERVAL == 0)
+        {
+          check_list (&lists[0]);
+          check_list (&lists[1]);
+        }
+    }
+  check_list (&lists[0]);
+  check_list (&lists[1]);
+
+  /* Setting an index past the end fills the gap with unknown children */
+  for (i = 0; reference_contains (&lists[1], objects[i]); i++)
+    ;
+  obj = objects[i];
+  i = lists[1].reference->len + 10;
+  _atspi_children_set (&lists[1].children, i, obj);
+  g_ptr_array_set_size (lists[1].reference, i + 1);
+  g_ptr_array_index (lists[1].reference, i) = obj;
+  check_list (&lists[1]);
+
+  for (i = 0; i < 2; i++)
+    {
+      _atspi_children_clear (&lists[i].children);
+      g_assert_cmpuint (_atspi_children_get_length (&lists[i].children), ==, 0);
+      g_assert_cmpint (_atspi_children_index_of (&lists[i].children, objects[0]), ==, -1);
+      _atspi_children_free (&lists[i].children);
+      g_ptr_array_unref (lists[i].reference);
+    }
+  for (i = 0; i < N_OBJECTS; i++)
+    g_object_unref (objects[i]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  g_test_add_func ("/children/random", test_children_random);
+  return g_test_run ();
+}
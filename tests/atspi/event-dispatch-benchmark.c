@@ -0,0 +1,217 @@
+/*
+ * AT-SPI - Assistive Technology Service Provider Interface
+ * (Gnome Accessibility Project; https://wiki.gnome.org/Accessibility)
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Measures how long libatspi takes to turn event signals into AtspiEvents
+ * and deliver them, by replaying a recorded stream of signals through
+ * _atspi_dbus_handle_event.  The signals look as if they were sent by our
+ * own connection, so an accessibility bus is needed; the benchmark is
+ * skipped if there is none.
+ */
+
+#include "atspi/atspi-event-listener-private.h"
+#include "atspi/atspi.h"
+#include <dbus/dbus.h>
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_RECORDED 1000
+#define N_OBJECTS 100
+#define N_EVENTS 1000000
+
+typedef struct
+{
+  const char *interface;
+  const char *member;
+  const char *detail;
+  char variant_type; /* 's', 'i', 'o' for an object reference, 'r' for a rect */
+  const char *type;  /* the event type that listeners should see */
+} RecordedEvent;
+
+/* The mix of events seen while tabbing through and typing into a document */
+static const RecordedEvent recorded_events[] = {
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "StateChanged", "focused", 'i', "object:state-changed:focused" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "StateChanged", "showing", 'i', "object:state-changed:showing" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "PropertyChange", "accessible-name", 's', "object:property-change:accessible-name" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "ChildrenChanged", "add", 'o', "object:children-changed:add" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "ChildrenChanged", "remove", 'o', "object:children-changed:remove" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "TextChanged", "insert", 's', "object:text-changed:insert" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "TextCaretMoved", "", 'i', "object:text-caret-moved" },
+  { ATSPI_DBUS_INTERFACE_EVENT_OBJECT, "BoundsChanged", "", 'r', "object:bounds-changed" },
+  { "org.a11y.atspi.Event.Focus", "Focus", "", 'i', "focus:" },
+  { "org.a11y.atspi.Event.Window", "Activate", "", 's', "window:activate" },
+  { "org.a11y.atspi.Event.Document", "LoadComplete", "", 'i', "document:load-complete" },
+};
+
+static guint n_received;
+
+static void
+on_event (AtspiEvent *event, void *user_data)
+{
+  n_received++;
+}
+
+static DBusMessage *
+record_signal (const RecordedEvent *recorded, const char *sender, guint n)
+{
+  DBusMessage *message;
+  DBusMessageIter iter, iter_variant, iter_struct;
+  gchar *path = g_strdup_printf ("/org/a11y/atspi/accessible/%u", n % N_OBJECTS + 1);
+  gchar *child_path = g_strdup_printf ("/org/a11y/atspi/accessible/%u", (n + 1) % N_OBJECTS + 1);
+  const char *root_path = ATSPI_DBUS_PATH_ROOT;
+  const char *string = "text";
+  dbus_int32_t detail1 = n % 2, detail2 = 0;
+  dbus_int32_t rect[4] = { 0, 0, 100, 20 };
+  gint i;
+
+  message = dbus_message_new_signal (path, recorded->interface, recorded->member);
+  dbus_message_set_sender (message, sender);
+  dbus_message_iter_init_append (message, &iter);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_STRING, &recorded->detail);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &detail1);
+  dbus_message_iter_append_basic (&iter, DBUS_TYPE_INT32, &detail2);
+  switch (recorded->variant_type)
+    {
+    case 's':
+      dbus_message_iter_open_container (&iter, DBUS_TYPE_VARIANT, "s", &iter_variant);
+      dbus_message_iter_append_basic (&iter_variant, DBUS_TYPE_STRING, &string);
+      break;
+    case 'o':
+      dbus_message_iter_open_container (&iter, DBUS_TYPE_VARIANT, "(so)", &iter_variant);
+      dbus_message_iter_open_container (&iter_variant, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+      dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &sender);
+      dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &child_path);
+      dbus_message_iter_close_container (&iter_variant, &iter_struct);
+      break;
+    case 'r':
+      dbus_message_iter_open_container (&iter, DBUS_TYPE_VARIANT, "(iiii)", &iter_variant);
+      dbus_message_iter_open_container (&iter_variant, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+      for (i = 0; i < 4; i++)
+        dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &rect[i]);
+      dbus_message_iter_close_container (&iter_variant, &iter_struct);
+      break;
+    default:
+      dbus_message_iter_open_container (&iter, DBUS_TYPE_VARIANT, "i", &iter_variant);
+      dbus_message_iter_append_basic (&iter_variant, DBUS_TYPE_INT32, &detail2);
+      break;
+    }
+  dbus_message_iter_close_container (&iter, &iter_variant);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_OBJECT_PATH, &root_path);
+  dbus_message_iter_close_container (&iter, &iter_struct);
+
+  g_free (path);
+  g_free (child_path);
+  return message;
+}
+
+static void
+on_checked_event (AtspiEvent *event, void *user_data)
+{
+  const RecordedEvent *recorded = user_data;
+
+  g_assert_cmpstr (event->type, ==, recorded->type);
+  n_received++;
+}
+
+/*
+ * Checks that each recorded signal is delivered with the event type that
+ * its listener was registered for.
+ */
+static void
+check_event_types (DBusMessage **messages)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (recorded_events); i++)
+    {
+      const RecordedEvent *recorded = &recorded_events[i];
+
+      n_received = 0;
+      atspi_event_listener_register_from_callback_shared (on_checked_event,
+                                                          (void *) recorded,
+                                                          NULL, recorded->type,
+                                                          NULL, NULL, NULL);
+      _atspi_dbus_handle_event (messages[i]);
+      atspi_event_listener_deregister_from_callback (on_checked_event,
+                                                     (void *) recorded,
+                                                     recorded->type, NULL);
+      g_assert_cmpuint (n_received, ==, 1);
+    }
+}
+
+static void
+replay (DBusMessage **messages)
+{
+  GTimer *timer;
+  guint i;
+
+  atspi_event_listener_register_from_callback_shared (on_event, NULL, NULL,
+                                                      "object:state-changed",
+                                                      NULL, NULL, NULL);
+  atspi_event_listener_register_from_callback_shared (on_event, NULL, NULL,
+                                                      "focus:", NULL, NULL,
+                                                      NULL);
+  n_received = 0;
+
+  timer = g_timer_new ();
+  for (i = 0; i < N_EVENTS; i++)
+    _atspi_dbus_handle_event (messages[i % N_RECORDED]);
+  g_timer_stop (timer);
+
+  g_print ("handled %d events (%u delivered) in %.3f s\n", N_EVENTS,
+           n_received, g_timer_elapsed (timer, NULL));
+  g_timer_destroy (timer);
+
+  atspi_event_listener_deregister_from_callback (on_event, NULL,
+                                                 "object:state-changed", NULL);
+  atspi_event_listener_deregister_from_callback (on_event, NULL, "focus:",
+                                                 NULL);
+}
+
+int
+main (int argc, char *argv[])
+{
+  DBusMessage *messages[N_RECORDED];
+  const char *sender;
+  guint i;
+
+  if (atspi_init () != 0)
+    {
+      g_print ("could not connect to the accessibility bus; skipping\n");
+      return 77;
+    }
+  sender = dbus_bus_get_unique_name (atspi_get_a11y_bus ());
+
+  for (i = 0; i < N_RECORDED; i++)
+    messages[i] = record_signal (&recorded_events[i % G_N_ELEMENTS (recorded_events)],
+                                 sender, i);
+
+  check_event_types (messages);
+  replay (messages);
+
+  for (i = 0; i < N_RECORDED; i++)
+    dbus_message_unref (messages[i]);
+  atspi_exit ();
+
+  return EXIT_SUCCESS;
+}
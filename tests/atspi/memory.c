@@ -1,12 +1,168 @@
+#include "atspi/atspi-misc-private.h"
 #include "atspi/atspi.h"
+#include <dbus/dbus.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+#include <malloc.h>
+#define HAVE_MALLINFO2
+#endif
+
+/* The size of the tree cached by measure_cache(), and the number of
+ * children of each object in it */
+#define N_CACHED 10000
+#define N_PER_PARENT 10
+
 pid_t child_pid;
 AtspiEventListener *listener;
 
+/* Returns the number of bytes allocated on the heap, or 0 if it is unknown */
+static gsize
+heap_in_use (void)
+{
+#ifdef HAVE_MALLINFO2
+  return mallinfo2 ().uordblks;
+#else
+  return 0;
+#endif
+}
+
+static gchar *
+cached_path (gint i)
+{
+  return g_strdup_printf ("/org/a11y/atspi/accessible/%d", i + 1);
+}
+
+/* Appends object i of a tree in which the children of object i are
+ * N_PER_PARENT * i + 1 onwards, as an application would describe it */
+static void
+append_cached_object (DBusMessageIter *iter_array, const char *sender, gint i)
+{
+  DBusMessageIter iter_struct, iter_sub;
+  const char *app_path = ATSPI_DBUS_PATH_ROOT;
+  const char *ifaces[] = { ATSPI_DBUS_INTERFACE_ACCESSIBLE, ATSPI_DBUS_INTERFACE_COMPONENT };
+  const char *name = (i ? "item" : "list");
+  const char *description = "";
+  gchar *path = cached_path (i);
+  gchar *parent_path = (i ? cached_path ((i - 1) / N_PER_PARENT) : g_strdup (ATSPI_DBUS_PATH_NULL));
+  dbus_int32_t index = (i ? (i - 1) % N_PER_PARENT : -1);
+  dbus_int32_t child_count = CLAMP (N_CACHED - 1 - N_PER_PARENT * i, 0, N_PER_PARENT);
+  dbus_uint32_t role = (i ? ATSPI_ROLE_LIST_ITEM : ATSPI_ROLE_APPLICATION);
+  dbus_uint32_t states[2] = { (1 << ATSPI_STATE_ENABLED) | (1 << ATSPI_STATE_SENSITIVE) |
+                                  (1 << ATSPI_STATE_SHOWING) | (1 << ATSPI_STATE_VISIBLE),
+                              0 };
+  guint j;
+
+  dbus_message_iter_open_container (iter_array, DBUS_TYPE_STRUCT, NULL, &iter_struct);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL, &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_OBJECT_PATH, &path);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL, &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_OBJECT_PATH, &app_path);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_STRUCT, NULL, &iter_sub);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &sender);
+  dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_OBJECT_PATH, &parent_path);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &index);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_INT32, &child_count);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "s", &iter_sub);
+  for (j = 0; j < G_N_ELEMENTS (ifaces); j++)
+    dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_STRING, &ifaces[j]);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &name);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_UINT32, &role);
+  dbus_message_iter_append_basic (&iter_struct, DBUS_TYPE_STRING, &description);
+  dbus_message_iter_open_container (&iter_struct, DBUS_TYPE_ARRAY, "u", &iter_sub);
+  for (j = 0; j < 2; j++)
+    dbus_message_iter_append_basic (&iter_sub, DBUS_TYPE_UINT32, &states[j]);
+  dbus_message_iter_close_container (&iter_struct, &iter_sub);
+  dbus_message_iter_close_container (iter_array, &iter_struct);
+
+  g_free (path);
+  g_free (parent_path);
+}
+
+/*
+ * Reports how much memory the cache takes for each object, by sending
+ * ourselves an AddAccessibles signal describing a tree and measuring the
+ * heap before and after it is handled, and again once every object has
+ * been asked for its state set.
+ */
+static void
+measure_cache (void)
+{
+  DBusConnection *bus = atspi_get_a11y_bus ();
+  const char *sender = dbus_bus_get_unique_name (bus);
+  DBusMessage *message, *reply;
+  DBusMessageIter iter, iter_array;
+  AtspiAccessible *top;
+  gsize before, cached;
+  gint i;
+
+  if (heap_in_use () == 0)
+    {
+      printf ("memory: heap usage is not known; not measuring the cache\n");
+      return;
+    }
+
+  message = dbus_message_new_signal ("/org/a11y/atspi/cache",
+                                     ATSPI_DBUS_INTERFACE_CACHE,
+                                     "AddAccessibles");
+  dbus_message_iter_init_append (message, &iter);
+  dbus_message_iter_open_container (&iter, DBUS_TYPE_ARRAY,
+                                    "((so)(so)(so)iiassusau)", &iter_array);
+  for (i = 0; i < N_CACHED; i++)
+    append_cached_object (&iter_array, sender, i);
+  dbus_message_iter_close_container (&iter, &iter_array);
+
+  before = heap_in_use ();
+  dbus_connection_send (bus, message, NULL);
+  dbus_message_unref (message);
+
+  /* The bus keeps messages in order, so the signal has come back to us by
+   * the time that the reply to a later call has */
+  message = dbus_message_new_method_call (DBUS_SERVICE_DBUS, DBUS_PATH_DBUS,
+                                          DBUS_INTERFACE_DBUS, "GetId");
+  reply = dbus_connection_send_with_reply_and_block (bus, message, -1, NULL);
+  dbus_message_unref (message);
+  if (reply)
+    dbus_message_unref (reply);
+  while (dbus_connection_dispatch (bus) == DBUS_DISPATCH_DATA_REMAINS)
+    ;
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+  cached = heap_in_use ();
+
+  /* Nothing answers calls to our own name, so everything must come from the
+   * cache */
+  top = _atspi_ref_accessible (sender, "/org/a11y/atspi/accessible/1");
+  atspi_accessible_set_cache_mask (top, ATSPI_CACHE_DEFAULT);
+  g_assert_cmpint (atspi_accessible_get_role (top, NULL), ==, ATSPI_ROLE_APPLICATION);
+  g_assert_cmpint (atspi_accessible_get_child_count (top, NULL), ==, N_PER_PARENT);
+  g_object_unref (top);
+
+  /* The state set of a cached object is there without being asked for */
+  for (i = 0; i < N_CACHED; i++)
+    {
+      gchar *path = cached_path (i);
+      AtspiAccessible *obj = _atspi_ref_accessible (sender, path);
+
+      g_assert_nonnull (obj->states);
+      g_assert_true (atspi_state_set_contains (obj->states, ATSPI_STATE_SHOWING));
+      g_object_unref (obj);
+      g_free (path);
+    }
+
+  printf ("memory: %d cached objects take %.1f bytes each\n",
+          N_CACHED, (double) (cached - before) / N_CACHED);
+}
+
 void
 basic (AtspiAccessible *obj)
 {
@@ -81,6 +237,8 @@ main ()
 {
   atspi_init ();
 
+  measure_cache ();
+
   listener = atspi_event_listener_new (on_event, NULL, NULL);
   atspi_event_listener_register (listener, "object:children-changed", NULL);
   child_pid = fork ();